@@ -101,10 +101,13 @@ namespace mongo {
     }
 
     inline BSONElement BSONObj::getField(const StringData& name) const {
+        // next() has already measured each field name while sizing the element, so
+        // compare lengths first and only touch the bytes of same length names
+        const int sz = name.size() + 1;
         BSONObjIterator i(*this);
         while ( i.more() ) {
             BSONElement e = i.next();
-            if ( strcmp(e.fieldName(), name.data()) == 0 )
+            if ( e.fieldNameSize() == sz && memcmp(e.fieldName(), name.data(), sz) == 0 )
                 return e;
         }
         return BSONElement();
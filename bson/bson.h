@@ -109,6 +109,7 @@ namespace mongo {
 #include "../bson/bsonobjbuilder.h"
 #include "../bson/bsonobjiterator.h"
 #include "../bson/bson-inl.h"
+#include "../bson/bsonfieldindex.h"
 
 namespace mongo {
 
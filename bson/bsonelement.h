@@ -396,6 +396,7 @@ namespace mongo {
 
         friend class BSONObjIterator;
         friend class BSONObj;
+        friend class BSONFieldIndex;
         const BSONElement& chk(int t) const {
             if ( t != type() ) {
                 StringBuilder ss;
@@ -0,0 +1,118 @@
+// bsonfieldindex.h
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace mongo {
+
+    /** An index of the top level field names of one BSONObj.
+
+        getField() on a wide object walks every element before the one wanted.  When many
+        fields of the same object are looked up (several query predicates, a projection)
+        build one of these instead: a single walk, then each lookup is a hash probe.
+
+        The indexed object must outlive the index.  reset() reuses the allocated space, so
+        keep one around and reset it per document.
+    */
+    class BSONFieldIndex {
+    public:
+        BSONFieldIndex() : _data(0), _mask(0) { }
+
+        explicit BSONFieldIndex( const BSONObj &o ) : _data(0), _mask(0) { reset( o ); }
+
+        void reset( const BSONObj &o ) {
+            _data = o.objdata();
+            _entries.clear();
+            BSONObjIterator i( o );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                Entry x;
+                x.name = e.fieldName();
+                x.len = (unsigned) e.fieldNameSize() - 1;
+                x.elem = e.rawdata();
+                _entries.push_back( x );
+            }
+
+            unsigned n = 8;
+            while ( n < _entries.size() * 2 )
+                n *= 2;
+            _mask = n - 1;
+            _table.assign( n, -1 );
+            for ( unsigned k = 0; k < _entries.size(); k++ ) {
+                const Entry &x = _entries[k];
+                unsigned h = hash( x.name, x.len ) & _mask;
+                while ( _table[h] >= 0 && !_entries[ _table[h] ].equals( x.name, x.len ) )
+                    h = ( h + 1 ) & _mask;
+                // the first of several same named fields wins, like getField()
+                if ( _table[h] < 0 )
+                    _table[h] = k;
+            }
+        }
+
+        /** @return true if this index was built for the object o (same buffer) */
+        bool covers( const BSONObj &o ) const { return _data && _data == o.objdata(); }
+
+        /** @param name need not be null terminated
+            @return the first element named name, or eoo() if there is none
+        */
+        BSONElement getField( const char *name, unsigned len ) const {
+            if ( _table.empty() )
+                return BSONElement();
+            unsigned h = hash( name, len ) & _mask;
+            while ( _table[h] >= 0 ) {
+                const Entry &x = _entries[ _table[h] ];
+                if ( x.equals( name, len ) )
+                    return BSONElement( x.elem );
+                h = ( h + 1 ) & _mask;
+            }
+            return BSONElement();
+        }
+
+        BSONElement getField( const StringData &name ) const {
+            return getField( name.data(), name.size() );
+        }
+
+        int nFields() const { return (int) _entries.size(); }
+
+    private:
+        struct Entry {
+            const char *name;
+            unsigned len;
+            const char *elem;
+            bool equals( const char *n, unsigned l ) const {
+                return len == l && memcmp( name, n, l ) == 0;
+            }
+        };
+
+        static unsigned hash( const char *p, unsigned len ) {
+            unsigned h = 2166136261U; // FNV-1a
+            for ( unsigned i = 0; i < len; i++ ) {
+                h ^= (unsigned char) p[i];
+                h *= 16777619U;
+            }
+            return h;
+        }
+
+        const char *_data;
+        unsigned _mask;
+        std::vector<Entry> _entries;
+        std::vector<int> _table;
+    };
+
+}
@@ -100,6 +100,12 @@ namespace mongo {
         RemoveOption_Broadcast = 1 << 1
     };
 
+    enum InsertOptions {
+        /** with several documents in one insert, go on past one that fails, e.g. on a duplicate key.
+            getLastError then reports the last failure. */
+        InsertOption_ContinueOnError = 1 << 0
+    };
+
     class DBClientBase;
 
     /**
@@ -112,6 +112,10 @@ namespace mongo {
             return (opts & QueryOption_CursorTailable) != 0;
         }
 
+        /** how many documents the getMores ask for, 0 for as many as the server sees fit */
+        int getBatchSize() const { return batchSize; }
+        void setBatchSize( int newBatchSize ) { batchSize = newBatchSize == 1 ? 2 : newBatchSize; }
+
         /** see ResultFlagType (constants.h) for flag values
             mostly these flags are for internal purposes -
             ResultFlag_ErrSet is the possible exception to that
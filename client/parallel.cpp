@@ -20,6 +20,7 @@
 #include "parallel.h"
 #include "connpool.h"
 #include "../db/queryutil.h"
+#include "../util/concurrency/thread_pool.h"
 #include "../db/dbmessage.h"
 #include "../s/util.h"
 #include "../s/shard.h"
@@ -63,6 +64,25 @@ namespace mongo {
         _init();
     }
 
+    void ClusteredCursor::_shardBatch( int numServers , int skipLeft , int& batchSize , int& limit ) const {
+        batchSize = 0;
+        limit = 0;
+        if ( _batchSize == 0 )
+            return;
+
+        // a negative batch size is the most there is to be returned at all
+        int total = abs( _batchSize ) + skipLeft;
+        if ( _batchSize < 0 )
+            limit = total;
+
+        batchSize = total;
+        if ( numServers > 1 ) {
+            int share = total / numServers;
+            share += share / 2 + 1;
+            batchSize = min( total , max( 101 , share ) );
+        }
+    }
+
     auto_ptr<DBClientCursor> ClusteredCursor::query( const string& server , int num , BSONObj extra , int skipLeft ) {
         uassert( 10017 ,  "cursor already done" , ! _done );
         assert( _didInit );
@@ -86,8 +106,13 @@ namespace mongo {
                        << " _fields:" << _fields << " options: " << _options << endl;
             }
             
+            int batchSize , limit;
+            _shardBatch( 1 , skipLeft , batchSize , limit );
+            if ( num == 0 )
+                num = limit;
+
             auto_ptr<DBClientCursor> cursor =
-                conn->query( _ns , q , num , 0 , ( _fields.isEmpty() ? 0 : &_fields ) , _options , _batchSize == 0 ? 0 : _batchSize + skipLeft );
+                conn->query( _ns , q , num , 0 , ( _fields.isEmpty() ? 0 : &_fields ) , _options , batchSize );
             
             if ( ! cursor.get() && _options & QueryOption_PartialResults ) {
                 _done = true;
@@ -122,6 +147,160 @@ namespace mongo {
         }
     }
 
+    /** one server's part of ClusteredCursor::queryAll */
+    class ShardQuery : boost::noncopyable {
+    public:
+        ShardQuery( const string& ns , const BSONObj& query , const BSONObj * fields , int options , int batchSize , int limit )
+            : _ns( ns ) , _query( query ) , _fields( fields ) , _options( options ) , _batchSize( batchSize ) , _limit( limit ) , _code( 0 ) {
+        }
+
+        /** waits for the first batch */
+        void run() {
+            try {
+                cursor = conn->get()->query( _ns , _query , _limit , 0 , _fields , _options , _batchSize );
+            }
+            catch ( SocketException& e ) {
+                socketError.reset( new SocketException( e ) );
+            }
+            catch ( DBException& e ) {
+                _code = e.getCode();
+                _error = e.what();
+            }
+            catch ( std::exception& e ) {
+                _error = e.what();
+            }
+        }
+
+        /** throws what run() caught */
+        void rethrow() const {
+            if ( socketError )
+                throw *socketError;
+            if ( _error.size() )
+                throw UserException( _code , _error );
+        }
+
+        /** gives back the connection, or drops it if it failed */
+        void release() {
+            cursor.reset();
+            if ( ! conn )
+                return;
+            if ( conn->get() && conn->get()->isFailed() )
+                conn->kill();
+            else
+                conn->done();
+        }
+
+        scoped_ptr<ShardConnection> conn;
+        auto_ptr<DBClientCursor> cursor;
+        scoped_ptr<SocketException> socketError;
+
+    private:
+        string _ns;
+        BSONObj _query;
+        const BSONObj * _fields;
+        int _options;
+        int _batchSize;
+        int _limit;
+
+        int _code;
+        string _error;
+    };
+
+    void ClusteredCursor::queryAll( const vector<ServerAndQuery>& servers , int skipLeft , FilteringClientCursor * out ) {
+        uassert( 14079 ,  "cursor already done" , ! _done );
+        assert( _didInit );
+
+        const bool partial = _options & QueryOption_PartialResults;
+
+        vector< shared_ptr<ShardQuery> > queries;
+        vector< shared_ptr<ParallelTask> > tasks;
+
+        int batchSize , limit;
+        _shardBatch( servers.size() , skipLeft , batchSize , limit );
+
+        try {
+            // version checks, which only go to the server when the version changed
+            for ( unsigned i=0; i<servers.size(); i++ ) {
+                BSONObj q = _query;
+                if ( ! servers[i]._extra.isEmpty() )
+                    q = concatQuery( q , servers[i]._extra );
+
+                shared_ptr<ShardQuery> sq( new ShardQuery( _ns , q , _fields.isEmpty() ? 0 : &_fields , _options , batchSize , limit ) );
+                queries.push_back( sq );
+
+                try {
+                    sq->conn.reset( new ShardConnection( servers[i]._server , _ns ) );
+                    if ( sq->conn->setVersion() )
+                        throw StaleConfigException( _ns , "ClusteredCursor::queryAll ShardConnection had to change" , true );
+                }
+                catch ( SocketException& e ) {
+                    if ( ! partial )
+                        throw;
+                    sq->socketError.reset( new SocketException( e ) );
+                }
+
+                if ( logLevel >= 5 ) {
+                    log(5) << "ClusteredCursor::queryAll (" << type() << ") server:" << servers[i]._server
+                           << " ns:" << _ns << " query:" << q << " _fields:" << _fields << " options: " << _options << endl;
+                }
+            }
+
+            // the first batches: this thread waits for one, and the pool for the others
+            for ( unsigned i=1; i<queries.size(); i++ ) {
+                if ( queries[i]->socketError )
+                    continue;
+                tasks.push_back( shared_ptr<ParallelTask>( new ParallelTask( boost::bind( &ShardQuery::run , queries[i].get() ) ) ) );
+            }
+            if ( queries.size() && ! queries[0]->socketError )
+                queries[0]->run();
+            for ( unsigned i=0; i<tasks.size(); i++ )
+                tasks[i]->join();
+            tasks.clear();
+
+            for ( unsigned i=0; i<queries.size(); i++ ) {
+                ShardQuery& sq = *queries[i];
+
+                if ( sq.socketError ) {
+                    if ( ! partial )
+                        sq.rethrow();
+                    continue;
+                }
+                sq.rethrow();
+
+                if ( ! sq.cursor.get() && partial )
+                    continue;
+
+                massert( 14080 , str::stream() << "error querying server: " << servers[i]._server  , sq.cursor.get() );
+
+                if ( sq.cursor->hasResultFlag( ResultFlag_ShardConfigStale ) )
+                    throw StaleConfigException( _ns , "ClusteredCursor::queryAll" );
+
+                if ( sq.cursor->hasResultFlag( ResultFlag_ErrSet ) ) {
+                    BSONObj o = sq.cursor->next();
+                    throw UserException( o["code"].numberInt() , o["$err"].String() );
+                }
+            }
+        }
+        catch ( ... ) {
+            for ( unsigned i=0; i<tasks.size(); i++ )
+                tasks[i]->join();
+            for ( unsigned i=0; i<queries.size(); i++ )
+                queries[i]->release();
+            throw;
+        }
+
+        for ( unsigned i=0; i<queries.size(); i++ ) {
+            ShardQuery& sq = *queries[i];
+            if ( sq.cursor.get() ) {
+                // attach hands the connection back
+                sq.cursor->attach( sq.conn.get() );
+                sq.conn.reset();
+            }
+            out[i].reset( sq.cursor );
+            sq.release();
+        }
+    }
+
     BSONObj ClusteredCursor::explain( const string& server , BSONObj extra ) {
         BSONObj q = _query;
         if ( ! extra.isEmpty() ) {
@@ -139,8 +318,29 @@ namespace mongo {
     }
 
     BSONObj ClusteredCursor::concatQuery( const BSONObj& query , const BSONObj& extraFilter ) {
-        if ( ! query.hasField( "query" ) )
-            return _concatFilter( query , extraFilter );
+        // $min, $max and $hint in the extra are query modifiers, so they go beside the filter rather than in it
+        BSONObjBuilder filterBuilder;
+        BSONObjBuilder modifierBuilder;
+        BSONObjIterator j( extraFilter );
+        while ( j.more() ) {
+            BSONElement e = j.next();
+            if ( str::equals( e.fieldName() , "$min" ) || str::equals( e.fieldName() , "$max" ) || str::equals( e.fieldName() , "$hint" ) )
+                modifierBuilder.append( e );
+            else
+                filterBuilder.append( e );
+        }
+        BSONObj filter = filterBuilder.obj();
+        BSONObj modifiers = modifierBuilder.obj();
+
+        if ( ! query.hasField( "query" ) ) {
+            if ( modifiers.isEmpty() )
+                return _concatFilter( query , filter );
+
+            BSONObjBuilder b;
+            b.append( "query" , _concatFilter( query , filter ) );
+            b.appendElements( modifiers );
+            return b.obj();
+        }
 
         BSONObjBuilder b;
         BSONObjIterator i( query );
@@ -152,8 +352,9 @@ namespace mongo {
                 continue;
             }
 
-            b.append( "query" , _concatFilter( e.embeddedObjectUserCheck() , extraFilter ) );
+            b.append( "query" , _concatFilter( e.embeddedObjectUserCheck() , filter ) );
         }
+        b.appendElements( modifiers );
         return b.obj();
     }
 
@@ -219,22 +420,61 @@ namespace mongo {
         return b.obj();
     }
 
+    // --------  ParallelTask -----------
+
+    /** never deleted, as cursors can still be using it while statics are destroyed at exit */
+    static ThreadPool& parallelTaskPool() {
+        static ThreadPool * pool = new ThreadPool( ParallelTask::PoolThreads );
+        return *pool;
+    }
+
+    ParallelTask::ParallelTask( const boost::function<void()>& f ) : _f( f ) {
+        parallelTaskPool().schedule( &ParallelTask::_run , this );
+    }
+
+    ParallelTask::~ParallelTask() {
+        join();
+    }
+
+    void ParallelTask::join() {
+        _done.waitToBeNotified();
+    }
+
+    void ParallelTask::_run() {
+        try {
+            _f();
+        }
+        catch ( std::exception& e ) {
+            error() << "ParallelTask exception: " << e.what() << endl;
+        }
+        _done.notifyOne();
+    }
+
     // --------  FilteringClientCursor -----------
     FilteringClientCursor::FilteringClientCursor( const BSONObj filter )
-        : _matcher( filter ) , _done( true ) {
+        : _matcher( filter ) , _done( true ) , _prefetch( false ) , _refills( 0 ) , _fetchCode( 0 ) {
     }
 
     FilteringClientCursor::FilteringClientCursor( auto_ptr<DBClientCursor> cursor , const BSONObj filter )
-        : _matcher( filter ) , _cursor( cursor ) , _done( cursor.get() == 0 ) {
+        : _matcher( filter ) , _cursor( cursor ) , _done( _cursor.get() == 0 ) , _prefetch( false ) , _refills( 0 ) , _fetchCode( 0 ) {
     }
 
     FilteringClientCursor::~FilteringClientCursor() {
+        if ( _fetching )
+            _fetching->join();
     }
 
     void FilteringClientCursor::reset( auto_ptr<DBClientCursor> cursor ) {
+        if ( _fetching ) {
+            _fetching->join();
+            _fetching.reset();
+        }
         _cursor = cursor;
         _next = BSONObj();
         _done = _cursor.get() == 0;
+        _refills = 0;
+        _batch.clear();
+        _fetchError.clear();
     }
 
     bool FilteringClientCursor::more() {
@@ -254,7 +494,6 @@ namespace mongo {
 
         BSONObj ret = _next;
         _next = BSONObj();
-        _advance();
         return ret;
     }
 
@@ -269,10 +508,10 @@ namespace mongo {
         if ( ! _cursor.get() || _done )
             return;
 
-        while ( _cursor->more() ) {
-            _next = _cursor->next();
+        while ( _more() ) {
+            _next = _nextRaw();
             if ( _matcher.matches( _next ) ) {
-                if ( ! _cursor->moreInCurrentBatch() )
+                if ( ! _prefetch && ! _cursor->moreInCurrentBatch() )
                     _next = _next.getOwned();
                 return;
             }
@@ -281,6 +520,70 @@ namespace mongo {
         _done = true;
     }
 
+    bool FilteringClientCursor::_more() {
+        if ( ! _prefetch )
+            return _cursor->more();
+        if ( _batch.empty() )
+            _refill();
+        return ! _batch.empty();
+    }
+
+    BSONObj FilteringClientCursor::_nextRaw() {
+        if ( ! _prefetch )
+            return _cursor->next();
+        BSONObj o = _batch.front();
+        _batch.pop_front();
+        return o;
+    }
+
+    void FilteringClientCursor::_refill() {
+        _join();
+        if ( ! _cursor->moreInCurrentBatch() && _refills > 0 )
+            _growBatch();
+        if ( ! _cursor->more() )
+            return;
+
+        while ( _cursor->moreInCurrentBatch() )
+            _batch.push_back( _cursor->next().getOwned() );
+
+        if ( _refills++ > 0 && ! _cursor->isDead() && ! _cursor->tailable() ) {
+            _growBatch();
+            _fetching.reset( new ParallelTask( boost::bind( &FilteringClientCursor::_fetch , this ) ) );
+        }
+    }
+
+    void FilteringClientCursor::_growBatch() {
+        int bs = _cursor->getBatchSize();
+        if ( bs > 0 )
+            _cursor->setBatchSize( bs < MaxBatchSize / 2 ? bs * 2 : MaxBatchSize );
+    }
+
+    void FilteringClientCursor::_fetch() {
+        try {
+            _cursor->more();
+        }
+        catch ( DBException& e ) {
+            _fetchCode = e.getCode();
+            _fetchError = e.what();
+        }
+        catch ( std::exception& e ) {
+            _fetchCode = 0;
+            _fetchError = e.what();
+        }
+    }
+
+    void FilteringClientCursor::_join() {
+        if ( ! _fetching )
+            return;
+        _fetching->join();
+        _fetching.reset();
+        if ( _fetchError.size() ) {
+            string msg = _fetchError;
+            _fetchError.clear();
+            throw UserException( _fetchCode , msg );
+        }
+    }
+
     // --------  SerialServerClusteredCursor -----------
 
     SerialServerClusteredCursor::SerialServerClusteredCursor( const set<ServerAndQuery>& servers , QueryMessage& q , int sortOrder) : ClusteredCursor( q ) {
@@ -293,36 +596,48 @@ namespace mongo {
             sort( _servers.rbegin() , _servers.rend() );
 
         _serverIndex = 0;
+        _cursors = 0;
 
         _needToSkip = q.ntoskip;
     }
 
+    SerialServerClusteredCursor::~SerialServerClusteredCursor() {
+        delete [] _cursors;
+        _cursors = 0;
+    }
+
+    void SerialServerClusteredCursor::_init() {
+        assert( ! _cursors );
+        _cursors = new FilteringClientCursor[_servers.size()];
+        queryAll( _servers , _needToSkip , _cursors );
+        for ( unsigned i=0; i<_servers.size(); i++ )
+            _cursors[i].prefetch();
+    }
+
     bool SerialServerClusteredCursor::more() {
 
         // TODO: optimize this by sending on first query and then back counting
         //       tricky in case where 1st server doesn't have any after
         //       need it to send n skipped
-        while ( _needToSkip > 0 && _current.more() ) {
-            _current.next();
-            _needToSkip--;
-        }
+        while ( _serverIndex < _servers.size() ) {
+            FilteringClientCursor& c = _cursors[_serverIndex];
 
-        if ( _current.more() )
-            return true;
-
-        if ( _serverIndex >= _servers.size() ) {
-            return false;
-        }
+            while ( _needToSkip > 0 && c.more() ) {
+                c.next();
+                _needToSkip--;
+            }
 
-        ServerAndQuery& sq = _servers[_serverIndex++];
+            if ( c.more() )
+                return true;
 
-        _current.reset( query( sq._server , 0 , sq._extra ) );
-        return more();
+            _serverIndex++;
+        }
+        return false;
     }
 
     BSONObj SerialServerClusteredCursor::next() {
         uassert( 10018 ,  "no more items" , more() );
-        return _current.next();
+        return _cursors[_serverIndex].next();
     }
 
     void SerialServerClusteredCursor::_explain( map< string,list<BSONObj> >& out ) {
@@ -355,6 +670,8 @@ namespace mongo {
     void ParallelSortClusteredCursor::_finishCons() {
         _numServers = _servers.size();
         _cursors = 0;
+        _heapReady = false;
+        _last = -1;
 
         if ( ! _sortKey.isEmpty() && ! _fields.isEmpty() ) {
             // we need to make sure the sort key is in the projection
@@ -403,13 +720,37 @@ namespace mongo {
         assert( ! _cursors );
         _cursors = new FilteringClientCursor[_numServers];
 
-        // TODO: parellize
-        int num = 0;
-        for ( set<ServerAndQuery>::iterator i = _servers.begin(); i!=_servers.end(); ++i ) {
-            const ServerAndQuery& sq = *i;
-            _cursors[num++].reset( query( sq._server , 0 , sq._extra , _needToSkip ) );
+        vector<ServerAndQuery> servers( _servers.begin() , _servers.end() );
+        queryAll( servers , _needToSkip , _cursors );
+        for ( int i=0; i<_numServers; i++ )
+            _cursors[i].prefetch();
+    }
+
+    /** heap order for cursor indexes: the one whose next document sorts first ends up on top */
+    class SortsAfter {
+    public:
+        SortsAfter( FilteringClientCursor * cursors , const BSONObj& sortKey ) : _cursors( cursors ) , _sortKey( sortKey ) {}
+        bool operator()( int l , int r ) const {
+            int c = _cursors[l].peek().woSortOrder( _cursors[r].peek() , _sortKey , true );
+            if ( c )
+                return c > 0;
+            return l > r;
         }
+    private:
+        FilteringClientCursor * _cursors;
+        BSONObj _sortKey;
+    };
 
+    void ParallelSortClusteredCursor::_initHeap() {
+        if ( _heapReady )
+            return;
+        _heapReady = true;
+
+        for ( int i=0; i<_numServers; i++ ) {
+            if ( _cursors[i].more() )
+                _heap.push_back( i );
+        }
+        make_heap( _heap.begin() , _heap.end() , SortsAfter( _cursors , _sortKey ) );
     }
 
     ParallelSortClusteredCursor::~ParallelSortClusteredCursor() {
@@ -417,6 +758,18 @@ namespace mongo {
         _cursors = 0;
     }
 
+    void ParallelSortClusteredCursor::_pushLast() {
+        if ( _last < 0 )
+            return;
+        int from = _last;
+        _last = -1;
+
+        if ( _cursors[from].more() ) {
+            _heap.push_back( from );
+            push_heap( _heap.begin() , _heap.end() , SortsAfter( _cursors , _sortKey ) );
+        }
+    }
+
     bool ParallelSortClusteredCursor::more() {
 
         if ( _needToSkip > 0 ) {
@@ -431,41 +784,23 @@ namespace mongo {
             _needToSkip = n;
         }
 
-        for ( int i=0; i<_numServers; i++ ) {
-            if ( _cursors[i].more() )
-                return true;
-        }
-        return false;
+        _initHeap();
+        _pushLast();
+        return ! _heap.empty();
     }
 
     BSONObj ParallelSortClusteredCursor::next() {
-        BSONObj best = BSONObj();
-        int bestFrom = -1;
-
-        for ( int i=0; i<_numServers; i++) {
-            if ( ! _cursors[i].more() )
-                continue;
-
-            BSONObj me = _cursors[i].peek();
-
-            if ( best.isEmpty() ) {
-                best = me;
-                bestFrom = i;
-                continue;
-            }
-
-            int comp = best.woSortOrder( me , _sortKey , true );
-            if ( comp < 0 )
-                continue;
-
-            best = me;
-            bestFrom = i;
-        }
+        _initHeap();
+        _pushLast();
+        uassert( 10019 ,  "no more elements" , ! _heap.empty() );
 
-        uassert( 10019 ,  "no more elements" , ! best.isEmpty() );
-        _cursors[bestFrom].next();
+        SortsAfter cmp( _cursors , _sortKey );
+        pop_heap( _heap.begin() , _heap.end() , cmp );
+        int from = _heap.back();
+        _heap.pop_back();
 
-        return best;
+        _last = from;
+        return _cursors[from].next();
     }
 
     void ParallelSortClusteredCursor::_explain( map< string,list<BSONObj> >& out ) {
@@ -25,9 +25,12 @@
 #include "../db/dbmessage.h"
 #include "../db/matcher.h"
 #include "../util/concurrency/mvar.h"
+#include "../util/concurrency/synchronization.h"
 
 namespace mongo {
 
+    class FilteringClientCursor;
+
     /**
      * holder for a server address and a query to run
      */
@@ -79,6 +82,7 @@ namespace mongo {
         virtual bool more() = 0;
         virtual BSONObj next() = 0;
 
+        /** query with extraFilter added to its filter; $min, $max and $hint in extraFilter become modifiers of it */
         static BSONObj concatQuery( const BSONObj& query , const BSONObj& extraFilter );
 
         virtual string type() const = 0;
@@ -90,6 +94,21 @@ namespace mongo {
         virtual void _init() = 0;
 
         auto_ptr<DBClientCursor> query( const string& server , int num = 0 , BSONObj extraFilter = BSONObj() , int skipLeft = 0 );
+
+        /**
+         * what to ask each of numServers for, so that between them they have the skipLeft documents still to
+         * be skipped and the batch after.  each gets a share of those in its first batch rather than all of
+         * them, more than an even share in case they are unevenly spread; the rest comes with getMores.
+         * @param limit (OUT) most documents any one of them could have to give, 0 if there's no limit
+         */
+        void _shardBatch( int numServers , int skipLeft , int& batchSize , int& limit ) const;
+
+        /**
+         * queries all of servers at once, so the wait is for the slowest of them rather than their sum.
+         * version checks are done first, on this thread, then each query waits for its first batch on its own.
+         * @param out gets the cursor for servers[i] at out[i], empty for a server that failed with PartialResults
+         */
+        void queryAll( const vector<ServerAndQuery>& servers , int skipLeft , FilteringClientCursor * out );
         BSONObj explain( const string& server , BSONObj extraFilter = BSONObj() );
 
         static BSONObj _concatFilter( const BSONObj& filter , const BSONObj& extraFilter );
@@ -108,26 +127,77 @@ namespace mongo {
     };
 
 
+    /**
+     * a task run on the thread pool clustered cursors share for their first batches and getMore
+     * prefetches, so that those don't cost a new thread each.  f shouldn't throw.
+     */
+    class ParallelTask : boost::noncopyable {
+    public:
+        explicit ParallelTask( const boost::function<void()>& f );
+        /** joins */
+        ~ParallelTask();
+
+        /** blocks until the task has run */
+        void join();
+
+        /** how many tasks run at once, over all the cursors of the process */
+        static const int PoolThreads = 32;
+
+    private:
+        void _run();
+
+        boost::function<void()> _f;
+        Notification _done;
+    };
+
     class FilteringClientCursor {
     public:
+        /** the batch size doubles with each getMore up to this, as the reader evidently wants the lot */
+        static const int MaxBatchSize = 1 << 20;
+
         FilteringClientCursor( const BSONObj filter = BSONObj() );
         FilteringClientCursor( auto_ptr<DBClientCursor> cursor , const BSONObj filter = BSONObj() );
         ~FilteringClientCursor();
 
         void reset( auto_ptr<DBClientCursor> cursor );
 
+        /**
+         * from here on each batch is copied out when it's reached, and the getMore for the
+         * one after is sent from another thread while this one is read.  that only starts from
+         * the second batch: a reader done with the first needn't cost the server another.
+         */
+        void prefetch() { _prefetch = true; }
+
         bool more();
+        /** the document after isn't looked for, nor fetched, until more() or peek() */
         BSONObj next();
 
         BSONObj peek();
     private:
         void _advance();
 
+        /** the cursor, or the copied batch when prefetching */
+        bool _more();
+        BSONObj _nextRaw();
+
+        void _refill();
+        void _growBatch();
+        void _fetch();
+        /** waits for the getMore in flight, if there is one, and throws what it did */
+        void _join();
+
         Matcher _matcher;
         auto_ptr<DBClientCursor> _cursor;
 
         BSONObj _next;
         bool _done;
+
+        bool _prefetch;
+        int _refills;
+        deque<BSONObj> _batch;
+        scoped_ptr<ParallelTask> _fetching;
+        int _fetchCode;
+        string _fetchError;
     };
 
 
@@ -186,12 +256,14 @@ namespace mongo {
 
 
     /**
-     * runs a query in serial across any number of servers
+     * runs a query across any number of servers
      * returns all results from 1 server, then the next, etc...
+     * the queries are all sent up front, see ClusteredCursor::queryAll
      */
     class SerialServerClusteredCursor : public ClusteredCursor {
     public:
         SerialServerClusteredCursor( const set<ServerAndQuery>& servers , QueryMessage& q , int sortOrder=0);
+        virtual ~SerialServerClusteredCursor();
         virtual bool more();
         virtual BSONObj next();
         virtual string type() const { return "SerialServer"; }
@@ -199,12 +271,12 @@ namespace mongo {
     protected:
         virtual void _explain( map< string,list<BSONObj> >& out );
 
-        void _init() {}
+        void _init();
 
         vector<ServerAndQuery> _servers;
         unsigned _serverIndex;
 
-        FilteringClientCursor _current;
+        FilteringClientCursor * _cursors;
 
         int _needToSkip;
     };
@@ -212,7 +284,7 @@ namespace mongo {
 
     /**
      * runs a query in parellel across N servers
-     * sots
+     * and merges their sorted results through a heap of the servers, ordered by their next document
      */
     class ParallelSortClusteredCursor : public ClusteredCursor {
     public:
@@ -226,6 +298,7 @@ namespace mongo {
     protected:
         void _finishCons();
         void _init();
+        void _initHeap();
 
         virtual void _explain( map< string,list<BSONObj> >& out );
 
@@ -235,6 +308,17 @@ namespace mongo {
 
         FilteringClientCursor * _cursors;
         int _needToSkip;
+
+        /** indexes into _cursors of the ones with more, the next in sort order on top */
+        vector<int> _heap;
+        bool _heapReady;
+
+        /**
+         * the cursor the last document came from, to go back on the heap by its next one when that is wanted.
+         * so once a limit's worth is read, none of the cursors is asked for more.  -1 if none
+         */
+        int _last;
+        void _pushLast();
     };
 
     /**
@@ -0,0 +1,121 @@
+// aggregate.cpp
+
+/**
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "../commands.h"
+#include "../instance.h"
+#include "../queryoptimizer.h"
+#include "../clientcursor.h"
+#include "../pipeline.h"
+#include "../../s/d_chunk_manager.h"
+#include "../../s/d_logic.h"
+
+namespace mongo {
+
+    /**
+     * feeds a pipeline from a collection, through the query optimizer so a leading $match can use an index.
+     * yields between documents, so the one handed out is only good until the next call.
+     */
+    class CursorSource : public DocumentSource {
+    public:
+        CursorSource( const string& ns , const BSONObj& query ) : _started( false ) {
+            _cursor = bestGuessCursor( ns.c_str() , query , BSONObj() );
+            _cc.reset( new ClientCursor( QueryOption_NoCursorTimeout , _cursor , ns ) );
+
+            // skip documents of chunks that are still migrating in
+            if ( shardingState.needShardChunkManager( ns ) )
+                _chunkManager = shardingState.getShardChunkManager( ns );
+        }
+
+        virtual bool next( BSONObj& out ) {
+            if ( ! _cc.get() )
+                return false;
+
+            while ( true ) {
+                if ( _started ) {
+                    _cursor->advance();
+                    if ( ! _cc->yieldSometimes() ) {
+                        // the ClientCursor is gone, along with the collection
+                        _cc.release();
+                        return false;
+                    }
+                    RARELY killCurrentOp.checkForInterrupt();
+                }
+                _started = true;
+
+                if ( ! _cursor->ok() )
+                    return false;
+
+                if ( _cc->currentIsDup() || ! _cc->currentMatches() )
+                    continue;
+
+                out = _cursor->current();
+                if ( _chunkManager && ! _chunkManager->belongsToMe( out ) )
+                    continue;
+
+                return true;
+            }
+        }
+
+    private:
+        shared_ptr<Cursor> _cursor;
+        auto_ptr<ClientCursor> _cc;
+        ShardChunkManagerPtr _chunkManager;
+        bool _started;
+    };
+
+    class PipelineCommand : public Command {
+    public:
+        PipelineCommand() : Command( "aggregate" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return READ; }
+        virtual void help( stringstream &help ) const {
+            help << "{ aggregate : 'collection name' , pipeline : [ { $match : {...} } , { $group : {...} } , ... ] }\n";
+            help << "stages are $match $project $unwind $group $sort $limit $skip";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            Timer t;
+            string ns = dbname + '.' + cmdObj.firstElement().valuestr();
+
+            if ( cmdObj["pipeline"].type() != Array ) {
+                errmsg = "pipeline has to be an array of stages";
+                return false;
+            }
+
+            // only a router, which has set its shard version on this connection, sends the split stages
+            Pipeline pipeline;
+            if ( ! pipeline.init( cmdObj["pipeline"].embeddedObject() , errmsg , ShardedConnectionInfo::get( false ) != 0 ) )
+                return false;
+
+            shared_ptr<DocumentSource> input;
+            if ( nsdetails( ns.c_str() ) )
+                input.reset( new CursorSource( ns , pipeline.query() ) );
+            else
+                input.reset( new ArraySource() );
+
+            BSONArrayBuilder arr( result.subarrayStart( "result" ) );
+            pipeline.run( input , arr );
+            arr.done();
+
+            result.append( "timeMillis" , t.millis() );
+            return true;
+        }
+
+    } pipelineCmd;
+
+}
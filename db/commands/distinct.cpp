@@ -30,6 +30,27 @@ namespace mongo {
         virtual LockType locktype() const { return READ; }
         virtual void help( stringstream &help ) const {
             help << "{ distinct : 'collection name' , key : 'a.b' , query : {} }";
+            help << "\nsorted:true returns the values in order, so that mongos can merge them from the shards as they are";
+        }
+
+        /** @return true if idx holds every field of query, and narrows on the first of them */
+        static bool coversQuery( IndexDetails& idx , const BSONObj& query ) {
+            if ( query.isEmpty() )
+                return true;
+
+            BSONObj keyPattern = idx.keyPattern();
+            if ( ! query.hasField( keyPattern.firstElement().fieldName() ) ) {
+                // would be a scan of the whole index
+                return false;
+            }
+
+            BSONObjIterator i( query );
+            while ( i.more() ) {
+                const char * fn = i.next().fieldName();
+                if ( fn[0] == '$' || ! idx.inKeyPattern( fn ) )
+                    return false;
+            }
+            return true;
         }
 
         bool run(const string& dbname, BSONObj& cmdObj, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
@@ -62,32 +83,26 @@ namespace mongo {
             }
 
             shared_ptr<Cursor> cursor;
-            if ( ! query.isEmpty() ) {
-                cursor = bestGuessCursor(ns.c_str() , query , BSONObj() );
-            }
-            else {
-
-                // query is empty, so lets see if we can find an index
-                // with the key so we don't have to hit the raw data
-                NamespaceDetails::IndexIterator ii = d->ii();
-                while ( ii.more() ) {
-                    IndexDetails& idx = ii.next();
 
-                    if ( d->isMultikey( ii.pos() - 1 ) )
-                        continue;
+            // lets see if we can find an index with the key and every queried field,
+            // so the values come from index keys and we don't have to hit the raw data
+            NamespaceDetails::IndexIterator ii = d->ii();
+            while ( ii.more() ) {
+                IndexDetails& idx = ii.next();
 
-                    if ( idx.inKeyPattern( key ) ) {
-                        cursor = bestGuessCursor( ns.c_str() , BSONObj() , idx.keyPattern() );
-                        break;
-                    }
-
-                }
+                if ( d->isMultikey( ii.pos() - 1 ) )
+                    continue;
 
-                if ( ! cursor.get() )
-                    cursor = bestGuessCursor(ns.c_str() , query , BSONObj() );
+                if ( ! idx.inKeyPattern( key ) || ! coversQuery( idx , query ) )
+                    continue;
 
+                cursor = bestGuessCursor( ns.c_str() , query , idx.keyPattern() );
+                break;
             }
 
+            if ( ! cursor.get() )
+                cursor = bestGuessCursor(ns.c_str() , query , BSONObj() );
+
 
 
             scoped_ptr<ClientCursor> cc (new ClientCursor(QueryOption_NoCursorTimeout, cursor, ns));
@@ -131,7 +146,16 @@ namespace mongo {
 
             assert( start == bb.buf() );
 
-            result.appendArray( "values" , arr.done() );
+            if ( cmdObj["sorted"].trueValue() ) {
+                BSONArrayBuilder sorted( result.subarrayStart( "values" ) );
+                for ( BSONElementSet::iterator i=values.begin(); i!=values.end(); ++i )
+                    sorted.append( *i );
+                sorted.done();
+                result.appendBool( "sorted" , true );
+            }
+            else {
+                result.appendArray( "values" , arr.done() );
+            }
 
             {
                 BSONObjBuilder b;
@@ -19,9 +19,200 @@
 #include "../commands.h"
 #include "../instance.h"
 #include "../queryoptimizer.h"
+#include "../clientcursor.h"
 
 namespace mongo {
 
+    /** a $reduce given as an object rather than a function, computed without javascript
+        e.g. { n : { $count : 1 } , total : { $sum : "price" } , lo : { $min : "price" } , hi : { $max : "price" } }
+        each output starts from its field in initial, if there is one, as prev does for a javascript $reduce.
+        a count or sum can only start from a number, as anything else would be concatenated or become NaN in javascript.
+        counts and sums stay ints while everything added is an int and the total fits, like the script engines
+        give back an integral NumberInt, then become longs, and doubles once a double is added.
+    */
+    class NativeReducer {
+    public:
+        bool init( const BSONObj& spec , const BSONObj& initial , string& errmsg ) {
+            BSONObjIterator i( spec );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                if ( e.type() != Object || e.embeddedObject().nFields() != 1 ) {
+                    errmsg = str::stream() << "bad $reduce field: " << e;
+                    return false;
+                }
+                BSONElement op = e.embeddedObject().firstElement();
+                Acc a;
+                a.out = e.fieldName();
+                a.field = op.type() == String ? op.valuestr() : "";
+                if ( strcmp( op.fieldName() , "$count" ) == 0 )
+                    a.op = Count;
+                else if ( strcmp( op.fieldName() , "$sum" ) == 0 )
+                    a.op = Sum;
+                else if ( strcmp( op.fieldName() , "$min" ) == 0 )
+                    a.op = Min;
+                else if ( strcmp( op.fieldName() , "$max" ) == 0 )
+                    a.op = Max;
+                else {
+                    errmsg = str::stream() << "unknown $reduce operator: " << op.fieldName();
+                    return false;
+                }
+                if ( a.op != Count && a.field.empty() ) {
+                    errmsg = str::stream() << op.fieldName() << " needs a field name";
+                    return false;
+                }
+                BSONElement start = initial[ a.out ];
+                if ( a.op == Count || a.op == Sum ) {
+                    if ( start.isNumber() ) {
+                        a.start.add( start );
+                    }
+                    else if ( ! start.eoo() ) {
+                        errmsg = str::stream() << "initial value of " << a.out << " has to be a number";
+                        return false;
+                    }
+                }
+                else if ( ! start.eoo() ) {
+                    a.startExtreme = start.wrap( "" );
+                }
+                _accs.push_back( a );
+            }
+            if ( _accs.empty() ) {
+                errmsg = "$reduce is empty";
+                return false;
+            }
+            return true;
+        }
+
+        /** a count or sum, in the narrowest type that holds it */
+        struct Total {
+            Total() : type( NumberInt ) , l() , d() {}
+
+            void add( long long n , BSONType t ) {
+                if ( type != NumberDouble ) {
+                    if ( ( n > 0 && l > numeric_limits<long long>::max() - n ) ||
+                         ( n < 0 && l < numeric_limits<long long>::min() - n ) ) {
+                        d = (double)l;
+                        type = NumberDouble;
+                    }
+                }
+                if ( type == NumberDouble ) {
+                    d += n;
+                    return;
+                }
+                l += n;
+                if ( t == NumberLong || l > numeric_limits<int>::max() || l < numeric_limits<int>::min() )
+                    type = NumberLong;
+            }
+
+            void add( const BSONElement& e ) {
+                if ( e.type() != NumberDouble ) {
+                    add( e.numberLong() , e.type() );
+                    return;
+                }
+                if ( type != NumberDouble ) {
+                    d = (double)l;
+                    type = NumberDouble;
+                }
+                d += e.number();
+            }
+
+            void append( BSONObjBuilder& b , const string& name ) const {
+                if ( type == NumberInt )
+                    b.append( name , (int)l );
+                else if ( type == NumberLong )
+                    b.append( name , l );
+                else
+                    b.append( name , d );
+            }
+
+            BSONType type;
+            long long l;
+            double d;
+        };
+
+        /** the running values of one group */
+        struct State {
+            vector<Total> totals;
+            vector<BSONObj> extremes; // single element objects, empty until a value is seen
+        };
+
+        void add( State& s , const BSONObj& obj ) const {
+            if ( s.totals.empty() ) {
+                for ( unsigned i=0; i<_accs.size(); i++ ) {
+                    s.totals.push_back( _accs[i].start );
+                    s.extremes.push_back( _accs[i].startExtreme );
+                }
+            }
+            for ( unsigned i=0; i<_accs.size(); i++ ) {
+                const Acc& a = _accs[i];
+                if ( a.op == Count ) {
+                    s.totals[i].add( 1 , NumberInt );
+                    continue;
+                }
+                BSONElement e = obj.getFieldDotted( a.field );
+                if ( e.eoo() )
+                    continue;
+                if ( a.op == Sum ) {
+                    if ( e.isNumber() )
+                        s.totals[i].add( e );
+                    continue;
+                }
+                if ( s.extremes[i].isEmpty() ) {
+                    s.extremes[i] = e.wrap( "" );
+                    continue;
+                }
+                int c = e.woCompare( s.extremes[i].firstElement() , false );
+                if ( ( a.op == Min && c < 0 ) || ( a.op == Max && c > 0 ) )
+                    s.extremes[i] = e.wrap( "" );
+            }
+        }
+
+        /** appends the output called name, returns false if there is no such output */
+        bool append( BSONObjBuilder& b , const State& s , const char * name ) const {
+            int i = find( name );
+            if ( i < 0 )
+                return false;
+            append( b , s , i );
+            return true;
+        }
+
+        /** appends the outputs not named in any of the given objects, in the order $reduce gave them */
+        void appendRest( BSONObjBuilder& b , const State& s , const BSONObj& a , const BSONObj& c ) const {
+            for ( unsigned i=0; i<_accs.size(); i++ ) {
+                const char * name = _accs[i].out.c_str();
+                if ( ! a.hasField( name ) && ! c.hasField( name ) )
+                    append( b , s , i );
+            }
+        }
+
+    private:
+        int find( const char * name ) const {
+            for ( unsigned i=0; i<_accs.size(); i++ )
+                if ( _accs[i].out == name )
+                    return i;
+            return -1;
+        }
+
+        void append( BSONObjBuilder& b , const State& s , unsigned i ) const {
+            const Acc& a = _accs[i];
+            if ( a.op == Count || a.op == Sum )
+                s.totals[i].append( b , a.out );
+            else if ( s.extremes[i].isEmpty() )
+                b.appendNull( a.out );
+            else
+                b.appendAs( s.extremes[i].firstElement() , a.out );
+        }
+
+        enum Op { Count , Sum , Min , Max };
+        struct Acc {
+            string out;
+            Op op;
+            string field;
+            Total start;
+            BSONObj startExtreme;
+        };
+        vector<Acc> _accs;
+    };
+
     class GroupCommand : public Command {
     public:
         GroupCommand() : Command("group") {}
@@ -137,15 +328,109 @@ namespace mongo {
             return true;
         }
 
+        bool groupNative( const string& ns , const BSONObj& query , const BSONObj& keyPattern ,
+                          const BSONObj& reduceSpec , const BSONObj& initial ,
+                          string& errmsg , BSONObjBuilder& result ) {
+            NativeReducer reducer;
+            if ( ! reducer.init( reduceSpec , initial , errmsg ) )
+                return false;
+
+            // groups come back in the order their keys were first seen, as with a javascript $reduce
+            map<BSONObj,unsigned,BSONObjCmp> index;
+            vector< pair<BSONObj,NativeReducer::State> > groups;
+            long long count = 0;
+
+            shared_ptr<Cursor> cursor = bestGuessCursor(ns.c_str() , query , BSONObj() );
+            auto_ptr<ClientCursor> cc( new ClientCursor( QueryOption_NoCursorTimeout , cursor , ns ) );
+
+            while ( cursor->ok() ) {
+                if ( cursor->matcher() && ! cursor->matcher()->matchesCurrent( cursor.get() ) ) {
+                    cursor->advance();
+                }
+                else {
+                    BSONObj obj = cursor->current();
+                    cursor->advance();
+
+                    BSONObj key = obj.extractFields( keyPattern , true );
+                    map<BSONObj,unsigned,BSONObjCmp>::iterator i = index.find( key );
+                    if ( i == index.end() ) {
+                        uassert( 14050 ,  "group() can't handle more than 20000 unique keys" , groups.size() < 20000 );
+                        key = key.getOwned();
+                        i = index.insert( make_pair( key , (unsigned)groups.size() ) ).first;
+                        groups.push_back( make_pair( key , NativeReducer::State() ) );
+                    }
+                    reducer.add( groups[i->second].second , obj );
+                    count++;
+                }
+
+                if ( ! cc->yieldSometimes() ) {
+                    // the ClientCursor is gone, along with the collection
+                    cc.release();
+                    break;
+                }
+
+                RARELY killCurrentOp.checkForInterrupt();
+            }
+
+            BSONArrayBuilder arr( result.subarrayStart( "retval" ) );
+            for ( unsigned i=0; i<groups.size(); i++ ) {
+                const BSONObj& key = groups[i].first;
+                const NativeReducer::State& state = groups[i].second;
+
+                // laid out like the javascript prev: the key's fields, then the rest of initial's, then new outputs.
+                // initial's value wins over the key's where both have a field.
+                BSONObjBuilder b( arr.subobjStart() );
+                BSONObjIterator j( key );
+                while ( j.more() ) {
+                    BSONElement e = j.next();
+                    if ( reducer.append( b , state , e.fieldName() ) )
+                        continue;
+                    BSONElement init = initial[ e.fieldName() ];
+                    b.append( init.eoo() ? e : init );
+                }
+                BSONObjIterator k( initial );
+                while ( k.more() ) {
+                    BSONElement e = k.next();
+                    if ( key.hasField( e.fieldName() ) || reducer.append( b , state , e.fieldName() ) )
+                        continue;
+                    b.append( e );
+                }
+                reducer.appendRest( b , state , key , initial );
+                b.done();
+            }
+            arr.done();
+
+            result.append( "count" , (double)count );
+            result.append( "keys" , (int)(groups.size()) );
+            return true;
+        }
+
         bool run(const string& dbname, BSONObj& jsobj, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
 
+            /* db.$cmd.findOne( { group : <p> } ) */
+            const BSONObj& p = jsobj.firstElement().embeddedObjectUserCheck();
+
+            if ( p["$reduce"].type() == Object ) {
+                // native reduce: no key function or finalize, those are javascript
+                if ( p["ns"].type() != String ) {
+                    errmsg = "ns has to be set";
+                    return false;
+                }
+                if ( ! p["$keyf"].eoo() || ! p["finalize"].eoo() ) {
+                    errmsg = "$keyf and finalize need a javascript $reduce";
+                    return false;
+                }
+                BSONObj q = p["cond"].type() == Object ? p["cond"].embeddedObject() : getQuery( p );
+                BSONObj key = p["key"].type() == Object ? p["key"].embeddedObjectUserCheck() : BSONObj();
+                BSONObj initial = p["initial"].type() == Object ? p["initial"].embeddedObject() : BSONObj();
+                return groupNative( dbname + "." + p["ns"].String() , q , key ,
+                                    p["$reduce"].embeddedObject() , initial , errmsg , result );
+            }
+
             if ( !globalScriptEngine ) {
                 errmsg = "server-side JavaScript execution is disabled";
                 return false;
             }
-            
-            /* db.$cmd.findOne( { group : <p> } ) */
-            const BSONObj& p = jsobj.firstElement().embeddedObjectUserCheck();
 
             BSONObj q;
             if ( p["cond"].type() == Object )
@@ -249,6 +249,11 @@ namespace mongo {
                 if (o.hasElement("db")) {
                     outDB = o["db"].String();
                 }
+
+                if ( o["incremental"].type() == String ) {
+                    incremental = o["incremental"].String();
+                    uassert( 14059 , "incremental needs out : { reduce : ... }" , outType == REDUCE );
+                }
             }
             else {
                 uasserted( 13606 , "'out' has to be a string or an object" );
@@ -260,6 +265,8 @@ namespace mongo {
                 incLong = tempLong + "_inc";
 
                 finalLong = str::stream() << (outDB.empty() ? dbname : outDB) << "." << finalShort;
+
+                marksLong = str::stream() << (outDB.empty() ? dbname : outDB) << ".mr.marks";
             }
 
             {
@@ -270,8 +277,11 @@ namespace mongo {
 
                 mapper.reset( new JSMapper( cmdObj["map"] ) );
                 reducer.reset( new JSReducer( cmdObj["reduce"] ) );
-                if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() )
+                reduceCode = cmdObj["reduce"].wrap();
+                if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() ) {
                     finalizer.reset( new JSFinalizer( cmdObj["finalize"] ) );
+                    finalizeCode = cmdObj["finalize"].wrap();
+                }
 
                 if ( cmdObj["mapparams"].type() == Array ) {
                     mapParams = cmdObj["mapparams"].embeddedObjectUserCheck();
@@ -298,7 +308,14 @@ namespace mongo {
                     limit = cmdObj["limit"].numberLong();
                 else
                     limit = 0;
+
+                uassert( 14060 , "incremental can't have a limit" , incremental.empty() || limit == 0 );
             }
+
+            jsMode = cmdObj["jsMode"].trueValue();
+            jsMaxKeys = 500000;
+            if ( cmdObj["jsMaxKeys"].isNumber() )
+                jsMaxKeys = cmdObj["jsMaxKeys"].numberLong();
         }
 
         /**
@@ -413,30 +430,43 @@ namespace mongo {
             }
             else if ( _config.outType == Config::REDUCE ) {
                 // reduce: apply reduce op on new result and existing one
+                // in batches, so that the existing results are found with one $in per batch
                 BSONList values;
 
                 auto_ptr<DBClientCursor> cursor = _db.query( _config.tempLong , BSONObj() );
                 while ( cursor->more() ) {
-                    BSONObj temp = cursor->next();
-                    BSONObj old;
-
-                    bool found;
-                    {
-                        Client::Context tx( _config.finalLong );
-                        found = Helpers::findOne( _config.finalLong.c_str() , temp["_id"].wrap() , old , true );
+                    BSONList batch;
+                    BSONArrayBuilder ids;
+                    while ( cursor->more() && batch.size() < 1000 && ids.len() < 1024 * 1024 ) {
+                        BSONObj temp = cursor->next().getOwned();
+                        ids.append( temp["_id"] );
+                        batch.push_back( temp );
                     }
 
-                    if ( found ) {
-                        // need to reduce
-                        values.clear();
-                        values.push_back( temp );
-                        values.push_back( old );
-                        Helpers::upsert( _config.finalLong , _config.reducer->finalReduce( values , _config.finalizer.get() ) );
+                    map<BSONObj,BSONObj,BSONObjCmp> existing;
+                    auto_ptr<DBClientCursor> found = _db.query( _config.finalLong , QUERY( "_id" << BSON( "$in" << ids.arr() ) ) );
+                    while ( found->more() ) {
+                        BSONObj old = found->next().getOwned();
+                        existing[ old["_id"].wrap() ] = old;
                     }
-                    else {
-                        Helpers::upsert( _config.finalLong , temp );
+
+                    for ( unsigned i=0; i<batch.size(); i++ ) {
+                        BSONObj& temp = batch[i];
+                        map<BSONObj,BSONObj,BSONObjCmp>::iterator old = existing.find( temp["_id"].wrap() );
+
+                        if ( old != existing.end() ) {
+                            // need to reduce
+                            values.clear();
+                            values.push_back( temp );
+                            values.push_back( old->second );
+                            Helpers::upsert( _config.finalLong , _config.reducer->finalReduce( values , _config.finalizer.get() ) );
+                        }
+                        else {
+                            // a new key, nothing to look up
+                            insert( _config.finalLong , temp );
+                        }
+                        getDur().commitIfNeeded();
                     }
-                    getDur().commitIfNeeded();
                 }
                 _db.dropCollection( _config.tempLong );
             }
@@ -444,6 +474,45 @@ namespace mongo {
             return _db.count( _config.finalLong );
         }
 
+        BSONObj State::incrementalFilter() {
+            const string& field = _config.incremental;
+
+            BSONObj old = _db.findOne( _config.marksLong , QUERY( "_id" << BSON( "out" << _config.finalLong << "ns" << _config.ns ) ) );
+            uassert( 14061 , str::stream() << "incremental field changed from " << old["field"].str() << " to " << field ,
+                     old.isEmpty() || old["field"].str() == field );
+
+            // documents inserted from now on are left for the next run
+            BSONObj fields = BSON( field << 1 );
+            BSONObj newest = _db.findOne( _config.ns , Query().sort( BSON( field << -1 ) ) , &fields );
+            if ( newest.isEmpty() )
+                return _config.filter;
+
+            BSONElement mark = newest.getFieldDotted( field );
+            uassert( 14062 , str::stream() << "no incremental field " << field << " in " << _config.ns , ! mark.eoo() );
+            _newMark = mark.wrap( "mark" );
+
+            BSONObjBuilder b;
+            b.appendElements( _config.filter );
+            BSONObjBuilder range( b.subobjStart( field ) );
+            if ( ! old.isEmpty() )
+                range.appendAs( old["mark"] , "$gt" );
+            range.appendAs( _newMark.firstElement() , "$lte" );
+            range.done();
+            return b.obj();
+        }
+
+        void State::saveMark() {
+            if ( _newMark.isEmpty() )
+                return;
+
+            BSONObj id = BSON( "out" << _config.finalLong << "ns" << _config.ns );
+            BSONObjBuilder b;
+            b.append( "_id" , id );
+            b.append( "field" , _config.incremental );
+            b.appendAs( _newMark.firstElement() , "mark" );
+            _db.update( _config.marksLong , QUERY( "_id" << id ) , b.obj() , true );
+        }
+
         /**
          * Insert doc in collection
          */
@@ -465,7 +534,7 @@ namespace mongo {
             getDur().commitIfNeeded();
         }
 
-        State::State( const Config& c ) : _config( c ), _size(0), _numEmits(0) {
+        State::State( const Config& c ) : _config( c ), _size(0), _dupCount(0), _numEmits(0), _jsMode(false) {
             _temp.reset( new InMemory() );
             _onDisk = _config.outType != Config::INMEMORY;
         }
@@ -479,6 +548,11 @@ namespace mongo {
         }
 
         State::~State() {
+            if ( _jsMode && _scope ) {
+                // the scope goes back to the pool, so don't keep the map alive
+                _scope->exec( "_mrMap = null;" , "mr cleanup" , false , false , false );
+            }
+
             if ( _onDisk ) {
                 try {
                     _db.dropCollection( _config.tempLong );
@@ -490,6 +564,74 @@ namespace mongo {
             }
         }
 
+        /**
+         * jsMode keeps emits in _mrMap, from the key as json to { k : key , v : [ values ] },
+         * so that they are only converted to bson once, at the end
+         */
+        static const char * jsModeSetup =
+            "_mrMap = {}; _mrEmits = 0; _mrKeys = 0; _mrVals = 0;\n"
+            "_mrKey = function( k ){\n"
+            "    // NumberLong(5) and 5 are the same key in bson\n"
+            "    if ( typeof NumberLong != 'undefined' && k instanceof NumberLong && k.top == undefined )\n"
+            "        return tojson( k.floatApprox );\n"
+            "    return tojson( k );\n"
+            "};\n"
+            "emit = function( k , v ){\n"
+            "    _mrEmits++;\n"
+            "    _mrVals++;\n"
+            "    var s = _mrKey( k );\n"
+            "    var e = _mrMap[s];\n"
+            "    if ( ! e ){\n"
+            "        e = _mrMap[s] = { k : k , v : [] };\n"
+            "        _mrKeys++;\n"
+            "    }\n"
+            "    e.v.push( v );\n"
+            "};\n"
+            "_mrReduceAll = function(){\n"
+            "    for ( var s in _mrMap ){\n"
+            "        var e = _mrMap[s];\n"
+            "        if ( e.v.length > 1 )\n"
+            "            e.v = [ _mrReduce( e.k , e.v ) ];\n"
+            "    }\n"
+            "    _mrVals = _mrKeys;\n"
+            "};\n"
+            "_mrCheck = function( maxKeys ){\n"
+            "    if ( _mrKeys > maxKeys )\n"
+            "        return false;\n"
+            "    if ( _mrVals > 2 * _mrKeys + 1000 )\n"
+            "        _mrReduceAll();\n"
+            "    return true;\n"
+            "};\n"
+            "_mrOut = function( n ){\n"
+            "    var out = {};\n"
+            "    var i = 0;\n"
+            "    for ( var s in _mrMap ){\n"
+            "        var e = _mrMap[s];\n"
+            "        var v = e.v.length > 1 ? _mrReduce( e.k , e.v ) : e.v[0];\n"
+            "        if ( typeof _mrFinalize != 'undefined' )\n"
+            "            v = _mrFinalize( e.k , v );\n"
+            "        out[i++] = { _id : e.k , value : v };\n"
+            "        delete _mrMap[s];\n"
+            "        if ( i >= n )\n"
+            "            break;\n"
+            "    }\n"
+            "    return out;\n"
+            "};\n"
+            "_mrDump = function( n ){\n"
+            "    var out = {};\n"
+            "    var i = 0;\n"
+            "    for ( var s in _mrMap ){\n"
+            "        var e = _mrMap[s];\n"
+            "        for ( var j=0; j<e.v.length; j++ )\n"
+            "            out[i++] = { '0' : e.k , '1' : e.v[j] };\n"
+            "        delete _mrMap[s];\n"
+            "        if ( i >= n )\n"
+            "            break;\n"
+            "    }\n"
+            "    return out;\n"
+            "};\n"
+            "_mrFinalize = undefined;\n";
+
         /**
          * Initialize the mapreduce operation, creating the inc collection
          */
@@ -506,7 +648,17 @@ namespace mongo {
             if ( _config.finalizer )
                 _config.finalizer->init( this );
 
-            _scope->injectNative( "emit" , fast_emit );
+            if ( _config.jsMode ) {
+                // emits go to the js map, reduce and finalize run from js
+                _scope->execSetup( jsModeSetup , "mr jsMode setup" );
+                _scope->execSetup( (string)"_mrReduce = " + _config.reduceCode.firstElement()._asCode() , "mr jsMode reduce" );
+                if ( ! _config.finalizeCode.isEmpty() )
+                    _scope->execSetup( (string)"_mrFinalize = " + _config.finalizeCode.firstElement()._asCode() , "mr jsMode finalize" );
+                _jsMode = true;
+            }
+            else {
+                _scope->injectNative( "emit" , fast_emit );
+            }
 
             if ( _onDisk ) {
                 // clear temp collections
@@ -548,6 +700,11 @@ namespace mongo {
          * If inline, the results will be in the in memory map
          */
         void State::finalReduce( CurOp * op , ProgressMeterHolder& pm ) {
+            if ( _jsMode ) {
+                _finalReduceInJS( op );
+                return;
+            }
+
             if ( ! _onDisk ) {
                 // all data has already been reduced, just finalize
                 if ( _config.finalizer ) {
@@ -648,6 +805,61 @@ namespace mongo {
             pm.finished();
         }
 
+        void State::_finalReduceInJS( CurOp * op ) {
+            op->setMessage( "m/r: (3/3) final reduce in js" );
+
+            long size = 0;
+            while ( true ) {
+                _scope->invokeSafe( "function( n ){ return _mrOut( n ); }" , BSON( "n" << 1000 ) );
+                BSONObj batch = _scope->getObject( "return" );
+                if ( batch.isEmpty() )
+                    break;
+
+                BSONObjIterator i( batch );
+                while ( i.more() ) {
+                    // { _id : key , value : val }
+                    BSONObj o = i.next().Obj().getOwned();
+                    if ( _onDisk ) {
+                        insert( _config.tempLong , o );
+                    }
+                    else {
+                        (*_temp)[o].push_back( o );
+                        size += o.objsize();
+                        uassert( 14058 , "too much data for in memory map/reduce" , size < ( BSONObjMaxUserSize / 2 ) );
+                    }
+                }
+
+                killCurrentOp.checkForInterrupt();
+            }
+            _size = size;
+        }
+
+        void State::bailFromJS() {
+            log(1) << "  mr: too many keys for jsMode, switching to bson" << endl;
+
+            _numEmits = (long long)_scope->getNumber( "_mrEmits" );
+            while ( true ) {
+                _scope->invokeSafe( "function( n ){ return _mrDump( n ); }" , BSON( "n" << 1000 ) );
+                BSONObj batch = _scope->getObject( "return" );
+                if ( batch.isEmpty() )
+                    break;
+
+                // { "0" : key , "1" : value } , like fast_emit gets
+                BSONObjIterator i( batch );
+                while ( i.more() )
+                    _add( _temp.get() , i.next().Obj().getOwned() , _size , _dupCount );
+            }
+
+            _scope->injectNative( "emit" , fast_emit );
+            _jsMode = false;
+        }
+
+        long long State::numEmits() const {
+            if ( _jsMode )
+                return (long long)_scope->getNumber( "_mrEmits" );
+            return _numEmits;
+        }
+
         /**
          * Attempts to reduce objects in the memory map.
          * A new memory map will be created to hold the results.
@@ -733,6 +945,15 @@ namespace mongo {
          * this method checks the size of in memory map and potentially flushes to disk
          */
         void State::checkSize() {
+            if ( _jsMode ) {
+                // reduces in js once there are twice as many values as keys
+                _scope->invokeSafe( "function( n ){ return _mrCheck( n ); }" , BSON( "n" << _config.jsMaxKeys ) );
+                if ( _scope->getBoolean( "return" ) )
+                    return;
+
+                bailFromJS();
+            }
+
             if ( _size < 1024 * 50 )
                 return;
 
@@ -813,6 +1034,9 @@ namespace mongo {
                 try {
                     state.init();
 
+                    if ( ! config.incremental.empty() )
+                        config.filter = state.incrementalFilter();
+
                     {
                         State** s = new State*();
                         s[0] = &state;
@@ -859,7 +1083,8 @@ namespace mongo {
 
                             // do map
                             if ( config.verbose ) mt.reset();
-                            config.mapper->map( o );
+                            // jsMode's emits can keep this past the record, so it gets a copy there
+                            config.mapper->map( state.jsMode() ? o.getOwned() : o );
                             if ( config.verbose ) mapTime += mt.micros();
 
                             num++;
@@ -893,9 +1118,12 @@ namespace mongo {
                     if ( state.numEmits() )
                         shouldHaveData = true;
 
+                    timingBuilder.append( "mode" , state.jsMode() ? "js" : config.jsMode ? "mixed" : "bson" );
                     timingBuilder.append( "mapTime" , mapTime / 1000 );
                     timingBuilder.append( "emitLoop" , t.millis() );
+                    timingBuilder.append( "reduceTime" , inReduce / 1000 );
 
+                    Timer ft;
                     op->setMessage( "m/r: (2/3) final reduce in memory" );
                     // do reduce in memory
                     // this will be the last reduce needed for inline mode
@@ -905,6 +1133,7 @@ namespace mongo {
                     state.prepTempCollection();
                     // final reduce
                     state.finalReduce( op , pm );
+                    timingBuilder.append( "finalReduceTime" , ft.millis() );
 
                     _tl.reset();
                 }
@@ -913,8 +1142,12 @@ namespace mongo {
                     throw;
                 }
 
+                Timer pt;
                 long long finalCount = state.postProcessCollection();
                 state.appendResults( result );
+                // only once the output has everything up to the mark
+                state.saveMark();
+                timingBuilder.append( "postProcessTime" , pt.millis() );
 
                 timingBuilder.append( "total" , t.millis() );
 
@@ -169,6 +169,14 @@ namespace mongo {
             BSONObj mapParams;
             BSONObj scopeSetup;
 
+            // the functions' code, for jsMode to define them in the scope
+            BSONObj reduceCode;
+            BSONObj finalizeCode;
+
+            // keep emits in the js heap until more than jsMaxKeys keys
+            bool jsMode;
+            long long jsMaxKeys;
+
             // output tables
             string incLong;
             string tempLong;
@@ -178,6 +186,11 @@ namespace mongo {
 
             string outDB;
 
+            // field the source is inserted in order of, for out : { reduce : ... , incremental : <field> }
+            string incremental;
+            // where the high-water marks of incremental jobs are kept
+            string marksLong;
+
             enum { REPLACE , // atomically replace the collection
                    MERGE ,  // merge keys, override dups
                    REDUCE , // merge keys, reduce dups
@@ -221,11 +234,27 @@ namespace mongo {
              */
             void reduceInMemory();
 
+            /** @return true while emits are kept in the js map rather than in _temp */
+            bool jsMode() const { return _jsMode; }
+
+            /**
+             * moves every emit out of the js map into _temp, and emits go there from then on
+             */
+            void bailFromJS();
+
             /**
              * transfers in memory storage to temp collection
              */
             void dumpToInc();
 
+            /**
+             * for an incremental job, @return the filter restricted to documents after the
+             * mark of the last run, up to the newest now, which saveMark() records when done
+             */
+            BSONObj incrementalFilter();
+
+            void saveMark();
+
             // ------ reduce stage -----------
 
             void prepTempCollection();
@@ -263,13 +292,16 @@ namespace mongo {
 
             const bool isOnDisk() { return _onDisk; }
 
-            long long numEmits() const { return _numEmits; }
+            long long numEmits() const;
 
         protected:
 
             void _insertToInc( BSONObj& o );
             static void _add( InMemory* im , const BSONObj& a , long& size, long& dupCount );
 
+            /** reduces and finalizes what is left in the js map, into _temp or the temp collection */
+            void _finalReduceInJS( CurOp * op );
+
             scoped_ptr<Scope> _scope;
             const Config& _config;
             bool _onDisk; // if the end result of this map reduce is disk or not
@@ -281,6 +313,10 @@ namespace mongo {
             long _dupCount; // number of duplicate key entries
 
             long long _numEmits;
+
+            bool _jsMode;
+
+            BSONObj _newMark; // { mark : <value> } , the high-water mark of this incremental run
         };
 
         BSONObj fast_emit( const BSONObj& args );
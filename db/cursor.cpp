@@ -38,6 +38,132 @@ namespace mongo {
         return ok();
     }
 
+    ScanFilter::ScanFilter( const BSONObj &query ) {
+        BSONObjIterator i( query );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            const char *fn = e.fieldName();
+            if ( fn[ 0 ] == '$' || strchr( fn, '.' ) )
+                continue;
+            vector< Bound > bounds;
+            if ( e.isNumber() ) {
+                Bound b = { fn, BSONObj::Equality, e.number(), e.type() == NumberLong };
+                bounds.push_back( b );
+            }
+            else if ( e.type() == Object ) {
+                BSONObjIterator j( e.embeddedObject() );
+                while ( j.more() ) {
+                    BSONElement f = j.next();
+                    if ( f.fieldName()[ 0 ] != '$' ) {
+                        // { a : { b : 1 } } is an embedded object equality
+                        bounds.clear();
+                        break;
+                    }
+                    int op = f.getGtLtOp( -1 );
+                    if ( f.isNumber() &&
+                         ( op == BSONObj::LT || op == BSONObj::LTE || op == BSONObj::GT || op == BSONObj::GTE ) ) {
+                        Bound b = { fn, op, f.number(), f.type() == NumberLong };
+                        bounds.push_back( b );
+                    }
+                }
+            }
+            for( vector< Bound >::const_iterator j = bounds.begin(); j != bounds.end(); ++j ) {
+                // compareElementValues orders NaN and +/-inf specially, let the Matcher handle those
+                if ( j->value <= numeric_limits< double >::max() && j->value >= -numeric_limits< double >::max() )
+                    _bounds.push_back( *j );
+            }
+        }
+    }
+
+    bool ScanFilter::mayMatch( const BSONObj &o ) const {
+        for( vector< Bound >::const_iterator i = _bounds.begin(); i != _bounds.end(); ++i ) {
+            BSONElement e = o.getField( i->field );
+            if ( e.type() == Array )
+                continue; // the Matcher looks inside arrays
+            if ( !e.isNumber() )
+                return false; // missing or different type never satisfies a numeric condition
+            double d = e.number();
+            if ( !( d <= numeric_limits< double >::max() && d >= -numeric_limits< double >::max() ) )
+                continue;
+            // longs may round to equal doubles, so strict bounds are only checked loosely there
+            bool loose = i->isLong || e.type() == NumberLong;
+            switch( i->op ) {
+            case BSONObj::Equality:
+                if ( d != i->value ) return false;
+                break;
+            case BSONObj::LT:
+                if ( loose ? d > i->value : d >= i->value ) return false;
+                break;
+            case BSONObj::LTE:
+                if ( d > i->value ) return false;
+                break;
+            case BSONObj::GT:
+                if ( loose ? d < i->value : d <= i->value ) return false;
+                break;
+            case BSONObj::GTE:
+                if ( d < i->value ) return false;
+                break;
+            }
+        }
+        return true;
+    }
+
+    BatchedBasicCursor::BatchedBasicCursor( DiskLoc dl, const ScanFilter &filter, int numWanted ) :
+        BasicCursor( dl ), _filter( filter ), _pos(),
+        _batchSize( numWanted > 0 && numWanted < BatchSize ? numWanted : BatchSize ) {
+        if ( ok() && !_filter.mayMatch( current() ) )
+            advance();
+    }
+
+    bool BatchedBasicCursor::advance() {
+        killCurrentOp.checkForInterrupt();
+        if ( eof() )
+            return false;
+        last = curr;
+        if ( _pos + 1 < _batch.size() )
+            ++_pos;
+        else
+            fill();
+        if ( _pos < _batch.size() ) {
+            curr = _batch[ _pos ];
+            addNscanned( _walked[ _pos ] );
+        }
+        else {
+            curr = DiskLoc();
+        }
+        return ok();
+    }
+
+    void BatchedBasicCursor::fill() {
+        _batch.clear();
+        _walked.clear();
+        _pos = 0;
+        unsigned n = 0;
+        DiskLoc loc = s->next( curr );
+        while ( !loc.isNull() ) {
+            ++n;
+            if ( _filter.mayMatch( BSONObj( loc.rec() ) ) ) {
+                _batch.push_back( loc );
+                _walked.push_back( n );
+                n = 0;
+                if ( _batch.size() == _batchSize )
+                    break;
+            }
+            else if ( n == 16 * BatchSize ) {
+                // nothing matching for a while: hand back a position so the caller can yield
+                _batch.push_back( loc );
+                _walked.push_back( n );
+                break;
+            }
+            loc = s->next( loc );
+        }
+        if ( loc.isNull() ) {
+            // walked to the end, so the records after the last candidate are used up too
+            addNscanned( n );
+        }
+        _batchSize = min( 2 * _batchSize, (unsigned)BatchSize );
+    }
+
     /* these will be used outside of mutexes - really functors - thus the const */
     class Forward : public AdvanceStrategy {
         virtual DiskLoc next( const DiskLoc &prev ) const {
@@ -175,6 +175,7 @@ namespace mongo {
         DiskLoc curr, last;
         const AdvanceStrategy *s;
         void incNscanned() { if ( !curr.isNull() ) { ++_nscanned; } }
+        void addNscanned( long long n ) { _nscanned += n; }
     private:
         bool tailable_;
         shared_ptr< CoveredIndexMatcher > _matcher;
@@ -182,6 +183,52 @@ namespace mongo {
         void init() { tailable_ = false; }
     };
 
+    /* The top level numeric conditions of a query, e.g. { a : 3 , b : { $gt : 5 } }.
+       These are ANDed with everything else in the query, so a record failing them
+       can't match it: a cheap pre-check for table scans, before the full Matcher.
+       Anything the checks can't decide (arrays, NaN, non numeric operators) passes.
+    */
+    class ScanFilter {
+    public:
+        ScanFilter( const BSONObj &query );
+        bool empty() const { return _bounds.empty(); }
+        bool mayMatch( const BSONObj &o ) const;
+    private:
+        struct Bound {
+            string field;
+            int op;         // BSONObj::Equality, LT, LTE, GT or GTE
+            double value;
+            bool isLong;
+        };
+        vector< Bound > _bounds;
+    };
+
+    /* forward table scan which walks ahead of the current position a batch of records at
+       a time, skipping the ones a ScanFilter rules out.  The records are read in a tight
+       loop rather than one advance()/matcher call apiece.  Read ahead positions are dropped
+       in noteLocation(), so nothing but curr is relied upon across a yield.
+       The first batch is no bigger than numWanted, when known, and each one after that
+       doubles up to BatchSize.  nscanned only counts records up to the current position.
+    */
+    class BatchedBasicCursor : public BasicCursor {
+    public:
+        enum { BatchSize = 1024 };
+        BatchedBasicCursor( DiskLoc dl, const ScanFilter &filter, int numWanted = 0 );
+        virtual bool advance();
+        virtual void noteLocation() {
+            _batch.clear();
+            _walked.clear();
+            _pos = 0;
+        }
+    private:
+        void fill();
+        ScanFilter _filter;
+        vector< DiskLoc > _batch;
+        vector< unsigned > _walked; // records walked to reach each of _batch
+        unsigned _pos;
+        unsigned _batchSize;
+    };
+
     /* used for order { $natural: -1 } */
     class ReverseCursor : public BasicCursor {
     public:
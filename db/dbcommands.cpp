@@ -511,6 +511,12 @@ namespace mongo {
 
             result.append( "writeBacksQueued" , ! writeBackManager.queuesEmpty() );
 
+            if ( globalScriptEngine ) {
+                BSONObjBuilder bb( result.subobjStart( "jsFunctionCache" ) );
+                Scope::appendFunctionCacheStats( bb );
+                bb.done();
+            }
+
             if( cmdLine.dur ) {
                 result.append("dur", dur::stats.asObj());
             }
@@ -234,7 +234,7 @@ namespace mongo {
         return me.obj();
     }
 
-    long long Helpers::removeRange( const string& ns , const BSONObj& min , const BSONObj& max , bool yield , bool maxInclusive , RemoveCallback * callback ) {
+    long long Helpers::removeRange( const string& ns , const BSONObj& min , const BSONObj& max , bool yield , bool maxInclusive , RemoveCallback * callback , const BSONObj& keyPattern , long long limit ) {
         BSONObj keya , keyb;
         BSONObj minClean = toKeyFormat( min , keya );
         BSONObj maxClean = toKeyFormat( max , keyb );
@@ -245,7 +245,7 @@ namespace mongo {
         if ( ! nsd )
             return 0;
 
-        int ii = nsd->findIndexByKeyPattern( keya );
+        int ii = nsd->findIndexByKeyPattern( keyPattern.isEmpty() ? keya : keyPattern );
         assert( ii >= 0 );
 
         long long num = 0;
@@ -256,7 +256,7 @@ namespace mongo {
         auto_ptr<ClientCursor> cc( new ClientCursor( QueryOption_NoCursorTimeout , c , ns ) );
         cc->setDoingDeletes( true );
 
-        while ( c->ok() ) {
+        while ( c->ok() && ( limit == 0 || num < limit ) ) {
             DiskLoc rloc = c->currLoc();
 
             if ( callback )
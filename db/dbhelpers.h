@@ -109,8 +109,12 @@ namespace mongo {
             virtual ~RemoveCallback() {}
             virtual void goingToDelete( const BSONObj& o ) = 0;
         };
-        /* removeRange: operation is oplog'd */
-        static long long removeRange( const string& ns , const BSONObj& min , const BSONObj& max , bool yield = false , bool maxInclusive = false , RemoveCallback * callback = 0 );
+        /* removeRange: operation is oplog'd
+           keyPattern: the index to go over, when it is not the one with min's field names in ascending order
+                       (e.g. { a : "hashed" }, where min and max are hashes)
+           limit: stop after deleting that many documents, 0 for no limit
+        */
+        static long long removeRange( const string& ns , const BSONObj& min , const BSONObj& max , bool yield = false , bool maxInclusive = false , RemoveCallback * callback = 0 , const BSONObj& keyPattern = BSONObj() , long long limit = 0 );
 
         /* Remove all objects from a collection.
         You do not need to set the database before calling.
@@ -26,6 +26,7 @@
 #include "../btree.h"
 #include "../curop-inl.h"
 #include "../matcher.h"
+#include <queue>
 
 #include "core.h"
 
@@ -417,6 +418,134 @@ namespace mongo {
         Point _max;
     };
 
+    /**
+     * @return a lower bound on the distance from p to any point of box, 0 if p is in it.
+     * for GEO_SPHERE x is longitude and the result is in radians: both the latitude gap and
+     * the distance to the great circle of the nearest meridian edge are lower bounds.
+     */
+    inline double minDistance( const Box& box , const Point& p , GeoDistType type ) {
+        double dx = max( 0.0 , max( box._min._x - p._x , p._x - box._max._x ) );
+        double dy = max( 0.0 , max( box._min._y - p._y , p._y - box._max._y ) );
+
+        if ( type == GEO_PLAIN )
+            return sqrt( ( dx * dx ) + ( dy * dy ) );
+
+        double d = deg2rad( dy );
+        if ( dx > 0 && box._max._x - box._min._x <= 180 ) {
+            // going the other way around may be shorter
+            double around = p._x < box._min._x ? p._x + 360 - box._max._x : box._min._x + 360 - p._x;
+            dx = min( dx , around );
+            if ( dx < 90 )
+                d = max( d , asin( sin( deg2rad( dx ) ) * cos( deg2rad( p._y ) ) ) );
+        }
+        return d;
+    }
+
+    /**
+     * a simple polygon, with straight edges in index coordinates.
+     * edges are bucketed into horizontal bands once, so that testing a point only looks at the
+     * edges in its band, and testing a box only at those in the bands it spans.
+     */
+    class Polygon {
+    public:
+        enum { MaxBands = 4096 };
+
+        Polygon( const vector<Point>& points ) : _points( points ) {
+            assert( _points.size() );
+            _bounds = Box( _points[0] , _points[0] );
+            for ( unsigned i=1; i<_points.size(); i++ ) {
+                _bounds._min._x = min( _bounds._min._x , _points[i]._x );
+                _bounds._min._y = min( _bounds._min._y , _points[i]._y );
+                _bounds._max._x = max( _bounds._max._x , _points[i]._x );
+                _bounds._max._y = max( _bounds._max._y , _points[i]._y );
+            }
+
+            _numBands = min( (unsigned)MaxBands , (unsigned)_points.size() );
+            _bandHeight = ( _bounds._max._y - _bounds._min._y ) / _numBands;
+            _bands.resize( _numBands );
+            for ( unsigned i=0; i<_points.size(); i++ ) {
+                const Point& a = _points[i];
+                const Point& b = _points[ ( i + 1 ) % _points.size() ];
+                int last = band( max( a._y , b._y ) );
+                for ( int k = band( min( a._y , b._y ) ); k <= last; k++ )
+                    _bands[k].push_back( i );
+            }
+        }
+
+        const Box& bounds() const { return _bounds; }
+
+        /** ray casting towards +x, over the edges of p's band */
+        bool contains( const Point& p ) const {
+            if ( p._x < _bounds._min._x || p._x > _bounds._max._x ||
+                    p._y < _bounds._min._y || p._y > _bounds._max._y )
+                return false;
+
+            bool in = false;
+            const vector<unsigned>& edges = _bands[ band( p._y ) ];
+            for ( unsigned i=0; i<edges.size(); i++ ) {
+                const Point& a = _points[ edges[i] ];
+                const Point& b = _points[ ( edges[i] + 1 ) % _points.size() ];
+                if ( ( a._y > p._y ) == ( b._y > p._y ) )
+                    continue;
+                double x = a._x + ( p._y - a._y ) * ( b._x - a._x ) / ( b._y - a._y );
+                if ( p._x < x )
+                    in = ! in;
+            }
+            return in;
+        }
+
+        /** @return whether any edge goes through box */
+        bool crosses( const Box& box ) const {
+            int last = band( box._max._y );
+            for ( int k = band( box._min._y ); k <= last; k++ ) {
+                const vector<unsigned>& edges = _bands[k];
+                for ( unsigned i=0; i<edges.size(); i++ ) {
+                    if ( segmentCrosses( _points[ edges[i] ] , _points[ ( edges[i] + 1 ) % _points.size() ] , box ) )
+                        return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        int band( double y ) const {
+            if ( _bandHeight <= 0 )
+                return 0;
+            int b = (int)( ( y - _bounds._min._y ) / _bandHeight );
+            return max( 0 , min( (int)_numBands - 1 , b ) );
+        }
+
+        /** > 0 when p is left of a->b, < 0 when right */
+        static double side( const Point& a , const Point& b , const Point& p ) {
+            return ( ( b._x - a._x ) * ( p._y - a._y ) ) - ( ( b._y - a._y ) * ( p._x - a._x ) );
+        }
+
+        static bool segmentCrosses( const Point& a , const Point& b , const Box& box ) {
+            if ( max( a._x , b._x ) < box._min._x || min( a._x , b._x ) > box._max._x ||
+                    max( a._y , b._y ) < box._min._y || min( a._y , b._y ) > box._max._y )
+                return false;
+
+            // the segment's bounds overlap the box, so it goes through unless all corners are on one side
+            double s[4] = { side( a , b , box._min ) , side( a , b , Point( box._min._x , box._max._y ) ) ,
+                            side( a , b , box._max ) , side( a , b , Point( box._max._x , box._min._y ) )
+                          };
+            bool left = false, right = false;
+            for ( int i=0; i<4; i++ ) {
+                if ( s[i] >= 0 )
+                    left = true;
+                if ( s[i] <= 0 )
+                    right = true;
+            }
+            return left && right;
+        }
+
+        vector<Point> _points;
+        Box _bounds;
+        unsigned _numBands;
+        double _bandHeight;
+        vector< vector<unsigned> > _bands; // edge i goes from _points[i] to the next
+    };
+
     class Geo2dPlugin : public IndexPlugin {
     public:
         Geo2dPlugin() : IndexPlugin( GEO2DNAME ) {
@@ -666,6 +795,47 @@ namespace mongo {
                     assert( fabs(M_PI-spheredist_deg(antizero, zero)) < 1e-6);
                 }
             }
+
+            {
+                // cell distances are lower bounds
+                Box b( Point( 10 , 10 ) , Point( 20 , 20 ) );
+                assert( minDistance( b , Point( 15 , 15 ) , GEO_PLAIN ) == 0 );
+                assert( minDistance( b , Point( 15 , 5 ) , GEO_PLAIN ) == 5 );
+                assert( fabs( minDistance( b , Point( 23 , 24 ) , GEO_PLAIN ) - 5 ) < 1e-6 );
+
+                Point BNA (-86.67, 36.12);
+                Point LAX (-118.40, 33.94);
+                Box around( Point( -119 , 33 ) , Point( -118 , 34 ) );
+                double d = minDistance( around , BNA , GEO_SPHERE );
+                assert( d > 0.4 && d <= spheredist_deg( BNA , LAX ) );
+                assert( minDistance( around , LAX , GEO_SPHERE ) == 0 );
+
+                // nearer going the other way around
+                Box east( Point( 170 , -10 ) , Point( 175 , 10 ) );
+                assert( minDistance( east , Point( -170 , 0 ) , GEO_SPHERE ) < deg2rad( 15 ) + 1e-9 );
+            }
+
+            {
+                // an L
+                vector<Point> points;
+                points.push_back( Point( 0 , 0 ) );
+                points.push_back( Point( 10 , 0 ) );
+                points.push_back( Point( 10 , 5 ) );
+                points.push_back( Point( 5 , 5 ) );
+                points.push_back( Point( 5 , 10 ) );
+                points.push_back( Point( 0 , 10 ) );
+                Polygon l( points );
+
+                assert( l.contains( Point( 2 , 2 ) ) );
+                assert( l.contains( Point( 7 , 2 ) ) );
+                assert( l.contains( Point( 2 , 7 ) ) );
+                assert( ! l.contains( Point( 7 , 7 ) ) );
+                assert( ! l.contains( Point( 11 , 1 ) ) );
+
+                assert( l.crosses( Box( Point( 4 , 4 ) , Point( 6 , 6 ) ) ) );
+                assert( ! l.crosses( Box( Point( 1 , 1 ) , Point( 2 , 2 ) ) ) );
+                assert( ! l.crosses( Box( Point( 7 , 7 ) , Point( 9 , 9 ) ) ) );
+            }
         }
     } geoUnitTest;
 
@@ -708,32 +878,36 @@ namespace mongo {
         virtual ~GeoAccumulator() {
         }
 
-        virtual void add( const KeyNode& node ) {
+        void add( const KeyNode& node ) {
+            add( node.key , node.recordLoc );
+        }
+
+        void add( const BSONObj& key , const DiskLoc& loc ) {
             // when looking at other boxes, don't want to look at some object twice
-            pair<set<DiskLoc>::iterator,bool> seenBefore = _seen.insert( node.recordLoc );
+            pair<set<DiskLoc>::iterator,bool> seenBefore = _seen.insert( loc );
             if ( ! seenBefore.second ) {
-                GEODEBUG( "\t\t\t\t already seen : " << node.recordLoc.obj()["_id"] );
+                GEODEBUG( "\t\t\t\t already seen : " << loc.obj()["_id"] );
                 return;
             }
             _lookedAt++;
 
             // distance check
             double d = 0;
-            if ( ! checkDistance( GeoHash( node.key.firstElement() ) , d ) ) {
-                GEODEBUG( "\t\t\t\t bad distance : " << node.recordLoc.obj()  << "\t" << d );
+            if ( ! checkDistance( GeoHash( key.firstElement() ) , d ) ) {
+                GEODEBUG( "\t\t\t\t bad distance : " << loc.obj()  << "\t" << d );
                 return;
             }
-            GEODEBUG( "\t\t\t\t good distance : " << node.recordLoc.obj()  << "\t" << d );
+            GEODEBUG( "\t\t\t\t good distance : " << loc.obj()  << "\t" << d );
 
             // matcher
             MatchDetails details;
             if ( _matcher.get() ) {
-                bool good = _matcher->matches( node.key , node.recordLoc , &details );
+                bool good = _matcher->matches( key , loc , &details );
                 if ( details.loadedObject )
                     _objectsLoaded++;
 
                 if ( ! good ) {
-                    GEODEBUG( "\t\t\t\t didn't match : " << node.recordLoc.obj()["_id"] );
+                    GEODEBUG( "\t\t\t\t didn't match : " << loc.obj()["_id"] );
                     return;
                 }
             }
@@ -741,11 +915,11 @@ namespace mongo {
             if ( ! details.loadedObject ) // dont double count
                 _objectsLoaded++;
 
-            addSpecific( node , d );
+            addSpecific( key , loc , d );
             _found++;
         }
 
-        virtual void addSpecific( const KeyNode& node , double d ) = 0;
+        virtual void addSpecific( const BSONObj& key , const DiskLoc& loc , double d ) = 0;
         virtual bool checkDistance( const GeoHash& node , double& d ) = 0;
 
         long long found() const {
@@ -769,26 +943,29 @@ namespace mongo {
             : GeoAccumulator( g , filter ) , _max( max ) , _near( n ), _maxDistance( maxDistance ), _type( type ), _farthest(-1)
         {}
 
-        virtual bool checkDistance( const GeoHash& h , double& d ) {
+        double distance( const GeoHash& h ) const {
             switch (_type) {
             case GEO_PLAIN:
-                d = _near.distance( Point(_g, h) );
-                break;
+                return _near.distance( Point(_g, h) );
             case GEO_SPHERE:
-                d = spheredist_deg(_near, Point(_g, h));
-                break;
+                return spheredist_deg(_near, Point(_g, h));
             default:
                 assert(0);
             }
+            return 0;
+        }
+
+        virtual bool checkDistance( const GeoHash& h , double& d ) {
+            d = distance( h );
             bool good = d < _maxDistance && ( _points.size() < _max || d < farthest() );
             GEODEBUG( "\t\t\t\t\t\t\t checkDistance " << _near.toString() << "\t" << h << "\t" << d
                       << " ok: " << good << " farthest: " << farthest() );
             return good;
         }
 
-        virtual void addSpecific( const KeyNode& node , double d ) {
-            GEODEBUG( "\t\t" << GeoHash( node.key.firstElement() ) << "\t" << node.recordLoc.obj() << "\t" << d );
-            _points.insert( GeoPoint( node.key , node.recordLoc , d ) );
+        virtual void addSpecific( const BSONObj& key , const DiskLoc& loc , double d ) {
+            GEODEBUG( "\t\t" << GeoHash( key.firstElement() ) << "\t" << loc.obj() << "\t" << d );
+            _points.insert( GeoPoint( key , loc , d ) );
             if ( _points.size() > _max ) {
                 _points.erase( --_points.end() );
 
@@ -888,175 +1065,111 @@ namespace mongo {
         }
     };
 
+    /**
+     * $near and geoNear: best first search over geohash cells.
+     * a queue holds cells, keyed by the least distance a point in them could be at, and points,
+     * keyed by their distance. a cell is replaced by its points when it has few enough keys,
+     * and by its four quarters when it doesn't. when a point comes off the queue nothing left
+     * can be nearer, so points are checked against the query in order until numWanted match.
+     */
     class GeoSearch {
     public:
+        enum { MaxKeysPerCell = 128 }; // more and the cell is split instead
+
         GeoSearch( const Geo2dType * g , const GeoHash& n , int numWanted=100 , BSONObj filter=BSONObj() , double maxDistance = numeric_limits<double>::max() , GeoDistType type=GEO_PLAIN)
             : _spec( g ) ,_startPt(g,n), _start( n ) ,
               _numWanted( numWanted ) , _filter( filter ) , _maxDistance( maxDistance ) ,
-              _hopper( new GeoHopper( g , numWanted , _startPt , filter , maxDistance, type ) ), _type(type) {
+              _hopper( new GeoHopper( g , numWanted , _startPt , filter , maxDistance, type ) ), _type(type) ,
+              _ordering( Ordering::make( g->_order ) ) {
             assert( g->getDetails() );
             _nscanned = 0;
             _found = 0;
-
-            if (type == GEO_PLAIN) {
-                _scanDistance = maxDistance;
-            }
-            else if (type == GEO_SPHERE) {
-                if (maxDistance == numeric_limits<double>::max()) {
-                    _scanDistance = maxDistance;
-                }
-                else {
-                    //TODO: consider splitting into x and y scan distances
-                    _scanDistance = computeXScanDistance(_startPt._y, rad2deg(maxDistance));
-                }
-            }
-            else {
-                assert(0);
-            }
         }
 
         void exec() {
             const IndexDetails& id = *_spec->getDetails();
 
-            const BtreeBucket * head = id.head.btree();
-            assert( head );
-            /*
-             * Search algorithm
-             * 1) use geohash prefix to find X items
-             * 2) compute max distance from want to an item
-             * 3) find optimal set of boxes that complete circle
-             * 4) use regular btree cursors to scan those boxes
-             */
+            _queue.push( Candidate( 0 , GeoHash() ) );
+            while ( ! _queue.empty() && _hopper->found() < _numWanted ) {
+                Candidate c = _queue.top();
+                _queue.pop();
 
-            GeoHopper * hopper = _hopper.get();
+                if ( c._distance >= _maxDistance )
+                    break;
 
-            _prefix = _start;
-            BtreeLocation min,max;
-            {
-                // 1 regular geo hash algorithm
+                if ( c.isCell() )
+                    scanCell( id , c._cell );
+                else
+                    _hopper->add( c._key , c._loc );
+            }
 
+            // for explain, the smallest cell holding everything found
+            _prefix = _start;
+            GeoHopper::Holder::iterator i = _hopper->_points.begin();
+            if ( i != _hopper->_points.end() ) {
+                _prefix = GeoHash( i->_key.firstElement() , _spec->_bits );
+                for ( ++i; i != _hopper->_points.end(); ++i )
+                    _prefix = _prefix.commonPrefix( GeoHash( i->_key.firstElement() , _spec->_bits ) );
+            }
+            GEODEBUG( "done search" )
+        }
 
-                if ( ! BtreeLocation::initial( id , _spec , min , max , _start , _found , NULL ) )
+        /** queues the points in cell, or its quarters from the one the walk stopped in */
+        void scanCell( const IndexDetails& id , const GeoHash& cell ) {
+            BtreeLocation loc;
+            loc.bucket = id.head.btree()->locate( id , id.head , cell.wrap() , _ordering ,
+                                                  loc.pos , loc.found , minDiskLoc );
+            int walked = 0;
+            while ( ! loc.bucket.isNull() ) {
+                KeyNode node = loc.bucket.btree()->keyNode( loc.pos );
+                GeoHash h( node.key.firstElement() );
+                if ( ! h.hasPrefix( cell ) )
                     return;
 
-                while ( !_prefix.constrains() || // if next pass would cover universe, just keep going
-                        ( _hopper->found() < _numWanted && _spec->sizeEdge( _prefix ) <= _scanDistance)) {
-                    GEODEBUG( _prefix << "\t" << _found << "\t DESC" );
-                    while ( min.hasPrefix(_prefix) && min.checkCur(_found, hopper) && min.advance(-1, _found, NULL) )
-                        _nscanned++;
-                    GEODEBUG( _prefix << "\t" << _found << "\t ASC" );
-                    while ( max.hasPrefix(_prefix) && max.checkCur(_found, hopper) && max.advance(+1, _found, NULL) )
-                        _nscanned++;
-
-                    if ( ! _prefix.constrains() ) {
-                        GEODEBUG( "done search w/o part 2" )
-                        return;
+                if ( ++walked > MaxKeysPerCell && cell.getBits() < _spec->_bits ) {
+                    // the quarters before h have been walked already
+                    static const char * quarters[] = { "00" , "01" , "10" , "11" };
+                    unsigned pos = cell.getBits() * 2;
+                    for ( int q = ( h.getBit( pos ) ? 2 : 0 ) + ( h.getBit( pos + 1 ) ? 1 : 0 ); q < 4; q++ ) {
+                        GeoHash quarter = cell + quarters[q];
+                        double d = minDistance( Box( _spec , quarter ) , _startPt , _type );
+                        if ( d < _maxDistance )
+                            _queue.push( Candidate( d , quarter ) );
                     }
-
-                    _alreadyScanned = Box(_spec, _prefix);
-                    _prefix = _prefix.up();
-                }
-            }
-            GEODEBUG( "done part 1" );
-            {
-                // 2
-                double farthest = hopper->farthest();
-                GEODEBUGPRINT(hopper->farthest());
-                if (hopper->found() < _numWanted) {
-                    // Not enough found in Phase 1
-                    farthest = _scanDistance;
-                }
-                else if (_type == GEO_SPHERE) {
-                    farthest = std::min(_scanDistance, computeXScanDistance(_startPt._y, rad2deg(farthest)));
-                }
-                GEODEBUGPRINT(farthest);
-
-                Box want( _startPt._x - farthest , _startPt._y - farthest , farthest * 2 );
-                GEODEBUGPRINT(want.toString());
-
-                _prefix = _start;
-                while (_prefix.constrains() && _spec->sizeEdge( _prefix ) < farthest ) {
-                    _prefix = _prefix.up();
-                }
-
-                PREFIXDEBUG(_prefix, _spec);
-
-                if (_prefix.getBits() <= 1) {
-                    // TODO consider walking in $natural order
-
-                    while ( min.checkCur(_found, hopper) && min.advance(-1, _found, NULL) )
-                        _nscanned++;
-                    while ( max.checkCur(_found, hopper) && max.advance(+1, _found, NULL) )
-                        _nscanned++;
-
-                    GEODEBUG( "done search after scanning whole collection" )
                     return;
                 }
 
-                if ( logLevel > 0 ) {
-                    log(1) << "want: " << want << " found:" << _found << " nscanned: " << _nscanned << " hash size:" << _spec->sizeEdge( _prefix )
-                           << " farthest: " << farthest << " using box: " << Box( _spec , _prefix ).toString() << endl;
-                }
-
-                for ( int x=-1; x<=1; x++ ) {
-                    for ( int y=-1; y<=1; y++ ) {
-                        GeoHash toscan = _prefix;
-                        toscan.move( x , y );
-
-                        // 3 & 4
-                        doBox( id , want , toscan );
-                    }
+                _nscanned++;
+                if ( loc.bucket.btree()->isUsed( loc.pos ) && _queued.insert( node.recordLoc ).second ) {
+                    double d = _hopper->distance( h );
+                    if ( d < _maxDistance )
+                        _queue.push( Candidate( d , node.key , node.recordLoc ) );
                 }
+                loc.advance( 1 , _found , NULL );
             }
-            GEODEBUG( "done search" )
-
         }
 
-        void doBox( const IndexDetails& id , const Box& want , const GeoHash& toscan , int depth = 0 ) {
-            Box testBox( _spec , toscan );
-            if ( logLevel > 2 ) {
-                cout << "\t";
-                for ( int i=0; i<depth; i++ )
-                    cout << "\t";
-                cout << " doBox: " << testBox.toString() << "\t" << toscan.toString() << " scanned so far: " << _nscanned << endl;
-            }
-            else {
-                GEODEBUGPRINT(testBox.toString());
-            }
-
-            if (_alreadyScanned.contains(testBox, _spec->_error)) {
-                GEODEBUG("skipping box: already scanned");
-                return; // been here, done this
-            }
-
-            double intPer = testBox.intersects( want );
-
-            if ( intPer <= 0 ) {
-                GEODEBUG("skipping box: not in want");
-                return;
-            }
-
-            bool goDeeper = intPer < .5 && depth < 2;
+        /** a cell, or a point when _loc is set */
+        struct Candidate {
+            Candidate( double d , const GeoHash& cell ) : _distance( d ) , _cell( cell ) {}
+            Candidate( double d , const BSONObj& key , const DiskLoc& loc ) : _distance( d ) , _key( key ) , _loc( loc ) {}
 
-            long long myscanned = 0;
+            bool isCell() const { return _loc.isNull(); }
 
-            BtreeLocation loc;
-            loc.bucket = id.head.btree()->locate( id , id.head , toscan.wrap() , Ordering::make(_spec->_order) ,
-                                                  loc.pos , loc.found , minDiskLoc );
-            loc.checkCur( _found , _hopper.get() );
-            while ( loc.hasPrefix( toscan ) && loc.advance( 1 , _found , _hopper.get() ) ) {
-                _nscanned++;
-                if ( ++myscanned > 100 && goDeeper ) {
-                    doBox( id , want , toscan + "00" , depth + 1);
-                    doBox( id , want , toscan + "01" , depth + 1);
-                    doBox( id , want , toscan + "10" , depth + 1);
-                    doBox( id , want , toscan + "11" , depth + 1);
-                    return;
-                }
+            /** reversed, for the nearest to be on top. ties are broken so results don't change with num */
+            bool operator<( const Candidate& other ) const {
+                if ( _distance != other._distance )
+                    return _distance > other._distance;
+                if ( isCell() != other.isCell() )
+                    return isCell();
+                return other._loc < _loc;
             }
 
-        }
-
+            double _distance;
+            GeoHash _cell;
+            BSONObj _key;
+            DiskLoc _loc;
+        };
 
         const Geo2dType * _spec;
 
@@ -1066,14 +1179,15 @@ namespace mongo {
         int _numWanted;
         BSONObj _filter;
         double _maxDistance;
-        double _scanDistance;
         shared_ptr<GeoHopper> _hopper;
 
         long long _nscanned;
         int _found;
         GeoDistType _type;
 
-        Box _alreadyScanned;
+        Ordering _ordering;
+        priority_queue<Candidate> _queue;
+        set<DiskLoc> _queued;
     };
 
     class GeoCursorBase : public Cursor {
@@ -1143,7 +1257,8 @@ namespace mongo {
         }
         virtual BSONObj prettyEndKey() const {
             GeoHash temp = _s->_prefix;
-            temp.move( 1 , 1 );
+            if ( temp.constrains() )
+                temp.move( 1 , 1 );
             return BSON( _s->_spec->_geo << temp.toString() );
         }
 
@@ -1221,11 +1336,11 @@ namespace mongo {
         virtual bool moreToDo() = 0;
         virtual void fillStack() = 0;
 
-        virtual void addSpecific( const KeyNode& node , double d ) {
+        virtual void addSpecific( const BSONObj& key , const DiskLoc& loc , double d ) {
             if ( _cur.isEmpty() )
-                _cur = GeoPoint( node , d );
+                _cur = GeoPoint( key , loc , d );
             else
-                _stack.push_back( GeoPoint( node , d ) );
+                _stack.push_back( GeoPoint( key , loc , d ) );
         }
 
         virtual long long nscanned() {
@@ -1246,174 +1361,187 @@ namespace mongo {
 
     };
 
-    class GeoCircleBrowse : public GeoBrowse {
+    /**
+     * $within: covers the region with geohash cells once, then walks each run of adjacent
+     * cells as one btree range. cells partly in the region are split, largest first, while
+     * that keeps to MaxCells. points in cells wholly inside the region aren't checked.
+     */
+    class GeoCoveringBrowse : public GeoBrowse {
     public:
+        enum { MaxCells = 32 };
 
-        enum State {
-            START ,
-            DOING_EXPAND ,
-            DOING_AROUND ,
-            DONE
-        } _state;
+        GeoCoveringBrowse( const Geo2dType * g , string type , BSONObj filter )
+            : GeoBrowse( g , type , filter ) , _next(0) , _rangeInside(false) , _btreeKeys(0) {
+        }
 
-        GeoCircleBrowse( const Geo2dType * g , const BSONObj& circle , BSONObj filter = BSONObj() , const string& type="$center")
-            : GeoBrowse( g , "circle" , filter ) {
+        enum CellState { OUTSIDE , BOUNDARY , INSIDE };
 
-            uassert( 13060 , "$center needs 2 fields (middle,max distance)" , circle.nFields() == 2 );
-            BSONObjIterator i(circle);
-            BSONElement center = i.next();
-            _start = g->_tohash(center);
-            _startPt = Point(center);
-            _prefix = _start;
-            _maxDistance = i.next().numberDouble();
-            uassert( 13061 , "need a max distance > 0 " , _maxDistance > 0 );
-            _maxDistance += g->_error;
+        /**
+         * @return INSIDE only if every point of cell is in the region, and OUTSIDE only if none is.
+         * BOUNDARY is always right, it just costs more.
+         */
+        virtual CellState classify( const Box& cell ) const = 0;
 
-            _state = START;
-            _found = 0;
+        /** @return whether the point at h is in the region */
+        virtual bool inRegion( const GeoHash& h , double& d ) = 0;
 
-            if (type == "$center") {
-                _type = GEO_PLAIN;
-                _xScanDistance = _maxDistance;
-                _yScanDistance = _maxDistance;
+        virtual bool checkDistance( const GeoHash& h , double& d ) {
+            if ( _rangeInside ) {
+                d = 0;
+                return true;
             }
-            else if (type == "$centerSphere") {
-                uassert(13461, "Spherical MaxDistance > PI. Are you sure you are using radians?", _maxDistance < M_PI);
-
-                _type = GEO_SPHERE;
-                _yScanDistance = rad2deg(_maxDistance);
-                _xScanDistance = computeXScanDistance(_startPt._y, _yScanDistance);
-
-                uassert(13462, "Spherical distance would require wrapping, which isn't implemented yet",
-                        (_startPt._x + _xScanDistance < 180) && (_startPt._x - _xScanDistance > -180) &&
-                        (_startPt._y + _yScanDistance < 90) && (_startPt._y - _yScanDistance > -90));
+            return inRegion( h , d );
+        }
 
-                GEODEBUGPRINT(_maxDistance);
-                GEODEBUGPRINT(_xScanDistance);
-                GEODEBUGPRINT(_yScanDistance);
-            }
-            else {
-                uassert(13460, "invalid $center query type: " + type, false);
-            }
+        /** has to be called by the constructor of the subclass, once the region is set up */
+        void cover() {
+            static const char * quarters[] = { "00" , "01" , "10" , "11" };
 
-            ok();
-        }
+            vector< pair<GeoHash,bool> > cells; // and whether each is inside
+            deque<GeoHash> todo; // fewest bits, so largest, first
+            todo.push_back( GeoHash() );
 
-        virtual bool moreToDo() {
-            return _state != DONE;
-        }
+            while ( todo.size() ) {
+                GeoHash cell = todo.front();
+                todo.pop_front();
 
-        virtual void fillStack() {
+                if ( cell.getBits() >= _spec->_bits || ( cell.constrains() && cells.size() + todo.size() + 4 > MaxCells ) ) {
+                    cells.push_back( make_pair( cell , false ) );
+                    continue;
+                }
 
-            if ( _state == START ) {
-                if ( ! BtreeLocation::initial( *_id , _spec , _min , _max ,
-                                               _prefix , _found , this ) ) {
-                    _state = DONE;
-                    return;
+                for ( int q=0; q<4; q++ ) {
+                    GeoHash quarter = cell + quarters[q];
+                    CellState state = classify( Box( _spec , quarter ) );
+                    if ( state == INSIDE )
+                        cells.push_back( make_pair( quarter , true ) );
+                    else if ( state == BOUNDARY )
+                        todo.push_back( quarter );
                 }
-                _state = DOING_EXPAND;
             }
 
+            sort( cells.begin() , cells.end() , CellCmp() );
 
-            if ( _state == DOING_AROUND ) {
-                // TODO could rework and return rather than looping
-                for (int i=-1; i<=1; i++) {
-                    for (int j=-1; j<=1; j++) {
-                        if (i == 0 && j == 0)
-                            continue; // main box
-
-                        GeoHash newBox = _prefix;
-                        newBox.move(i, j);
+            for ( unsigned i=0; i<cells.size(); i++ ) {
+                Range r;
+                r.start = cells[i].first.getHash();
+                r.end = r.start + ( 1ULL << ( 64 - ( cells[i].first.getBits() * 2 ) ) );
+                r.toEnd = r.end == 0;
+                r.inside = cells[i].second;
 
-                        PREFIXDEBUG(newBox, _g);
-                        if (needToCheckBox(newBox)) {
-                            // TODO consider splitting into quadrants
-                            getPointsForPrefix(newBox);
-                        }
-                        else  {
-                            GEODEBUG("skipping box");
-                        }
+                if ( _ranges.size() ) {
+                    Range& last = _ranges.back();
+                    if ( ! last.toEnd && last.end == r.start && last.inside == r.inside ) {
+                        last.end = r.end;
+                        last.toEnd = r.toEnd;
+                        continue;
                     }
                 }
-
-                _state = DONE;
-                return;
+                _ranges.push_back( r );
             }
+            GEODEBUG( "covered with " << cells.size() << " cells in " << _ranges.size() << " ranges" );
+        }
 
-            if (_state == DOING_EXPAND) {
-                GEODEBUG( "circle prefix [" << _prefix << "]" );
-                PREFIXDEBUG(_prefix, _g);
+        virtual bool moreToDo() {
+            return _next < _ranges.size();
+        }
 
-                while ( _min.hasPrefix( _prefix ) && _min.advance( -1 , _found , this ) );
-                while ( _max.hasPrefix( _prefix ) && _max.advance( 1 , _found , this ) );
+        virtual void fillStack() {
+            if ( _next >= _ranges.size() )
+                return;
 
-                if ( ! _prefix.constrains() ) {
-                    GEODEBUG( "\t exhausted the btree" );
-                    _state = DONE;
-                    return;
-                }
+            const Range& r = _ranges[_next++];
+            _rangeInside = r.inside;
 
-                Point ll (_g, _prefix);
-                GeoHash trHash = _prefix;
-                trHash.move( 1 , 1 );
-                Point tr (_g, trHash);
-                double sideLen = fabs(tr._x - ll._x);
-
-                if (sideLen > std::max(_xScanDistance, _yScanDistance)) { // circle must be contained by surrounding squares
-                    if ( (ll._x + _xScanDistance < _startPt._x && ll._y + _yScanDistance < _startPt._y) &&
-                            (tr._x - _xScanDistance > _startPt._x && tr._y - _yScanDistance > _startPt._y) ) {
-                        GEODEBUG("square fully contains circle");
-                        _state = DONE;
-                    }
-                    else if (_prefix.getBits() > 1) {
-                        GEODEBUG("checking surrounding squares");
-                        _state = DOING_AROUND;
-                    }
-                    else {
-                        GEODEBUG("using simple search");
-                        _prefix = _prefix.up();
-                    }
-                }
-                else {
-                    _prefix = _prefix.up();
-                }
+            BtreeLocation loc;
+            loc.bucket = _id->head.btree()->locate( *_id , _id->head , GeoHash( (long long)r.start , 32 ).wrap() ,
+                                                    Ordering::make( _spec->_order ) , loc.pos , loc.found , minDiskLoc );
+            while ( ! loc.bucket.isNull() ) {
+                unsigned long long h = GeoHash( loc.key().firstElement() ).getHash();
+                if ( ! r.toEnd && h >= r.end )
+                    break;
+                loc.checkCur( _btreeKeys , this );
+                loc.advance( 1 , _btreeKeys , NULL );
+            }
+        }
+
+    private:
+        /** btree key order, which is unsigned */
+        struct CellCmp {
+            bool operator()( const pair<GeoHash,bool>& a , const pair<GeoHash,bool>& b ) const {
+                return (unsigned long long)a.first.getHash() < (unsigned long long)b.first.getHash();
+            }
+        };
+
+        /** hashes in [start,end), or from start on when end wrapped around */
+        struct Range {
+            unsigned long long start;
+            unsigned long long end;
+            bool toEnd;
+            bool inside;
+        };
+
+        vector<Range> _ranges;
+        unsigned _next;
+        bool _rangeInside;
+        int _btreeKeys;
+    };
 
-                return;
-            }
+    class GeoCircleBrowse : public GeoCoveringBrowse {
+    public:
 
-            /* Clients are expected to use moreToDo before calling
-             * fillStack, so DONE is checked for there. If any more
-             * State values are defined, you should handle them
-             * here. */
-            assert(0);
-        }
+        GeoCircleBrowse( const Geo2dType * g , const BSONObj& circle , BSONObj filter = BSONObj() , const string& type="$center")
+            : GeoCoveringBrowse( g , "circle" , filter ) {
 
-        bool needToCheckBox(const GeoHash& prefix) {
-            Point ll (_g, prefix);
-            if (fabs(ll._x - _startPt._x) <= _xScanDistance) return true;
-            if (fabs(ll._y - _startPt._y) <= _yScanDistance) return true;
+            uassert( 13060 , "$center needs 2 fields (middle,max distance)" , circle.nFields() == 2 );
+            BSONObjIterator i(circle);
+            BSONElement center = i.next();
+            _start = g->_tohash(center);
+            _startPt = Point(center);
+            _maxDistance = i.next().numberDouble();
+            uassert( 13061 , "need a max distance > 0 " , _maxDistance > 0 );
+            _maxDistance += g->_error;
 
-            GeoHash trHash = prefix;
-            trHash.move( 1 , 1 );
-            Point tr (_g, trHash);
+            if (type == "$center") {
+                _type = GEO_PLAIN;
+            }
+            else if (type == "$centerSphere") {
+                uassert(13461, "Spherical MaxDistance > PI. Are you sure you are using radians?", _maxDistance < M_PI);
 
-            if (fabs(tr._x - _startPt._x) <= _xScanDistance) return true;
-            if (fabs(tr._y - _startPt._y) <= _yScanDistance) return true;
+                _type = GEO_SPHERE;
+                double yScanDistance = rad2deg(_maxDistance);
+                double xScanDistance = computeXScanDistance(_startPt._y, yScanDistance);
 
-            return false;
-        }
+                uassert(13462, "Spherical distance would require wrapping, which isn't implemented yet",
+                        (_startPt._x + xScanDistance < 180) && (_startPt._x - xScanDistance > -180) &&
+                        (_startPt._y + yScanDistance < 90) && (_startPt._y - yScanDistance > -90));
 
-        void getPointsForPrefix(const GeoHash& prefix) {
-            if ( ! BtreeLocation::initial( *_id , _spec , _min , _max , prefix , _found , this ) ) {
-                return;
+                GEODEBUGPRINT(_maxDistance);
+            }
+            else {
+                uassert(13460, "invalid $center query type: " + type, false);
             }
 
-            while ( _min.hasPrefix( prefix ) && _min.advance( -1 , _found , this ) );
-            while ( _max.hasPrefix( prefix ) && _max.advance( 1 , _found , this ) );
+            cover();
+            ok();
         }
 
+        virtual CellState classify( const Box& cell ) const {
+            if ( minDistance( cell , _startPt , _type ) > _maxDistance )
+                return OUTSIDE;
+            if ( _type != GEO_PLAIN )
+                return BOUNDARY;
 
-        virtual bool checkDistance( const GeoHash& h , double& d ) {
+            // a circle is convex
+            if ( _startPt.distance( cell._min ) <= _maxDistance &&
+                    _startPt.distance( cell._max ) <= _maxDistance &&
+                    _startPt.distance( Point( cell._min._x , cell._max._y ) ) <= _maxDistance &&
+                    _startPt.distance( Point( cell._max._x , cell._min._y ) ) <= _maxDistance )
+                return INSIDE;
+            return BOUNDARY;
+        }
+
+        virtual bool inRegion( const GeoHash& h , double& d ) {
             switch (_type) {
             case GEO_PLAIN:
                 d = _g->distance( _start , h );
@@ -1433,28 +1561,13 @@ namespace mongo {
         GeoHash _start;
         Point _startPt;
         double _maxDistance; // user input
-        double _xScanDistance; // effected by GeoDistType
-        double _yScanDistance; // effected by GeoDistType
-
-        int _found;
-
-        GeoHash _prefix;
-        BtreeLocation _min;
-        BtreeLocation _max;
-
     };
 
-    class GeoBoxBrowse : public GeoBrowse {
+    class GeoBoxBrowse : public GeoCoveringBrowse {
     public:
 
-        enum State {
-            START ,
-            DOING_EXPAND ,
-            DONE
-        } _state;
-
         GeoBoxBrowse( const Geo2dType * g , const BSONObj& box , BSONObj filter = BSONObj() )
-            : GeoBrowse( g , "box" , filter ) {
+            : GeoCoveringBrowse( g , "box" , filter ) {
 
             uassert( 13063 , "$box needs 2 fields (bottomLeft,topRight)" , box.nFields() == 2 );
             BSONObjIterator i(box);
@@ -1466,14 +1579,6 @@ namespace mongo {
 
             uassert( 13064 , "need an area > 0 " , _want.area() > 0 );
 
-            _state = START;
-            _found = 0;
-
-            Point center = _want.center();
-            _prefix = _g->hash( center._x , center._y );
-
-            GEODEBUG( "center : " << center.toString() << "\t" << _prefix );
-
             {
                 GeoHash a(0LL,32);
                 GeoHash b(0LL,32);
@@ -1481,108 +1586,86 @@ namespace mongo {
                 _fudge = _g->distance(a,b);
             }
 
-            _wantLen = _fudge + std::max((_want._max._x - _want._min._x), (_want._max._y - _want._min._y));
-
+            cover();
             ok();
         }
 
-        virtual bool moreToDo() {
-            return _state != DONE;
+        virtual CellState classify( const Box& cell ) const {
+            if ( cell._min._x > _want._max._x + _fudge || cell._max._x + _fudge < _want._min._x ||
+                    cell._min._y > _want._max._y + _fudge || cell._max._y + _fudge < _want._min._y )
+                return OUTSIDE;
+
+            if ( _want.between( _want._min._x , _want._max._x , cell._min._x , _fudge ) &&
+                    _want.between( _want._min._x , _want._max._x , cell._max._x , _fudge ) &&
+                    _want.between( _want._min._y , _want._max._y , cell._min._y , _fudge ) &&
+                    _want.between( _want._min._y , _want._max._y , cell._max._y , _fudge ) )
+                return INSIDE;
+            return BOUNDARY;
         }
 
-        virtual void fillStack() {
-            if ( _state == START ) {
+        virtual bool inRegion( const GeoHash& h , double& d ) {
+            bool res = _want.inside( Point( _g , h ) , _fudge );
+            GEODEBUG( "\t want : " << _want.toString()
+                      << " point: " << Point( _g , h ).toString()
+                      << " in : " << res );
+            return res;
+        }
 
-                if ( ! BtreeLocation::initial( *_id , _spec , _min , _max ,
-                                               _prefix , _found , this ) ) {
-                    _state = DONE;
-                    return;
-                }
-                _state = DOING_EXPAND;
-            }
+        GeoHash _bl;
+        GeoHash _tr;
+        Box _want;
 
-            if ( _state == DOING_EXPAND ) {
-                int started = _found;
-                while ( started == _found || _state == DONE ) {
-                    GEODEBUG( "box prefix [" << _prefix << "]" );
-                    while ( _min.hasPrefix( _prefix ) && _min.advance( -1 , _found , this ) );
-                    while ( _max.hasPrefix( _prefix ) && _max.advance( 1 , _found , this ) );
+        double _fudge;
+    };
 
-                    if ( _state == DONE )
-                        return;
 
-                    if ( ! _prefix.constrains() ) {
-                        GEODEBUG( "box exhausted" );
-                        _state = DONE;
-                        return;
-                    }
+    class GeoPolygonBrowse : public GeoCoveringBrowse {
+    public:
 
-                    if (_g->sizeEdge(_prefix) < _wantLen) {
-                        _prefix = _prefix.up();
-                    }
-                    else {
-                        for (int i=-1; i<=1; i++) {
-                            for (int j=-1; j<=1; j++) {
-
-                                if (i == 0 && j == 0)
-                                    continue; // main box
-
-                                GeoHash newBox = _prefix;
-                                newBox.move(i, j);
-
-                                PREFIXDEBUG(newBox, _g);
-
-                                Box cur( _g , newBox );
-                                if (_want.intersects(cur)) {
-                                    // TODO consider splitting into quadrants
-                                    getPointsForPrefix(newBox);
-                                }
-                                else  {
-                                    GEODEBUG("skipping box");
-                                }
-                            }
-                        }
-                        _state = DONE;
-                    }
+        GeoPolygonBrowse( const Geo2dType * g , const BSONObj& polyPoints , BSONObj filter = BSONObj() )
+            : GeoCoveringBrowse( g , "polygon" , filter ) , _poly( parse( polyPoints ) ) {
+            cover();
+            ok();
+        }
 
+        static vector<Point> parse( const BSONObj& polyPoints ) {
+            vector<Point> points;
+            BSONObjIterator i( polyPoints );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                bool ok = e.isABSONObj();
+                if ( ok ) {
+                    BSONObjIterator xy( e.embeddedObject() );
+                    ok = xy.more() && xy.next().isNumber() && xy.more() && xy.next().isNumber();
                 }
-                return;
+                uassert( 14066 , "polygon points have to be [ x , y ] pairs of numbers" , ok );
+                points.push_back( Point( e ) );
             }
-
+            uassert( 14065 , "polygon must be defined by 3 points or more" , points.size() >= 3 );
+            return points;
         }
 
-        void getPointsForPrefix(const GeoHash& prefix) {
-            if ( ! BtreeLocation::initial( *_id , _spec , _min , _max , prefix , _found , this ) ) {
-                return;
-            }
+        virtual CellState classify( const Box& cell ) const {
+            const Box& b = _poly.bounds();
+            if ( cell._min._x > b._max._x || cell._max._x < b._min._x ||
+                    cell._min._y > b._max._y || cell._max._y < b._min._y )
+                return OUTSIDE;
 
-            while ( _min.hasPrefix( prefix ) && _min.advance( -1 , _found , this ) );
-            while ( _max.hasPrefix( prefix ) && _max.advance( 1 , _found , this ) );
-        }
+            if ( _poly.crosses( cell ) )
+                return BOUNDARY;
 
-        virtual bool checkDistance( const GeoHash& h , double& d ) {
-            bool res = _want.inside( Point( _g , h ) , _fudge );
-            GEODEBUG( "\t want : " << _want.toString()
-                      << " point: " << Point( _g , h ).toString()
-                      << " in : " << res );
-            return res;
+            // no edge goes through, so the whole cell is on the same side as its center
+            return _poly.contains( cell.center() ) ? INSIDE : OUTSIDE;
         }
 
-        GeoHash _bl;
-        GeoHash _tr;
-        Box _want;
-        double _wantLen;
-
-        int _found;
-
-        GeoHash _prefix;
-        BtreeLocation _min;
-        BtreeLocation _max;
+        virtual bool inRegion( const GeoHash& h , double& d ) {
+            d = 0;
+            return _poly.contains( Point( _g , h ) );
+        }
 
-        double _fudge;
+        Polygon _poly;
     };
 
-
     shared_ptr<Cursor> Geo2dType::newCursor( const BSONObj& query , const BSONObj& order , int numWanted ) const {
         if ( numWanted < 0 )
             numWanted = numWanted * -1;
@@ -1652,6 +1735,11 @@ namespace mongo {
                     shared_ptr<Cursor> c( new GeoBoxBrowse( this , e.embeddedObjectUserCheck() , query ) );
                     return c;
                 }
+                else if ( type == "$polygon" ) {
+                    uassert( 14064 , "$polygon has to take an object or array" , e.isABSONObj() );
+                    shared_ptr<Cursor> c( new GeoPolygonBrowse( this , e.embeddedObjectUserCheck() , query ) );
+                    return c;
+                }
                 throw UserException( 13058 , (string)"unknown $with type: " + type );
             }
             default:
@@ -1757,7 +1845,9 @@ namespace mongo {
             BSONObjBuilder stats( result.subobjStart( "stats" ) );
             stats.append( "time" , cc().curop()->elapsedMillis() );
             stats.appendNumber( "btreelocs" , gs._nscanned );
-            stats.appendNumber( "nscanned" , gs._hopper->_lookedAt );
+            stats.appendNumber( "nscanned" , (long long)gs._queued.size() );
+            // the points taken off the queue nearest first, which is about as many as are returned
+            stats.appendNumber( "pointsLookedAt" , gs._hopper->_lookedAt );
             stats.appendNumber( "objectsLoaded" , gs._hopper->_objectsLoaded );
             stats.append( "avgDistance" , totalDistance / x );
             stats.append( "maxDistance" , gs._hopper->farthest() );
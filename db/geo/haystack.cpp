@@ -48,8 +48,7 @@ namespace mongo {
 
         }
 
-        void got( const DiskLoc& loc ) {
-            Point p( loc.obj().getFieldDotted( _geoField ) );
+        void got( const DiskLoc& loc , const Point& p ) {
             if ( _near.distance( p ) > _maxDistance )
                 return;
             _locs.push_back( loc );
@@ -69,17 +68,37 @@ namespace mongo {
         vector<DiskLoc> _locs;
     };
 
+    /** a point and its record, as stored in the keys of one bucket */
+    struct GeoHaystackEntry {
+        GeoHaystackEntry( const Point& p , const DiskLoc& loc ) : _p( p ) , _loc( loc ) {}
+        Point _p;
+        DiskLoc _loc;
+    };
+    typedef vector<GeoHaystackEntry> GeoHaystackBucket;
+
+    /**
+     * a key is { "" : "<x bucket>_<y bucket>" , "" : <other field> }, and the record is read for its point.
+     * an index made with pointInKey : true has { "" : x , "" : y } after that, so searching only reads the
+     * records it returns.  it's an option of the index so that one never holds keys of both kinds.
+     */
     class GeoHaystackSearchIndex : public IndexType {
 
     public:
 
         GeoHaystackSearchIndex( const IndexPlugin* plugin , const IndexSpec* spec )
-            : IndexType( plugin , spec ) {
+            : IndexType( plugin , spec ) , _cacheMutex( "haystackCache" ) , _cacheWriteCount(0) {
 
             BSONElement e = spec->info["bucketSize"];
             uassert( 13321 , "need bucketSize" , e.isNumber() );
             _bucketSize = e.numberDouble();
 
+            // how many buckets, by bucket key and other field, to keep in memory. off by default
+            _cacheSize = 0;
+            if ( spec->info["bucketCache"].isNumber() )
+                _cacheSize = max( 0 , spec->info["bucketCache"].numberInt() );
+
+            _pointInKey = spec->info["pointInKey"].trueValue();
+
             BSONObjBuilder orderBuilder;
 
             BSONObjIterator i( spec->keyPattern );
@@ -114,18 +133,22 @@ namespace mongo {
         }
 
         string makeString( int hashedX , int hashedY ) const {
-            stringstream ss;
-            ss << hashedX << "_" << hashedY;
-            return ss.str();
+            StringBuilder buf( 16 );
+            buf << hashedX << "_" << hashedY;
+            return buf.str();
         }
 
-        void _add( const BSONObj& obj, const string& root , const BSONElement& e , BSONObjSetDefaultOrder& keys ) const {
+        void _add( const BSONObj& obj, const string& root , const BSONElement& e , const Point& p , BSONObjSetDefaultOrder& keys ) const {
             BSONObjBuilder buf;
             buf.append( "" , root );
             if ( e.eoo() )
                 buf.appendNull( "" );
             else
                 buf.appendAs( e , "" );
+            if ( _pointInKey ) {
+                buf.append( "" , p._x );
+                buf.append( "" , p._y );
+            }
 
             BSONObj key = buf.obj();
             GEOQUADDEBUG( obj << "\n\t" << root << "\n\t" << key );
@@ -140,11 +163,13 @@ namespace mongo {
 
             uassert( 13323 , "latlng not an array" , loc.isABSONObj() );
             string root;
+            Point p;
             {
                 BSONObjIterator i( loc.Obj() );
                 BSONElement x = i.next();
                 BSONElement y = i.next();
                 root = makeString( hash(x) , hash(y) );
+                p = Point( x.number() , y.number() );
             }
 
 
@@ -154,11 +179,11 @@ namespace mongo {
             obj.getFieldsDotted( _other[0] , all );
 
             if ( all.size() == 0 ) {
-                _add( obj , root , BSONElement() , keys );
+                _add( obj , root , BSONElement() , p , keys );
             }
             else {
                 for ( BSONElementSet::iterator i=all.begin(); i!=all.end(); ++i ) {
-                    _add( obj , root , *i , keys );
+                    _add( obj , root , *i , p , keys );
                 }
             }
 
@@ -188,6 +213,7 @@ namespace mongo {
             GeoHaystackSearchHopper hopper(n,maxDistance,limit,_geo);
 
             long long btreeMatches = 0;
+            long long cacheHits = 0;
 
             for ( int a=-scale; a<=scale; a++ ) {
                 for ( int b=-scale; b<=scale; b++ ) {
@@ -206,17 +232,15 @@ namespace mongo {
 
                     GEOQUADDEBUG( "KEY: " << key );
 
-                    set<DiskLoc> thisPass;
-                    BtreeCursor cursor( nsd , idxNo , *getDetails() , key , key , true , 1 );
-                    while ( cursor.ok() ) {
-                        pair<set<DiskLoc>::iterator, bool> p = thisPass.insert( cursor.currLoc() );
-                        if ( p.second ) {
-                            hopper.got( cursor.currLoc() );
-                            GEOQUADDEBUG( "\t" << cursor.current() );
-                            btreeMatches++;
-                        }
-                        cursor.advance();
-                    }
+                    shared_ptr<const GeoHaystackBucket> bucket = cached( key );
+                    if ( bucket )
+                        cacheHits++;
+                    else
+                        bucket = load( nsd , idxNo , key );
+
+                    for ( unsigned i=0; i<bucket->size(); i++ )
+                        hopper.got( (*bucket)[i]._loc , (*bucket)[i]._p );
+                    btreeMatches += bucket->size();
                 }
 
             }
@@ -229,6 +253,8 @@ namespace mongo {
                 BSONObjBuilder b( result.subobjStart( "stats" ) );
                 b.append( "time" , t.millis() );
                 b.appendNumber( "btreeMatches" , btreeMatches );
+                if ( _cacheSize )
+                    b.appendNumber( "cacheHits" , cacheHits );
                 b.append( "n" , num );
                 b.done();
             }
@@ -238,12 +264,97 @@ namespace mongo {
             return _spec->getDetails();
         }
 
+        /** reads the entries for key, which is the bucket and other field, and caches them if on */
+        shared_ptr<const GeoHaystackBucket> load( NamespaceDetails* nsd , int idxNo , const BSONObj& key ) {
+            shared_ptr<GeoHaystackBucket> bucket( new GeoHaystackBucket() );
+
+            // with the point in the key, the keys of this bucket are key followed by any point
+            BSONObj end = key;
+            if ( _pointInKey ) {
+                BSONObjBuilder b;
+                b.appendElements( key );
+                b.appendMaxKey( "" );
+                end = b.obj();
+            }
+
+            set<DiskLoc> thisPass;
+            BtreeCursor cursor( nsd , idxNo , *getDetails() , key , end , true , 1 );
+            while ( cursor.ok() ) {
+                pair<set<DiskLoc>::iterator, bool> p = thisPass.insert( cursor.currLoc() );
+                if ( p.second ) {
+                    if ( _pointInKey ) {
+                        BSONObjIterator i( cursor.currKey() );
+                        for ( unsigned k=0; k<=_other.size(); k++ )
+                            i.next();
+                        double x = i.next().number();
+                        double y = i.next().number();
+                        bucket->push_back( GeoHaystackEntry( Point( x , y ) , cursor.currLoc() ) );
+                    }
+                    else {
+                        bucket->push_back( GeoHaystackEntry( Point( cursor.current().getFieldDotted( _geo ) ) , cursor.currLoc() ) );
+                    }
+                    GEOQUADDEBUG( "\t" << cursor.current() );
+                }
+                cursor.advance();
+            }
+
+            if ( _cacheSize ) {
+                unsigned long long writes = writeCount();
+                scoped_lock lk( _cacheMutex );
+                if ( _cacheWriteCount == writes && ! _cacheIndex.count( key ) ) {
+                    _cache.push_front( make_pair( key.getOwned() , bucket ) );
+                    _cacheIndex[ _cache.front().first ] = _cache.begin();
+                    if ( _cache.size() > _cacheSize ) {
+                        _cacheIndex.erase( _cache.back().first );
+                        _cache.pop_back();
+                    }
+                }
+            }
+            return bucket;
+        }
+
+        /** @return the cached entries for key, if it's there and nothing was written since */
+        shared_ptr<const GeoHaystackBucket> cached( const BSONObj& key ) {
+            if ( ! _cacheSize )
+                return shared_ptr<const GeoHaystackBucket>();
+
+            unsigned long long writes = writeCount();
+            scoped_lock lk( _cacheMutex );
+            if ( writes != _cacheWriteCount ) {
+                _cache.clear();
+                _cacheIndex.clear();
+                _cacheWriteCount = writes;
+                return shared_ptr<const GeoHaystackBucket>();
+            }
+
+            CacheIndex::iterator i = _cacheIndex.find( key );
+            if ( i == _cacheIndex.end() )
+                return shared_ptr<const GeoHaystackBucket>();
+            _cache.splice( _cache.begin() , _cache , i->second );
+            return i->second->second;
+        }
+
+        /** changes on any write to the collection, which is when the cache goes */
+        unsigned long long writeCount() const {
+            scoped_lock lk( NamespaceDetailsTransient::_qcMutex );
+            return NamespaceDetailsTransient::get_inlock( getDetails()->parentNS().c_str() ).writeCount();
+        }
+
         string _geo;
         vector<string> _other;
 
         BSONObj _order;
 
         double _bucketSize;
+        bool _pointInKey;
+
+        typedef list< pair< BSONObj , shared_ptr<const GeoHaystackBucket> > > Cache; // most recently used first
+        typedef map< BSONObj , Cache::iterator , BSONObjCmp > CacheIndex;
+        unsigned _cacheSize;
+        mongo::mutex _cacheMutex;
+        unsigned long long _cacheWriteCount;
+        Cache _cache;
+        CacheIndex _cacheIndex;
     };
 
     class GeoHaystackSearchIndexPlugin : public IndexPlugin {
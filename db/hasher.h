@@ -0,0 +1,133 @@
+// hasher.h
+
+/**
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "jsobj.h"
+#include "../util/md5.hpp"
+
+namespace mongo {
+
+    /**
+     * hashes a BSON value into 64 bits, for "hashed" indexes and hashed shard keys.
+     *
+     * values that compare equal hash the same, e.g. 1, 1.0 and NumberLong(1). objects and arrays are hashed
+     * element by element. a missing value hashes like null, as it is indexed like null.
+     *
+     * the hashes end up in indexes and in chunk boundaries, so this must never change.
+     */
+    class BSONElementHasher : boost::noncopyable {
+    public:
+        static long long hash64( const BSONElement& e ) {
+            md5_state_t st;
+            md5_init( &st );
+            _append( &st , e );
+
+            md5digest d;
+            md5_finish( &st , d );
+
+            unsigned long long h = 0;
+            for ( int i=7; i>=0; i-- )
+                h = ( h << 8 ) | d[i];
+            return (long long)h;
+        }
+
+    private:
+        static void _bytes( md5_state_t* st , const void* p , int len ) {
+            md5_append( st , (const md5_byte_t*)p , len );
+        }
+
+        /** little endian, whatever the platform */
+        static void _number( md5_state_t* st , unsigned long long x ) {
+            md5_byte_t b[8];
+            for ( int i=0; i<8; i++ ) {
+                b[i] = (md5_byte_t)( x & 0xff );
+                x >>= 8;
+            }
+            md5_append( st , b , 8 );
+        }
+
+        static void _append( md5_state_t* st , const BSONElement& e ) {
+            // the canonical type, as that is what comparisons go by first; null's for a missing value
+            md5_byte_t type = (md5_byte_t)( e.eoo() ? 5 : e.canonicalType() );
+            _bytes( st , &type , 1 );
+
+            switch ( e.type() ) {
+            case EOO:
+            case Undefined:
+            case jstNULL:
+            case MinKey:
+            case MaxKey:
+                break;
+            case NumberInt:
+            case NumberLong:
+            case NumberDouble: {
+                // integral numbers as integers, so that the three types agree
+                double d = e.number();
+                if ( e.type() != NumberDouble ) {
+                    _number( st , (unsigned long long)e.numberLong() );
+                }
+                else if ( d != d ) {
+                    _bytes( st , "nan" , 3 );
+                }
+                else if ( d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(long long)d ) {
+                    _number( st , (unsigned long long)(long long)d );
+                }
+                else {
+                    unsigned long long bits;
+                    memcpy( &bits , &d , sizeof( bits ) );
+                    _number( st , bits );
+                }
+                break;
+            }
+            case String:
+            case Symbol:
+            case Code:
+                _bytes( st , e.valuestr() , e.valuestrsize() - 1 );
+                break;
+            case Object:
+            case Array: {
+                BSONObjIterator i( e.embeddedObject() );
+                while ( i.more() ) {
+                    BSONElement x = i.next();
+                    if ( e.type() == Object )
+                        _bytes( st , x.fieldName() , strlen( x.fieldName() ) + 1 );
+                    _append( st , x );
+                }
+                break;
+            }
+            case Bool: {
+                md5_byte_t b = e.boolean() ? 1 : 0;
+                _bytes( st , &b , 1 );
+                break;
+            }
+            case Date:
+            case Timestamp:
+                _number( st , (unsigned long long)e._numberLong() );
+                break;
+            case jstOID:
+                _bytes( st , e.value() , 12 );
+                break;
+            default:
+                _bytes( st , e.value() , e.valuesize() );
+                break;
+            }
+        }
+    };
+
+}
@@ -0,0 +1,101 @@
+// db/hashindex.cpp
+
+/**
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+#include "namespace-inl.h"
+#include "jsobj.h"
+#include "index.h"
+#include "hasher.h"
+#include "../util/unittest.h"
+
+namespace mongo {
+
+    const string HASHEDNAME = "hashed";
+
+    /**
+     * { a : "hashed" } keeps the 64 bit hash of a, as a NumberLong.
+     * it is what a hashed shard key splits, migrates and cleans up by.
+     */
+    class HashedIndex : public IndexType {
+    public:
+
+        HashedIndex( const IndexPlugin* plugin , const IndexSpec* spec )
+            : IndexType( plugin , spec ) {
+
+            uassert( 14072 , "a hashed index has to be over a single field" , spec->keyPattern.nFields() == 1 );
+            uassert( 14073 , "a hashed index can't be unique" , ! spec->info["unique"].trueValue() );
+            _field = spec->keyPattern.firstElement().fieldName();
+        }
+
+        void getKeys( const BSONObj &obj, BSONObjSetDefaultOrder &keys ) const {
+            BSONElement e = obj.getFieldDotted( _field.c_str() );
+            uassert( 14074 , "a hashed index can't index arrays" , e.type() != Array );
+
+            BSONObjBuilder b;
+            b.append( "" , BSONElementHasher::hash64( e ) );
+            keys.insert( b.obj() );
+        }
+
+        shared_ptr<Cursor> newCursor( const BSONObj& query , const BSONObj& order , int numWanted ) const {
+            uasserted( 14075 , "hashed indexes can't answer queries" );
+            return shared_ptr<Cursor>();
+        }
+
+        /** the keys are hashes, not field values, so they can't answer ordinary queries */
+        IndexSuitability suitability( const BSONObj& query , const BSONObj& order ) const {
+            return USELESS;
+        }
+
+    private:
+        string _field;
+    };
+
+    class HashedIndexPlugin : public IndexPlugin {
+    public:
+        HashedIndexPlugin() : IndexPlugin( HASHEDNAME ) {
+        }
+
+        virtual IndexType* generate( const IndexSpec* spec ) const {
+            return new HashedIndex( this , spec );
+        }
+
+    } hashedIndexPlugin;
+
+    class HashedIndexUnitTest : public UnitTest {
+    public:
+        void run() {
+            BSONObj o = BSON( "a" << 1 << "b" << BSON( "c" << "x" ) );
+            long long h = BSONElementHasher::hash64( o["a"] );
+
+            assert( h == BSONElementHasher::hash64( BSON( "a" << 1.0 ).firstElement() ) );
+            assert( h == BSONElementHasher::hash64( BSON( "a" << 1LL ).firstElement() ) );
+            assert( h != BSONElementHasher::hash64( BSON( "a" << 2 ).firstElement() ) );
+            assert( h != BSONElementHasher::hash64( BSON( "a" << "1" ).firstElement() ) );
+
+            // a missing field is indexed like null
+            BSONObjBuilder b;
+            b.appendNull( "z" );
+            assert( BSONElementHasher::hash64( o["z"] ) == BSONElementHasher::hash64( b.obj().firstElement() ) );
+
+            // field names are part of an object's hash, not of the field's own
+            assert( BSONElementHasher::hash64( o["b"] ) == BSONElementHasher::hash64( BSON( "" << BSON( "c" << "x" ) ).firstElement() ) );
+            assert( BSONElementHasher::hash64( o["b"] ) != BSONElementHasher::hash64( BSON( "b" << BSON( "d" << "x" ) ).firstElement() ) );
+        }
+    } hashedIndexUnitTest;
+
+}
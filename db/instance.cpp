@@ -580,23 +580,31 @@ namespace mongo {
 
         Client::Context ctx(ns);
         if( d.moreJSObjs() ) { 
+            bool keepGoing = d.reservedField() & InsertOption_ContinueOnError;
             int n = 0;
             while ( 1 ) {
                 BSONObj js = d.nextJsObj();
-                uassert( 10059 , "object to insert too large", js.objsize() <= BSONObjMaxUserSize);
-
-                {
-                    // check no $ modifiers
-                    BSONObjIterator i( js );
-                    while ( i.more() ) {
-                        BSONElement e = i.next();
-                        uassert( 13511 , "object to insert can't have $ modifiers" , e.fieldName()[0] != '$' );
+                try {
+                    uassert( 10059 , "object to insert too large", js.objsize() <= BSONObjMaxUserSize);
+
+                    {
+                        // check no $ modifiers
+                        BSONObjIterator i( js );
+                        while ( i.more() ) {
+                            BSONElement e = i.next();
+                            uassert( 13511 , "object to insert can't have $ modifiers" , e.fieldName()[0] != '$' );
+                        }
                     }
-                }
 
-                theDataFileMgr.insertWithObjMod(ns, js, false);
-                logOp("i", ns, js);
-                ++n;
+                    theDataFileMgr.insertWithObjMod(ns, js, false);
+                    logOp("i", ns, js);
+                    ++n;
+                }
+                catch ( UserException& ) {
+                    // the error was recorded for getLastError when it was raised
+                    if ( ! keepGoing )
+                        throw;
+                }
 
                 if( !d.moreJSObjs() )
                     break;
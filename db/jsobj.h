@@ -41,6 +41,7 @@
 #include "../bson/bsonobjbuilder.h"
 #include "../bson/bsonobjiterator.h"
 #include "../bson/bson-inl.h"
+#include "../bson/bsonfieldindex.h"
 #include "../bson/ordering.h"
 #include "../bson/stringdata.h"
 
@@ -113,6 +113,7 @@ namespace mongo {
                 subMatcherOnPrimitives = true;
             }
         }
+        initNumericCompare();
     }
 
     ElementMatcher::ElementMatcher( BSONElement _e , int _op , const BSONObj& array, bool _isNot )
@@ -153,6 +154,29 @@ namespace mongo {
             uassert( 13020 , "with $all, can't mix $elemMatch and others" , myset->size() == 0 && !myregex.get());
         }
 
+        initNumericCompare();
+    }
+
+    void ElementMatcher::initNumericCompare() {
+        numericCompare = false;
+        switch( compareOp ) {
+        case BSONObj::Equality:
+        case BSONObj::LT:
+        case BSONObj::LTE:
+        case BSONObj::GT:
+        case BSONObj::GTE:
+            break;
+        default:
+            return;
+        }
+        if ( !toMatch.isNumber() )
+            return;
+        // compareElementValues orders NaN and +/-inf specially, leave those to it
+        double d = toMatch.number();
+        if ( !( d <= numeric_limits< double >::max() && d >= -numeric_limits< double >::max() ) )
+            return;
+        numberToMatch = d;
+        numericCompare = true;
     }
 
 
@@ -301,7 +325,7 @@ namespace mongo {
     /* _jsobj          - the query pattern
     */
     Matcher::Matcher(const BSONObj &_jsobj, bool subMatcher) :
-        where(0), jsobj(_jsobj), haveSize(), all(), hasArray(0), haveNeg(), _atomic(false), nRegex(0) {
+        where(0), jsobj(_jsobj), _useFieldIndex(false), haveSize(), all(), hasArray(0), haveNeg(), _atomic(false), nRegex(0) {
 
         BSONObjIterator i(jsobj);
         while ( i.more() ) {
@@ -319,7 +343,9 @@ namespace mongo {
                 uassert( 10067 , "$where query, but no script engine", globalScriptEngine );
                 massert( 13089 , "no current client needed for $where" , haveClient() );
                 where = new Where();
-                where->scope = globalScriptEngine->getPooledScope( cc().ns() );
+                // pooled by database like eval, group and map/reduce, so the function is compiled
+                // once per scope and reused by every query, getMore and count that has it
+                where->scope = globalScriptEngine->getPooledScope( cc().database()->name );
                 where->scope->localConnect( cc().database()->name.c_str() );
 
                 if ( e.type() == CodeWScope ) {
@@ -408,10 +434,12 @@ namespace mongo {
             // normal, simple case e.g. { a : "foo" }
             addBasic(e, BSONObj::Equality, false);
         }
+
+        orderBasics();
     }
 
     Matcher::Matcher( const Matcher &other, const BSONObj &key ) :
-        where(0), constrainIndexKey_( key ), haveSize(), all(), hasArray(0), haveNeg(), _atomic(false), nRegex(0) {
+        where(0), constrainIndexKey_( key ), _useFieldIndex(false), haveSize(), all(), hasArray(0), haveNeg(), _atomic(false), nRegex(0) {
         // do not include fields which would make keyMatch() false
         for( vector< ElementMatcher >::const_iterator i = other.basics.begin(); i != other.basics.end(); ++i ) {
             if ( key.hasField( i->toMatch.fieldName() ) ) {
@@ -437,6 +465,8 @@ namespace mongo {
         for( list< shared_ptr< Matcher > >::const_iterator i = other._orMatchers.begin(); i != other._orMatchers.end(); ++i ) {
             _orMatchers.push_back( shared_ptr< Matcher >( new Matcher( **i, key ) ) );
         }
+
+        orderBasics();
     }
 
     inline bool regexMatches(const RegexMatcher& rm, const BSONElement& e) {
@@ -457,6 +487,18 @@ namespace mongo {
     inline int Matcher::valuesMatch(const BSONElement& l, const BSONElement& r, int op, const ElementMatcher& bm) {
         assert( op != BSONObj::NE && op != BSONObj::NIN );
 
+        if ( bm.numericCompare && op == bm.compareOp && l.isNumber() &&
+                !( l.type() == NumberLong && r.type() == NumberLong ) ) {
+            double left = l.number();
+            if ( left <= numeric_limits< double >::max() && left >= -numeric_limits< double >::max() ) {
+                double right = bm.numberToMatch;
+                if ( op == BSONObj::Equality )
+                    return left == right;
+                int c = left < right ? -1 : ( left == right ? 0 : 1 );
+                return op & ( 1 << ( c + 1 ) );
+            }
+        }
+
         if ( op == BSONObj::Equality ) {
             return l.valuesEqual(r);
         }
@@ -510,14 +552,39 @@ namespace mongo {
         return (op & z);
     }
 
-    int Matcher::matchesNe(const char *fieldName, const BSONElement &toMatch, const BSONObj &obj, const ElementMatcher& bm , MatchDetails * details ) {
-        int ret = matchesDotted( fieldName, toMatch, obj, BSONObj::Equality, bm , false , details );
+    int Matcher::matchesNe(const char *fieldName, const BSONElement &toMatch, const BSONObj &obj, const ElementMatcher& bm , MatchDetails * details , FieldLookup * fields ) {
+        int ret = matchesDotted( fieldName, toMatch, obj, BSONObj::Equality, bm , false , details , fields );
         if ( bm.toMatch.type() != jstNULL )
             return ( ret <= 0 ) ? 1 : 0;
         else
             return -ret;
     }
 
+    inline BSONElement Matcher::lookupField( const BSONObj &obj, const char *name, size_t len, FieldLookup *fields ) {
+        if ( fields )
+            return fields->get( obj, name, len );
+        BSONObjIterator i( obj );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            const char *fn = e.fieldName();
+            if ( strncmp( fn, name, len ) == 0 && fn[len] == 0 )
+                return e;
+        }
+        return BSONElement();
+    }
+
+    BSONElement Matcher::FieldLookup::get( const BSONObj &obj, const char *name, size_t len ) {
+        if ( obj.objdata() == _obj.objdata() ) {
+            if ( _index.covers( obj ) )
+                return _index.getField( name, (unsigned) len );
+            if ( ++_n > 1 ) {
+                _index.reset( obj );
+                return _index.getField( name, (unsigned) len );
+            }
+        }
+        return lookupField( obj, name, len, 0 );
+    }
+
     int retMissing( const ElementMatcher &bm ) {
         if ( bm.compareOp != BSONObj::opEXISTS )
             return 0;
@@ -543,7 +610,7 @@ namespace mongo {
         0 missing element
         1 match
     */
-    int Matcher::matchesDotted(const char *fieldName, const BSONElement& toMatch, const BSONObj& obj, int compareOp, const ElementMatcher& em , bool isArr, MatchDetails * details ) {
+    int Matcher::matchesDotted(const char *fieldName, const BSONElement& toMatch, const BSONObj& obj, int compareOp, const ElementMatcher& em , bool isArr, MatchDetails * details , FieldLookup * fields ) {
         DEBUGMATCHER( "\t matchesDotted : " << fieldName << " hasDetails: " << ( details ? "yes" : "no" ) );
         if ( compareOp == BSONObj::opALL ) {
 
@@ -606,10 +673,10 @@ namespace mongo {
         } // end opALL
 
         if ( compareOp == BSONObj::NE )
-            return matchesNe( fieldName, toMatch, obj, em , details );
+            return matchesNe( fieldName, toMatch, obj, em , details , fields );
         if ( compareOp == BSONObj::NIN ) {
             for( set<BSONElement,element_lt>::const_iterator i = em.myset->begin(); i != em.myset->end(); ++i ) {
-                int ret = matchesNe( fieldName, *i, obj, em , details );
+                int ret = matchesNe( fieldName, *i, obj, em , details , fields );
                 if ( ret != 1 )
                     return ret;
             }
@@ -642,9 +709,7 @@ namespace mongo {
 
             const char *p = strchr(fieldName, '.');
             if ( p ) {
-                string left(fieldName, p-fieldName);
-
-                BSONElement se = obj.getField(left.c_str());
+                BSONElement se = lookupField( obj, fieldName, p - fieldName, fields );
                 if ( se.eoo() )
                     ;
                 else if ( se.type() != Object && se.type() != Array )
@@ -689,7 +754,7 @@ namespace mongo {
                 return retMissing( em );
             }
             else {
-                e = obj.getField(fieldName);
+                e = lookupField( obj, fieldName, strlen( fieldName ), fields );
             }
         }
 
@@ -747,35 +812,85 @@ namespace mongo {
 
     extern int dump;
 
+    namespace {
+        /** @return lower for the kinds of basic that are cheaper and more likely to reject a document */
+        int basicRank( const ElementMatcher &bm ) {
+            switch( bm.compareOp ) {
+            case BSONObj::Equality:
+                return bm.numericCompare ? 0 : 1;
+            case BSONObj::LT:
+            case BSONObj::LTE:
+            case BSONObj::GT:
+            case BSONObj::GTE:
+                return bm.numericCompare ? 1 : 2;
+            case BSONObj::opIN:
+            case BSONObj::opMOD:
+            case BSONObj::opTYPE:
+                return 3;
+            case BSONObj::opEXISTS:
+            case BSONObj::opSIZE:
+                return 4;
+            case BSONObj::NE:
+            case BSONObj::NIN:
+                return 5;
+            default:
+                // $all, $elemMatch and the like look through arrays
+                return 6;
+            }
+        }
+
+        struct CheaperBasic {
+            CheaperBasic( const vector<ElementMatcher> &basics ) : _basics( basics ) {}
+            bool operator()( unsigned l, unsigned r ) const {
+                return basicRank( _basics[l] ) < basicRank( _basics[r] );
+            }
+            const vector<ElementMatcher> &_basics;
+        };
+    }
+
+    void Matcher::orderBasics() {
+        // only worth a pass over the document when several lookups will use it
+        _useFieldIndex = constrainIndexKey_.isEmpty() && basics.size() >= 4;
+        _basicsOrder.clear();
+        for ( unsigned i = 0; i < basics.size(); i++ )
+            _basicsOrder.push_back( i );
+        stable_sort( _basicsOrder.begin(), _basicsOrder.end(), CheaperBasic( basics ) );
+    }
+
     /* See if an object matches the query.
     */
     bool Matcher::matches(const BSONObj& jsobj , MatchDetails * details ) {
         /* assuming there is usually only one thing to match.  if more this
         could be slow sometimes. */
 
+        FieldLookup fields( jsobj );
+
         // check normal non-regex cases:
-        for ( unsigned i = 0; i < basics.size(); i++ ) {
+        for ( unsigned k = 0; k < basics.size(); k++ ) {
+            // when details are requested keep the declared order, so elemMatchKey
+            // reports the same array element it always has
+            unsigned i = details ? k : _basicsOrder[k];
             ElementMatcher& bm = basics[i];
             BSONElement& m = bm.toMatch;
             // -1=mismatch. 0=missing element. 1=match
-            int cmp = matchesDotted(m.fieldName(), m, jsobj, bm.compareOp, bm , false , details );
+            int cmp = matchesDotted(m.fieldName(), m, jsobj, bm.compareOp, bm , false , details , _useFieldIndex ? &fields : 0 );
             if ( bm.compareOp != BSONObj::opEXISTS && bm.isNot )
                 cmp = -cmp;
-            if ( cmp < 0 )
-                return false;
-            if ( cmp == 0 ) {
+            bool rejected = false;
+            if ( cmp < 0 ) {
+                rejected = true;
+            }
+            else if ( cmp == 0 ) {
                 /* missing is ok iff we were looking for null */
                 if ( m.type() == jstNULL || m.type() == Undefined || ( bm.compareOp == BSONObj::opIN && bm.myset->count( staticNull.firstElement() ) > 0 ) ) {
-                    if ( ( bm.compareOp == BSONObj::NE ) ^ bm.isNot ) {
-                        return false;
-                    }
+                    rejected = ( bm.compareOp == BSONObj::NE ) ^ bm.isNot;
                 }
                 else {
-                    if ( !bm.isNot ) {
-                        return false;
-                    }
+                    rejected = !bm.isNot;
                 }
             }
+            if ( rejected )
+                return false;
         }
 
         for ( int r = 0; r < nRegex; r++ ) {
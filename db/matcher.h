@@ -54,7 +54,7 @@ namespace mongo {
     class ElementMatcher {
     public:
 
-        ElementMatcher() {
+        ElementMatcher() : numericCompare() {
         }
 
         ElementMatcher( BSONElement _e , int _op, bool _isNot );
@@ -78,6 +78,14 @@ namespace mongo {
         bool subMatcherOnPrimitives ;
 
         vector< shared_ptr<Matcher> > allMatchers;
+
+        // set when toMatch is a finite number and compareOp is a plain comparison,
+        // so numeric candidates can be compared without going through compareElementValues
+        bool numericCompare;
+        double numberToMatch;
+
+    private:
+        void initNumericCompare();
     };
 
     class Where; // used for $where javascript eval
@@ -119,15 +127,17 @@ namespace mongo {
        TODO: we should rewrite the matcher to be more an AST style.
     */
     class Matcher : boost::noncopyable {
+        class FieldLookup;
+
         int matchesDotted(
             const char *fieldName,
             const BSONElement& toMatch, const BSONObj& obj,
-            int compareOp, const ElementMatcher& bm, bool isArr , MatchDetails * details );
+            int compareOp, const ElementMatcher& bm, bool isArr , MatchDetails * details , FieldLookup * fields = 0 );
 
         int matchesNe(
             const char *fieldName,
             const BSONElement &toMatch, const BSONObj &obj,
-            const ElementMatcher&bm, MatchDetails * details );
+            const ElementMatcher&bm, MatchDetails * details , FieldLookup * fields = 0 );
 
     public:
         static int opDirection(int op) {
@@ -180,6 +190,29 @@ namespace mongo {
 
         int valuesMatch(const BSONElement& l, const BSONElement& r, int op, const ElementMatcher& bm);
 
+        /* basics are ANDed together, so they may be evaluated in any order.  once parsed, they are
+           ordered with the cheap and usually selective kinds first.  the order doesn't change after
+           that, so matches() leaves the Matcher as it was and it can be shared.
+        */
+        void orderBasics();
+
+        /* the top level fields of the document one matches() call is on.  the first lookup walks the
+           document and the second indexes it, so a document the first predicate rejects is never hashed.
+        */
+        class FieldLookup : boost::noncopyable {
+        public:
+            FieldLookup( const BSONObj &obj ) : _obj( obj ), _n() { }
+            /** obj.getField( string( name, len ) ), through the index when obj is the document */
+            BSONElement get( const BSONObj &obj, const char *name, size_t len );
+        private:
+            const BSONObj &_obj;
+            unsigned _n;
+            BSONFieldIndex _index;
+        };
+
+        /** obj.getField( string( name, len ) ), using fields when given */
+        static BSONElement lookupField( const BSONObj &obj, const char *name, size_t len, FieldLookup *fields );
+
         bool parseOrNor( const BSONElement &e, bool subMatcher );
         void parseOr( const BSONElement &e, bool subMatcher, list< shared_ptr< Matcher > > &matchers );
 
@@ -187,6 +220,9 @@ namespace mongo {
         BSONObj jsobj;                  // the query pattern.  e.g., { name: "joe" }
         BSONObj constrainIndexKey_;
         vector<ElementMatcher> basics;
+        vector<unsigned> _basicsOrder;      // indexes into basics, in evaluation order
+        // with several predicates, matches() indexes the top level fields of each document once
+        bool _useFieldIndex;
         bool haveSize;
         bool all;
         bool hasArray;
@@ -411,7 +411,7 @@ namespace mongo {
         void reset();
         static std::map< string, shared_ptr< NamespaceDetailsTransient > > _map;
     public:
-        NamespaceDetailsTransient(const char *ns) : _ns(ns), _keysComputed(false), _qcWriteCount() { }
+        NamespaceDetailsTransient(const char *ns) : _ns(ns), _keysComputed(false), _qcWriteCount(), _writeCount() { }
         /* _get() is not threadsafe -- see get_inlock() comments */
         static NamespaceDetailsTransient& _get(const char *ns);
         /* use get_w() when doing write operations */
@@ -463,6 +463,7 @@ namespace mongo {
         /* query cache (for query optimizer) ------------------------------------- */
     private:
         int _qcWriteCount;
+        unsigned long long _writeCount;
         map< QueryPattern, pair< BSONObj, long long > > _qcCache;
     public:
         static mongo::mutex _qcMutex;
@@ -476,11 +477,14 @@ namespace mongo {
         }
         /* you must notify the cache if you are doing writes, as query plan optimality will change */
         void notifyOfWriteOp() {
+            _writeCount++;
             if ( _qcCache.empty() )
                 return;
             if ( ++_qcWriteCount >= 100 )
                 clearQueryCache();
         }
+        /** bumped by every notifyOfWriteOp(), so that a cache of index contents can tell it is stale */
+        unsigned long long writeCount() const { return _writeCount; }
         BSONObj indexForPattern( const QueryPattern &pattern ) {
             return _qcCache[ pattern ].first;
         }
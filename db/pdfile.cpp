@@ -636,7 +636,7 @@ namespace mongo {
 
     /*---------------------------------------------------------------------*/
 
-    shared_ptr<Cursor> DataFileMgr::findAll(const char *ns, const DiskLoc &startLoc) {
+    shared_ptr<Cursor> DataFileMgr::findAll(const char *ns, const DiskLoc &startLoc, const BSONObj &query, int numWanted) {
         NamespaceDetails * d = nsdetails( ns );
         if ( ! d )
             return shared_ptr<Cursor>(new BasicCursor(DiskLoc()));
@@ -669,6 +669,8 @@ namespace mongo {
         if ( !startLoc.isNull() )
             return shared_ptr<Cursor>(new BasicCursor( startLoc ));
 
+        ScanFilter filter( query );
+
         while ( e->firstRecord.isNull() && !e->xnext.isNull() ) {
             /* todo: if extent is empty, free it for reuse elsewhere.
                that is a bit complicated have to clean up the freelists.
@@ -678,17 +680,19 @@ namespace mongo {
             // it might be nice to free the whole extent here!  but have to clean up free recs then.
             e = e->getNextExtent();
         }
+        if ( !filter.empty() )
+            return shared_ptr<Cursor>(new BatchedBasicCursor( e->firstRecord, filter, numWanted ));
         return shared_ptr<Cursor>(new BasicCursor( e->firstRecord ));
     }
 
     /* get a table scan cursor, but can be forward or reverse direction.
        order.$natural - if set, > 0 means forward (asc), < 0 backward (desc).
     */
-    shared_ptr<Cursor> findTableScan(const char *ns, const BSONObj& order, const DiskLoc &startLoc) {
+    shared_ptr<Cursor> findTableScan(const char *ns, const BSONObj& order, const DiskLoc &startLoc, const BSONObj &query, int numWanted) {
         BSONElement el = order.getField("$natural"); // e.g., { $natural : -1 }
 
         if ( el.number() >= 0 )
-            return DataFileMgr::findAll(ns, startLoc);
+            return DataFileMgr::findAll(ns, startLoc, query, numWanted);
 
         // "reverse natural order"
         NamespaceDetails *d = nsdetails(ns);
@@ -50,7 +50,11 @@ namespace mongo {
     /* deletes this ns, indexes and cursors */
     void dropCollection( const string &name, string &errmsg, BSONObjBuilder &result );
     bool userCreateNS(const char *ns, BSONObj j, string& err, bool logForReplication, bool *deferIdIndex = 0);
-    shared_ptr<Cursor> findTableScan(const char *ns, const BSONObj& order, const DiskLoc &startLoc=DiskLoc());
+    /* @param query if not empty, a forward scan of a non capped collection may skip records which
+                   can't match query (see ScanFilter).  callers must still apply their matcher.
+       @param numWanted if known, how many matches the caller is after, which bounds the read ahead
+    */
+    shared_ptr<Cursor> findTableScan(const char *ns, const BSONObj& order, const DiskLoc &startLoc=DiskLoc(), const BSONObj &query=BSONObj(), int numWanted=0);
 
     // -1 if library unavailable.
     boost::intmax_t freeSpace( const string &path = dbpath );
@@ -130,7 +134,7 @@ namespace mongo {
         void insertNoReturnVal(const char *ns, BSONObj o, bool god = false);
 
         DiskLoc insert(const char *ns, const void *buf, int len, bool god = false, const BSONElement &writeId = BSONElement(), bool mayAddIndex = true);
-        static shared_ptr<Cursor> findAll(const char *ns, const DiskLoc &startLoc = DiskLoc());
+        static shared_ptr<Cursor> findAll(const char *ns, const DiskLoc &startLoc = DiskLoc(), const BSONObj &query = BSONObj(), int numWanted = 0);
 
         /* special version of insert for transaction logging -- streamlined a bit.
            assumes ns is capped and no indexes
@@ -0,0 +1,679 @@
+// pipeline.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "pipeline.h"
+#include "../util/mongoutils/str.h"
+
+namespace mongo {
+
+    using namespace mongoutils;
+
+    // $group and $sort hold everything they see, so cap them rather than exhaust memory
+    static const long long GroupMemLimit = 100 * 1024 * 1024;
+    static const long long SortMemLimit = 100 * 1024 * 1024;
+
+    bool ArraySource::next( BSONObj& out ) {
+        if ( _pos >= _docs.size() )
+            return false;
+        out = _docs[_pos++];
+        return true;
+    }
+
+    bool MatchSource::next( BSONObj& out ) {
+        while ( _source->next( out ) ) {
+            if ( _matcher.matches( out ) )
+                return true;
+        }
+        return false;
+    }
+
+    bool ProjectSource::next( BSONObj& out ) {
+        BSONObj in;
+        if ( ! _source->next( in ) )
+            return false;
+        out = _projection.transform( in );
+        return true;
+    }
+
+    BSONObj UnwindSource::replaceField( const BSONObj& doc , const char * path , const BSONElement& e ) {
+        const char * dot = strchr( path , '.' );
+        int len = dot ? (int)( dot - path ) : (int)strlen( path );
+
+        BSONObjBuilder b( doc.objsize() + e.size() );
+        BSONObjIterator i( doc );
+        while ( i.more() ) {
+            BSONElement f = i.next();
+            if ( strncmp( f.fieldName() , path , len ) != 0 || f.fieldName()[len] != 0 ) {
+                b.append( f );
+            }
+            else if ( ! dot ) {
+                b.appendAs( e , f.fieldName() );
+            }
+            else if ( f.type() == Object ) {
+                b.append( f.fieldName() , replaceField( f.embeddedObject() , dot + 1 , e ) );
+            }
+            else {
+                b.append( f );
+            }
+        }
+        return b.obj();
+    }
+
+    bool UnwindSource::next( BSONObj& out ) {
+        while ( true ) {
+            if ( _elems.get() ) {
+                if ( _elems->more() ) {
+                    out = replaceField( _doc , _path.c_str() , _elems->next() );
+                    return true;
+                }
+                _elems.reset();
+            }
+
+            // _doc stays valid while we iterate it since we don't call next() on our source
+            if ( ! _source->next( _doc ) )
+                return false;
+
+            BSONElement a = _doc.getFieldDotted( _path.c_str() );
+            if ( a.type() == Array ) {
+                _elems.reset( new BSONObjIterator( a.embeddedObject() ) );
+                continue;
+            }
+
+            if ( a.eoo() || a.isNull() )
+                continue;
+
+            // a single value unwinds to itself
+            out = _doc;
+            return true;
+        }
+    }
+
+    bool LimitSource::next( BSONObj& out ) {
+        if ( _n >= _limit )
+            return false;
+        if ( ! _source->next( out ) )
+            return false;
+        _n++;
+        return true;
+    }
+
+    bool SkipSource::next( BSONObj& out ) {
+        while ( _skip > 0 ) {
+            if ( ! _source->next( out ) )
+                return false;
+            _skip--;
+        }
+        return _source->next( out );
+    }
+
+    void SortSource::trim() {
+        if ( (long long)_docs.size() <= _limit )
+            return;
+
+        // a stable sort, not a selection, so which of several equal keys are kept doesn't vary
+        stable_sort( _docs.begin() , _docs.end() , KeyCmp( _spec ) );
+        _docs.resize( (size_t)_limit );
+
+        _size = 0;
+        for ( unsigned i=0; i<_docs.size(); i++ )
+            _size += _docs[i].first.objsize() + _docs[i].second.objsize();
+    }
+
+    void SortSource::load() {
+        BSONObj doc;
+        while ( _source->next( doc ) ) {
+            BSONObjBuilder kb;
+            BSONObjIterator i( _spec );
+            while ( i.more() ) {
+                BSONElement e = doc.getFieldDotted( i.next().fieldName() );
+                if ( e.eoo() )
+                    kb.appendNull( "" );
+                else
+                    kb.appendAs( e , "" );
+            }
+
+            KeyAndDoc x( kb.obj() , doc.getOwned() );
+            _size += x.first.objsize() + x.second.objsize();
+            _docs.push_back( x );
+
+            if ( _limit && (long long)_docs.size() >= 2 * _limit )
+                trim();
+
+            uassert( 14051 , "$sort too big, 100mb cap; use a $limit after it" , _size < SortMemLimit );
+        }
+
+        if ( _limit )
+            trim();
+        stable_sort( _docs.begin() , _docs.end() , KeyCmp( _spec ) );
+    }
+
+    bool SortSource::next( BSONObj& out ) {
+        if ( ! _sorted ) {
+            load();
+            _sorted = true;
+        }
+        if ( _pos >= _docs.size() )
+            return false;
+        out = _docs[_pos++].second;
+        return true;
+    }
+
+    namespace {
+
+        /** $sum : stays an int, then a long, until it sees a double */
+        class SumAccumulator : public GroupSource::Accumulator {
+        public:
+            SumAccumulator() : _type( NumberInt ) , _l(0) , _d(0) {}
+            virtual void process( const BSONElement& e ) {
+                switch ( e.type() ) {
+                case NumberLong:
+                    if ( _type == NumberInt )
+                        _type = NumberLong;
+                    // fall through
+                case NumberInt:
+                    _l += e.numberLong();
+                    _d += e.number();
+                    break;
+                case NumberDouble:
+                    _type = NumberDouble;
+                    _d += e.number();
+                    break;
+                default:
+                    break;
+                }
+            }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const {
+                if ( _type == NumberDouble )
+                    b.append( name , _d );
+                else if ( _type == NumberLong || _l > numeric_limits<int>::max() || _l < numeric_limits<int>::min() )
+                    b.append( name , _l );
+                else
+                    b.append( name , (int)_l );
+            }
+        private:
+            BSONType _type;
+            long long _l;
+            double _d;
+        };
+
+        /** $avg : shards send { sum , n } so the router can weight them */
+        class AvgAccumulator : public GroupSource::Accumulator {
+        public:
+            AvgAccumulator() : _sum(0) , _n(0) {}
+            virtual void process( const BSONElement& e ) {
+                if ( ! e.isNumber() )
+                    return;
+                _sum += e.number();
+                _n++;
+            }
+            virtual void merge( const BSONElement& e ) {
+                if ( e.type() != Object )
+                    return;
+                BSONObj o = e.embeddedObject();
+                _sum += o["sum"].number();
+                _n += o["n"].numberLong();
+            }
+            virtual void appendPartial( BSONObjBuilder& b , const char * name ) const {
+                b.append( name , BSON( "sum" << _sum << "n" << _n ) );
+            }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const {
+                if ( _n )
+                    b.append( name , _sum / _n );
+                else
+                    b.appendNull( name );
+            }
+        private:
+            double _sum;
+            long long _n;
+        };
+
+        /** $min and $max , by BSON sort order */
+        class ExtremeAccumulator : public GroupSource::Accumulator {
+        public:
+            ExtremeAccumulator( int sign ) : _sign( sign ) {}
+            virtual void process( const BSONElement& e ) {
+                if ( e.eoo() )
+                    return;
+                if ( _v.isEmpty() || e.woCompare( _v.firstElement() , false ) * _sign < 0 )
+                    _v = e.wrap( "" );
+            }
+            virtual void appendPartial( BSONObjBuilder& b , const char * name ) const {
+                // a null here would win every $min on the router
+                if ( ! _v.isEmpty() )
+                    b.appendAs( _v.firstElement() , name );
+            }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const {
+                if ( _v.isEmpty() )
+                    b.appendNull( name );
+                else
+                    b.appendAs( _v.firstElement() , name );
+            }
+            virtual int memUsage() const { return _v.objsize(); }
+        private:
+            int _sign;
+            BSONObj _v;
+        };
+
+        /** $first and $last , in the order documents reach the $group */
+        class EndAccumulator : public GroupSource::Accumulator {
+        public:
+            EndAccumulator( bool last ) : _last( last ) , _set( false ) {}
+            virtual void process( const BSONElement& e ) {
+                if ( _set && ! _last )
+                    return;
+                _set = true;
+                _v = e.eoo() ? BSONObj() : e.wrap( "" );
+            }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const {
+                if ( _v.isEmpty() )
+                    b.appendNull( name );
+                else
+                    b.appendAs( _v.firstElement() , name );
+            }
+            virtual int memUsage() const { return _v.objsize(); }
+        private:
+            bool _last;
+            bool _set;
+            BSONObj _v;
+        };
+
+        /** $push , or $addToSet when unique */
+        class ArrayAccumulator : public GroupSource::Accumulator {
+        public:
+            ArrayAccumulator( bool unique ) : _unique( unique ) , _size(0) {}
+            virtual void process( const BSONElement& e ) {
+                if ( e.eoo() )
+                    return;
+                BSONObj v = e.wrap( "" );
+                if ( _unique && ! _set.insert( v ).second )
+                    return;
+                _vals.push_back( v );
+                _size += v.objsize();
+            }
+            virtual void merge( const BSONElement& e ) {
+                if ( e.type() != Array )
+                    return;
+                BSONObjIterator i( e.embeddedObject() );
+                while ( i.more() )
+                    process( i.next() );
+            }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const {
+                BSONArrayBuilder a( b.subarrayStart( name ) );
+                for ( unsigned i=0; i<_vals.size(); i++ )
+                    a.append( _vals[i].firstElement() );
+                a.done();
+            }
+            virtual int memUsage() const { return _unique ? 2 * _size : _size; }
+        private:
+            bool _unique;
+            int _size;
+            vector<BSONObj> _vals;
+            set<BSONObj,BSONObjCmp> _set;
+        };
+
+    }
+
+    GroupSource::Accumulator * GroupSource::newAccumulator( const string& op ) {
+        if ( op == "$sum" )
+            return new SumAccumulator();
+        if ( op == "$avg" )
+            return new AvgAccumulator();
+        if ( op == "$min" )
+            return new ExtremeAccumulator( 1 );
+        if ( op == "$max" )
+            return new ExtremeAccumulator( -1 );
+        if ( op == "$first" )
+            return new EndAccumulator( false );
+        if ( op == "$last" )
+            return new EndAccumulator( true );
+        if ( op == "$push" )
+            return new ArrayAccumulator( false );
+        if ( op == "$addToSet" )
+            return new ArrayAccumulator( true );
+        return 0;
+    }
+
+    void GroupSource::Expr::init( const BSONElement& e ) {
+        if ( e.type() == String && e.valuestr()[0] == '$' )
+            path = e.valuestr() + 1;
+        else
+            constant = e.wrap( "" );
+    }
+
+    BSONElement GroupSource::Expr::eval( const BSONObj& doc ) const {
+        if ( path.empty() )
+            return constant.firstElement();
+        return doc.getFieldDotted( path.c_str() );
+    }
+
+    bool GroupSource::init( const BSONObj& spec , string& errmsg ) {
+        bool haveId = false;
+
+        BSONObjIterator i( spec );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            const char * name = e.fieldName();
+
+            if ( strcmp( name , "_id" ) == 0 ) {
+                haveId = true;
+                if ( e.type() == Object ) {
+                    _idCompound = true;
+                    BSONObjIterator j( e.embeddedObject() );
+                    while ( j.more() ) {
+                        BSONElement f = j.next();
+                        Expr x;
+                        x.init( f );
+                        _idFields.push_back( make_pair( string( f.fieldName() ) , x ) );
+                    }
+                }
+                else {
+                    _id.init( e );
+                }
+                continue;
+            }
+
+            if ( name[0] == '$' || strchr( name , '.' ) ) {
+                errmsg = str::stream() << "$group output field names can't start with $ or contain . : " << name;
+                return false;
+            }
+            if ( e.type() != Object || e.embeddedObject().nFields() != 1 ) {
+                errmsg = str::stream() << "$group fields have to be { <$accumulator> : <expr> } : " << e;
+                return false;
+            }
+
+            BSONElement op = e.embeddedObject().firstElement();
+            scoped_ptr<Accumulator> test( newAccumulator( op.fieldName() ) );
+            if ( ! test ) {
+                errmsg = str::stream() << "unknown $group accumulator: " << op.fieldName();
+                return false;
+            }
+
+            AccSpec a;
+            a.name = name;
+            a.op = op.fieldName();
+            a.arg.init( op );
+            _accs.push_back( a );
+        }
+
+        if ( ! haveId ) {
+            errmsg = "$group needs an _id";
+            return false;
+        }
+        return true;
+    }
+
+    BSONObj GroupSource::groupKey( const BSONObj& doc ) const {
+        BSONObjBuilder b;
+        if ( _mode == Merge ) {
+            // the shards already worked out the _id
+            BSONElement e = doc["_id"];
+            if ( e.eoo() )
+                b.appendNull( "_id" );
+            else
+                b.append( e );
+        }
+        else if ( _idCompound ) {
+            BSONObjBuilder sub( b.subobjStart( "_id" ) );
+            for ( unsigned i=0; i<_idFields.size(); i++ ) {
+                BSONElement e = _idFields[i].second.eval( doc );
+                if ( e.eoo() )
+                    sub.appendNull( _idFields[i].first );
+                else
+                    sub.appendAs( e , _idFields[i].first );
+            }
+            sub.done();
+        }
+        else {
+            BSONElement e = _id.eval( doc );
+            if ( e.eoo() )
+                b.appendNull( "_id" );
+            else
+                b.appendAs( e , "_id" );
+        }
+        return b.obj();
+    }
+
+    void GroupSource::load() {
+        BSONObj doc;
+        while ( _source->next( doc ) ) {
+            BSONObj key = groupKey( doc );
+
+            Groups::iterator i = _groups.lower_bound( key );
+            if ( i == _groups.end() || _groups.key_comp()( key , i->first ) ) {
+                i = _groups.insert( i , make_pair( key , Group() ) );
+                for ( unsigned k=0; k<_accs.size(); k++ )
+                    i->second.push_back( shared_ptr<Accumulator>( newAccumulator( _accs[k].op ) ) );
+                _memUsage += key.objsize();
+            }
+
+            Group& g = i->second;
+            for ( unsigned k=0; k<_accs.size(); k++ ) {
+                Accumulator& a = *g[k];
+                int before = a.memUsage();
+                if ( _mode == Merge )
+                    a.merge( doc.getField( _accs[k].name ) );
+                else
+                    a.process( _accs[k].arg.eval( doc ) );
+                _memUsage += a.memUsage() - before;
+            }
+
+            uassert( 14052 , "$group too big, 100mb cap" , _memUsage < GroupMemLimit );
+        }
+    }
+
+    bool GroupSource::next( BSONObj& out ) {
+        if ( ! _done ) {
+            load();
+            _done = true;
+            _pos = _groups.begin();
+        }
+
+        if ( _pos == _groups.end() )
+            return false;
+
+        BSONObjBuilder b;
+        b.appendElements( _pos->first );
+        const Group& g = _pos->second;
+        for ( unsigned k=0; k<_accs.size(); k++ ) {
+            if ( _mode == Partial )
+                g[k]->appendPartial( b , _accs[k].name.c_str() );
+            else
+                g[k]->appendFinal( b , _accs[k].name.c_str() );
+        }
+        _current = b.obj();
+        out = _current;
+
+        // done with this group
+        _groups.erase( _pos++ );
+        return true;
+    }
+
+    bool Pipeline::build( const BSONObj& stages , bool fromRouter , vector< shared_ptr<DocumentSource> >& out , string& errmsg ) {
+        vector<BSONElement> specs;
+        BSONObjIterator i( stages );
+        while ( i.more() ) {
+            BSONElement s = i.next();
+            if ( s.type() != Object || s.embeddedObject().nFields() != 1 ) {
+                errmsg = str::stream() << "a pipeline stage has to be { <$stage> : <spec> } : " << s;
+                return false;
+            }
+            specs.push_back( s.embeddedObject().firstElement() );
+        }
+
+        for ( unsigned k=0; k<specs.size(); k++ ) {
+            BSONElement spec = specs[k];
+            string name = spec.fieldName();
+            shared_ptr<DocumentSource> stage;
+
+            if ( name == "$match" ) {
+                if ( spec.type() != Object ) {
+                    errmsg = "$match takes a query object";
+                    return false;
+                }
+                if ( k == 0 ) {
+                    // answered by whatever feeds the pipeline, see query()
+                    continue;
+                }
+                stage.reset( new MatchSource( spec.embeddedObject() ) );
+            }
+            else if ( name == "$project" ) {
+                if ( spec.type() != Object ) {
+                    errmsg = "$project takes a field spec object";
+                    return false;
+                }
+                stage.reset( new ProjectSource( spec.embeddedObject() ) );
+            }
+            else if ( name == "$unwind" ) {
+                if ( spec.type() != String || spec.valuestr()[0] != '$' || spec.valuestr()[1] == 0 ) {
+                    errmsg = "$unwind takes a \"$path\" string";
+                    return false;
+                }
+                stage.reset( new UnwindSource( spec.valuestr() + 1 ) );
+            }
+            else if ( name == "$group" || name == "$groupPartial" || name == "$groupMerge" ) {
+                if ( spec.type() != Object ) {
+                    errmsg = "$group takes an object";
+                    return false;
+                }
+                if ( name != "$group" && ! fromRouter ) {
+                    errmsg = str::stream() << name << " is only for sharded aggregation, use $group";
+                    return false;
+                }
+                GroupSource::Mode mode = GroupSource::Full;
+                if ( name == "$groupPartial" )
+                    mode = GroupSource::Partial;
+                else if ( name == "$groupMerge" )
+                    mode = GroupSource::Merge;
+
+                GroupSource * g = new GroupSource( mode );
+                stage.reset( g );
+                if ( ! g->init( spec.embeddedObject() , errmsg ) )
+                    return false;
+            }
+            else if ( name == "$sort" ) {
+                if ( spec.type() != Object || spec.embeddedObject().isEmpty() ) {
+                    errmsg = "$sort takes a non empty object";
+                    return false;
+                }
+                SortSource * s = new SortSource( spec.embeddedObject() );
+                stage.reset( s );
+                if ( k + 1 < specs.size() && strcmp( specs[k+1].fieldName() , "$limit" ) == 0 && specs[k+1].isNumber() )
+                    s->setLimit( specs[k+1].numberLong() );
+            }
+            else if ( name == "$limit" ) {
+                if ( ! spec.isNumber() || spec.numberLong() <= 0 ) {
+                    errmsg = "$limit takes a positive number";
+                    return false;
+                }
+                stage.reset( new LimitSource( spec.numberLong() ) );
+            }
+            else if ( name == "$skip" ) {
+                if ( ! spec.isNumber() || spec.numberLong() < 0 ) {
+                    errmsg = "$skip takes a non negative number";
+                    return false;
+                }
+                stage.reset( new SkipSource( spec.numberLong() ) );
+            }
+            else {
+                errmsg = str::stream() << "unknown pipeline stage: " << name;
+                return false;
+            }
+
+            out.push_back( stage );
+        }
+        return true;
+    }
+
+    bool Pipeline::init( const BSONObj& stages , string& errmsg , bool fromRouter ) {
+        _stages = stages.getOwned();
+        _fromRouter = fromRouter;
+
+        vector< shared_ptr<DocumentSource> > test;
+        if ( ! build( _stages , _fromRouter , test , errmsg ) )
+            return false;
+
+        BSONElement first = _stages.firstElement();
+        if ( first.type() == Object && first.embeddedObject().firstElement().fieldName() == string( "$match" ) )
+            _query = first.embeddedObject().firstElement().embeddedObject();
+        return true;
+    }
+
+    void Pipeline::run( const shared_ptr<DocumentSource>& input , BSONArrayBuilder& out ) const {
+        vector< shared_ptr<DocumentSource> > stages;
+        string errmsg;
+        massert( 14053 , errmsg , build( _stages , _fromRouter , stages , errmsg ) );
+
+        shared_ptr<DocumentSource> last = input;
+        for ( unsigned i=0; i<stages.size(); i++ ) {
+            stages[i]->setSource( last );
+            last = stages[i];
+        }
+
+        BSONObj o;
+        while ( last->next( o ) ) {
+            uassert( 14054 , "aggregation result too big, 16mb cap" , out.len() + o.objsize() < BSONObjMaxUserSize );
+            out.append( o );
+        }
+    }
+
+    void Pipeline::split( const BSONObj& stages , BSONArrayBuilder& shardPart , BSONArrayBuilder& mergePart ) {
+        vector<BSONObj> specs;
+        BSONObjIterator i( stages );
+        while ( i.more() ) {
+            BSONElement s = i.next();
+            if ( s.type() == Object )
+                specs.push_back( s.embeddedObject() );
+        }
+
+        unsigned k = 0;
+
+        // stages that look at one document at a time run entirely on the shards
+        for ( ; k < specs.size(); k++ ) {
+            string name = specs[k].firstElement().fieldName();
+            if ( name != "$match" && name != "$project" && name != "$unwind" )
+                break;
+            shardPart.append( specs[k] );
+        }
+
+        if ( k < specs.size() ) {
+            BSONElement spec = specs[k].firstElement();
+            string name = spec.fieldName();
+            if ( name == "$group" ) {
+                shardPart.append( BSON( "$groupPartial" << spec.embeddedObject() ) );
+                mergePart.append( BSON( "$groupMerge" << spec.embeddedObject() ) );
+                k++;
+            }
+            else if ( name == "$sort" || name == "$limit" ) {
+                // each shard cuts down what it sends, the router still sorts and limits
+                shardPart.append( specs[k] );
+                mergePart.append( specs[k] );
+                k++;
+                if ( name == "$sort" && k < specs.size() && specs[k].firstElement().fieldName() == string( "$limit" ) ) {
+                    shardPart.append( specs[k] );
+                    mergePart.append( specs[k] );
+                    k++;
+                }
+            }
+        }
+
+        for ( ; k < specs.size(); k++ )
+            mergePart.append( specs[k] );
+    }
+
+}
@@ -0,0 +1,264 @@
+// pipeline.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+#include "jsobj.h"
+#include "matcher.h"
+#include "projection.h"
+
+namespace mongo {
+
+    /**
+     * one stage of an aggregation pipeline.
+     * stages pull from the one before them, so documents stream through
+     * and only $group and $sort hold on to more than one at a time.
+     */
+    class DocumentSource : boost::noncopyable {
+    public:
+        virtual ~DocumentSource() {}
+
+        /**
+         * @param out set to the next document, only valid until the following call
+         * @return false when there are no more
+         */
+        virtual bool next( BSONObj& out ) = 0;
+
+        void setSource( const shared_ptr<DocumentSource>& source ) { _source = source; }
+
+    protected:
+        shared_ptr<DocumentSource> _source;
+    };
+
+    /** documents already in memory, e.g. the partial results from each shard */
+    class ArraySource : public DocumentSource {
+    public:
+        ArraySource() : _pos(0) {}
+        void add( const BSONObj& o ) { _docs.push_back( o.getOwned() ); }
+        virtual bool next( BSONObj& out );
+    private:
+        vector<BSONObj> _docs;
+        unsigned _pos;
+    };
+
+    /** $match : { <query> } */
+    class MatchSource : public DocumentSource {
+    public:
+        MatchSource( const BSONObj& query ) : _matcher( query ) {}
+        virtual bool next( BSONObj& out );
+    private:
+        Matcher _matcher;
+    };
+
+    /** $project : { <fields> } , the same spec as the fields argument of a query */
+    class ProjectSource : public DocumentSource {
+    public:
+        ProjectSource( const BSONObj& spec ) { _projection.init( spec ); }
+        virtual bool next( BSONObj& out );
+    private:
+        Projection _projection;
+    };
+
+    /** $unwind : "$path" , one document per element of the array at path */
+    class UnwindSource : public DocumentSource {
+    public:
+        UnwindSource( const string& path ) : _path( path ) {}
+        virtual bool next( BSONObj& out );
+
+        /** @return a copy of doc with the field at path replaced by e */
+        static BSONObj replaceField( const BSONObj& doc , const char * path , const BSONElement& e );
+
+    private:
+        string _path;
+        BSONObj _doc;
+        auto_ptr<BSONObjIterator> _elems;
+    };
+
+    /** $limit : n */
+    class LimitSource : public DocumentSource {
+    public:
+        LimitSource( long long limit ) : _limit( limit ) , _n(0) {}
+        virtual bool next( BSONObj& out );
+    private:
+        long long _limit;
+        long long _n;
+    };
+
+    /** $skip : n */
+    class SkipSource : public DocumentSource {
+    public:
+        SkipSource( long long skip ) : _skip( skip ) {}
+        virtual bool next( BSONObj& out );
+    private:
+        long long _skip;
+    };
+
+    /**
+     * $sort : { <field> : 1 | -1 , ... }
+     * sorts in memory, and when directly followed by a $limit only keeps the first limit documents.
+     * documents with equal keys stay in the order they came in.
+     */
+    class SortSource : public DocumentSource {
+    public:
+        SortSource( const BSONObj& spec ) : _spec( spec.getOwned() ) , _limit(0) , _sorted(false) , _pos(0) , _size(0) {}
+        void setLimit( long long limit ) { _limit = limit; }
+        virtual bool next( BSONObj& out );
+
+    private:
+        typedef pair<BSONObj,BSONObj> KeyAndDoc;
+
+        class KeyCmp {
+        public:
+            KeyCmp( const BSONObj& spec ) : _spec( spec ) {}
+            bool operator()( const KeyAndDoc& l , const KeyAndDoc& r ) const {
+                return l.first.woCompare( r.first , _spec , false ) < 0;
+            }
+        private:
+            BSONObj _spec;
+        };
+
+        void load();
+        void trim();
+
+        BSONObj _spec;
+        long long _limit;
+        bool _sorted;
+        unsigned _pos;
+        long long _size;
+        vector<KeyAndDoc> _docs;
+    };
+
+    /**
+     * $group : { _id : <expr> , <field> : { <$accumulator> : <expr> } , ... }
+     * an <expr> is "$path", an object of them for a compound _id, or a constant.
+     * accumulators are $sum $avg $min $max $first $last $push $addToSet.
+     */
+    class GroupSource : public DocumentSource {
+    public:
+        /**
+         * Full reads documents and outputs finished groups.
+         * Partial and Merge split that across shards: each shard outputs the running
+         * state of its groups, and the router merges those into finished groups.
+         */
+        enum Mode { Full , Partial , Merge };
+
+        class Accumulator {
+        public:
+            virtual ~Accumulator() {}
+            /** @param e the value from one document, eoo() if it has none */
+            virtual void process( const BSONElement& e ) = 0;
+            /** @param e the partial state appendPartial() wrote on a shard */
+            virtual void merge( const BSONElement& e ) { process( e ); }
+            virtual void appendPartial( BSONObjBuilder& b , const char * name ) const { appendFinal( b , name ); }
+            virtual void appendFinal( BSONObjBuilder& b , const char * name ) const = 0;
+            /** @return approximate bytes held, for the memory cap */
+            virtual int memUsage() const { return 0; }
+        };
+
+        GroupSource( Mode mode ) : _mode( mode ) , _idCompound(false) , _done(false) , _memUsage(0) {}
+
+        /** @return false and errmsg on a bad spec */
+        bool init( const BSONObj& spec , string& errmsg );
+
+        virtual bool next( BSONObj& out );
+
+    private:
+        /** "$path" or a constant */
+        struct Expr {
+            string path;          // "$" stripped; empty for a constant
+            BSONObj constant;     // { "" : value }
+            void init( const BSONElement& e );
+            /** @return the value in doc, eoo() if it has none */
+            BSONElement eval( const BSONObj& doc ) const;
+        };
+
+        struct AccSpec {
+            string name;
+            string op;
+            Expr arg;
+        };
+
+        typedef vector< shared_ptr<Accumulator> > Group;
+        typedef map< BSONObj , Group , BSONObjCmp > Groups;
+
+        static Accumulator * newAccumulator( const string& op );
+        void load();
+
+        /** @return { _id : <key> } for doc */
+        BSONObj groupKey( const BSONObj& doc ) const;
+
+        Mode _mode;
+        Expr _id;
+        bool _idCompound;
+        vector< pair<string,Expr> > _idFields;
+        vector<AccSpec> _accs;
+
+        bool _done;
+        long long _memUsage;
+        Groups _groups;
+        Groups::iterator _pos;
+        BSONObj _current;
+    };
+
+    /**
+     * a parsed aggregation pipeline, e.g.
+     * [ { $match : { a : 1 } } , { $unwind : "$tags" } , { $group : { _id : "$tags" , n : { $sum : 1 } } } ]
+     */
+    class Pipeline {
+    public:
+        Pipeline() : _fromRouter( false ) {}
+
+        /**
+         * @param stages array of { <$stage> : <spec> }
+         * @param fromRouter if the stages came from split(), so can have the internal $groupPartial and $groupMerge
+         * @return false and errmsg on a bad spec
+         */
+        bool init( const BSONObj& stages , string& errmsg , bool fromRouter = false );
+
+        /**
+         * a leading $match is not made a stage: input to run() has to already match this
+         * so that it can be answered by the query optimizer
+         */
+        BSONObj query() const { return _query; }
+
+        /**
+         * runs each document of input through the stages and appends the results to out
+         * uasserts if out grows past the size of a reply
+         */
+        void run( const shared_ptr<DocumentSource>& input , BSONArrayBuilder& out ) const;
+
+        /**
+         * splits stages for a sharded collection.
+         * each shard runs shardPart, then the router runs mergePart over their combined output.
+         * leading $match $project and $unwind stages go to the shards; a $group after them
+         * becomes a Partial group on the shards and a Merge group on the router, and a $sort
+         * (with its $limit) is also done on each shard so the router sorts fewer documents.
+         */
+        static void split( const BSONObj& stages , BSONArrayBuilder& shardPart , BSONArrayBuilder& mergePart );
+
+    private:
+        /** @param out gets one stage per element of stages, less a leading $match */
+        static bool build( const BSONObj& stages , bool fromRouter , vector< shared_ptr<DocumentSource> >& out , string& errmsg );
+
+        BSONObj _query;
+        BSONObj _stages;
+        bool _fromRouter;
+    };
+
+}
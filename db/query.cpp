@@ -417,17 +417,24 @@ namespace mongo {
             _ns(ns), _capped(false), _count(), _myCount(),
             _skip( spec["skip"].numberLong() ),
             _limit( spec["limit"].numberLong() ),
-            _bc() {
+            _bc(), _keysExact() {
         }
 
         virtual void _init() {
-            _c = qp().newCursor();
+            int numWanted = 0;
+            if ( _limit > 0 && _skip + _limit < INT_MAX )
+                numWanted = (int)( _skip + _limit );
+            _c = qp().newCursor( DiskLoc() , numWanted , true );
             _capped = _c->capped();
             if ( qp().exactKeyMatch() && ! matcher()->needRecord() ) {
                 _query = qp().simplifiedQuery( qp().indexKey() );
                 _bc = dynamic_cast< BtreeCursor* >( _c.get() );
                 _bc->forgetEndKey();
             }
+            else if ( qp().keysExact() ) {
+                // the index bounds decide the query: count keys, no matcher and no record fetch
+                _keysExact = true;
+            }
         }
 
         virtual long long nscanned() {
@@ -484,6 +491,15 @@ namespace mongo {
                     _gotOne();
                 }
             }
+            else if ( _keysExact ) {
+                // a run of keys per call, rather than a trip through the plan runner per key
+                for( int i = 0; i < 128 && _c->ok() && !stopRequested(); ++i ) {
+                    _gotOne();
+                    if ( !stopRequested() )
+                        _c->advance();
+                }
+                return;
+            }
             else {
                 if ( !matcher()->matches(_c->currKey(), _c->currLoc() ) ) {
                 }
@@ -531,6 +547,7 @@ namespace mongo {
         shared_ptr<Cursor> _c;
         BSONObj _query;
         BtreeCursor * _bc;
+        bool _keysExact;
         BSONObj _firstMatch;
 
         ClientCursor::CleanupPointer _cc;
@@ -678,7 +695,7 @@ namespace mongo {
                 _capped = true;
             }
             else {
-                _c = qp().newCursor( DiskLoc() , _pq.getNumToReturn() + _pq.getSkip() );
+                _c = qp().newCursor( DiskLoc() , _pq.getNumToReturn() + _pq.getSkip() , true );
                 _capped = _c->capped();
 
                 // setup check for if we can only use index to extract
@@ -63,6 +63,7 @@ namespace mongo {
         _scanAndOrderRequired( true ),
         _exactKeyMatch( false ),
         _direction( 0 ),
+        _startKeyInclusive( true ),
         _endKeyInclusive( endKey.isEmpty() ),
         _unhelpful( false ),
         _special( special ),
@@ -166,15 +167,22 @@ doneCheckOrder:
         _frv.reset( new FieldRangeVector( fbs, idxKey, _direction ) );
         _originalFrv.reset( new FieldRangeVector( originalFrs, idxKey, _direction ) );
         if ( _startOrEndSpec ) {
-            BSONObj newStart, newEnd;
-            if ( !startKey.isEmpty() )
-                _startKey = startKey;
+            // startKey ($min) is inclusive and endKey ($max) exclusive whichever way the index is walked,
+            // so walking it backwards starts at endKey, past any keys equal to it, and ends at startKey
+            const BSONObj &first = _direction >= 0 ? startKey : endKey;
+            const BSONObj &last = _direction >= 0 ? endKey : startKey;
+            if ( !first.isEmpty() )
+                _startKey = first;
             else
                 _startKey = _frv->startKey();
-            if ( !endKey.isEmpty() )
-                _endKey = endKey;
+            if ( !last.isEmpty() )
+                _endKey = last;
             else
                 _endKey = _frv->endKey();
+            if ( _direction < 0 ) {
+                _startKeyInclusive = endKey.isEmpty();
+                _endKeyInclusive = true;
+            }
         }
 
         if ( ( _scanAndOrderRequired || _order.isEmpty() ) &&
@@ -183,7 +191,7 @@ doneCheckOrder:
         }
     }
 
-    shared_ptr<Cursor> QueryPlan::newCursor( const DiskLoc &startLoc , int numWanted ) const {
+    shared_ptr<Cursor> QueryPlan::newCursor( const DiskLoc &startLoc , int numWanted , bool filterTableScan ) const {
 
         if ( _type ) {
             // hopefully safe to use original query in these contexts - don't think we can mix type with $or clause separation yet
@@ -198,14 +206,19 @@ doneCheckOrder:
         if ( !_index ) {
             if ( _fbs.nNontrivialRanges() )
                 checkTableScanAllowed( _fbs.ns() );
-            return findTableScan( _fbs.ns(), _order, startLoc );
+            return findTableScan( _fbs.ns(), _order, startLoc, filterTableScan ? _originalQuery : BSONObj(), numWanted );
         }
 
         massert( 10363 ,  "newCursor() with start location not implemented for indexed plans", startLoc.isNull() );
 
         if ( _startOrEndSpec ) {
             // we are sure to spec _endKeyInclusive
-            return shared_ptr<Cursor>( new BtreeCursor( _d, _idxNo, *_index, _startKey, _endKey, _endKeyInclusive, _direction >= 0 ? 1 : -1 ) );
+            shared_ptr<Cursor> c( new BtreeCursor( _d, _idxNo, *_index, _startKey, _endKey, _endKeyInclusive, _direction >= 0 ? 1 : -1 ) );
+            if ( !_startKeyInclusive ) {
+                while( c->ok() && c->currKey().woCompare( _startKey, BSONObj(), false ) == 0 )
+                    c->advance();
+            }
+            return c;
         }
         else if ( _index->getSpec().getType() ) {
             return shared_ptr<Cursor>( new BtreeCursor( _d, _idxNo, *_index, _frv->startKey(), _frv->endKey(), true, _direction >= 0 ? 1 : -1 ) );
@@ -247,6 +260,76 @@ doneCheckOrder:
         return _d->isMultikey( _idxNo );
     }
 
+    /** a value whose order in the index is the same as its order for the matcher */
+    static bool simpleKeyValue( const BSONElement &e ) {
+        switch( e.type() ) {
+        case NumberDouble:
+        case NumberInt:
+        case NumberLong: {
+            double d = e.number();
+            return d <= numeric_limits< double >::max() && d >= -numeric_limits< double >::max();
+        }
+        case String:
+        case jstOID:
+        case Bool:
+        case Date:
+        case Timestamp:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool QueryPlan::keysExact() const {
+        if ( !_index || _type || _startOrEndSpec || !_frv || isMultiKey() )
+            return false;
+        BSONObj idxKey = _index->keyPattern();
+        BSONObjIterator i( _originalQuery );
+        while( i.more() ) {
+            BSONElement e = i.next();
+            if ( e.fieldName()[ 0 ] == '$' || !idxKey.hasField( e.fieldName() ) )
+                return false;
+            if ( e.type() == Object ) {
+                BSONObjIterator j( e.embeddedObject() );
+                if ( !j.more() )
+                    return false;
+                while( j.more() ) {
+                    BSONElement f = j.next();
+                    switch( f.getGtLtOp( -1 ) ) {
+                    case BSONObj::LT:
+                    case BSONObj::LTE:
+                    case BSONObj::GT:
+                    case BSONObj::GTE:
+                        if ( !simpleKeyValue( f ) )
+                            return false;
+                        break;
+                    case BSONObj::opIN: {
+                        if ( f.type() != Array )
+                            return false;
+                        BSONObjIterator k( f.embeddedObject() );
+                        while( k.more() )
+                            if ( !simpleKeyValue( k.next() ) )
+                                return false;
+                        break;
+                    }
+                    default:
+                        return false;
+                    }
+                }
+            }
+            else if ( !simpleKeyValue( e ) ) {
+                return false;
+            }
+            // an open ended range, e.g. $gt:5, also spans keys of other types
+            const vector< FieldInterval > &intervals = _fbs.range( e.fieldName() ).intervals();
+            for( vector< FieldInterval >::const_iterator k = intervals.begin(); k != intervals.end(); ++k ) {
+                if ( k->_lower._bound.canonicalType() != k->_upper._bound.canonicalType() )
+                    return false;
+            }
+        }
+        return true;
+    }
+
     QueryPlanSet::QueryPlanSet( const char *ns, auto_ptr< FieldRangeSet > frs, auto_ptr< FieldRangeSet > originalFrs, const BSONObj &originalQuery, const BSONObj &order, const BSONElement *hint, bool honorRecordedPlan, const BSONObj &min, const BSONObj &max, bool bestGuessOnly, bool mayYield ) :
         _ns(ns),
         _originalQuery( originalQuery ),
@@ -786,7 +869,9 @@ doneCheckOrder:
                 return false;
             if ( strcmp( pe.fieldName(), ke.fieldName() ) != 0 )
                 return false;
-            if ( ( i == firstSignificantField ) && !( ( direction > 0 ) == ( pe.number() > 0 ) ) )
+            // plugin indexes, e.g. { a : "hashed" }, keep their keys in ascending order
+            bool ascending = pe.type() == String || pe.number() > 0;
+            if ( ( i == firstSignificantField ) && !( ( direction > 0 ) == ascending ) )
                 return false;
             ++i;
         }
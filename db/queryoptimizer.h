@@ -54,7 +54,11 @@ namespace mongo {
            requested sort order */
         bool unhelpful() const { return _unhelpful; }
         int direction() const { return _direction; }
-        shared_ptr<Cursor> newCursor( const DiskLoc &startLoc = DiskLoc() , int numWanted=0 ) const;
+        /* @param filterTableScan - a table scan cursor may skip records that can't match the query.
+                                    only for read only callers: the read ahead isn't revisited after
+                                    the caller's own writes.
+        */
+        shared_ptr<Cursor> newCursor( const DiskLoc &startLoc = DiskLoc() , int numWanted=0 , bool filterTableScan=false ) const;
         shared_ptr<Cursor> newReverseCursor() const;
         BSONObj indexKey() const;
         bool indexed() const { return _index; }
@@ -69,6 +73,11 @@ namespace mongo {
         // just for testing
         shared_ptr< FieldRangeVector > frv() const { return _frv; }
         bool isMultiKey() const;
+        /* When true, every key the index cursor visits matches the query, so counting keys
+           counts matches: the query is only equalities / ranges / $in over indexed fields,
+           each bounded within one type, and the index is not multikey.
+         */
+        bool keysExact() const;
 
     private:
         NamespaceDetails * _d;
@@ -85,6 +94,7 @@ namespace mongo {
         shared_ptr< FieldRangeVector > _originalFrv;
         BSONObj _startKey;
         BSONObj _endKey;
+        bool _startKeyInclusive;
         bool _endKeyInclusive;
         bool _unhelpful;
         string _special;
@@ -0,0 +1,539 @@
+// db/text.cpp
+
+/**
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+#include "namespace-inl.h"
+#include "jsobj.h"
+#include "index.h"
+#include "../util/unittest.h"
+#include "commands.h"
+#include "pdfile.h"
+#include "btree.h"
+#include "curop-inl.h"
+#include "matcher.h"
+#include <queue>
+
+/**
+ * full text search
+ * { title : "text" , body : "text" } indexes the words of those string fields (or arrays of strings).
+ * there is a key { "" : term , "" : tf } per distinct term of a document, so the keys of
+ * one term are its posting list.  searching is the "text" command, which intersects the
+ * posting lists of the words searched for and returns the best scoring documents by tf-idf.
+ */
+namespace mongo {
+
+    string TEXTNAME = "text";
+
+    namespace text {
+
+        /** terms longer than this are cut, so keys stay well under the btree key limit */
+        const unsigned MaxTermLength = 64;
+
+        const char * stopWordList[] = {
+            "a" , "an" , "and" , "are" , "as" , "at" , "be" , "but" , "by" , "for" , "from" , "has" , "he" ,
+            "if" , "in" , "into" , "is" , "it" , "its" , "no" , "not" , "of" , "on" , "or" , "she" , "such" ,
+            "that" , "the" , "their" , "then" , "there" , "these" , "they" , "this" , "to" , "was" , "were" ,
+            "will" , "with" , 0
+        };
+
+        class StopWords {
+        public:
+            StopWords() {
+                for ( int i=0; stopWordList[i]; i++ )
+                    _words.insert( stopWordList[i] );
+            }
+            bool has( const string& w ) const { return _words.count( w ) > 0; }
+        private:
+            set<string> _words;
+        } stopWords;
+
+        bool isConsonant( const string& w , int i ) {
+            switch ( w[i] ) {
+            case 'a': case 'e': case 'i': case 'o': case 'u':
+                return false;
+            case 'y':
+                return i == 0 || ! isConsonant( w , i - 1 );
+            default:
+                return true;
+            }
+        }
+
+        /** @return the number of vowel-consonant sequences in w[0,len) */
+        int measure( const string& w , int len ) {
+            int m = 0;
+            int i = 0;
+            while ( i < len && isConsonant( w , i ) )
+                i++;
+            while ( i < len ) {
+                while ( i < len && ! isConsonant( w , i ) )
+                    i++;
+                if ( i == len )
+                    break;
+                while ( i < len && isConsonant( w , i ) )
+                    i++;
+                m++;
+            }
+            return m;
+        }
+
+        bool hasVowel( const string& w , int len ) {
+            for ( int i=0; i<len; i++ )
+                if ( ! isConsonant( w , i ) )
+                    return true;
+            return false;
+        }
+
+        bool endsWith( const string& w , const char * suffix ) {
+            size_t n = strlen( suffix );
+            return w.size() >= n && w.compare( w.size() - n , n , suffix ) == 0;
+        }
+
+        bool endsDoubleConsonant( const string& w ) {
+            int n = w.size();
+            return n >= 2 && w[n-1] == w[n-2] && isConsonant( w , n - 1 );
+        }
+
+        /** consonant vowel consonant, where the last isn't w x or y: hop, but not snow */
+        bool endsCVC( const string& w ) {
+            int n = w.size();
+            if ( n < 3 || ! isConsonant( w , n - 3 ) || isConsonant( w , n - 2 ) || ! isConsonant( w , n - 1 ) )
+                return false;
+            char c = w[n-1];
+            return c != 'w' && c != 'x' && c != 'y';
+        }
+
+        /**
+         * steps 1a 1b and 1c of Porter's stemmer: plurals, -ed, -ing and a trailing y.
+         * that folds the inflections that matter most for search and leaves derivations alone.
+         * only plain lowercase ascii words are stemmed.
+         */
+        void stem( string& w ) {
+            if ( w.size() <= 2 )
+                return;
+            for ( unsigned i=0; i<w.size(); i++ )
+                if ( w[i] < 'a' || w[i] > 'z' )
+                    return;
+
+            // 1a
+            if ( endsWith( w , "sses" ) || endsWith( w , "ies" ) )
+                w.resize( w.size() - 2 );
+            else if ( endsWith( w , "s" ) && ! endsWith( w , "ss" ) )
+                w.resize( w.size() - 1 );
+
+            // 1b
+            bool fix = false;
+            if ( endsWith( w , "eed" ) ) {
+                if ( measure( w , w.size() - 3 ) > 0 )
+                    w.resize( w.size() - 1 );
+            }
+            else if ( endsWith( w , "ed" ) && hasVowel( w , w.size() - 2 ) ) {
+                w.resize( w.size() - 2 );
+                fix = true;
+            }
+            else if ( endsWith( w , "ing" ) && hasVowel( w , w.size() - 3 ) ) {
+                w.resize( w.size() - 3 );
+                fix = true;
+            }
+            if ( fix ) {
+                char last = w[w.size()-1];
+                if ( endsWith( w , "at" ) || endsWith( w , "bl" ) || endsWith( w , "iz" ) )
+                    w += 'e';
+                else if ( endsDoubleConsonant( w ) && last != 'l' && last != 's' && last != 'z' )
+                    w.resize( w.size() - 1 );
+                else if ( measure( w , w.size() ) == 1 && endsCVC( w ) )
+                    w += 'e';
+            }
+
+            // 1c
+            if ( endsWith( w , "y" ) && hasVowel( w , w.size() - 1 ) )
+                w[w.size()-1] = 'i';
+        }
+
+        /**
+         * appends the terms of s to out: lowercased, stemmed words less stop words.
+         * words are runs of letters and digits; bytes >= 0x80 count as letters so utf-8 words stay whole.
+         */
+        void tokenize( const char * s , vector<string>& out ) {
+            const unsigned char * p = (const unsigned char*)s;
+            while ( *p ) {
+                while ( *p && *p < 0x80 && ! isalnum( *p ) )
+                    p++;
+                if ( ! *p )
+                    break;
+
+                string w;
+                while ( *p && ( *p >= 0x80 || isalnum( *p ) ) ) {
+                    w += (char)( *p < 0x80 ? tolower( *p ) : *p );
+                    p++;
+                }
+
+                if ( stopWords.has( w ) )
+                    continue;
+                stem( w );
+                if ( w.size() > MaxTermLength ) {
+                    // back up over continuation bytes so a multi-byte character isn't split
+                    unsigned len = MaxTermLength;
+                    while ( len > 0 && ( w[len] & 0xC0 ) == 0x80 )
+                        len--;
+                    w.resize( len );
+                }
+                out.push_back( w );
+            }
+        }
+
+        /** one entry of a posting list: a document, and how much of it is the term */
+        struct Posting {
+            Posting( const DiskLoc& loc , double tf ) : loc( loc ) , tf( tf ) {}
+            bool operator<( const Posting& other ) const { return loc < other.loc; }
+            DiskLoc loc;
+            double tf;
+        };
+        typedef vector<Posting> PostingList;
+
+        struct Scored {
+            Scored( double score , const DiskLoc& loc ) : score( score ) , loc( loc ) {}
+            /** so that a priority_queue of these has the lowest score on top */
+            bool operator<( const Scored& other ) const {
+                if ( score != other.score )
+                    return score > other.score;
+                return loc < other.loc;
+            }
+            double score;
+            DiskLoc loc;
+        };
+
+    } // namespace text
+
+    class TextIndex : public IndexType {
+    public:
+
+        TextIndex( const IndexPlugin* plugin , const IndexSpec* spec )
+            : IndexType( plugin , spec ) {
+
+            BSONObj weights;
+            if ( spec->info["weights"].type() == Object )
+                weights = spec->info["weights"].embeddedObject();
+
+            BSONObjIterator i( spec->keyPattern );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                uassert( 14067 , "all fields of a text index have to be \"text\"" ,
+                         e.type() == String && TEXTNAME == e.valuestr() );
+
+                double weight = 1;
+                BSONElement w = weights[ e.fieldName() ];
+                if ( ! w.eoo() ) {
+                    uassert( 14068 , "text weights have to be numbers greater than 0" , w.isNumber() && w.number() > 0 );
+                    weight = w.number();
+                }
+                _fields.push_back( make_pair( string( e.fieldName() ) , weight ) );
+            }
+        }
+
+        /**
+         * a key per distinct term: { "" : term , "" : tf }.
+         * tf is the term's share of the words of each field it is in, times that field's weight,
+         * so a word in a short title counts for more than the same word in a long body.
+         */
+        void getKeys( const BSONObj &obj, BSONObjSetDefaultOrder &keys ) const {
+            map<string,double> tf;
+
+            for ( unsigned i=0; i<_fields.size(); i++ ) {
+                BSONElementSet all;
+                obj.getFieldsDotted( _fields[i].first , all );
+                for ( BSONElementSet::iterator j=all.begin(); j!=all.end(); ++j ) {
+                    if ( j->type() != String )
+                        continue;
+
+                    vector<string> terms;
+                    text::tokenize( j->valuestr() , terms );
+                    for ( unsigned k=0; k<terms.size(); k++ )
+                        tf[ terms[k] ] += _fields[i].second / terms.size();
+                }
+            }
+
+            for ( map<string,double>::iterator i=tf.begin(); i!=tf.end(); ++i ) {
+                BSONObjBuilder b;
+                b.append( "" , i->first );
+                b.append( "" , i->second );
+                keys.insert( b.obj() );
+            }
+        }
+
+        shared_ptr<Cursor> newCursor( const BSONObj& query , const BSONObj& order , int numWanted ) const {
+            uasserted( 14069 , "text indexes are searched with the text command" );
+            return shared_ptr<Cursor>();
+        }
+
+        /** the keys are terms, not field values, so they can't answer ordinary queries */
+        IndexSuitability suitability( const BSONObj& query , const BSONObj& order ) const {
+            return USELESS;
+        }
+
+        /**
+         * all the words of search have to be in a document for it to match.
+         * posting lists are read whole and sorted by record, then walked from the shortest,
+         * so the work is about the size of the rarest term's list plus a search per other term.
+         * the best limit documents by sum(tf * idf) are kept in a heap, and only those, or
+         * the ones that could get into it, are read for filter.
+         */
+        void search( NamespaceDetails* nsd , int idxNo , const string& search , const BSONObj& filter ,
+                     unsigned limit , bool explain , BSONObjBuilder& result ) {
+            Timer t;
+
+            vector<string> words;
+            text::tokenize( search.c_str() , words );
+            set<string> terms( words.begin() , words.end() );
+
+            vector<string> termOrder;
+            vector<text::PostingList> lists;
+            long long nscanned = 0;
+            for ( set<string>::iterator i=terms.begin(); i!=terms.end(); ++i ) {
+                termOrder.push_back( *i );
+                lists.push_back( text::PostingList() );
+                nscanned += load( nsd , idxNo , *i , lists.back() );
+            }
+
+            // rarest first
+            vector<unsigned> order;
+            for ( unsigned i=0; i<lists.size(); i++ )
+                order.push_back( i );
+            for ( unsigned i=1; i<order.size(); i++ )
+                for ( unsigned j=i; j>0 && lists[order[j]].size() < lists[order[j-1]].size(); j-- )
+                    swap( order[j] , order[j-1] );
+
+            double numRecords = (double)max( 1LL , nsd->stats.nrecords );
+            vector<double> idf( lists.size() );
+            for ( unsigned i=0; i<lists.size(); i++ )
+                idf[i] = ::log( 1 + numRecords / max( (size_t)1 , lists[i].size() ) );
+
+            scoped_ptr<Matcher> matcher;
+            if ( ! filter.isEmpty() )
+                matcher.reset( new Matcher( filter ) );
+
+            priority_queue<text::Scored> best;
+            long long nmatched = 0;
+            long long nscannedObjects = 0;
+
+            if ( ! lists.empty() && limit > 0 ) {
+                const text::PostingList& first = lists[order[0]];
+                vector<unsigned> pos( lists.size() , 0 );
+
+                for ( unsigned i=0; i<first.size(); i++ ) {
+                    double score = first[i].tf * idf[order[0]];
+                    bool all = true;
+                    for ( unsigned k=1; k<order.size(); k++ ) {
+                        const text::PostingList& l = lists[order[k]];
+                        text::PostingList::const_iterator j =
+                            lower_bound( l.begin() + pos[k] , l.end() , first[i] );
+                        pos[k] = j - l.begin();
+                        if ( j == l.end() || j->loc != first[i].loc ) {
+                            all = false;
+                            break;
+                        }
+                        score += j->tf * idf[order[k]];
+                    }
+                    if ( ! all )
+                        continue;
+
+                    nmatched++;
+                    if ( best.size() >= limit && ! ( text::Scored( score , first[i].loc ) < best.top() ) )
+                        continue;
+
+                    if ( matcher ) {
+                        nscannedObjects++;
+                        if ( ! matcher->matches( first[i].loc.obj() ) )
+                            continue;
+                    }
+
+                    best.push( text::Scored( score , first[i].loc ) );
+                    if ( best.size() > limit )
+                        best.pop();
+                }
+            }
+
+            vector<text::Scored> results;
+            while ( ! best.empty() ) {
+                results.push_back( best.top() );
+                best.pop();
+            }
+
+            BSONArrayBuilder arr( result.subarrayStart( "results" ) );
+            for ( int i=results.size()-1; i>=0; i-- ) {
+                BSONObjBuilder b( arr.subobjStart() );
+                b.append( "score" , results[i].score );
+                b.append( "obj" , results[i].loc.obj() );
+                b.done();
+            }
+            arr.done();
+
+            {
+                BSONObjBuilder b( result.subobjStart( "stats" ) );
+                b.appendNumber( "nscanned" , nscanned );
+                b.appendNumber( "nscannedObjects" , nscannedObjects );
+                b.appendNumber( "nmatched" , nmatched );
+                b.append( "n" , (int)results.size() );
+                b.append( "time" , t.millis() );
+                if ( explain ) {
+                    BSONArrayBuilder a( b.subarrayStart( "terms" ) );
+                    for ( unsigned i=0; i<order.size(); i++ ) {
+                        BSONObjBuilder tb( a.subobjStart() );
+                        tb.append( "term" , termOrder[order[i]] );
+                        tb.append( "postings" , (int)lists[order[i]].size() );
+                        tb.append( "idf" , idf[order[i]] );
+                        tb.done();
+                    }
+                    a.done();
+                }
+                b.done();
+            }
+        }
+
+        /**
+         * reads the posting list of term into out, sorted by record
+         * @return keys read
+         */
+        long long load( NamespaceDetails* nsd , int idxNo , const string& term , text::PostingList& out ) const {
+            BSONObjBuilder start;
+            start.append( "" , term );
+            start.appendMinKey( "" );
+            BSONObjBuilder end;
+            end.append( "" , term );
+            end.appendMaxKey( "" );
+
+            long long n = 0;
+            BtreeCursor cursor( nsd , idxNo , *getDetails() , start.obj() , end.obj() , true , 1 );
+            while ( cursor.ok() ) {
+                BSONObjIterator i( cursor.currKey() );
+                i.next();
+                out.push_back( text::Posting( cursor.currLoc() , i.next().number() ) );
+                n++;
+                cursor.advance();
+            }
+            sort( out.begin() , out.end() );
+            return n;
+        }
+
+        const IndexDetails* getDetails() const {
+            return _spec->getDetails();
+        }
+
+        vector< pair<string,double> > _fields; // field, weight
+    };
+
+    class TextIndexPlugin : public IndexPlugin {
+    public:
+        TextIndexPlugin() : IndexPlugin( TEXTNAME ) {
+        }
+
+        virtual IndexType* generate( const IndexSpec* spec ) const {
+            return new TextIndex( this , spec );
+        }
+
+    } textIndexPlugin;
+
+    class TextSearchCommand : public Command {
+    public:
+        TextSearchCommand() : Command( "text" ) {}
+        virtual LockType locktype() const { return READ; }
+        bool slaveOk() const { return true; }
+        bool slaveOverrideOk() const { return true; }
+        virtual void help( stringstream &help ) const {
+            help << "{ text : 'collection name' , search : 'words' [ , filter : { query } ] [ , limit : 100 ] [ , explain : true ] }\n";
+            help << "documents with all the words, best tf-idf score first. needs a \"text\" index";
+        }
+        bool run(const string& dbname , BSONObj& cmdObj, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+
+            string ns = dbname + "." + cmdObj.firstElement().valuestr();
+
+            NamespaceDetails * d = nsdetails( ns.c_str() );
+            if ( ! d ) {
+                errmsg = "can't find ns";
+                return false;
+            }
+
+            vector<int> idxs;
+            d->findIndexByType( TEXTNAME , idxs );
+            if ( idxs.size() == 0 ) {
+                errmsg = "no text index";
+                return false;
+            }
+            if ( idxs.size() > 1 ) {
+                errmsg = "more than 1 text index";
+                return false;
+            }
+
+            int idxNum = idxs[0];
+
+            IndexDetails& id = d->idx( idxNum );
+            TextIndex * ti = (TextIndex*)id.getSpec().getType();
+            assert( &id == ti->getDetails() );
+
+            BSONElement search = cmdObj["search"];
+            uassert( 14070 , "search needs to be a string" , search.type() == String );
+
+            BSONObj filter;
+            if ( ! cmdObj["filter"].eoo() ) {
+                uassert( 14071 , "filter needs to be an object" , cmdObj["filter"].type() == Object );
+                filter = cmdObj["filter"].embeddedObject();
+            }
+
+            unsigned limit = 100;
+            if ( cmdObj["limit"].isNumber() )
+                limit = (unsigned)max( 0 , cmdObj["limit"].numberInt() );
+
+            ti->search( d , idxNum , search.valuestr() , filter , limit , cmdObj["explain"].trueValue() , result );
+            return true;
+        }
+
+    } textSearchCommand;
+
+    struct TextUnitTest : public UnitTest {
+        string stemmed( const char * w ) {
+            string s = w;
+            text::stem( s );
+            return s;
+        }
+
+        void run() {
+            assert( stemmed( "caresses" ) == "caress" );
+            assert( stemmed( "ponies" ) == "poni" );
+            assert( stemmed( "pony" ) == "poni" );
+            assert( stemmed( "cats" ) == "cat" );
+            assert( stemmed( "agreed" ) == "agree" );
+            assert( stemmed( "running" ) == "run" );
+            assert( stemmed( "hoped" ) == "hope" );
+            assert( stemmed( "hopping" ) == "hop" );
+            assert( stemmed( "falling" ) == "fall" );
+            assert( stemmed( "conflated" ) == "conflate" );
+            assert( stemmed( "sing" ) == "sing" );
+            assert( stemmed( "x2s" ) == "x2s" );
+
+            vector<string> t;
+            text::tokenize( "The Quick, brown-cats; jumped over 2 lazy dogs! caf\xc3\xa9" , t );
+            assert( t.size() == 9 );
+            assert( t[0] == "quick" );
+            assert( t[2] == "cat" );
+            assert( t[3] == "jump" );
+            assert( t[5] == "2" );
+            assert( t[6] == "lazi" );
+            assert( t[8] == "caf\xc3\xa9" );
+        }
+    } textUnitTest;
+
+}
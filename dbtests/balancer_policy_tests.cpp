@@ -19,19 +19,22 @@
 #include "pch.h"
 #include "dbtests.h"
 
-// TODO SERVER-1822
-//#include "../s/config.h" // for ShardFields
-//#include "../s/balancer_policy.h"
+#include "../s/config.h" // for ShardFields
+#include "../s/balancer_policy.h"
 
 namespace BalancerPolicyTests {
 
-//
-// TODO SERVER-1822
-//
-#if 0
-
     typedef mongo::ShardFields sf;  // fields from 'shards' colleciton
     typedef mongo::LimitsFields lf; // fields from the balancer's limits map
+    typedef mongo::StatsFields stf; // fields from the balancer's stats map
+
+    /** n chunks of { x : 1 } starting at 'from' */
+    vector<BSONObj> makeChunks( int from , int n ) {
+        vector<BSONObj> chunks;
+        for ( int i=from; i<from+n; i++ )
+            chunks.push_back( BSON( "min" << BSON( "x" << i ) << "max" << BSON( "x" << i + 1 ) ) );
+        return chunks;
+    }
 
     class SizeMaxedShardTest {
     public:
@@ -179,10 +182,77 @@ namespace BalancerPolicyTests {
         }
     };
 
-//
-// TODO SERVER-1822
-//
-#endif // #if 0
+    class BalanceDataSizeTest {
+    public:
+        void run() {
+            // as many chunks on each shard, but shard1's are much bigger
+            BalancerPolicy::ShardToChunksMap chunkMap;
+            chunkMap["shard0"] = makeChunks( 0 , 4 );
+            chunkMap["shard1"] = makeChunks( 4 , 4 );
+
+            BalancerPolicy::ShardToLimitsMap limitsMap;
+            limitsMap["shard0"] = BSON( sf::maxSize(0LL) << lf::currSize(0LL) << sf::draining(false) << lf::hasOpsQueued(false) );
+            limitsMap["shard1"] = BSON( sf::maxSize(0LL) << lf::currSize(0LL) << sf::draining(false) << lf::hasOpsQueued(false) );
+
+            // chunk counts alone are balanced
+            BalancerPolicy::ChunkInfo* c = BalancerPolicy::balance( "ns", limitsMap, chunkMap, 1 );
+            ASSERT( ! c );
+
+            BalancerPolicy::ShardToStatsMap statsMap;
+            statsMap["shard0"] = BSON( stf::dataSize(1000LL) << stf::ops(0LL) );
+            statsMap["shard1"] = BSON( stf::dataSize(10000LL) << stf::ops(0LL) );
+
+            c = BalancerPolicy::balance( "ns", limitsMap, chunkMap, statsMap, 1 );
+            ASSERT( c );
+            ASSERT_EQUALS( c->from , "shard1" );
+            ASSERT_EQUALS( c->to , "shard0" );
+            delete c;
+        }
+    };
+
+    class BalanceOpsTest {
+    public:
+        void run() {
+            // as much data on each shard, but all the operations go to shard1.
+            // loads are 16/3 and 32/3 chunks, and a move takes 4/3, well within half the imbalance
+            BalancerPolicy::ShardToChunksMap chunkMap;
+            chunkMap["shard0"] = makeChunks( 0 , 8 );
+            chunkMap["shard1"] = makeChunks( 8 , 8 );
+
+            BalancerPolicy::ShardToLimitsMap limitsMap;
+            limitsMap["shard0"] = BSON( sf::maxSize(0LL) << lf::currSize(0LL) << sf::draining(false) << lf::hasOpsQueued(false) );
+            limitsMap["shard1"] = BSON( sf::maxSize(0LL) << lf::currSize(0LL) << sf::draining(false) << lf::hasOpsQueued(false) );
+
+            BalancerPolicy::ShardToStatsMap statsMap;
+            statsMap["shard0"] = BSON( stf::dataSize(1000LL) << stf::ops(0LL) );
+            statsMap["shard1"] = BSON( stf::dataSize(1000LL) << stf::ops(800LL) );
+
+            BalancerPolicy::ChunkInfo* c = BalancerPolicy::balance( "ns", limitsMap, chunkMap, statsMap, 1 );
+            ASSERT( c );
+            ASSERT_EQUALS( c->from , "shard1" );
+            ASSERT_EQUALS( c->to , "shard0" );
+            delete c;
+        }
+    };
+
+    class BalanceOvershootTest {
+    public:
+        void run() {
+            // shard0's single chunk is the hot one; moving it would just make another shard the hot one
+            BalancerPolicy::ShardToChunksMap chunkMap;
+            BalancerPolicy::ShardToLimitsMap limitsMap;
+            BalancerPolicy::ShardToStatsMap statsMap;
+            for ( int i=0; i<4; i++ ) {
+                string shard = str::stream() << "shard" << i;
+                chunkMap[shard] = makeChunks( i , 1 );
+                limitsMap[shard] = BSON( sf::maxSize(0LL) << lf::currSize(0LL) << sf::draining(false) << lf::hasOpsQueued(false) );
+                statsMap[shard] = BSON( stf::dataSize(1000LL) << stf::ops( i == 0 ? 10000LL : 0LL ) );
+            }
+
+            BalancerPolicy::ChunkInfo* c = BalancerPolicy::balance( "ns", limitsMap, chunkMap, statsMap, 1 );
+            ASSERT( ! c );
+        }
+    };
 
     class All : public Suite {
     public:
@@ -190,13 +260,15 @@ namespace BalancerPolicyTests {
         }
 
         void setupTests() {
-            // TODO SERVER-1822
-            // add< SizeMaxedShardTest >();
-            // add< DrainingShardTest >();
-            // add< BalanceNormalTest >();
-            // add< BalanceDrainingTest >();
-            // add< BalanceEndedDrainingTest >();
-            // add< BalanceImpasseTest >();
+            add< SizeMaxedShardTest >();
+            add< DrainingShardTest >();
+            add< BalanceNormalTest >();
+            add< BalanceDrainingTest >();
+            add< BalanceEndedDrainingTest >();
+            add< BalanceImpasseTest >();
+            add< BalanceDataSizeTest >();
+            add< BalanceOpsTest >();
+            add< BalanceOvershootTest >();
         }
     } allTests;
 
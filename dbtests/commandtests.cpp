@@ -84,6 +84,186 @@ namespace CommandTests {
         };
     }
 
+    namespace Group {
+        struct NativeReduce {
+            NativeReduce() { db.dropCollection( ns() ); }
+            ~NativeReduce() { db.dropCollection( ns() ); }
+            const char* ns() { return "test.group_native"; }
+
+            void run() {
+                db.insert( ns() , BSON( "k" << 1 << "price" << 5 ) );
+                db.insert( ns() , BSON( "k" << 1 << "price" << 3 ) );
+                db.insert( ns() , BSON( "k" << 2 << "price" << 7 ) );
+                db.insert( ns() , BSON( "k" << 2 ) );
+
+                BSONObj reduce = BSON( "n" << BSON( "$count" << 1 ) <<
+                                       "total" << BSON( "$sum" << "price" ) <<
+                                       "lo" << BSON( "$min" << "price" ) <<
+                                       "hi" << BSON( "$max" << "price" ) );
+                BSONObj cmd = BSON( "group" << BSON( "ns" << "group_native" <<
+                                                     "key" << BSON( "k" << 1 ) <<
+                                                     "$reduce" << reduce <<
+                                                     "initial" << BSON( "tag" << "x" ) ) );
+                BSONObj result;
+                ASSERT( db.runCommand( "test" , cmd , result ) );
+                ASSERT_EQUALS( 4 , result["count"].number() );
+                ASSERT_EQUALS( 2 , result["keys"].numberInt() );
+
+                vector<BSONElement> groups = result["retval"].Array();
+                ASSERT_EQUALS( 2U , groups.size() );
+                ASSERT_EQUALS( BSON( "k" << 1 << "tag" << "x" << "n" << 2 << "total" << 8 << "lo" << 3 << "hi" << 5 ) ,
+                               groups[0].Obj() );
+                ASSERT_EQUALS( BSON( "k" << 2 << "tag" << "x" << "n" << 2 << "total" << 7 << "lo" << 7 << "hi" << 7 ) ,
+                               groups[1].Obj() );
+                // all ints in, ints out
+                ASSERT_EQUALS( NumberInt , groups[0].Obj()["n"].type() );
+                ASSERT_EQUALS( NumberInt , groups[0].Obj()["total"].type() );
+
+                BSONObj bad = BSON( "group" << BSON( "ns" << "group_native" <<
+                                                     "key" << BSON( "k" << 1 ) <<
+                                                     "$reduce" << BSON( "n" << BSON( "$avg" << "price" ) ) ) );
+                ASSERT( ! db.runCommand( "test" , bad , result ) );
+            }
+
+            DBDirectClient db;
+        };
+
+        /** a native $reduce gives what the same reduce in javascript does, starting from initial */
+        struct NativeMatchesJS {
+            NativeMatchesJS() { db.dropCollection( ns() ); }
+            ~NativeMatchesJS() { db.dropCollection( ns() ); }
+            const char* ns() { return "test.group_native_js"; }
+
+            BSONObj group( const BSONElement& reduce ) {
+                BSONObjBuilder b;
+                b.append( "ns" , "group_native_js" );
+                b.append( "key" , BSON( "k" << 1 ) );
+                b.appendAs( reduce , "$reduce" );
+                b.append( "initial" , BSON( "n" << 10 << "total" << 0.5 << "big" << 0 << "lo" << 100 << "hi" << -1 ) );
+                BSONObj result;
+                ASSERT( db.runCommand( "test" , BSON( "group" << b.obj() ) , result ) );
+                return result;
+            }
+
+            void run() {
+                db.insert( ns() , BSON( "k" << 1 << "price" << 5 << "big" << 2000000000 ) );
+                db.insert( ns() , BSON( "k" << 1 << "price" << 3 << "big" << 2000000000 ) );
+                db.insert( ns() , BSON( "k" << 2 << "price" << 7 << "big" << 1 ) );
+                db.insert( ns() , BSON( "k" << 3 ) );
+
+                BSONObj native = group( BSON( "r" << BSON( "n" << BSON( "$count" << 1 ) <<
+                                                           "total" << BSON( "$sum" << "price" ) <<
+                                                           "big" << BSON( "$sum" << "big" ) <<
+                                                           "lo" << BSON( "$min" << "price" ) <<
+                                                           "hi" << BSON( "$max" << "price" ) ) ).firstElement() );
+                BSONObjBuilder code;
+                code.appendCode( "r" , "function( obj , prev ){ "
+                                 "  prev.n++; "
+                                 "  if ( obj.price != null ){ "
+                                 "    prev.total += obj.price; "
+                                 "    prev.lo = Math.min( prev.lo , obj.price ); "
+                                 "    prev.hi = Math.max( prev.hi , obj.price ); "
+                                 "  } "
+                                 "  if ( obj.big != null ) "
+                                 "    prev.big += obj.big; "
+                                 "}" );
+                BSONObj js = group( code.obj().firstElement() );
+
+                ASSERT_EQUALS( js["count"].number() , native["count"].number() );
+                vector<BSONElement> n = native["retval"].Array();
+                vector<BSONElement> j = js["retval"].Array();
+                ASSERT_EQUALS( 3U , n.size() );
+                ASSERT_EQUALS( j.size() , n.size() );
+                const char * fields[] = { "k" , "n" , "total" , "big" , "lo" , "hi" };
+                for ( unsigned i=0; i<n.size(); i++ ) {
+                    for ( unsigned f=0; f<sizeof( fields ) / sizeof( fields[0] ); f++ ) {
+                        BSONElement a = n[i].Obj()[ fields[f] ];
+                        BSONElement b = j[i].Obj()[ fields[f] ];
+                        ASSERT( a.isNumber() );
+                        ASSERT_EQUALS( 0 , a.woCompare( b , false ) );
+                    }
+                }
+
+                BSONObj first = n[0].Obj();
+                ASSERT_EQUALS( 12 , first["n"].number() );
+                ASSERT_EQUALS( NumberInt , first["n"].type() );
+                ASSERT_EQUALS( NumberDouble , first["total"].type() );
+                ASSERT_EQUALS( NumberLong , first["big"].type() );
+                ASSERT_EQUALS( 4000000000LL , first["big"].numberLong() );
+                ASSERT_EQUALS( NumberInt , n[1].Obj()["big"].type() );
+                // nothing to compare, so the initial values stay
+                ASSERT_EQUALS( 100 , n[2].Obj()["lo"].number() );
+                ASSERT_EQUALS( -1 , n[2].Obj()["hi"].number() );
+            }
+
+            DBDirectClient db;
+        };
+
+        /** a native $reduce lays out its groups and their fields as javascript does, initial winning over key */
+        struct NativeLayoutMatchesJS {
+            NativeLayoutMatchesJS() { db.dropCollection( ns() ); }
+            ~NativeLayoutMatchesJS() { db.dropCollection( ns() ); }
+            const char* ns() { return "test.group_native_layout"; }
+
+            BSONObj group( const BSONElement& reduce , const BSONObj& initial ) {
+                BSONObjBuilder b;
+                b.append( "ns" , "group_native_layout" );
+                b.append( "key" , BSON( "k" << 1 << "j" << 1 ) );
+                b.appendAs( reduce , "$reduce" );
+                b.append( "initial" , initial );
+                BSONObj result;
+                db.runCommand( "test" , BSON( "group" << b.obj() ) , result );
+                return result;
+            }
+
+            void run() {
+                // keys are first seen out of their sort order
+                db.insert( ns() , BSON( "k" << 3 << "j" << "c" ) );
+                db.insert( ns() , BSON( "k" << 1 << "j" << "a" ) );
+                db.insert( ns() , BSON( "k" << 2 << "j" << "b" ) );
+                db.insert( ns() , BSON( "k" << 1 << "j" << "a" ) );
+
+                BSONObj initial = BSON( "tag" << "x" << "j" << "i" << "n" << 0 );
+                BSONObj native = group( BSON( "r" << BSON( "total" << BSON( "$sum" << "k" ) <<
+                                                           "n" << BSON( "$count" << 1 ) ) ).firstElement() , initial );
+                BSONObjBuilder code;
+                code.appendCode( "r" , "function( obj , prev ){ "
+                                 "  prev.n++; "
+                                 "  prev.total = ( prev.total || 0 ) + obj.k; "
+                                 "}" );
+                BSONObj js = group( code.obj().firstElement() , initial );
+                ASSERT( native["ok"].trueValue() );
+                ASSERT( js["ok"].trueValue() );
+
+                vector<BSONElement> n = native["retval"].Array();
+                vector<BSONElement> j = js["retval"].Array();
+                ASSERT_EQUALS( 3U , n.size() );
+                ASSERT_EQUALS( j.size() , n.size() );
+                for ( unsigned i=0; i<n.size(); i++ ) {
+                    BSONObjIterator a( n[i].Obj() );
+                    BSONObjIterator b( j[i].Obj() );
+                    while ( a.more() && b.more() ) {
+                        BSONElement x = a.next();
+                        BSONElement y = b.next();
+                        ASSERT_EQUALS( string( y.fieldName() ) , string( x.fieldName() ) );
+                        ASSERT_EQUALS( 0 , x.woCompare( y , false ) );
+                    }
+                    ASSERT( ! a.more() && ! b.more() );
+                }
+
+                ASSERT_EQUALS( BSON( "k" << 3 << "j" << "i" << "tag" << "x" << "n" << 1 << "total" << 3 ) , n[0].Obj() );
+                ASSERT_EQUALS( BSON( "k" << 1 << "j" << "i" << "tag" << "x" << "n" << 2 << "total" << 2 ) , n[1].Obj() );
+
+                // javascript would append to a string, so a native count can't start from one
+                BSONObj bad = group( BSON( "r" << BSON( "n" << BSON( "$count" << 1 ) ) ).firstElement() ,
+                                     BSON( "n" << "0" ) );
+                ASSERT( ! bad["ok"].trueValue() );
+            }
+
+            DBDirectClient db;
+        };
+    }
+
     class All : public Suite {
     public:
         All() : Suite( "commands" ) {
@@ -92,6 +272,9 @@ namespace CommandTests {
         void setupTests() {
             add< FileMD5::Type0 >();
             add< FileMD5::Type2 >();
+            add< Group::NativeReduce >();
+            add< Group::NativeMatchesJS >();
+            add< Group::NativeLayoutMatchesJS >();
         }
 
     } all;
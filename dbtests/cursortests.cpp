@@ -249,6 +249,87 @@ namespace CursorTests {
 
     } // namespace BtreeCursorTests
 
+    namespace BatchedBasicCursorTests {
+
+        class FilterBasics {
+        public:
+            void run() {
+                ScanFilter f( fromjson( "{a:3,b:{$gt:5,$lte:10},c:'x',d:{e:1},'f.g':1,$where:'1'}" ) );
+                ASSERT( !f.empty() );
+                ASSERT( f.mayMatch( fromjson( "{a:3,b:6}" ) ) );
+                ASSERT( f.mayMatch( fromjson( "{a:3.0,b:10}" ) ) );
+                ASSERT( !f.mayMatch( fromjson( "{a:3,b:5}" ) ) );
+                ASSERT( !f.mayMatch( fromjson( "{a:3,b:11}" ) ) );
+                ASSERT( !f.mayMatch( fromjson( "{a:4,b:6}" ) ) );
+                ASSERT( !f.mayMatch( fromjson( "{b:6}" ) ) );
+                ASSERT( !f.mayMatch( fromjson( "{a:'3',b:6}" ) ) );
+                // arrays are left to the matcher
+                ASSERT( f.mayMatch( fromjson( "{a:[1,2],b:6}" ) ) );
+                ASSERT( ScanFilter( fromjson( "{c:'x',d:{e:1},'f.g':1,h:{$ne:1},i:{$in:[1]}}" ) ).empty() );
+            }
+        };
+
+        class FilterLongs {
+        public:
+            void run() {
+                ScanFilter f( BSON( "a" << GT << 9007199254740992LL ) );
+                // 2^53+1 rounds to 2^53 as a double, but does satisfy the condition
+                ASSERT( f.mayMatch( BSON( "a" << 9007199254740993LL ) ) );
+                ASSERT( !f.mayMatch( BSON( "a" << 9007199254740990LL ) ) );
+            }
+        };
+
+        class Scan {
+        public:
+            ~Scan() { _c.dropCollection( ns() ); }
+            void run() {
+                for( int i = 0; i < 5000; ++i )
+                    _c.insert( ns(), BSON( "a" << i % 100 << "b" << i ) );
+                BSONObj query = BSON( "a" << GTE << 90 << "b" << LT << 4000 );
+                Client::Context ctx( ns() );
+                shared_ptr< Cursor > c = findTableScan( ns(), BSONObj(), DiskLoc(), query );
+                ASSERT_EQUALS( "BasicCursor", c->toString() );
+                Matcher m( query );
+                int count = 0;
+                for( ; c->ok(); c->advance() ) {
+                    if ( m.matches( c->current() ) )
+                        ++count;
+                }
+                ASSERT_EQUALS( 400, count );
+                ASSERT_EQUALS( 5000, c->nscanned() );
+            }
+        private:
+            static const char *ns() { return "unittests.cursortests.BatchedBasicCursor"; }
+            dblock _lk;
+            DBDirectClient _c;
+        };
+
+        class ScanNumWanted {
+        public:
+            ~ScanNumWanted() { _c.dropCollection( ns() ); }
+            void run() {
+                for( int i = 0; i < 5000; ++i )
+                    _c.insert( ns(), BSON( "a" << i ) );
+                BSONObj query = BSON( "a" << GTE << 10 );
+                Client::Context ctx( ns() );
+                shared_ptr< Cursor > c = findTableScan( ns(), BSONObj(), DiskLoc(), query, 1 );
+                ASSERT( c->ok() );
+                ASSERT_EQUALS( 10, c->current()[ "a" ].number() );
+                // the first ten records and the one matching, not a whole batch
+                ASSERT_EQUALS( 11, c->nscanned() );
+                ASSERT( c->advance() );
+                ASSERT_EQUALS( 12, c->nscanned() );
+                while( c->advance() );
+                ASSERT_EQUALS( 5000, c->nscanned() );
+            }
+        private:
+            static const char *ns() { return "unittests.cursortests.BatchedBasicCursorNumWanted"; }
+            dblock _lk;
+            DBDirectClient _c;
+        };
+
+    } // namespace BatchedBasicCursorTests
+
     class All : public Suite {
     public:
         All() : Suite( "cursor" ) {}
@@ -262,6 +343,10 @@ namespace CursorTests {
             add< BtreeCursorTests::EqIn >();
             add< BtreeCursorTests::RangeEq >();
             add< BtreeCursorTests::RangeIn >();
+            add< BatchedBasicCursorTests::FilterBasics >();
+            add< BatchedBasicCursorTests::FilterLongs >();
+            add< BatchedBasicCursorTests::Scan >();
+            add< BatchedBasicCursorTests::ScanNumWanted >();
         }
     } myall;
 } // namespace CursorTests
@@ -19,6 +19,7 @@
 #include "pch.h"
 #include "dbtests.h"
 
+#include "../db/hasher.h"
 #include "../s/d_chunk_manager.h"
 
 namespace {
@@ -443,6 +444,94 @@ namespace {
         }
     };
 
+    /** a config.chunks entry for collection test.foo, key 'a' */
+    static BSONObj chunkDoc( int min , int max , const string& shard , ShardChunkVersion version ) {
+        BSONObjBuilder b;
+        b.append( "ns" , "test.foo" );
+        b.append( "min" , BSON( "a" << min ) );
+        b.append( "max" , BSON( "a" << max ) );
+        b.append( "shard" , shard );
+        b.appendTimestamp( "lastmod" , version.toLong() );
+        return b.obj();
+    }
+
+    class CloneWithChangesTests {
+    public:
+        void run() {
+            BSONObj collection = BSON( "_id"     << "test.foo" <<
+                                       "dropped" << false <<
+                                       "key"     << BSON( "a" << 1 ) <<
+                                       "unique"  << false  );
+
+            // [0->10) [10->20) on shard0
+            BSONArray chunks = BSON_ARRAY( chunkDoc( 0 , 10 , "shard0" , ShardChunkVersion( 1 , 0 ) ) <<
+                                           chunkDoc( 10 , 20 , "shard0" , ShardChunkVersion( 1 , 1 ) ) );
+            ShardChunkManager s( collection , chunks );
+            ASSERT_EQUALS( s.getVersion() , ShardChunkVersion( 1 , 1 ) );
+            ASSERT_EQUALS( s.getCollectionVersion() , ShardChunkVersion( 1 , 1 ) );
+
+            // [10->20) splits, [15->20) moves to shard1, [30->40) comes over from shard1 and shard1 splits [50->70)
+            BSONArray changes = BSON_ARRAY( chunkDoc( 10 , 15 , "shard0" , ShardChunkVersion( 2 , 0 ) ) <<
+                                            chunkDoc( 15 , 20 , "shard0" , ShardChunkVersion( 2 , 1 ) ) <<
+                                            chunkDoc( 15 , 20 , "shard1" , ShardChunkVersion( 3 , 0 ) ) <<
+                                            chunkDoc( 0 , 10 , "shard0" , ShardChunkVersion( 3 , 1 ) ) <<
+                                            chunkDoc( 30 , 40 , "shard0" , ShardChunkVersion( 4 , 0 ) ) <<
+                                            chunkDoc( 50 , 60 , "shard1" , ShardChunkVersion( 4 , 1 ) ) <<
+                                            chunkDoc( 60 , 70 , "shard1" , ShardChunkVersion( 4 , 2 ) ) );
+            ShardChunkManagerPtr refreshed( s.cloneWithChanges( changes , "shard0" ) );
+            ASSERT_EQUALS( refreshed->getVersion() , ShardChunkVersion( 4 , 0 ) );
+            ASSERT_EQUALS( refreshed->getCollectionVersion() , ShardChunkVersion( 4 , 2 ) );
+            ASSERT_EQUALS( refreshed->getNumChunks() , 3u );
+            ASSERT( refreshed->belongsToMe( BSON( "a" << 5 ) ) );
+            ASSERT( refreshed->belongsToMe( BSON( "a" << 12 ) ) );
+            ASSERT( ! refreshed->belongsToMe( BSON( "a" << 17 ) ) );
+            ASSERT( ! refreshed->belongsToMe( BSON( "a" << 25 ) ) );
+            ASSERT( refreshed->belongsToMe( BSON( "a" << 35 ) ) );
+            ASSERT( ! refreshed->belongsToMe( BSON( "a" << 55 ) ) );
+
+            // the original manager is left as it was
+            ASSERT_EQUALS( s.getNumChunks() , 2u );
+            ASSERT( s.belongsToMe( BSON( "a" << 17 ) ) );
+
+            // nothing changed
+            ShardChunkManagerPtr same( refreshed->cloneWithChanges( BSONArray() , "shard0" ) );
+            ASSERT_EQUALS( same->getVersion() , refreshed->getVersion() );
+            ASSERT_EQUALS( same->getNumChunks() , 3u );
+
+            // everything moved away
+            BSONArray away = BSON_ARRAY( chunkDoc( 0 , 15 , "shard1" , ShardChunkVersion( 5 , 0 ) ) <<
+                                         chunkDoc( 30 , 40 , "shard1" , ShardChunkVersion( 6 , 0 ) ) );
+            ShardChunkManagerPtr empty( refreshed->cloneWithChanges( away , "shard0" ) );
+            ASSERT_EQUALS( empty->getVersion() , ShardChunkVersion( 0 ) );
+            ASSERT_EQUALS( empty->getCollectionVersion() , ShardChunkVersion( 6 , 0 ) );
+            ASSERT_EQUALS( empty->getNumChunks() , 0u );
+        }
+    };
+
+    class HashedTests {
+    public:
+        void run() {
+            BSONObj collection = BSON( "_id"     << "test.foo" <<
+                                       "dropped" << false <<
+                                       "key"     << BSON( "a" << "hashed" ) <<
+                                       "unique"  << false );
+
+            // the chunks are ranges of hashes: [hash(5)->MaxKey)
+            long long h = BSONElementHasher::hash64( BSON( "a" << 5 ).firstElement() );
+            BSONArray chunks = BSON_ARRAY( BSON( "_id" << "test.foo-a_5" <<
+                                                 "ns"  << "test.foo" <<
+                                                 "min" << BSON( "a" << h ) <<
+                                                 "max" << BSON( "a" << MAXKEY ) ) );
+
+            ShardChunkManager s ( collection , chunks );
+
+            ASSERT( s.belongsToMe( BSON( "a" << 5 << "b" << 1 ) ) );
+            ASSERT( s.belongsToMe( BSON( "a" << 5.0 ) ) );
+            ASSERT( s.belongsToMe( BSON( "a" << 5LL ) ) );
+            ASSERT_EQUALS( s.belongsToMe( BSON( "a" << 6 ) ) , BSONElementHasher::hash64( BSON( "a" << 6 ).firstElement() ) >= h );
+        }
+    };
+
     class ShardChunkManagerSuite : public Suite {
     public:
         ShardChunkManagerSuite() : Suite ( "shard_chunk_manager" ) {}
@@ -461,6 +550,8 @@ namespace {
             add< CloneSplitExceptionTests >();
             add< EmptyShardTests >();
             add< LastChunkTests >();
+            add< CloneWithChangesTests >();
+            add< HashedTests >();
         }
     } shardChunkManagerSuite;
 
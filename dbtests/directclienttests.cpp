@@ -69,12 +69,42 @@ namespace DirectClientTests {
         }
     };
 
+    class InsertContinueOnError : public ClientBase {
+    public:
+        virtual void run() {
+            client().dropCollection( ns );
+            client().insert( ns, BSON( "_id" << 2 ) );
+            ASSERT( !error() );
+
+            for( int pass = 0; pass < 2; pass++ ) {
+                int flags = pass ? InsertOption_ContinueOnError : 0;
+                BufBuilder b;
+                b.appendNum( flags );
+                b.appendStr( ns );
+                for( int i = 1; i <= 3; i++ )
+                    BSON( "_id" << i << "pass" << pass ).appendSelfToBufBuilder( b );
+                Message toSend;
+                toSend.setData( dbInsert, b.buf(), b.len() );
+                client().say( toSend );
+
+                // the duplicate is the error either way, but only with the flag does { _id : 3 } go in
+                ASSERT( error() );
+                ASSERT_EQUALS( 11000, client().getPrevError().getIntField( "code" ) );
+                ASSERT_EQUALS( pass ? 3U : 2U, client().count( ns ) );
+                client().remove( ns, BSON( "_id" << NE << 2 ) );
+            }
+
+            client().dropCollection( ns );
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "directclient" ) {
         }
         void setupTests() {
             add< Capped >();
+            add< InsertContinueOnError >();
         }
     } myall;
 }
@@ -1762,6 +1762,49 @@ namespace JsobjTests {
         }
     };
 
+    class FieldIndexTest {
+    public:
+        void run() {
+            BSONObjBuilder b;
+            for ( int i = 0; i < 150; i++ )
+                b.append( string( "field" ) + BSONObjBuilder::numStr( i % 100 ) + ( i >= 100 ? "x" : "" ), i );
+            b.append( "field7", -1 ); // duplicate name: first one wins
+            BSONObj x = b.obj();
+
+            BSONFieldIndex idx( x );
+            ASSERT( idx.covers( x ) );
+            ASSERT_EQUALS( x.nFields(), idx.nFields() );
+            ASSERT_EQUALS( 7, idx.getField( "field7" ).numberInt() );
+            ASSERT_EQUALS( 7, x.getField( "field7" ).numberInt() );
+            ASSERT_EQUALS( 120, idx.getField( "field20x" ).numberInt() );
+            ASSERT_EQUALS( 2, idx.getField( "field2x", 6 ).numberInt() );
+            ASSERT( idx.getField( "field" ).eoo() );
+            ASSERT( idx.getField( "" ).eoo() );
+            ASSERT( !idx.covers( BSON( "field7" << 7 ) ) );
+
+            int N = 20000;
+            const char *names[] = { "field3", "field50", "field99", "field49x", "missing" };
+            long long total = 0;
+            {
+                Timer t;
+                for ( int i=0; i<N; i++ )
+                    for ( int j=0; j<5; j++ )
+                        total += x.getField( names[j] ).type();
+                cout << "getField wide : " << t.millis() << endl;
+            }
+            {
+                Timer t;
+                for ( int i=0; i<N; i++ ) {
+                    idx.reset( x );
+                    for ( int j=0; j<5; j++ )
+                        total -= idx.getField( names[j] ).type();
+                }
+                cout << "BSONFieldIndex wide : " << t.millis() << endl;
+            }
+            ASSERT_EQUALS( 0, total );
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "jsobj" ) {
@@ -1872,6 +1915,7 @@ namespace JsobjTests {
             add< StringDataTest >();
             add< CompareOps >();
             add< HashingTest >();
+            add< FieldIndexTest >();
         }
     } myall;
 
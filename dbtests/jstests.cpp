@@ -962,6 +962,45 @@ namespace JSTests {
         }
     };
 
+    class FunctionCache {
+    public:
+        void run() {
+            auto_ptr<Scope> s;
+            s.reset( globalScriptEngine->newScope() );
+
+            ScriptingFunction f = s->createFunction( "function( z ){ return z + 1; }" );
+            ASSERT( f );
+            ASSERT( f == s->createFunction( "function( z ){ return z + 1; }" ) );
+            ASSERT( f != s->createFunction( "function( z ){ return z + 2; }" ) );
+
+            BSONObjBuilder b;
+            Scope::appendFunctionCacheStats( b );
+            BSONObj before = b.obj();
+
+            // fills the cache, so f is the least recently used and gets released
+            for ( int i=0; i<Scope::MaxCachedFunctions; i++ )
+                s->createFunction( ( string( "function(){ return " ) + BSONObjBuilder::numStr( i ) + "; }" ).c_str() );
+
+            BSONObjBuilder a;
+            Scope::appendFunctionCacheStats( a );
+            BSONObj after = a.obj();
+            ASSERT( after["evictions"].numberLong() > before["evictions"].numberLong() );
+            ASSERT_EQUALS( before["misses"].numberLong() + Scope::MaxCachedFunctions , after["misses"].numberLong() );
+
+            // dropped from the cache, but whoever has f can still call it until the scope is done with
+            s->invokeSafe( f , BSON( "" << 2 ) );
+            ASSERT_EQUALS( 3 , s->getNumber( "return" ) );
+            s->releaseRetiredFunctions();
+
+            // the newest are still there, and f compiles again
+            ScriptingFunction g = s->createFunction( "function(){ return 7; }" );
+            s->invokeSafe( g , BSONObj() );
+            ASSERT_EQUALS( 7 , s->getNumber( "return" ) );
+            ScriptingFunction h = s->createFunction( "function( z ){ return z + 1; }" );
+            s->invokeSafe( h , BSON( "" << 2 ) );
+            ASSERT_EQUALS( 3 , s->getNumber( "return" ) );
+        }
+    };
 
     class All : public Suite {
     public:
@@ -986,6 +1025,7 @@ namespace JSTests {
             add< NumberLong >();
             add< NumberLong2 >();
             add< RenameTest >();
+            add< FunctionCache >();
 
             add< WeirdObjects >();
             add< CodeTests >();
@@ -120,6 +120,48 @@ namespace MatcherTests {
     };
 
 
+    /** basics run cheapest kinds first; results must not depend on the order */
+    class BasicsOrder {
+    public:
+        void run() {
+            Matcher m( fromjson( "{a:1,b:{$gt:5},'c.d':'x'}" ) );
+            for ( int i = 0; i < 1000; i++ ) {
+                BSONObj o = BSON( "a" << 1 << "b" << i % 10 << "c" << BSON( "d" << ( i % 3 ? "x" : "y" ) ) );
+                ASSERT_EQUALS( i % 10 > 5 && i % 3 != 0, m.matches( o ) );
+            }
+            MatchDetails details;
+            ASSERT( !m.matches( fromjson( "{a:1,b:4,c:{d:'x'}}" ), &details ) );
+            ASSERT( m.matches( fromjson( "{a:1,b:[4,7],c:{d:'x'}}" ), &details ) );
+            ASSERT_EQUALS( string( "1" ), details.elemMatchKey );
+
+            // one Matcher used on documents in turn, as across yields, keeps nothing from the last one
+            Matcher w( fromjson( "{a:{$ne:3},b:{$exists:true},c:{$gte:2},d:'x',e:{$in:[1,2]}}" ) );
+            BSONObj yes = fromjson( "{e:2,d:'x',c:5,b:null,a:1}" );
+            BSONObj no = fromjson( "{e:2,d:'x',c:5,b:null,a:3}" );
+            for ( int i = 0; i < 300; i++ ) {
+                ASSERT( w.matches( yes ) );
+                ASSERT( !w.matches( no ) );
+            }
+        }
+    };
+
+    class NumericCompare {
+    public:
+        void run() {
+            Matcher m( fromjson( "{a:{$lt:5}}" ) );
+            ASSERT( m.matches( BSON( "a" << 4 ) ) );
+            ASSERT( m.matches( BSON( "a" << 4.5 ) ) );
+            ASSERT( m.matches( BSON( "a" << 4LL ) ) );
+            ASSERT( !m.matches( BSON( "a" << 5 ) ) );
+            ASSERT( !m.matches( BSON( "a" << "4" ) ) );
+            // NaN sorts before all numbers
+            ASSERT( m.matches( BSON( "a" << numeric_limits< double >::quiet_NaN() ) ) );
+            Matcher l( BSON( "a" << 9007199254740993LL ) );
+            ASSERT( l.matches( BSON( "a" << 9007199254740993LL ) ) );
+            ASSERT( !l.matches( BSON( "a" << 9007199254740992LL ) ) );
+        }
+    };
+
     class TimingBase {
     public:
         long time( const BSONObj& patt , const BSONObj& obj ) {
@@ -142,6 +184,25 @@ namespace MatcherTests {
         }
     };
 
+    /** a full scan style workload: several predicates against wide documents */
+    class WideTiming : public TimingBase {
+    public:
+        void run() {
+            BSONObjBuilder b;
+            for ( int i = 0; i < 100; i++ )
+                b.append( BSONObjBuilder::numStr( i ) , i );
+            b.append( "x", BSON( "y" << 5 << "z" << "abc" ) );
+            b.append( "last", 7.5 );
+            BSONObj obj = b.obj();
+
+            long numeric = time( BSON( "50" << GTE << 50 << "last" << LT << 8 ) , obj );
+            long dotted = time( BSON( "x.y" << 5 << "x.z" << "abc" ) , obj );
+            long regex = time( fromjson( "{'x.z':/^ab/,'99':99}" ) , obj );
+
+            cout << "wide numeric: " << numeric << " dotted: " << dotted << " regex: " << regex << endl;
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "matcher" ) {
@@ -155,7 +216,10 @@ namespace MatcherTests {
             add< MixedNumericIN >();
             add< Size >();
             add< MixedNumericEmbedded >();
+            add< BasicsOrder >();
+            add< NumericCompare >();
             add< AllTiming >();
+            add< WideTiming >();
         }
     } dball;
 
@@ -149,6 +149,10 @@ namespace PerfTests {
         virtual const char * timed2() { return 0; }
 
         virtual void post() { }
+
+        // optional, e.g. latency percentiles, printed after the first timed phase
+        virtual void report() { }
+
         virtual string name() = 0;
         virtual unsigned long long expectation() = 0;
         virtual int howLongMillis() { return 5000; } // how long to run test
@@ -181,6 +185,7 @@ namespace PerfTests {
             client().getLastError(); // block until all ops are finished
             int ms = t.millis();
             say(n, ms, name());
+            report();
 
             if( n < expectation() ) {
                 cout << "\ntest " << name() << " seems slow n:" << n << " ops/sec but expect greater than:" << expectation() << endl;
@@ -318,6 +323,261 @@ namespace PerfTests {
         unsigned long long expectation() { return 1000; }
     };
 
+    /** unindexed count over a collection, mostly rejected by a numeric condition */
+    class TableScanCount : public B {
+    public:
+        string name() { return "table-scan-count"; }
+        void prep() {
+            for( int i = 0; i < 20000; i++ )
+                client().insert( ns(), BSON( "x" << i << "y" << i % 100 << "z" << "abcdefghijklmnopqrstuvwxyz" ) );
+        }
+        void timed() {
+            ASSERT( client().count( ns(), BSON( "y" << 7 << "x" << GT << 100 ) ) == 199 );
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 10; }
+    };
+
+    /** documents keep arriving and a map/reduce rolls them up, incrementally vs from scratch */
+    class RollingMapReduce : public B {
+    public:
+        RollingMapReduce() : _ts(0) {}
+        string name() { return "mr-incremental-rollup"; }
+        void prep() {
+            client().dropCollection( "perftest.mr_rollup" );
+            client().remove( "perftest.mr.marks" , BSONObj() );
+            for( int i = 0; i < 10000; i++ )
+                insertOne();
+        }
+        void timed() {
+            for( int i = 0; i < 10; i++ )
+                insertOne();
+            mapReduce( BSON( "reduce" << "mr_rollup" << "incremental" << "ts" ) );
+        }
+        const char * timed2() {
+            for( int i = 0; i < 10; i++ )
+                insertOne();
+            mapReduce( BSON( "replace" << "mr_rollup" ) );
+            return "mr-full-rollup";
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 20; }
+    private:
+        void insertOne() {
+            client().insert( ns() , BSON( "ts" << _ts << "k" << _ts % 100 << "v" << 1 ) );
+            _ts++;
+        }
+        void mapReduce( const BSONObj& out ) {
+            BSONObjBuilder cmd;
+            cmd.append( "mapreduce" , name() );
+            cmd.appendCode( "map" , "function(){ emit( this.k , this.v ); }" );
+            cmd.appendCode( "reduce" , "function( k , vs ){ return Array.sum( vs ); }" );
+            cmd.append( "out" , out );
+            BSONObj res;
+            ASSERT( client().runCommand( "perftest" , cmd.obj() , res ) );
+        }
+        long long _ts;
+    };
+
+    /** $where over wide documents that only looks at a couple of fields */
+    class WhereWide : public B {
+    public:
+        string name() { return "where-wide-docs"; }
+        void prep() {
+            for( int i = 0; i < 1000; i++ ) {
+                BSONObjBuilder b;
+                b.append( "x" , i );
+                for( int j = 0; j < 100; j++ )
+                    b.append( BSONObjBuilder::numStr( j ) , "some filler that is never read" );
+                client().insert( ns() , b.obj() );
+            }
+        }
+        void timed() {
+            ASSERT_EQUALS( 10U , client().count( ns() , BSON( "$where" << "this.x % 100 == 0" ) ) );
+        }
+        const char * timed2() {
+            client().count( ns() , BSON( "$where" << "return obj.x % 100 == 0" ) );
+            return "where-wide-docs-obj";
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 20; }
+    };
+
+    /** $near for the 100 nearest, and a $within circle, over points spread evenly */
+    class GeoNearUniform : public B {
+    public:
+        string name() { return "geo-near-uniform"; }
+        void prep() {
+            for( int i = 0; i < 50000; i++ )
+                client().insert( ns() , BSON( "loc" << point( i ) ) );
+            client().ensureIndex( ns() , BSON( "loc" << "2d" ) );
+        }
+        void timed() {
+            BSONObj q = BSON( "loc" << BSON( "$near" << BSON_ARRAY( 10 << 10 ) ) );
+            ASSERT_EQUALS( 100 , client().query( ns() , q , 100 )->itcount() );
+        }
+        const char * timed2() {
+            BSONObj q = BSON( "loc" << BSON( "$within" << BSON( "$center" << BSON_ARRAY( BSON_ARRAY( 10 << 10 ) << 5 ) ) ) );
+            client().query( ns() , q )->itcount();
+            return "geo-within-center";
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 50; }
+    protected:
+        virtual BSONArray point( int i ) {
+            return BSON_ARRAY( ( ( i * 7919 ) % 20000 ) / 100.0 - 100 << ( ( i * 104729LL ) % 20011 ) / 100.0 - 100 );
+        }
+    };
+
+    /** the same, with most points packed around the one searched from */
+    class GeoNearClustered : public GeoNearUniform {
+    public:
+        string name() { return "geo-near-clustered"; }
+        const char * timed2() {
+            GeoNearUniform::timed2();
+            return "geo-within-center-clustered";
+        }
+    protected:
+        virtual BSONArray point( int i ) {
+            if ( i % 5 == 0 )
+                return GeoNearUniform::point( i );
+            return BSON_ARRAY( 10 + ( ( i * 7919 ) % 1000 ) / 1000.0 << 10 + ( ( i * 104729LL ) % 1009 ) / 1000.0 );
+        }
+    };
+
+    /** $within a polygon of 2000 vertices */
+    class GeoWithinPolygon : public GeoNearUniform {
+    public:
+        string name() { return "geo-within-polygon"; }
+        void prep() {
+            GeoNearUniform::prep();
+            BSONArrayBuilder poly;
+            for( int i = 0; i < 2000; i++ ) {
+                double angle = 2 * M_PI * i / 2000;
+                double r = 20 + 8 * sin( 12 * angle );
+                poly.append( BSON_ARRAY( r * cos( angle ) << r * sin( angle ) ) );
+            }
+            _q = BSON( "loc" << BSON( "$within" << BSON( "$polygon" << poly.arr() ) ) );
+        }
+        void timed() {
+            ASSERT( client().query( ns() , _q )->itcount() > 0 );
+        }
+        const char * timed2() { return 0; }
+    private:
+        BSONObj _q;
+    };
+
+    /** geoSearch for one category near a point, with latency percentiles */
+    class HaystackSearch : public B {
+    public:
+        string name() { return "geo-haystack-search"; }
+        void prep() {
+            for( int i = 0; i < 50000; i++ ) {
+                double x = ( ( i * 7919 ) % 20000 ) / 200.0;
+                double y = ( ( i * 104729LL ) % 20011 ) / 200.0;
+                client().insert( ns() , BSON( "loc" << BSON_ARRAY( x << y ) << "type" << i % 20 ) );
+            }
+            // by hand, for the options
+            BSONObjBuilder b;
+            b.append( "ns" , ns() );
+            b.append( "key" , BSON( "loc" << "geoHaystack" << "type" << 1 ) );
+            b.append( "name" , "haystack" );
+            b.append( "bucketSize" , 1 );
+            b.append( "pointInKey" , true );
+            if ( cacheSize() )
+                b.append( "bucketCache" , cacheSize() );
+            client().insert( "perftest.system.indexes" , b.obj() );
+            _i = 0;
+        }
+        void timed() {
+            BSONObj cmd = BSON( "geoSearch" << name() << "near" << BSON_ARRAY( 20 + _i % 50 << 20 + _i % 37 ) <<
+                                "maxDistance" << 3 << "search" << BSON( "type" << _i % 20 ) << "limit" << 10 );
+            _i++;
+            Timer t;
+            BSONObj res;
+            ASSERT( client().runCommand( "perftest" , cmd , res ) );
+            _micros.push_back( t.micros() );
+        }
+        void report() {
+            sort( _micros.begin() , _micros.end() );
+            if ( _micros.empty() )
+                return;
+            cout << "stats\t" << name() << " latency micros"
+                 << "\tp50 " << _micros[ _micros.size() / 2 ]
+                 << "\tp90 " << _micros[ _micros.size() * 9 / 10 ]
+                 << "\tp99 " << _micros[ _micros.size() * 99 / 100 ] << endl;
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 100; }
+    protected:
+        virtual int cacheSize() { return 0; }
+    private:
+        unsigned _i;
+        vector<unsigned long long> _micros;
+    };
+
+    /** the same, with the bucket cache on */
+    class HaystackSearchCached : public HaystackSearch {
+    public:
+        string name() { return "geo-haystack-search-cached"; }
+    protected:
+        virtual int cacheSize() { return 1000; }
+    };
+
+    /** two word text searches over documents of 30 words from a vocabulary of 2000 */
+    class TextSearch : public B {
+    public:
+        string name() { return "text-search"; }
+        void prep() {
+            for( int i = 0; i < 20000; i++ ) {
+                StringBuilder body;
+                BSONArrayBuilder words;
+                for ( int j = 0; j < 30; j++ ) {
+                    unsigned r = ( i * 7919 + j * 104729 ) % 10007;
+                    StringBuilder w;
+                    w << "w" << ( r * r ) % 2000;
+                    body << w.str() << " ";
+                    words.append( w.str() );
+                }
+                client().insert( ns() , BSON( "body" << body.str() << "words" << words.arr() ) );
+            }
+            BSONObjBuilder b;
+            b.append( "ns" , ns() );
+            b.append( "key" , BSON( "body" << "text" ) );
+            b.append( "name" , "body_text" );
+            client().insert( "perftest.system.indexes" , b.obj() );
+            _i = 0;
+        }
+        void timed() {
+            StringBuilder search;
+            search << "w" << _i % 100 << " w" << ( _i * 7 ) % 300;
+            _i++;
+            BSONObj res;
+            ASSERT( client().runCommand( "perftest" , BSON( "text" << name() << "search" << search.str() << "limit" << 10 ) , res ) );
+        }
+        virtual int howLongMillis() { return 2000; }
+        unsigned long long expectation() { return 100; }
+    protected:
+        unsigned _i;
+    };
+
+    /** the emulation the text index replaces: $all over an array of the words, no ranking */
+    class TextSearchAll : public TextSearch {
+    public:
+        string name() { return "text-search-all"; }
+        void prep() {
+            TextSearch::prep();
+            client().ensureIndex( ns() , BSON( "words" << 1 ) );
+        }
+        void timed() {
+            StringBuilder a , b;
+            a << "w" << _i % 100;
+            b << "w" << ( _i * 7 ) % 300;
+            _i++;
+            client().query( ns() , QUERY( "words" << BSON( "$all" << BSON_ARRAY( a.str() << b.str() ) ) ) , 10 )->itcount();
+        }
+    };
+
     template <typename T>
     class MoreIndexes : public T {
     public:
@@ -378,6 +638,16 @@ namespace PerfTests {
             add< Update1 >();
             add< MoreIndexes<Update1> >();
             add< InsertBig >();
+            add< TableScanCount >();
+            add< RollingMapReduce >();
+            add< WhereWide >();
+            add< GeoNearUniform >();
+            add< GeoNearClustered >();
+            add< GeoWithinPolygon >();
+            add< HaystackSearch >();
+            add< HaystackSearchCached >();
+            add< TextSearch >();
+            add< TextSearchAll >();
         }
     } myall;
 }
@@ -0,0 +1,244 @@
+// pipelinetests.cpp : aggregation pipeline unit tests
+//
+
+/**
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+#include "../db/pipeline.h"
+#include "../db/json.h"
+#include "../client/dbclient.h"
+
+#include "dbtests.h"
+
+namespace PipelineTests {
+
+    /** @return the array in json */
+    static BSONArray arr( const char * json ) {
+        return BSONArray( fromjson( string( "{a:" ) + json + "}" )["a"].Obj().getOwned() );
+    }
+
+    /** runs stages over docs without a collection */
+    static BSONObj runOver( const BSONObj& stages , const vector<BSONObj>& docs , bool fromRouter = false ) {
+        Pipeline p;
+        string errmsg;
+        ASSERT( p.init( stages , errmsg , fromRouter ) );
+
+        shared_ptr<ArraySource> input( new ArraySource() );
+        Matcher m( p.query() );
+        for ( unsigned i=0; i<docs.size(); i++ )
+            if ( m.matches( docs[i] ) )
+                input->add( docs[i] );
+
+        BSONArrayBuilder b;
+        p.run( input , b );
+        return b.arr();
+    }
+
+    class Unwind {
+    public:
+        void run() {
+            vector<BSONObj> docs;
+            docs.push_back( fromjson( "{a:1,x:{t:[1,2]}}" ) );
+            docs.push_back( fromjson( "{a:2,x:{t:3}}" ) );
+            docs.push_back( fromjson( "{a:3}" ) );
+
+            BSONObj res = runOver( arr( "[{$unwind:'$x.t'}]" ) , docs );
+            ASSERT_EQUALS( fromjson( "{'0':{a:1,x:{t:1}},'1':{a:1,x:{t:2}},'2':{a:2,x:{t:3}}}" ) , res );
+        }
+    };
+
+    class Group {
+    public:
+        void run() {
+            vector<BSONObj> docs;
+            docs.push_back( fromjson( "{k:'a',v:1,tags:['x','y']}" ) );
+            docs.push_back( fromjson( "{k:'a',v:2.5,tags:['x']}" ) );
+            docs.push_back( fromjson( "{k:'b',v:4,tags:[]}" ) );
+            docs.push_back( fromjson( "{k:'c',v:7}" ) );
+
+            BSONObj res = runOver( arr( "[{$match:{v:{$lt:5}}},"
+                                   "{$group:{_id:'$k',n:{$sum:1},total:{$sum:'$v'},avg:{$avg:'$v'},"
+                                   "lo:{$min:'$v'},hi:{$max:'$v'},tags:{$addToSet:'$tags'}}},"
+                                   "{$sort:{total:-1}}]" ) , docs );
+
+            vector<BSONElement> out;
+            res.elems( out );
+            ASSERT_EQUALS( 2U , out.size() );
+            ASSERT_EQUALS( fromjson( "{_id:'b',n:1,total:4,avg:4,lo:4,hi:4,tags:[[]]}" ) , out[0].Obj() );
+            ASSERT_EQUALS( fromjson( "{_id:'a',n:2,total:3.5,avg:1.75,lo:1,hi:2.5,tags:[['x','y'],['x']]}" ) , out[1].Obj() );
+            ASSERT_EQUALS( NumberInt , out[0].Obj()["n"].type() );
+        }
+    };
+
+    class CompoundId {
+    public:
+        void run() {
+            vector<BSONObj> docs;
+            docs.push_back( fromjson( "{a:1,b:1}" ) );
+            docs.push_back( fromjson( "{a:1,b:2}" ) );
+            docs.push_back( fromjson( "{a:1,b:1.0}" ) );
+
+            BSONObj res = runOver( arr( "[{$group:{_id:{x:'$a',y:'$b'},n:{$sum:1}}}]" ) , docs );
+            ASSERT_EQUALS( fromjson( "{'0':{_id:{x:1,y:1},n:2},'1':{_id:{x:1,y:2},n:1}}" ) , res );
+        }
+    };
+
+    class SortLimit {
+    public:
+        void run() {
+            vector<BSONObj> docs;
+            for ( int i=0; i<1000; i++ )
+                docs.push_back( BSON( "x" << ( i * 7919 ) % 1000 ) );
+
+            BSONObj res = runOver( arr( "[{$sort:{x:-1}},{$limit:3},{$project:{_id:0,x:1}}]" ) , docs );
+            ASSERT_EQUALS( fromjson( "{'0':{x:999},'1':{x:998},'2':{x:997}}" ) , res );
+        }
+    };
+
+    /** documents with equal keys come out in input order, whichever ones the limit keeps */
+    class SortLimitStable {
+    public:
+        void run() {
+            vector<BSONObj> docs;
+            for ( int i=0; i<1000; i++ )
+                docs.push_back( BSON( "x" << i % 2 << "i" << i ) );
+
+            BSONObj res = runOver( arr( "[{$sort:{x:1}},{$limit:5},{$project:{_id:0,i:1}}]" ) , docs );
+            ASSERT_EQUALS( fromjson( "{'0':{i:0},'1':{i:2},'2':{i:4},'3':{i:6},'4':{i:8}}" ) , res );
+        }
+    };
+
+    class BadSpec {
+    public:
+        void run() {
+            const char * bad[] = { "[{$nope:1}]" , "[{$group:{n:{$sum:1}}}]" , "[{$group:{_id:1,n:{$median:'$a'}}}]" ,
+                                   "[{$limit:0}]" , "[{$unwind:'a'}]" , "[{$sort:{}}]" , "[{$match:1,$limit:1}]" ,
+                                   // only from a router
+                                   "[{$groupPartial:{_id:'$a',n:{$sum:1}}}]" , "[{$groupMerge:{_id:'$a',n:{$sum:1}}}]" , 0
+                                 };
+            for ( int i=0; bad[i]; i++ ) {
+                Pipeline p;
+                string errmsg;
+                ASSERT( ! p.init( arr( bad[i] ) , errmsg ) );
+                ASSERT( ! errmsg.empty() );
+            }
+        }
+    };
+
+    /** what two shards and a router compute together has to equal the whole pipeline */
+    class Split {
+    public:
+        void run() {
+            const char * stages = "[{$match:{v:{$gte:0}}},{$group:{_id:'$k',total:{$sum:'$v'},avg:{$avg:'$v'},"
+                                  "lo:{$min:'$v'},all:{$push:'$v'}}},{$sort:{_id:1}}]";
+
+            vector<BSONObj> shard0, shard1, both;
+            for ( int i=0; i<100; i++ ) {
+                BSONObj o = BSON( "k" << i % 7 << "v" << i );
+                ( i % 3 ? shard0 : shard1 ).push_back( o );
+                both.push_back( o );
+            }
+            shard1.push_back( BSON( "k" << 100 << "w" << 1 ) );
+            both.push_back( BSON( "k" << 100 << "w" << 1 ) );
+
+            BSONArrayBuilder shardPart;
+            BSONArrayBuilder mergePart;
+            Pipeline::split( arr( stages ) , shardPart , mergePart );
+            BSONObj shardStages = shardPart.arr();
+            BSONObj mergeStages = mergePart.arr();
+
+            ASSERT_EQUALS( string( "$groupPartial" ) , shardStages["1"].Obj().firstElement().fieldName() );
+            ASSERT_EQUALS( string( "$groupMerge" ) , mergeStages["0"].Obj().firstElement().fieldName() );
+            ASSERT_EQUALS( string( "$sort" ) , mergeStages["1"].Obj().firstElement().fieldName() );
+
+            BSONObj r0 = runOver( shardStages , shard0 , true );
+            BSONObj r1 = runOver( shardStages , shard1 , true );
+            vector<BSONObj> partials;
+            BSONObjIterator i( r0 );
+            while ( i.more() )
+                partials.push_back( i.next().Obj().getOwned() );
+            BSONObjIterator j( r1 );
+            while ( j.more() )
+                partials.push_back( j.next().Obj().getOwned() );
+
+            BSONObj merged = runOver( mergeStages , partials , true );
+            BSONObj whole = runOver( arr( stages ) , both );
+
+            // $push order depends on which shard answers first, so only compare the rest
+            ASSERT_EQUALS( whole.nFields() , merged.nFields() );
+            BSONObjIterator m( merged );
+            BSONObjIterator w( whole );
+            while ( w.more() ) {
+                BSONObj a = m.next().Obj();
+                BSONObj b = w.next().Obj();
+                ASSERT_EQUALS( b["_id"].number() , a["_id"].number() );
+                ASSERT_EQUALS( b["total"].number() , a["total"].number() );
+                ASSERT_EQUALS( b["avg"].isNull() , a["avg"].isNull() );
+                ASSERT_EQUALS( b["avg"].number() , a["avg"].number() );
+                ASSERT_EQUALS( b["lo"].woCompare( a["lo"] ) , 0 );
+                ASSERT_EQUALS( b["all"].Obj().nFields() , a["all"].Obj().nFields() );
+            }
+        }
+    };
+
+    class Command {
+    public:
+        Command() { _client.dropCollection( ns() ); }
+        ~Command() { _client.dropCollection( ns() ); }
+        const char * ns() { return "unittests.pipeline"; }
+
+        void run() {
+            _client.ensureIndex( ns() , BSON( "a" << 1 ) );
+            for ( int i=0; i<50; i++ )
+                _client.insert( ns() , BSON( "a" << i << "b" << i % 5 ) );
+
+            BSONObj res;
+            ASSERT( _client.runCommand( "unittests" ,
+                                        BSON( "aggregate" << "pipeline" << "pipeline" <<
+                                              arr( "[{$match:{a:{$gte:10,$lt:20}}},{$group:{_id:'$b',n:{$sum:1}}},{$skip:1},{$limit:2}]" ) ) ,
+                                        res ) );
+            ASSERT_EQUALS( fromjson( "{'0':{_id:1,n:2},'1':{_id:2,n:2}}" ) , res["result"].Obj() );
+
+            ASSERT( ! _client.runCommand( "unittests" , BSON( "aggregate" << "pipeline" << "pipeline" << 1 ) , res ) );
+
+            // no collection, no documents
+            ASSERT( _client.runCommand( "unittests" , BSON( "aggregate" << "nonexistent" << "pipeline" << BSONArray() ) , res ) );
+            ASSERT( res["result"].Obj().isEmpty() );
+        }
+
+    private:
+        DBDirectClient _client;
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "pipeline" ) {
+        }
+
+        void setupTests() {
+            add< Unwind >();
+            add< Group >();
+            add< CompoundId >();
+            add< SortLimit >();
+            add< SortLimitStable >();
+            add< BadSpec >();
+            add< Split >();
+            add< Command >();
+        }
+    } myall;
+
+} // namespace PipelineTests
@@ -965,6 +965,26 @@ namespace QueryOptimizerTests {
             }
         };
 
+        class KeysExact : public Base {
+        public:
+            void run() {
+                QueryPlan p( nsd(), INDEXNO( "a" << 1 ), FBS( BSON( "a" << GT << 1 << LT << 5 ) ), FBS2( BSON( "a" << GT << 1 << LT << 5 ) ), BSON( "a" << GT << 1 << LT << 5 ), BSONObj() );
+                ASSERT( p.keysExact() );
+                QueryPlan p2( nsd(), INDEXNO( "a" << 1 ), FBS( BSON( "a" << GT << 1 ) ), FBS2( BSON( "a" << GT << 1 ) ), BSON( "a" << GT << 1 ), BSONObj() );
+                ASSERT( !p2.keysExact() );
+                QueryPlan p3( nsd(), INDEXNO( "a" << 1 << "b" << 1 ), FBS( BSON( "a" << 4 << "b" << GTE << "x" << LTE << "y" ) ), FBS2( BSON( "a" << 4 << "b" << GTE << "x" << LTE << "y" ) ), BSON( "a" << 4 << "b" << GTE << "x" << LTE << "y" ), BSONObj() );
+                ASSERT( p3.keysExact() );
+                QueryPlan p4( nsd(), INDEXNO( "a" << 1 ), FBS( BSON( "a" << 4 << "c" << 1 ) ), FBS2( BSON( "a" << 4 << "c" << 1 ) ), BSON( "a" << 4 << "c" << 1 ), BSONObj() );
+                ASSERT( !p4.keysExact() );
+                QueryPlan p5( nsd(), INDEXNO( "a" << 1 ), FBS( fromjson( "{a:{$in:[1,'x']}}" ) ), FBS2( fromjson( "{a:{$in:[1,'x']}}" ) ), fromjson( "{a:{$in:[1,'x']}}" ), BSONObj() );
+                ASSERT( p5.keysExact() );
+                QueryPlan p6( nsd(), INDEXNO( "a" << 1 ), FBS( fromjson( "{a:/x/}" ) ), FBS2( fromjson( "{a:/x/}" ) ), fromjson( "{a:/x/}" ), BSONObj() );
+                ASSERT( !p6.keysExact() );
+                QueryPlan p7( nsd(), INDEXNO( "a" << 1 ), FBS( fromjson( "{a:{$mod:[2,0]}}" ) ), FBS2( fromjson( "{a:{$mod:[2,0]}}" ) ), fromjson( "{a:{$mod:[2,0]}}" ), BSONObj() );
+                ASSERT( !p7.keysExact() );
+            }
+        };
+
         class MoreKeyMatch : public Base {
         public:
             void run() {
@@ -1751,6 +1771,7 @@ namespace QueryOptimizerTests {
             add< QueryPlanTests::MoreOptimal >();
             add< QueryPlanTests::KeyMatch >();
             add< QueryPlanTests::MoreKeyMatch >();
+            add< QueryPlanTests::KeysExact >();
             add< QueryPlanTests::ExactKeyQueryTypes >();
             add< QueryPlanTests::Unhelpful >();
             add< QueryPlanSetTests::NoIndexes >();
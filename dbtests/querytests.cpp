@@ -133,6 +133,22 @@ namespace QueryTests {
         }
     };
 
+    class CountIndexedRange : public Base {
+    public:
+        void run() {
+            for( int i = 0; i < 150; ++i )
+                insert( BSON( "a" << i ) );
+            insert( "{\"a\":\"b\"}" );
+            insert( "{\"b\":5}" );
+            string err;
+            ASSERT_EQUALS( 50, runCount( ns(), fromjson( "{\"query\":{\"a\":{\"$gte\":100,\"$lt\":1000}}}" ), err ) );
+            ASSERT_EQUALS( 3, runCount( ns(), fromjson( "{\"query\":{\"a\":{\"$in\":[1,5,7,1000]}}}" ), err ) );
+            ASSERT_EQUALS( 10, runCount( ns(), fromjson( "{\"query\":{\"a\":{\"$gte\":100,\"$lt\":1000}},\"skip\":30,\"limit\":10}" ), err ) );
+            // open ended: the string key is in range but doesn't match
+            ASSERT_EQUALS( 50, runCount( ns(), fromjson( "{\"query\":{\"a\":{\"$gte\":100}}}" ), err ) );
+        }
+    };
+
     class FindOne : public Base {
     public:
         void run() {
@@ -725,6 +741,45 @@ namespace QueryTests {
     };
     BSONObj MinMax::empty_;
 
+    class MinMaxReverse : public ClientBase {
+    public:
+        MinMaxReverse() : ns( "unittests.querytests.MinMaxReverse" ) {}
+        ~MinMaxReverse() {
+            client().dropCollection( ns );
+        }
+        void run() {
+            client().ensureIndex( ns, BSON( "a" << 1 ) );
+            client().insert( ns, fromjson( "{a:null}" ) );
+            client().insert( ns, BSON( "a" << 1 ) );
+            client().insert( ns, BSON( "a" << 2 ) );
+            client().insert( ns, BSON( "a" << 3 ) );
+            client().insert( ns, BSON( "a" << "x" ) );
+
+            // $min is inclusive and $max exclusive, walked backwards too, and they bound keys of every type
+            check( BSON( "a" << 1 ), BSON( "a" << 3 ), 1, "[1,2]" );
+            check( BSON( "a" << 1 ), BSON( "a" << 3 ), -1, "[2,1]" );
+            check( BSON( "a" << 2 ), BSONObj(), 1, "[2,3,\"x\"]" );
+            check( BSON( "a" << 2 ), BSONObj(), -1, "[\"x\",3,2]" );
+            check( BSONObj(), BSON( "a" << 2 ), -1, "[1,null]" );
+        }
+    private:
+        void check( const BSONObj &min, const BSONObj &max, int direction, const char *expected ) {
+            Query q = Query().sort( BSON( "a" << direction ) ).hint( BSON( "a" << 1 ) );
+            if ( !min.isEmpty() )
+                q.minKey( min );
+            if ( !max.isEmpty() )
+                q.maxKey( max );
+            BSONArrayBuilder b;
+            auto_ptr< DBClientCursor > c = client().query( ns, q );
+            while( c->more() )
+                b.append( c->next()[ "a" ] );
+            BSONObj found = b.arr();
+            BSONObj want = fromjson( string( "{e:" ) + expected + "}" )[ "e" ].embeddedObject();
+            ASSERT_EQUALS( 0, found.woCompare( want, BSONObj(), false ) );
+        }
+        const char *ns;
+    };
+
     class DirectLocking : public ClientBase {
     public:
         void run() {
@@ -959,6 +1014,38 @@ namespace QueryTests {
         }
     };
 
+    class HelperRemoveRangeTest : public CollectionBase {
+    public:
+
+        HelperRemoveRangeTest() : CollectionBase( "helperremoverange" ) {
+        }
+
+        void run() {
+            writelock lk("");
+            Client::Context ctx( "unittests" );
+
+            for ( int i=0; i<100; i++ ) {
+                insert( ns() , BSON( "_id" << i << "x" << i * 2 ) );
+            }
+
+            // [10,50) in batches of 15
+            BSONObj min = BSON( "_id" << 10 );
+            BSONObj max = BSON( "_id" << 50 );
+            ASSERT_EQUALS( 15 , Helpers::removeRange( ns() , min , max , false , false , 0 , BSONObj() , 15 ) );
+            ASSERT_EQUALS( 85 , count() );
+            ASSERT_EQUALS( 15 , Helpers::removeRange( ns() , min , max , false , false , 0 , BSONObj() , 15 ) );
+            ASSERT_EQUALS( 10 , Helpers::removeRange( ns() , min , max , false , false , 0 , BSONObj() , 15 ) );
+            ASSERT_EQUALS( 0 , Helpers::removeRange( ns() , min , max , false , false , 0 , BSONObj() , 15 ) );
+            ASSERT_EQUALS( 60 , count() );
+
+            BSONObj res;
+            ASSERT( Helpers::findById( cc(), ns() , BSON( "_id" << 9 ) , res ) );
+            ASSERT( ! Helpers::findById( cc(), ns() , BSON( "_id" << 10 ) , res ) );
+            ASSERT( ! Helpers::findById( cc(), ns() , BSON( "_id" << 49 ) , res ) );
+            ASSERT( Helpers::findById( cc(), ns() , BSON( "_id" << 50 ) , res ) );
+        }
+    };
+
     class ClientCursorTest : public CollectionBase {
         ClientCursorTest() : CollectionBase( "clientcursortest" ) {
         }
@@ -1222,6 +1309,7 @@ namespace QueryTests {
             add< CountFields >();
             add< CountQueryFields >();
             add< CountIndexedRegex >();
+            add< CountIndexedRange >();
             add< FindOne >();
             add< BoundedKey >();
             add< GetMore >();
@@ -1250,6 +1338,7 @@ namespace QueryTests {
             add< IndexInsideArrayCorrect >();
             add< SubobjArr >();
             add< MinMax >();
+            add< MinMaxReverse >();
             add< DirectLocking >();
             add< FastCountIn >();
             add< EmbeddedArray >();
@@ -1258,6 +1347,7 @@ namespace QueryTests {
             add< TailableCappedRaceCondition >();
             add< HelperTest >();
             add< HelperByIdTest >();
+            add< HelperRemoveRangeTest >();
             add< FindingStart >();
             add< FindingStartPartiallyFull >();
             add< WhatsMyUri >();
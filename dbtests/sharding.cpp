@@ -21,6 +21,7 @@
 #include "dbtests.h"
 
 #include "../client/parallel.h"
+#include "../s/chunk.h"
 
 namespace ShardingTests {
 
@@ -43,6 +44,144 @@ namespace ShardingTests {
         };
     }
 
+    namespace routingtabletests {
+
+        /** key strings have to order like the keys do */
+        class KeyString {
+        public:
+            static int sign( int x ) { return x < 0 ? -1 : x > 0 ? 1 : 0; }
+
+            static int cmp( const string& l , const string& r ) {
+                int c = memcmp( l.data() , r.data() , min( l.size() , r.size() ) );
+                if ( c )
+                    return sign( c );
+                return l.size() < r.size() ? -1 : l.size() > r.size() ? 1 : 0;
+            }
+
+            void run() {
+                OID a , b;
+                a.init( "4d0a3c9f0000000000000001" );
+                b.init( "4d0a3c9f0000000000000100" );
+
+                vector<BSONObj> keys;
+                keys.push_back( BSON( "x" << MINKEY ) );
+                keys.push_back( BSON( "x" << MAXKEY ) );
+                {
+                    BSONObjBuilder n;
+                    n.appendNull( "x" );
+                    keys.push_back( n.obj() );
+                }
+                keys.push_back( BSON( "x" << -1e300 ) );
+                keys.push_back( BSON( "x" << -5 ) );
+                keys.push_back( BSON( "x" << -0.5 ) );
+                keys.push_back( BSON( "x" << -0.0 ) );
+                keys.push_back( BSON( "x" << 0 ) );
+                keys.push_back( BSON( "x" << 0.25 ) );
+                keys.push_back( BSON( "x" << 5LL ) );
+                keys.push_back( BSON( "x" << 5.0 ) );
+                keys.push_back( BSON( "x" << 1000000000000LL ) );
+                keys.push_back( BSON( "x" << 1e300 ) );
+                keys.push_back( BSON( "x" << "" ) );
+                keys.push_back( BSON( "x" << "a" ) );
+                keys.push_back( BSON( "x" << "ab" ) );
+                keys.push_back( BSON( "x" << "b" ) );
+                keys.push_back( BSON( "x" << "\xc3\xa9" ) );
+                keys.push_back( BSON( "x" << a ) );
+                keys.push_back( BSON( "x" << b ) );
+                keys.push_back( BSON( "x" << false ) );
+                keys.push_back( BSON( "x" << true ) );
+                keys.push_back( BSON( "x" << Date_t( 1 ) ) );
+                keys.push_back( BSON( "x" << Date_t( 1ULL << 40 ) ) );
+                keys.push_back( BSON( "x" << "a" << "y" << 2 ) );
+                keys.push_back( BSON( "x" << "a" << "y" << MAXKEY ) );
+                keys.push_back( BSON( "x" << "ab" << "y" << MINKEY ) );
+                keys.push_back( BSON( "x" << 5 << "y" << "z" ) );
+
+                vector<string> strs( keys.size() );
+                for ( unsigned i=0; i<keys.size(); i++ )
+                    ASSERT( ChunkRoutingTable::keyString( keys[i] , strs[i] ) );
+
+                for ( unsigned i=0; i<keys.size(); i++ ) {
+                    for ( unsigned j=0; j<keys.size(); j++ ) {
+                        if ( keys[i].nFields() != keys[j].nFields() )
+                            continue;
+                        ASSERT_EQUALS( sign( keys[i].woCompare( keys[j] ) ) , cmp( strs[i] , strs[j] ) );
+                    }
+                }
+
+                string s;
+                ASSERT( ! ChunkRoutingTable::keyString( BSON( "x" << BSON( "a" << 1 ) ) , s ) );
+                ASSERT( ! ChunkRoutingTable::keyString( BSON( "x" << ( 1LL << 60 ) ) , s ) );
+                ASSERT( ! ChunkRoutingTable::keyString( BSON( "x" << numeric_limits<double>::quiet_NaN() ) , s ) );
+            }
+        };
+
+        class Bounds {
+        public:
+            static BSONObj k( int x ) { return BSON( "" << x ); }
+
+            static set<string> route( const ChunkRoutingTable& t , const vector< pair<BSONObj,BSONObj> >& bounds ) {
+                set<Shard> shards;
+                t.getShardsForBounds( bounds , shards );
+                set<string> names;
+                for ( set<Shard>::iterator i=shards.begin(); i!=shards.end(); ++i )
+                    names.insert( i->getName() );
+                return names;
+            }
+
+            static set<string> names( const char * a , const char * b = 0 , const char * c = 0 ) {
+                set<string> s;
+                s.insert( a );
+                if ( b ) s.insert( b );
+                if ( c ) s.insert( c );
+                return s;
+            }
+
+            void run() {
+                Shard s0( "s0" , "localhost:30000" ) , s1( "s1" , "localhost:30001" ) , s2( "s2" , "localhost:30002" );
+
+                // [MinKey,10) s0 , [10,20) s1 , [20,30) s0 , [30,MaxKey) s2
+                ChunkRoutingTable t;
+                t.add( BSON( "x" << 10 ) , s0 );
+                t.add( BSON( "x" << 20 ) , s1 );
+                t.add( BSON( "x" << 30 ) , s0 );
+                t.add( BSON( "x" << MAXKEY ) , s2 );
+                ASSERT_EQUALS( 4 , t.size() );
+
+                vector< pair<BSONObj,BSONObj> > b;
+                b.push_back( make_pair( k( 5 ) , k( 5 ) ) );
+                ASSERT( names( "s0" ) == route( t , b ) );
+
+                // a chunk's max belongs to the next one
+                b.clear();
+                b.push_back( make_pair( k( 10 ) , k( 10 ) ) );
+                ASSERT( names( "s1" ) == route( t , b ) );
+
+                // an $in
+                b.clear();
+                b.push_back( make_pair( k( 12 ) , k( 12 ) ) );
+                b.push_back( make_pair( k( 15 ) , k( 15 ) ) );
+                b.push_back( make_pair( k( 25 ) , k( 25 ) ) );
+                ASSERT( names( "s0" , "s1" ) == route( t , b ) );
+
+                b.clear();
+                b.push_back( make_pair( k( 12 ) , k( 22 ) ) );
+                b.push_back( make_pair( k( 35 ) , k( 35 ) ) );
+                ASSERT( names( "s0" , "s1" , "s2" ) == route( t , b ) );
+
+                b.clear();
+                b.push_back( make_pair( BSON( "" << MINKEY ) , BSON( "" << MAXKEY ) ) );
+                ASSERT( names( "s0" , "s1" , "s2" ) == route( t , b ) );
+
+                // values without a key string are compared as BSON: objects sort after numbers
+                b.clear();
+                b.push_back( make_pair( k( 15 ) , k( 15 ) ) );
+                b.push_back( make_pair( BSON( "" << BSON( "a" << 1 ) ) , BSON( "" << BSON( "a" << 1 ) ) ) );
+                ASSERT( names( "s1" , "s2" ) == route( t , b ) );
+            }
+        };
+    }
+
     class All : public Suite {
     public:
         All() : Suite( "sharding" ) {
@@ -50,6 +189,8 @@ namespace ShardingTests {
 
         void setupTests() {
             add< serverandquerytests::test1 >();
+            add< routingtabletests::KeyString >();
+            add< routingtabletests::Bounds >();
         }
     } myall;
 
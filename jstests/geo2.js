@@ -19,8 +19,9 @@ printjson(slow.stats);
 
 v = "\n" + tojson( fast ) + "\n" + tojson( slow );
 
-assert.lt( fast.stats.nscanned * 10 , slow.stats.nscanned , "A1" + v );
-assert.lt( fast.stats.objectsLoaded , slow.stats.objectsLoaded , "A2" + v );
+// the search no longer depends on where it starts, and only looks at the points it returns
+assert.eq( 10 , fast.stats.pointsLookedAt , "A1" + v );
+assert.eq( fast.stats.nscanned , slow.stats.nscanned , "A2" + v );
 assert.eq( fast.stats.avgDistance , slow.stats.avgDistance , "A3" + v );
 
 function a( cur ){
@@ -20,8 +20,10 @@ slow = db.runCommand( { geoNear : t.getName() , near : [ 50 , 50 ] , num : 10 ,
 
 printjson( slow.stats );
 
-assert.lt( fast.stats.nscanned * 10 , slow.stats.nscanned , "A1" );
-assert.lt( fast.stats.objectsLoaded , slow.stats.objectsLoaded , "A2" );
+// the search no longer depends on where it starts, and only looks at the points it returns
+assert.eq( 10 , fast.stats.pointsLookedAt , "A1" );
+assert.eq( fast.stats.nscanned , slow.stats.nscanned , "A1b" );
+assert.eq( fast.stats.objectsLoaded , slow.stats.objectsLoaded , "A2" );
 assert.eq( fast.stats.avgDistance , slow.stats.avgDistance , "A3" );
 
 // test filter
@@ -0,0 +1,58 @@
+// geoSearch with the bucket cache on, which has to forget buckets when the collection changes
+
+t = db.geo_haystack3
+t.drop()
+
+for ( x=0; x<20; x++ )
+    for ( y=0; y<20; y++ )
+        t.insert( { _id : x * 20 + y , loc : [ x , y ] , z : ( x + y ) % 4 } );
+
+t.ensureIndex( { loc : "geoHaystack" , z : 1 } , { bucketSize : 1 , bucketCache : 100 } );
+
+q = { near : [ 7 , 8 ] , maxDistance : 3 , search : { z : 3 } , limit : 1000 };
+
+function ids( res ){
+    return res.results.map( function(z){ return z._id; } ).sort( function(a,b){ return a - b; } );
+}
+
+first = t.runCommand( "geoSearch" , q );
+assert.eq( 0 , first.stats.cacheHits , "cold" );
+assert.lt( 0 , first.stats.n , "some" );
+
+second = t.runCommand( "geoSearch" , q );
+assert.lt( 0 , second.stats.cacheHits , "warm" );
+assert.eq( first.stats.btreeMatches , second.stats.btreeMatches , "warm matches" );
+assert.eq( ids( first ) , ids( second ) , "same results" );
+
+// a write drops the cache, and the new point shows up
+t.insert( { _id : 1000 , loc : [ 7.5 , 8.5 ] , z : 3 } );
+third = t.runCommand( "geoSearch" , q );
+assert.eq( 0 , third.stats.cacheHits , "cleared" );
+assert.eq( first.stats.n + 1 , third.stats.n , "insert seen" );
+
+t.remove( { _id : 1000 } );
+assert.eq( ids( first ) , ids( t.runCommand( "geoSearch" , q ) ) , "remove seen" );
+
+// moving a point changes its key
+t.update( { _id : 7 * 20 + 8 } , { $set : { loc : [ 50 , 50 ] } } );
+assert.eq( first.stats.n - 1 , t.runCommand( "geoSearch" , q ).stats.n , "moved away" );
+
+// with the point in the keys, the same searches give the same results, and go on doing so as points move
+u = db.geo_haystack3_point
+u.drop()
+t.find().forEach( function( z ){ u.insert( z ); } );
+u.ensureIndex( { loc : "geoHaystack" , z : 1 } , { bucketSize : 1 , pointInKey : true } );
+
+function same( msg ){
+    [ 0 , 1 , 2 , 3 ].forEach( function( z ){
+        var s = { near : [ 7 , 8 ] , maxDistance : 3 , search : { z : z } , limit : 1000 };
+        assert.eq( ids( t.runCommand( "geoSearch" , s ) ) , ids( u.runCommand( "geoSearch" , s ) ) , msg + " " + z );
+    } );
+}
+same( "pointInKey" );
+
+[ t , u ].forEach( function( c ){
+    c.update( { _id : 7 * 20 + 8 } , { $set : { loc : [ 8 , 8 ] } } );
+    c.remove( { _id : 6 * 20 + 8 } );
+} );
+same( "pointInKey after writes" );
@@ -0,0 +1,78 @@
+// $near walks cells nearest first, and $within only the cells covering the shape
+
+t = db.geo_knn;
+
+function dist( a , b ){
+    return Math.sqrt( Math.pow( a[0] - b[0] , 2 ) + Math.pow( a[1] - b[1] , 2 ) );
+}
+
+function check( msg , pt , num , maxDistance , filter ){
+    var all = t.find( filter || {} ).toArray().map( function(z){ return dist( pt , z.loc ); } );
+    all = all.filter( function(d){ return maxDistance == null || d < maxDistance; } );
+    all.sort( function(a,b){ return a - b; } );
+    all = all.slice( 0 , num );
+
+    var cmd = { geoNear : t.getName() , near : pt , num : num };
+    if ( maxDistance != null )
+        cmd.maxDistance = maxDistance;
+    if ( filter )
+        cmd.query = filter;
+    var res = db.runCommand( cmd );
+    assert( res.ok , msg + " ok" );
+    assert.eq( all.length , res.results.length , msg + " length" );
+    for ( var i=0; i<all.length; i++ )
+        assert.close( all[i] , res.results[i].dis , msg + " " + i );
+
+    var q = { loc : { $near : pt } };
+    if ( maxDistance != null )
+        q.loc.$maxDistance = maxDistance;
+    Object.extend( q , filter || {} );
+    var found = t.find( q ).limit( num ).toArray();
+    assert.eq( all.length , found.length , msg + " $near length" );
+    for ( var i=0; i<all.length; i++ )
+        assert.close( all[i] , dist( pt , found[i].loc ) , msg + " $near " + i );
+
+    return res.stats;
+}
+
+function checkWithin( msg ){
+    var shapes = [ { $center : [ [ 10 , 10 ] , 0.3 ] } , { $center : [ [ 0 , 0 ] , 30 ] } ,
+                   { $box : [ [ 9.5 , 9.5 ] , [ 10.1 , 12 ] ] } , { $box : [ [ -90 , -90 ] , [ 90 , 90 ] ] } ];
+    var all = t.find().toArray();
+    shapes.forEach( function( s ){
+        var n = all.filter( function(z){
+            if ( s.$center )
+                return dist( s.$center[0] , z.loc ) <= s.$center[1];
+            return z.loc[0] >= s.$box[0][0] && z.loc[0] <= s.$box[1][0] &&
+                   z.loc[1] >= s.$box[0][1] && z.loc[1] <= s.$box[1][1];
+        } ).length;
+        assert.eq( n , t.find( { loc : { $within : s } } ).itcount() , msg + " " + tojson( s ) );
+    } );
+}
+
+// uniform
+t.drop();
+Random.srand( 1 );
+for ( var i=0; i<10000; i++ )
+    t.insert( { loc : [ Random.rand() * 200 - 100 , Random.rand() * 200 - 100 ] , a : i % 10 } );
+t.ensureIndex( { loc : "2d" } );
+
+stats = check( "uniform" , [ 0 , 0 ] , 10 );
+assert.lt( stats.btreelocs , 2000 , "uniform btreelocs" );
+assert.eq( 10 , stats.pointsLookedAt , "uniform pointsLookedAt" );
+assert.lte( stats.nscanned , stats.btreelocs , "uniform nscanned" );
+check( "uniform corner" , [ 99 , -99 ] , 100 );
+check( "uniform max" , [ 20 , 20 ] , 1000 , 5 );
+check( "uniform filter" , [ 20 , 20 ] , 50 , null , { a : 3 } );
+checkWithin( "uniform" );
+
+// a dense cluster on top of the same spread
+for ( var i=0; i<10000; i++ )
+    t.insert( { loc : [ 10 + Random.rand() - 0.5 , 10 + Random.rand() - 0.5 ] , a : i % 10 } );
+
+stats = check( "cluster" , [ 10 , 10 ] , 100 );
+assert.lt( stats.btreelocs , 2000 , "cluster btreelocs" );
+check( "next to cluster" , [ 11 , 11 ] , 100 );
+check( "far from cluster" , [ -50 , 50 ] , 20 );
+check( "cluster max" , [ 10 , 10 ] , 20000 , 0.1 );
+checkWithin( "cluster" );
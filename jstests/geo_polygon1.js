@@ -0,0 +1,56 @@
+// $within $polygon
+
+t = db.geo_polygon1;
+t.drop();
+
+function inside( poly , p ){
+    var c = false;
+    for ( var i=0, j=poly.length-1; i<poly.length; j=i++ ){
+        var a = poly[i], b = poly[j];
+        if ( ( a[1] > p[1] ) != ( b[1] > p[1] ) &&
+             p[0] < a[0] + ( p[1] - a[1] ) * ( b[0] - a[0] ) / ( b[1] - a[1] ) )
+            c = ! c;
+    }
+    return c;
+}
+
+Random.srand( 7 );
+var pts = [];
+for ( var i=0; i<20000; i++ ){
+    var p = [ Random.rand() * 100 - 50 , Random.rand() * 100 - 50 ];
+    pts.push( p );
+    t.insert( { _id : i , loc : p , a : i % 3 } );
+}
+t.ensureIndex( { loc : "2d" } );
+
+// a star with many points, which is nowhere near convex
+var star = [];
+for ( var i=0; i<2000; i++ ){
+    var angle = 2 * Math.PI * i / 2000;
+    var r = 20 + 8 * Math.sin( 12 * angle );
+    star.push( [ 5 + r * Math.cos( angle ) , -5 + r * Math.sin( angle ) ] );
+}
+
+var polys = {
+    triangle : [ [ 0 , 0 ] , [ 20 , 0 ] , [ 10 , 20 ] ] ,
+    l : [ [ -40 , -40 ] , [ 0 , -40 ] , [ 0 , -30 ] , [ -30 , -30 ] , [ -30 , 10 ] , [ -40 , 10 ] ] ,
+    star : star
+};
+
+for ( var name in polys ){
+    var poly = polys[name];
+    var n = pts.filter( function(p){ return inside( poly , p ); } ).length;
+    assert.lt( 0 , n , name );
+    assert.eq( n , t.find( { loc : { $within : { $polygon : poly } } } ).itcount() , name );
+    assert.eq( n , t.find( { loc : { $within : { $polygon : poly } } } ).count() , name + " count" );
+
+    var m = pts.filter( function(p,i){ return i % 3 == 1 && inside( poly , p ); } ).length;
+    assert.eq( m , t.find( { loc : { $within : { $polygon : poly } } , a : 1 } ).itcount() , name + " filtered" );
+}
+
+// a polygon can be given as an object too
+assert.eq( t.find( { loc : { $within : { $polygon : polys.triangle } } } ).itcount() ,
+           t.find( { loc : { $within : { $polygon : { a : [ 0 , 0 ] , b : [ 20 , 0 ] , c : [ 10 , 20 ] } } } } ).itcount() , "object" );
+
+assert.throws( function(){ t.find( { loc : { $within : { $polygon : [ [ 0 , 0 ] , [ 1 , 1 ] ] } } } ).itcount(); } , null , "2 points" );
+assert.throws( function(){ t.find( { loc : { $within : { $polygon : [ [ 0 , 0 ] , [ 1 , 1 ] , [ "a" , 1 ] ] } } } ).itcount(); } , null , "not numbers" );
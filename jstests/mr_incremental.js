@@ -0,0 +1,46 @@
+// out : { reduce : ... , incremental : <field> } only maps what was inserted since the last run
+
+t = db.mr_incremental;
+t.drop();
+out = db.mr_incremental_out;
+out.drop();
+db.mr.marks.remove( { "_id.ns" : t.getFullName() } );
+
+m = function(){ emit( this.k , 1 ); }
+r = function( k , vs ){ return Array.sum( vs ); }
+
+function run(){
+    var res = t.mapReduce( m , r , { out : { reduce : "mr_incremental_out" , incremental : "ts" } } );
+    assert( res.ok , tojson( res ) );
+    return res;
+}
+
+for ( i=0; i<100; i++ )
+    t.insert( { ts : i , k : i % 10 } );
+
+res = run();
+assert.eq( 100 , res.counts.input , "A1" );
+assert.eq( 10 , out.count() , "A2" );
+assert.eq( 10 , out.findOne( { _id : 3 } ).value , "A3" );
+assert.eq( 99 , db.mr.marks.findOne( { "_id.ns" : t.getFullName() } ).mark , "A4" );
+
+// nothing new
+res = run();
+assert.eq( 0 , res.counts.input , "B1" );
+assert.eq( 10 , out.findOne( { _id : 3 } ).value , "B2" );
+
+// new documents, with some new keys
+for ( i=100; i<150; i++ )
+    t.insert( { ts : i , k : i % 20 } );
+res = run();
+assert.eq( 50 , res.counts.input , "C1" );
+assert.eq( 20 , out.count() , "C2" );
+assert.eq( 13 , out.findOne( { _id : 3 } ).value , "C3" );
+assert.eq( 2 , out.findOne( { _id : 13 } ).value , "C4" );
+
+// needs reduce output, and no limit
+assert.throws( function(){ t.mapReduce( m , r , { out : { merge : "mr_incremental_out" , incremental : "ts" } } ); } , null , "D1" );
+assert.throws( function(){ t.mapReduce( m , r , { out : { reduce : "mr_incremental_out" , incremental : "ts" } , limit : 5 } ); } , null , "D2" );
+
+out.drop();
+t.drop();
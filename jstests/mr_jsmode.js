@@ -0,0 +1,77 @@
+// jsMode keeps emits in js, and switches to bson when there are too many keys
+
+t = db.mr_jsmode;
+t.drop();
+
+for ( i=0; i<3000; i++ )
+    t.insert( { x : i % 50 , y : i , tags : [ "a" , "b" + ( i % 3 ) ] } );
+t.insert( { x : NumberLong( 7 ) , y : 1 , tags : [] } );
+t.insert( { x : { a : 1 } , y : 1 , tags : [] } );
+db.getLastError();
+
+m = function(){
+    emit( this.x , { n : 1 , total : this.y } );
+    this.tags.forEach( function( z ){ emit( z , { n : 1 , total : 0 } ); } );
+}
+
+r = function( k , vs ){
+    var res = { n : 0 , total : 0 };
+    vs.forEach( function( v ){ res.n += v.n; res.total += v.total; } );
+    return res;
+}
+
+f = function( k , v ){
+    v.avg = v.total / v.n;
+    return v;
+}
+
+function run( extra ){
+    var cmd = { mapreduce : "mr_jsmode" , map : m , reduce : r , finalize : f , out : { inline : 1 } , verbose : true };
+    for ( var k in extra )
+        cmd[k] = extra[k];
+    var res = db.runCommand( cmd );
+    assert( res.ok , tojson( res ) );
+    res.results.sort( function( a , b ){ return tojson( a._id ) < tojson( b._id ) ? -1 : 1; } );
+    return res;
+}
+
+a = run( {} );
+b = run( { jsMode : true } );
+c = run( { jsMode : true , jsMaxKeys : 10 } );
+
+assert.eq( "bson" , a.timing.mode , "A1" );
+assert.eq( "js" , b.timing.mode , "A2" );
+assert.eq( "mixed" , c.timing.mode , "A3" );
+assert( b.timing.reduceTime >= 0 && b.timing.finalReduceTime >= 0 , "A4" );
+
+// 50 numbers, { a : 1 } , "a" , "b0" "b1" "b2"
+assert.eq( 55 , a.results.length , "B1" );
+assert.eq( a.counts , b.counts , "B2" );
+assert.eq( a.counts , c.counts , "B3" );
+assert.eq( a.results , b.results , "B4" );
+assert.eq( a.results , c.results , "B5" );
+
+res = t.mapReduce( m , r , { out : "mr_jsmode_out" , jsMode : true } );
+assert.eq( 55 , db.mr_jsmode_out.count() , "C1" );
+assert.eq( 3000 , db.mr_jsmode_out.findOne( { _id : "a" } ).value.n , "C2" );
+assert.eq( 61 , db.mr_jsmode_out.findOne( { _id : 7 } ).value.n , "C3" );
+res.drop();
+
+// emitting this keeps it past the map, while the records it came from grow and move
+mt = function(){
+    emit( this.y % 10 , this );
+}
+rt = function( k , vs ){
+    var res = { n : 0 };
+    vs.forEach( function( v ){ res.n += v.n || 1; } );
+    return res;
+}
+join = startParallelShell( "for ( i=0; i<3000; i++ ) db.mr_jsmode.update( { y : i } , { $set : { pad : new Array( 500 ).join( 'x' ) } } ); db.getLastError();" );
+res = db.runCommand( { mapreduce : "mr_jsmode" , map : mt , reduce : rt , out : { inline : 1 } , jsMode : true } );
+join();
+assert( res.ok , tojson( res ) );
+total = 0;
+res.results.forEach( function( z ){ total += z.value.n; } );
+assert.eq( 3002 , total , "D1" );
+
+t.drop();
@@ -0,0 +1,45 @@
+// cursor2.js
+// queries over several shards, each merge type, many times over so connections handed back at the end are
+// reused rather than leaked
+
+s = new ShardingTest( "cursor2" , 3 );
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+
+db = s.getDB( "test" );
+N = 3000;
+for ( i=0; i<N; i++ )
+    db.foo.insert( { num : i , x : N - i } );
+db.getLastError();
+
+s.adminCommand( { split : "test.foo" , middle : { num : 1000 } } );
+s.adminCommand( { split : "test.foo" , middle : { num : 2000 } } );
+primary = s.config.databases.findOne( { _id : "test" } ).primary;
+others = s.config.shards.find( { _id : { $ne : primary } } ).toArray();
+s.adminCommand( { movechunk : "test.foo" , find : { num : 1000 } , to : others[0]._id } );
+s.adminCommand( { movechunk : "test.foo" , find : { num : 2000 } , to : others[1]._id } );
+assert.eq( 3 , s.config.chunks.count( { ns : "test.foo" } ) , "chunks" );
+
+for ( round=0; round<20; round++ ) {
+    // serial
+    assert.eq( N , db.foo.find().itcount() , "serial " + round );
+    assert.eq( 100 , db.foo.find().limit( 100 ).itcount() , "serial limit " + round );
+
+    // merge sorted
+    a = db.foo.find().sort( { x : 1 } ).limit( 10 ).toArray();
+    assert.eq( 1 , a[0].x , "sorted first " + round );
+    assert.eq( 10 , a[9].x , "sorted last " + round );
+
+    // shard key order
+    a = db.foo.find( { num : { $gt : 990 , $lt : 2010 } } ).sort( { num : 1 } ).toArray();
+    assert.eq( 1019 , a.length , "key order " + round );
+    for ( j=1; j<a.length; j++ )
+        assert.lt( a[j-1].num , a[j].num , "key order in order " + round );
+}
+
+// a lot of getMores, which are prefetched
+assert.eq( N , db.foo.find().batchSize( 50 ).itcount() , "getMores" );
+assert.eq( N , db.foo.find().sort( { x : -1 } ).batchSize( 50 ).itcount() , "sorted getMores" );
+
+s.stop();
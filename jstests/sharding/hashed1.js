@@ -0,0 +1,50 @@
+// hashed1.js
+// a hashed shard key: an empty collection starts out split over the shards, and documents are routed by the hash
+
+s = new ShardingTest( "hashed1" , 2 );
+
+s.adminCommand( { enablesharding : "test" } );
+
+assert( ! s.admin.runCommand( { shardcollection : "test.bad" , key : { a : "hashed" , b : 1 } } ).ok , "compound" );
+assert( ! s.admin.runCommand( { shardcollection : "test.bad" , key : { a : "hashed" } , unique : true } ).ok , "unique" );
+
+s.adminCommand( { shardcollection : "test.foo" , key : { _id : "hashed" } , numInitialChunks : 8 } );
+s.printChunks();
+
+assert.eq( 8 , s.config.chunks.count( { ns : "test.foo" } ) , "initial chunks" );
+assert.eq( 4 , s.config.chunks.count( { ns : "test.foo" , shard : "shard0000" } ) , "shard0000 chunks" );
+assert.eq( 4 , s.config.chunks.count( { ns : "test.foo" , shard : "shard0001" } ) , "shard0001 chunks" );
+
+db = s.getDB( "test" );
+for ( i=0; i<1000; i++ )
+    db.foo.insert( { _id : i , x : i % 10 } );
+db.getLastError();
+
+// increasing _ids still land on both shards
+primary = s.getServer( "test" ).getDB( "test" );
+secondary = s.getOther( primary ).getDB( "test" );
+assert.eq( 1000 , db.foo.count() , "total" );
+assert.eq( 1000 , primary.foo.count() + secondary.foo.count() , "sum" );
+assert.lt( 100 , primary.foo.count() , "primary has some" );
+assert.lt( 100 , secondary.foo.count() , "secondary has some" );
+
+// an equality goes to a single shard, and finds the same document as a number of another type
+assert.eq( 1 , db.foo.find( { _id : 5 } ).itcount() , "equality" );
+assert.eq( 5 , db.foo.findOne( { _id : NumberLong( 5 ) } ).x , "other number type" );
+assert.eq( 3 , db.foo.find( { _id : { $in : [ 1 , 2 , 3 ] } } ).itcount() , "$in" );
+assert.eq( 4 , db.foo.find( { _id : { $gte : 10 , $lt : 14 } } ).itcount() , "range" );
+
+db.foo.update( { _id : 7 } , { $set : { y : 1 } } );
+assert.eq( 1 , db.foo.findOne( { _id : 7 } ).y , "update" );
+db.foo.remove( { _id : 8 } );
+assert.eq( 999 , db.foo.count() , "remove" );
+
+// moving a chunk moves the documents whose hashes are in it
+id = primary.foo.findOne()._id;
+s.adminCommand( { movechunk : "test.foo" , find : { _id : id } , to : s.getOther( s.getServer( "test" ) ).name } );
+assert.eq( 1 , secondary.foo.find( { _id : id } ).itcount() , "moved" );
+assert.soon( function(){ return primary.foo.find( { _id : id } ).itcount() == 0; } , "cleaned up" );
+assert.eq( 999 , db.foo.count() , "count after move" );
+assert.eq( 999 , primary.foo.count() + secondary.foo.count() , "no documents left behind" );
+
+s.stop();
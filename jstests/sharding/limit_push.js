@@ -35,7 +35,8 @@ assert.eq( 60 , db.limit_push.find( q ).count() , "Did not find 60 documents" );
 exp = db.limit_push.find( q ).sort( { x:-1} ).limit(1).explain();
 printjson( exp )
 
-assert.eq("ParallelSort", exp.clusteredType, "Not a ParallelSort");
+// sorted on the shard key, the chunks are read in key order rather than merged
+assert.eq("ShardKeyOrdered", exp.clusteredType, "Not a ShardKeyOrdered");
 
 var k = 0;
 for (var j in exp.shards) {
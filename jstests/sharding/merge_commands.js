@@ -0,0 +1,81 @@
+// merge_commands.js
+// count, distinct and geoNear send the shards a bounded form of themselves and merge what comes back as it is
+
+s = new ShardingTest( "merge_commands" , 2 );
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+
+db = s.getDB( "test" );
+N = 2000;
+for ( i=0; i<N; i++ ) {
+    var o = { num : i , x : i % 37 , loc : [ i % 50 , Math.floor( i / 40 ) ] };
+    db.foo.insert( o );
+    db.bar.insert( o );
+}
+db.foo.insert( { num : 10 , x : "a" } );
+db.foo.insert( { num : N + 10 , x : "a" } );
+db.getLastError();
+
+s.adminCommand( { split : "test.foo" , middle : { num : N / 2 } } );
+s.adminCommand( { movechunk : "test.foo" , find : { num : 0 } , to : s.getOther( s.getServer( "test" ) ).name } );
+
+// count
+assert.eq( N + 2 , db.foo.count() , "count" );
+assert.eq( 20 , db.foo.find().skip( 10 ).limit( 20 ).count( true ) , "skip and limit" );
+assert.eq( 5 , db.foo.find( { x : 3 } ).limit( 5 ).count( true ) , "limit with a query" );
+assert.eq( 2 , db.foo.find().skip( N ).limit( 20 ).count( true ) , "skip past most" );
+assert.eq( 0 , db.foo.find().skip( N + 5 ).count( true ) , "skip past all" );
+
+x = db.runCommand( { count : "foo" , skip : 2 , limit : 5 } );
+assert.eq( 5 , x.n , "count command" );
+for ( shard in x.shards )
+    assert.gte( 7 , x.shards[shard] , "a shard counts no further than skip+limit" );
+
+x = db.runCommand( { count : "foo" , query : { num : 5 } } );
+assert.eq( 1 , x.n , "count on the shard key" );
+assert.eq( 1 , Object.keySet( x.shards ).length , "count on the shard key goes to one shard" );
+
+// distinct
+d = db.foo.distinct( "x" );
+assert.eq( 38 , d.length , "distinct" );
+for ( i=0; i<37; i++ )
+    assert.eq( i , d[i] , "distinct in order " + i );
+assert.eq( "a" , d[37] , "a value on both shards comes back once" );
+assert.eq( [ 3 ] , db.foo.distinct( "x" , { num : 3 } ) , "distinct on the shard key" );
+
+// geoNear
+db.foo.ensureIndex( { loc : "2d" } );
+db.bar.ensureIndex( { loc : "2d" } );
+
+function distances( res ){
+    return res.results.map( function( z ){ return z.dis; } );
+}
+
+x = db.runCommand( { geoNear : "foo" , near : [ 0 , 0 ] , num : 50 } );
+y = db.runCommand( { geoNear : "bar" , near : [ 0 , 0 ] , num : 50 } );
+assert.eq( 50 , x.results.length , "geoNear num" );
+assert.eq( distances( y ) , distances( x ) , "geoNear same as unsharded" );
+
+x = db.runCommand( { geoNear : "foo" , near : [ 25 , 25 ] , num : 1000 , maxDistance : 3 } );
+y = db.runCommand( { geoNear : "bar" , near : [ 25 , 25 ] , num : 1000 , maxDistance : 3 } );
+assert.lt( 0 , x.results.length , "geoNear maxDistance found some" );
+assert.eq( distances( y ) , distances( x ) , "geoNear maxDistance same as unsharded" );
+x.results.forEach( function( z ){ assert.gt( 3 , z.dis , "within maxDistance" ); } );
+
+// timings, against the same commands on an unsharded collection
+function time( name , f ){
+    var start = new Date();
+    for ( var i=0; i<50; i++ )
+        f();
+    print( "merge_commands " + name + ": " + ( ( new Date() - start ) / 50 ) + "ms" );
+}
+
+time( "count sharded" , function(){ db.foo.find( { x : { $lt : 20 } } ).limit( 100 ).count( true ); } );
+time( "count unsharded" , function(){ db.bar.find( { x : { $lt : 20 } } ).limit( 100 ).count( true ); } );
+time( "distinct sharded" , function(){ db.foo.distinct( "num" ); } );
+time( "distinct unsharded" , function(){ db.bar.distinct( "num" ); } );
+time( "geoNear sharded" , function(){ db.runCommand( { geoNear : "foo" , near : [ 0 , 0 ] , num : 100 } ); } );
+time( "geoNear unsharded" , function(){ db.runCommand( { geoNear : "bar" , near : [ 0 , 0 ] , num : 100 } ); } );
+
+s.stop();
@@ -0,0 +1,64 @@
+// sort_key_order.js
+// a query sorted on the shard key reads the chunks in key order, and only goes to the shards it needs;
+// skips and limits come out right however the documents are spread
+
+s = new ShardingTest( "sort_key_order" , 2 );
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+
+db = s.getDB( "test" );
+
+N = 100;
+for ( i=0; i<N; i++ )
+    db.foo.insert( { num : i , x : N - i } );
+db.getLastError();
+
+// [ min , 25 ) and [ 50 , 75 ) on one shard, [ 25 , 50 ) and [ 75 , max ) on the other
+primary = s.getServer( "test" ).name;
+other = s.getOther( s.getServer( "test" ) ).name;
+s.adminCommand( { split : "test.foo" , middle : { num : 25 } } );
+s.adminCommand( { split : "test.foo" , middle : { num : 50 } } );
+s.adminCommand( { split : "test.foo" , middle : { num : 75 } } );
+s.adminCommand( { movechunk : "test.foo" , find : { num : 25 } , to : other } );
+s.adminCommand( { movechunk : "test.foo" , find : { num : 75 } , to : other } );
+
+function nums( c ){
+    return c.toArray().map( function( z ){ return z.num; } );
+}
+
+function range( from , to , step ){
+    var a = [];
+    for ( var i=from; step > 0 ? i < to : i > to; i += step )
+        a.push( i );
+    return a;
+}
+
+assert.eq( "ShardKeyOrdered" , db.foo.find().sort( { num : 1 } ).explain().clusteredType , "explain" );
+
+assert.eq( range( 0 , N , 1 ) , nums( db.foo.find().sort( { num : 1 } ) ) , "ascending" );
+assert.eq( range( N - 1 , -1 , -1 ) , nums( db.foo.find().sort( { num : -1 } ) ) , "descending" );
+assert.eq( range( 0 , 5 , 1 ) , nums( db.foo.find().sort( { num : 1 } ).limit( 5 ) ) , "limit" );
+assert.eq( range( 60 , 65 , 1 ) , nums( db.foo.find().sort( { num : 1 } ).skip( 60 ).limit( 5 ) ) , "skip limit" );
+assert.eq( range( 60 , 65 , 1 ) , nums( db.foo.find().sort( { num : 1 } ).skip( 60 ).limit( -5 ) ) , "skip hard limit" );
+assert.eq( range( 79 , 29 , -1 ) , nums( db.foo.find( { num : { $gte : 30 , $lt : 80 } } ).sort( { num : -1 } ) ) , "query" );
+
+// a query on the first chunk only goes to its shard
+assert.eq( 1 , db.foo.find( { num : { $lt : 20 } } ).sort( { num : 1 } ).explain().numShards , "one shard" );
+
+// merged sorts push the skip and limit down too
+assert.eq( range( 10 , 15 , 1 ) , nums( db.foo.find().sort( { x : -1 } ).skip( 10 ).limit( -5 ) ) , "merged skip hard limit" );
+assert.eq( range( 10 , 15 , 1 ) , nums( db.foo.find().sort( { x : -1 } ).skip( 10 ).limit( 5 ) ) , "merged skip limit" );
+assert.eq( range( 0 , N , 1 ) , nums( db.foo.find().sort( { x : -1 } ).batchSize( 7 ) ) , "merged small batches" );
+
+// chunks moving while a cursor is read in order
+c = db.foo.find().sort( { num : 1 } ).batchSize( 10 );
+seen = [];
+for ( i=0; i<30; i++ )
+    seen.push( c.next().num );
+s.adminCommand( { movechunk : "test.foo" , find : { num : 60 } , to : other } );
+while ( c.hasNext() )
+    seen.push( c.next().num );
+assert.eq( range( 0 , N , 1 ) , seen , "after a migration" );
+
+s.stop();
@@ -0,0 +1,45 @@
+// sort_key_order_types.js
+// reading chunks in shard key order keeps keys of every type, not just those of the chunk bounds' own type
+
+s = new ShardingTest( "sort_key_order_types" , 2 );
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { k : 1 } } );
+
+db = s.getDB( "test" );
+
+keys = [ null , -5 , 0 , 10 , 49.5 , 50 , 75 , 100 , "a" , "abc" , "l" , "m" , "zzz" ,
+         ObjectId() , ObjectId() , true , new Date( 1000 ) , new Date( 2000 ) ];
+for ( i=0; i<keys.length; i++ ) {
+    db.foo.insert( { _id : i , k : keys[i] } );
+    db.bar.insert( { _id : i , k : keys[i] } );
+}
+db.getLastError();
+
+// [ min , 0 ) and [ 50 , "m" ) on one shard, [ 0 , 50 ) and [ "m" , max ) on the other, so every range
+// but the second has bounds of two types
+other = s.getOther( s.getServer( "test" ) ).name;
+s.adminCommand( { split : "test.foo" , middle : { k : 0 } } );
+s.adminCommand( { split : "test.foo" , middle : { k : 50 } } );
+s.adminCommand( { split : "test.foo" , middle : { k : "m" } } );
+s.adminCommand( { movechunk : "test.foo" , find : { k : 0 } , to : other } );
+s.adminCommand( { movechunk : "test.foo" , find : { k : "m" } , to : other } );
+
+function ids( c ){
+    return c.toArray().map( function( z ){ return z._id; } );
+}
+
+assert.eq( "ShardKeyOrdered" , db.foo.find().sort( { k : 1 } ).explain().clusteredType , "explain" );
+
+// test.bar isn't sharded, so it gives the order a single server would
+[ 1 , -1 ].forEach( function( dir ){
+    assert.eq( ids( db.bar.find().sort( { k : dir } ) ) , ids( db.foo.find().sort( { k : dir } ) ) , "all " + dir );
+    assert.eq( ids( db.bar.find().sort( { k : dir } ).skip( 3 ).limit( 10 ) ) ,
+               ids( db.foo.find().sort( { k : dir } ).skip( 3 ).limit( 10 ) ) , "skip limit " + dir );
+    assert.eq( ids( db.bar.find( { k : { $gte : 10 } } ).sort( { k : dir } ) ) ,
+               ids( db.foo.find( { k : { $gte : 10 } } ).sort( { k : dir } ) ) , "query " + dir );
+} );
+
+assert.eq( keys.length , db.foo.find().sort( { k : 1 } ).itcount() , "count" );
+
+s.stop();
@@ -0,0 +1,39 @@
+// version3.js
+// after a migration, mongos sends the new shard version along with the next operation rather than on a
+// round trip of its own
+
+s = new ShardingTest( "version3" , 2 );
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+
+db = s.getDB( "test" );
+for ( i=0; i<100; i++ )
+    db.foo.insert( { num : i } );
+db.getLastError();
+
+function setShardVersionStats(){
+    var x = s.getDB( "admin" ).runCommand( "serverStatus" ).setShardVersion;
+    return { piggybacked : x.piggybacked || 0 , roundTrip : x.roundTrip || 0 , staleRetry : x.staleRetry || 0 };
+}
+
+before = setShardVersionStats();
+printjson( before );
+assert.lt( 0 , before.roundTrip , "the first version for a connection takes a round trip" );
+
+for ( i=1; i<5; i++ ) {
+    s.adminCommand( { split : "test.foo" , middle : { num : i * 20 } } );
+    s.adminCommand( { movechunk : "test.foo" , find : { num : i * 20 } , to : s.getOther( s.getServer( "test" ) ).name } );
+
+    assert.eq( 100 , db.foo.find().itcount() , "find " + i );
+    assert.eq( 1 , db.foo.find( { num : i * 20 } ).itcount() , "find one " + i );
+    db.foo.update( { num : i * 20 } , { $set : { x : i } } );
+    assert.eq( i , db.foo.findOne( { num : i * 20 } ).x , "update " + i );
+}
+
+after = setShardVersionStats();
+printjson( after );
+assert.lt( before.piggybacked , after.piggybacked , "piggybacked" );
+assert.eq( before.staleRetry , after.staleRetry , "a piggybacked version goes with the operation, which isn't retried" );
+
+s.stop();
@@ -0,0 +1,53 @@
+// version4.js
+// a mongos whose chunks of a collection are newer than the config server's, because the collection was dropped and
+// sharded again while its collections entry looked the same, reads all the chunks again rather than only newer ones
+
+s = new ShardingTest( "version4" , 2 , 1 , 2 );
+
+s2 = s._mongos[1];
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+
+a = s.getDB( "test" ).foo;
+b = s2.getDB( "test" ).foo;
+
+for ( i=0; i<100; i++ )
+    a.insert( { num : i } );
+a.getDB().getLastError();
+
+other = s.getOther( s.getServer( "test" ) ).name;
+for ( i=1; i<5; i++ ) {
+    s.adminCommand( { split : "test.foo" , middle : { num : i * 20 } } );
+    s.adminCommand( { movechunk : "test.foo" , find : { num : i * 20 } , to : other } );
+}
+
+// the second mongos loads the chunks as they are now
+assert.eq( 100 , b.find().itcount() , "b before" );
+
+lastmod = s.config.collections.findOne( { _id : "test.foo" } ).lastmod;
+
+a.drop();
+s.adminCommand( { shardcollection : "test.foo" , key : { num : 1 } } );
+for ( i=0; i<50; i++ )
+    a.insert( { num : i , again : true } );
+a.getDB().getLastError();
+
+// as if it all happened within the second the entry's lastmod is kept to
+s.config.collections.update( { _id : "test.foo" } , { $set : { lastmod : lastmod } } );
+s.config.getLastError();
+
+primary = s.getServer( "test" ).getDB( "test" ).foo;
+secondary = s.getOther( s.getServer( "test" ) ).getDB( "test" ).foo;
+
+assert.eq( 50 , b.find().itcount() , "b after" );
+assert.eq( 50 , b.find( { again : true } ).itcount() , "b after, new documents" );
+
+// inserts through the second mongos go where the new chunk is
+for ( i=50; i<100; i++ )
+    b.insert( { num : i , again : true } );
+b.getDB().getLastError();
+assert.eq( 100 , primary.count() , "all on the primary" );
+assert.eq( 0 , secondary.count() , "none left on the other shard" );
+
+s.stop();
@@ -0,0 +1,63 @@
+// text index and the text command
+
+t = db.text1
+t.drop()
+
+assert( ! t.runCommand( "text" , { search : "dog" } ).ok , "no index" );
+
+t.insert( { _id : 1 , title : "Running dogs" , body : "the dog runs fast" } );
+t.insert( { _id : 2 , title : "Cats" , body : "a cat sleeps all day while the dogs run around" } );
+t.insert( { _id : 3 , title : "Birds" , body : [ "birds fly" , "they sing" ] } );
+t.insert( { _id : 4 , title : 5 } );
+
+t.ensureIndex( { title : "text" , body : "text" } , { weights : { title : 10 } } );
+
+function ids( res ){
+    return res.results.map( function(z){ return z.obj._id; } );
+}
+
+res = t.runCommand( "text" , { search : "dog" } );
+assert( res.ok , "A1" );
+assert.eq( [ 1 , 2 ] , ids( res ) , "A2" );
+assert.lt( res.results[1].score , res.results[0].score , "A3" );
+
+// all the words have to be there, in any form
+assert.eq( [ 1 , 2 ] , ids( t.runCommand( "text" , { search : "DOGS running" } ) ) , "B1" );
+assert.eq( [ 2 ] , ids( t.runCommand( "text" , { search : "dog sleeping" } ) ) , "B2" );
+assert.eq( [ 3 ] , ids( t.runCommand( "text" , { search : "bird, singing" } ) ) , "B3" );
+assert.eq( [] , ids( t.runCommand( "text" , { search : "dog bird" } ) ) , "B4" );
+assert.eq( [] , ids( t.runCommand( "text" , { search : "the" } ) ) , "B5" );
+
+// limit and filter
+assert.eq( [ 1 ] , ids( t.runCommand( "text" , { search : "dog" , limit : 1 } ) ) , "C1" );
+assert.eq( [ 2 ] , ids( t.runCommand( "text" , { search : "dog" , filter : { _id : { $ne : 1 } } } ) ) , "C2" );
+
+res = t.runCommand( "text" , { search : "dog run" , explain : true } );
+assert.eq( 2 , res.stats.n , "D1" );
+assert.eq( 2 , res.stats.terms.length , "D2" );
+assert.eq( 4 , res.stats.nscanned , "D3" );
+assert.eq( 0 , res.stats.nscannedObjects , "D4" );
+
+// the index is kept up to date, and isn't used for ordinary queries
+t.update( { _id : 3 } , { $set : { title : "Dogs" } } );
+assert.eq( [ 3 , 1 , 2 ] , ids( t.runCommand( "text" , { search : "dog" } ) ) , "E1" );
+t.remove( { _id : 1 } );
+assert.eq( [ 3 , 2 ] , ids( t.runCommand( "text" , { search : "dog" } ) ) , "E2" );
+assert.eq( 1 , t.find( { title : "Cats" } ).itcount() , "E3" );
+assert.eq( "BasicCursor" , t.find( { title : "Cats" } ).explain().cursor , "E4" );
+
+// long terms are cut on a character boundary
+longWord = "";
+for ( i=0; i<63; i++ )
+    longWord += "a";
+t.insert( { _id : 5 , title : longWord + "\u00e9b" } );
+res = t.runCommand( "text" , { search : longWord + "\u00e9c" , explain : true } );
+assert.eq( [ 5 ] , ids( res ) , "L1" );
+assert.eq( longWord , res.stats.terms[0].term , "L2" );
+
+assert( ! t.runCommand( "text" , { search : 5 } ).ok , "F1" );
+assert( ! t.runCommand( "text" , { search : "dog" , filter : 5 } ).ok , "F2" );
+
+t.dropIndexes();
+t.ensureIndex( { title : "text" , n : 1 } );
+assert( db.getLastError() , "G1" );
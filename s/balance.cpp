@@ -42,57 +42,99 @@ namespace mongo {
     int Balancer::_moveChunks( const vector<CandidateChunkPtr>* candidateChunks ) {
         int movedCount = 0;
 
-        for ( vector<CandidateChunkPtr>::const_iterator it = candidateChunks->begin(); it != candidateChunks->end(); ++it ) {
-            const CandidateChunk& chunkInfo = *it->get();
+        // A shard can give or take one chunk at a time, but the candidates are of different collections, so
+        // those that have no shard in common don't get in each other's way and are moved at the same time.
+        vector<CandidateChunkPtr> pending( *candidateChunks );
+        while ( ! pending.empty() ) {
+            vector<CandidateChunkPtr> now;
+            vector<CandidateChunkPtr> later;
+            set<string> busy;
+            for ( vector<CandidateChunkPtr>::const_iterator it = pending.begin(); it != pending.end(); ++it ) {
+                const CandidateChunk& chunkInfo = *it->get();
+                if ( busy.count( chunkInfo.from ) || busy.count( chunkInfo.to ) ) {
+                    later.push_back( *it );
+                    continue;
+                }
+                busy.insert( chunkInfo.from );
+                busy.insert( chunkInfo.to );
+                now.push_back( *it );
+            }
+
+            // one of them on this thread
+            vector<char> moved( now.size() , 0 );
+            vector< shared_ptr<boost::thread> > threads;
+            for ( unsigned i=1; i<now.size(); i++ )
+                threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( &Balancer::_moveChunk , this , now[i] , &moved[i] ) ) ) );
+            _moveChunk( now[0] , &moved[0] );
+            for ( unsigned i=0; i<threads.size(); i++ )
+                threads[i]->join();
 
-            DBConfigPtr cfg = grid.getDBConfig( chunkInfo.ns );
-            assert( cfg );
+            for ( unsigned i=0; i<moved.size(); i++ )
+                movedCount += moved[i];
 
-            ChunkManagerPtr cm = cfg->getChunkManager( chunkInfo.ns );
+            pending.swap( later );
+        }
+
+        return movedCount;
+    }
+
+    void Balancer::_moveChunk( CandidateChunkPtr candidate , char * moved ) {
+        const CandidateChunk& chunkInfo = *candidate.get();
+        try {
+            *moved = _moveChunk( chunkInfo ) ? 1 : 0;
+        }
+        catch ( std::exception& e ) {
+            log() << "balancer move of " << chunkInfo.chunk << " in " << chunkInfo.ns << " failed: " << e.what() << endl;
+        }
+    }
+
+    bool Balancer::_moveChunk( const CandidateChunk& chunkInfo ) {
+        DBConfigPtr cfg = grid.getDBConfig( chunkInfo.ns );
+        assert( cfg );
+
+        ChunkManagerPtr cm = cfg->getChunkManager( chunkInfo.ns );
+        assert( cm );
+
+        const BSONObj& chunkToMove = chunkInfo.chunk;
+        ChunkPtr c = cm->findChunkForKey( chunkToMove["min"].Obj() );
+        if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
+            // likely a split happened somewhere
+            cm = cfg->getChunkManager( chunkInfo.ns , true /* reload */);
             assert( cm );
 
-            const BSONObj& chunkToMove = chunkInfo.chunk;
-            ChunkPtr c = cm->findChunk( chunkToMove["min"].Obj() );
+            c = cm->findChunkForKey( chunkToMove["min"].Obj() );
             if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
-                // likely a split happened somewhere
-                cm = cfg->getChunkManager( chunkInfo.ns , true /* reload */);
-                assert( cm );
-
-                c = cm->findChunk( chunkToMove["min"].Obj() );
-                if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
-                    log() << "chunk mismatch after reload, ignoring will retry issue cm: "
-                          << c->getMin() << " min: " << chunkToMove["min"].Obj() << endl;
-                    continue;
-                }
+                log() << "chunk mismatch after reload, ignoring will retry issue cm: "
+                      << c->getMin() << " min: " << chunkToMove["min"].Obj() << endl;
+                return false;
             }
+        }
 
-            BSONObj res;
-            if ( c->moveAndCommit( Shard::make( chunkInfo.to ) , Chunk::MaxChunkSize , res ) ) {
-                movedCount++;
-                continue;
-            }
+        BSONObj res;
+        if ( c->moveAndCommit( Shard::make( chunkInfo.to ) , Chunk::MaxChunkSize , res ) ) {
+            return true;
+        }
 
-            // the move requires acquiring the collection metadata's lock, which can fail
-            log() << "balacer move failed: " << res << " from: " << chunkInfo.from << " to: " << chunkInfo.to
-                  << " chunk: " << chunkToMove << endl;
+        // the move requires acquiring the collection metadata's lock, which can fail
+        log() << "balacer move failed: " << res << " from: " << chunkInfo.from << " to: " << chunkInfo.to
+              << " chunk: " << chunkToMove << endl;
 
-            if ( res["chunkTooBig"].trueValue() ) {
-                // reload just to be safe
-                cm = cfg->getChunkManager( chunkInfo.ns );
-                assert( cm );
-                c = cm->findChunk( chunkToMove["min"].Obj() );
-                
-                log() << "forcing a split because migrate failed for size reasons" << endl;
-                
-                res = BSONObj();
-                c->singleSplit( true , res );
-                log() << "forced split results: " << res << endl;
+        if ( res["chunkTooBig"].trueValue() ) {
+            // reload just to be safe
+            cm = cfg->getChunkManager( chunkInfo.ns );
+            assert( cm );
+            c = cm->findChunkForKey( chunkToMove["min"].Obj() );
 
-                // TODO: if the split fails, mark as jumbo SERVER-2571
-            }
+            log() << "forcing a split because migrate failed for size reasons" << endl;
+
+            res = BSONObj();
+            c->singleSplit( true , res );
+            log() << "forced split results: " << res << endl;
+
+            // TODO: if the split fails, mark as jumbo SERVER-2571
         }
 
-        return movedCount;
+        return false;
     }
 
     void Balancer::_ping( DBClientBase& conn ) {
@@ -188,6 +230,17 @@ namespace mongo {
             shardLimitsMap[ s.getName() ] = limitsObj;
         }
 
+        // the operations of each shard, per collection, from 'top'
+        map< string, BSONObj > shardTopMap;
+        for ( vector<Shard>::const_iterator it = allShards.begin(); it != allShards.end(); ++it ) {
+            try {
+                shardTopMap[ it->getName() ] = it->runCommand( "admin" , "top" )["totals"].Obj().getOwned();
+            }
+            catch ( std::exception& e ) {
+                log( LL_WARNING ) << "balancer couldn't get operation counts from " << it->getName() << ": " << e.what() << endl;
+            }
+        }
+
         //
         // 3. For each collection, check if the balancing policy recommends moving anything around.
         //
@@ -215,11 +268,46 @@ namespace mongo {
                 shardToChunksMap[s.getName()].size();
             }
 
-            CandidateChunk* p = _policy->balance( ns , shardLimitsMap , shardToChunksMap , _balancedLastTime );
+            BalancerPolicy::ShardToStatsMap shardToStatsMap;
+            _getStats( ns , allShards , shardTopMap , &shardToStatsMap );
+
+            CandidateChunk* p = _policy->balance( ns , shardLimitsMap , shardToChunksMap , shardToStatsMap , _balancedLastTime );
             if ( p ) candidateChunks->push_back( CandidateChunkPtr( p ) );
         }
     }
 
+    void Balancer::_getStats( const string& ns , const vector<Shard>& allShards , const map< string, BSONObj >& shardTopMap ,
+                              BalancerPolicy::ShardToStatsMap* shardToStatsMap ) {
+        const string db = nsToDatabase( ns.c_str() );
+        const string coll = ns.substr( db.size() + 1 );
+
+        for ( vector<Shard>::const_iterator it = allShards.begin(); it != allShards.end(); ++it ) {
+            const string& shard = it->getName();
+            BSONObjBuilder b;
+
+            // a shard that never had any of the collection doesn't have it at all
+            try {
+                b.append( StatsFields::dataSize.name() , it->runCommand( db , BSON( "collStats" << coll ) )["size"].numberLong() );
+            }
+            catch ( std::exception& ) {
+                b.append( StatsFields::dataSize.name() , 0LL );
+            }
+
+            // the counts go up from when the shard started, what matters is by how much since the last round
+            map< string, BSONObj >::const_iterator top = shardTopMap.find( shard );
+            if ( top != shardTopMap.end() ) {
+                const long long count = top->second.getObjectField( ns.c_str() ).getObjectField( "total" )["count"].numberLong();
+                const string key = shard + " " + ns;
+                map< string, long long >::iterator last = _lastOps.find( key );
+                if ( last != _lastOps.end() && last->second <= count )
+                    b.append( StatsFields::ops.name() , count - last->second );
+                _lastOps[key] = count;
+            }
+
+            (*shardToStatsMap)[ shard ] = b.obj();
+        }
+    }
+
     bool Balancer::_init() {
         try {
 
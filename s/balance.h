@@ -31,8 +31,8 @@ namespace mongo {
      * uses a 'DistributedLock' for that coordination.
      *
      * The balancer does act continuously but in "rounds". At a given round, it would decide if there is an imbalance by
-     * checking the difference in chunks between the most and least loaded shards. It would issue a request for a chunk
-     * migration per round, if it found so.
+     * checking the difference in load -- chunks, data and operations -- between the most and least loaded shards. It
+     * would issue a request for a chunk migration per collection and round, if it found so.
      */
     class Balancer : public BackgroundJob {
     public:
@@ -60,6 +60,9 @@ namespace mongo {
 
         // decide which chunks to move; owned here.
         scoped_ptr<BalancerPolicy> _policy;
+
+        // "<shard> <ns>" -> the operation count on ns there, as of the last round
+        map< string, long long > _lastOps;
         
         /**
          * Checks that the balancer can connect to all servers it needs to do its job.
@@ -80,13 +83,31 @@ namespace mongo {
         void _doBalanceRound( DBClientBase& conn, vector<CandidateChunkPtr>* candidateChunks );
 
         /**
-         * Issues chunk migration request, one at a time.
+         * Gathers the collection's data size on each shard, and the number of operations on it there since the last
+         * round.
+         *
+         * @param shardTopMap is the 'totals' of the top command, per shard
+         * @param shardToStatsMap (OUT) stats for the policy, per shard
+         */
+        void _getStats( const string& ns , const vector<Shard>& allShards , const map< string, BSONObj >& shardTopMap ,
+                        BalancerPolicy::ShardToStatsMap* shardToStatsMap );
+
+        /**
+         * Issues chunk migration requests. Those that have no shard in common are issued at the same time.
          *
          * @param candidateChunks possible chunks to move
          * @return number of chunks effectively moved
          */
         int _moveChunks( const vector<CandidateChunkPtr>* candidateChunks );
 
+        /**
+         * @return true if the chunk was moved
+         */
+        bool _moveChunk( const CandidateChunk& chunkInfo );
+
+        /** as above, for a thread of its own: sets 'moved' and catches exceptions */
+        void _moveChunk( CandidateChunkPtr candidate , char * moved );
+
         /**
          * Marks this balancer as being live on the config server(s).
          *
@@ -32,12 +32,42 @@ namespace mongo {
     BSONField<long long> LimitsFields::currSize( "currSize" );
     BSONField<bool> LimitsFields::hasOpsQueued( "hasOpsQueued" );
 
+    // stats map fields
+    BSONField<long long> StatsFields::dataSize( "dataSize" );
+    BSONField<long long> StatsFields::ops( "ops" );
+
+    BalancerPolicy::ChunkInfo* BalancerPolicy::balance( const string& ns,
+            const ShardToLimitsMap& shardToLimitsMap,
+            const ShardToChunksMap& shardToChunksMap,
+            int balancedLastTime ) {
+        return balance( ns , shardToLimitsMap , shardToChunksMap , ShardToStatsMap() , balancedLastTime );
+    }
+
     BalancerPolicy::ChunkInfo* BalancerPolicy::balance( const string& ns,
             const ShardToLimitsMap& shardToLimitsMap,
             const ShardToChunksMap& shardToChunksMap,
+            const ShardToStatsMap& shardToStatsMap,
             int balancedLastTime ) {
-        pair<string,unsigned> min("",numeric_limits<unsigned>::max());
-        pair<string,unsigned> max("",0);
+
+        // The collection's averages per chunk, which the shards' data and operations are measured in
+        long long totalChunks = 0;
+        long long totalSize = 0;
+        long long totalOps = 0;
+        for ( ShardToChunksIter i = shardToChunksMap.begin(); i!=shardToChunksMap.end(); ++i ) {
+            totalChunks += i->second.size();
+
+            ShardToStatsIter it = shardToStatsMap.find( i->first );
+            if ( it != shardToStatsMap.end() ) {
+                totalSize += std::max( 0LL , it->second[ StatsFields::dataSize.name() ].numberLong() );
+                totalOps += std::max( 0LL , it->second[ StatsFields::ops.name() ].numberLong() );
+            }
+        }
+        const double avgChunkSize = totalChunks ? (double)totalSize / totalChunks : 0;
+        const double avgChunkOps = totalChunks ? (double)totalOps / totalChunks : 0;
+        const int terms = 1 + ( avgChunkSize > 0 ? 1 : 0 ) + ( avgChunkOps > 0 ? 1 : 0 );
+
+        pair<string,double> min("",numeric_limits<double>::max());
+        pair<string,double> max("",0);
         vector<string> drainingShards;
 
         for (ShardToChunksIter i = shardToChunksMap.begin(); i!=shardToChunksMap.end(); ++i ) {
@@ -51,22 +81,33 @@ namespace mongo {
             const bool draining = isDraining( shardLimits );
             const bool opsQueued = hasOpsQueued( shardLimits );
 
+            // The shard's load, in chunks
+            const unsigned size = i->second.size();
+            double load = size;
+            ShardToStatsIter st = shardToStatsMap.find( shard );
+            if ( st != shardToStatsMap.end() ) {
+                if ( avgChunkSize > 0 )
+                    load += std::max( 0LL , st->second[ StatsFields::dataSize.name() ].numberLong() ) / avgChunkSize;
+                if ( avgChunkOps > 0 )
+                    load += std::max( 0LL , st->second[ StatsFields::ops.name() ].numberLong() ) / avgChunkOps;
+            }
+            load /= terms;
+
             // Is this shard a better chunk receiver then the current one?
             // Shards that would be bad receiver candidates:
             // + maxed out shards
             // + draining shards
             // + shards with operations queued for writeback
-            const unsigned size = i->second.size();
             if ( ! maxedOut && ! draining && ! opsQueued ) {
-                if ( size < min.second ) {
-                    min = make_pair( shard , size );
+                if ( load < min.second ) {
+                    min = make_pair( shard , load );
                 }
             }
 
             // Check whether this shard is a better chunk donor then the current one.
             // Draining shards take a lower priority than overloaded shards.
-            if ( size > max.second ) {
-                max = make_pair( shard , size );
+            if ( size > 0 && load > max.second ) {
+                max = make_pair( shard , load );
             }
             if ( draining && (size > 0)) {
                 drainingShards.push_back( shard );
@@ -75,14 +116,14 @@ namespace mongo {
 
         // If there is no candidate chunk receiver -- they may have all been maxed out,
         // draining, ... -- there's not much that the policy can do.
-        if ( min.second == numeric_limits<unsigned>::max() ) {
+        if ( min.second == numeric_limits<double>::max() ) {
             log() << "no availalable shards to take chunks" << endl;
             return NULL;
         }
 
         log(1) << "collection : " << ns << endl;
-        log(1) << "donor      : " << max.second << " chunks on " << max.first << endl;
-        log(1) << "receiver   : " << min.second << " chunks on " << min.first << endl;
+        log(1) << "donor      : " << max.second << " load on " << max.first << endl;
+        log(1) << "receiver   : " << min.second << " load on " << min.first << endl;
         if ( ! drainingShards.empty() ) {
             string drainingStr;
             joinStringDelim( drainingShards, &drainingStr, ',' );
@@ -91,10 +132,12 @@ namespace mongo {
 
         // Solving imbalances takes a higher priority than draining shards. Many shards can
         // be draining at once but we choose only one of them to cater to per round.
-        const int imbalance = max.second - min.second;
+        // A move takes away the donor's average chunk.
+        const double imbalance = max.second - min.second;
         const int threshold = balancedLastTime ? 2 : 8;
+        const double moved = max.first.empty() ? 0 : max.second / shardToChunksMap.find( max.first )->second.size();
         string from, to;
-        if ( imbalance >= threshold ) {
+        if ( imbalance >= threshold && moved <= imbalance / 2 ) {
             from = max.first;
             to = min.first;
 
@@ -45,6 +45,24 @@ namespace mongo {
         static ChunkInfo* balance( const string& ns, const ShardToLimitsMap& shardToLimitsMap,
                                    const ShardToChunksMap& shardToChunksMap, int balancedLastTime );
 
+        /**
+         * As above, but a shard's load is more than its number of chunks: it is the average of its chunks, of
+         * how many average chunks its share of the collection's data makes up, and of how many its share of the
+         * collection's operations does. Shards with as many chunks but much more data or traffic get balanced
+         * too. Without any stats, the load is the number of chunks, and the moves are those of the above.
+         *
+         * A chunk moves from the most to the least loaded shard if they are apart by the imbalance threshold,
+         * and if the donor's average chunk is no more than half of that, so the receiver doesn't end up the
+         * most loaded of the two and send it back.
+         *
+         * @param shardToStatsMap is a map from shardId to the collection's usage on that shard:
+         * { "dataSize" : <bytes> , "ops" : <operations since the last round> }. Both are optional.
+         */
+        typedef map< string,BSONObj > ShardToStatsMap;
+        static ChunkInfo* balance( const string& ns, const ShardToLimitsMap& shardToLimitsMap,
+                                   const ShardToChunksMap& shardToChunksMap, const ShardToStatsMap& shardToStatsMap,
+                                   int balancedLastTime );
+
         // below exposed for testing purposes only -- treat it as private --
 
         static BSONObj pickChunk( const vector<BSONObj>& from, const vector<BSONObj>& to );
@@ -71,6 +89,7 @@ namespace mongo {
         // Convenience types
         typedef ShardToChunksMap::const_iterator ShardToChunksIter;
         typedef ShardToLimitsMap::const_iterator ShardToLimitsIter;
+        typedef ShardToStatsMap::const_iterator ShardToStatsIter;
 
     };
 
@@ -93,6 +112,14 @@ namespace mongo {
         static BSONField<bool> hasOpsQueued;  // writeback queue is not empty?
     };
 
+    /**
+     * Field names used in the 'stats' map, per shard and collection.
+     */
+    struct StatsFields {
+        static BSONField<long long> dataSize; // bytes of the collection's documents on the shard
+        static BSONField<long long> ops;      // operations on the collection there since the last round
+    };
+
 }  // namespace mongo
 
 #endif  // S_BALANCER_POLICY_HEADER
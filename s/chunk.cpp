@@ -19,7 +19,9 @@
 #include "pch.h"
 
 #include "../client/connpool.h"
+#include "../db/cmdline.h"
 #include "../db/queryutil.h"
+#include "../util/timer.h"
 #include "../util/unittest.h"
 
 #include "chunk.h"
@@ -67,9 +69,13 @@ namespace mongo {
     }
 
     bool Chunk::contains( const BSONObj& obj ) const {
+        return containsKey( _manager->getShardKey().extractKey( obj ) );
+    }
+
+    bool Chunk::containsKey( const BSONObj& key ) const {
         return
-            _manager->getShardKey().compare( getMin() , obj ) <= 0 &&
-            _manager->getShardKey().compare( obj , getMax() ) < 0;
+            _manager->getShardKey().compare( getMin() , key ) <= 0 &&
+            _manager->getShardKey().compare( key , getMax() ) < 0;
     }
 
     bool ChunkRange::contains(const BSONObj& obj) const {
@@ -206,8 +212,9 @@ namespace mongo {
 
         // We assume that if the chunk being split is the first (or last) one on the collection, this chunk is
         // likely to see more insertions. Instead of splitting mid-chunk, we use the very first (or last) key
-        // as a split point.
-        if ( minIsInf() ) {
+        // as a split point. That doesn't hold for a hashed key, whose insertions land all over the key space.
+        const bool hashed = _manager->getShardKey().isHashed();
+        if ( minIsInf() && ! hashed ) {
             splitPoint.clear();
             BSONObj key = _getExtremeKey( 1 );
             if ( ! key.isEmpty() ) {
@@ -215,7 +222,7 @@ namespace mongo {
             }
 
         }
-        else if ( maxIsInf() ) {
+        else if ( maxIsInf() && ! hashed ) {
             splitPoint.clear();
             BSONObj key = _getExtremeKey( -1 );
             if ( ! key.isEmpty() ) {
@@ -281,7 +288,7 @@ namespace mongo {
         }
 
         // return the second half, if a single split, or the first new chunk, if a multisplit.
-        return _manager->findChunk( m[0] );
+        return _manager->findChunkForKey( m[0] );
     }
 
     bool Chunk::moveAndCommit( const Shard& to , long long chunkSize /* bytes */, BSONObj& res ) {
@@ -291,20 +298,22 @@ namespace mongo {
 
         Shard from = _shard;
 
+        BSONObjBuilder cmd;
+        cmd.append( "moveChunk" , _manager->getns() );
+        cmd.append( "from" , from.getConnString() );
+        cmd.append( "to" , to.getConnString() );
+        cmd.append( "min" , _min );
+        cmd.append( "max" , _max );
+        cmd.append( "maxChunkSizeBytes" , chunkSize );
+        cmd.append( "shardId" , genID() );
+        cmd.append( "configdb" , configServer.modelServer() );
+        // the shards can't tell a hashed range from the field's own values
+        if ( _manager->getShardKey().isHashed() )
+            cmd.append( "keyPattern" , _manager->getShardKey().key() );
+
         ScopedDbConnection fromconn( from);
 
-        bool worked = fromconn->runCommand( "admin" ,
-                                            BSON( "moveChunk" << _manager->getns() <<
-                                                    "from" << from.getConnString() <<
-                                                    "to" << to.getConnString() <<
-                                                    "min" << _min <<
-                                                    "max" << _max <<
-                                                    "maxChunkSizeBytes" << chunkSize <<
-                                                    "shardId" << genID() <<
-                                                    "configdb" << configServer.modelServer()
-                                                ) ,
-                                            res
-                                          );
+        bool worked = fromconn->runCommand( "admin" , cmd.obj() , res );
 
         fromconn.done();
 
@@ -535,14 +544,26 @@ namespace mongo {
     }
 
     void ChunkManager::_reload_inlock() {
+        Timer t;
         int tries = 3;
         while (tries--) {
-            _chunkMap.clear();
-            _chunkRanges.clear();
-            _shards.clear();
-            _load();
+            // only the first try builds on what we already have; if that doesn't come out whole, start from scratch.
+            // either way the new map is built on the side: requests in flight keep the Chunk objects they hold, as a
+            // reload never changes a Chunk but replaces it
+            ChunkMap chunkMap;
+            if ( tries == 2 )
+                chunkMap = _chunkMap;
+            bool incremental = ! chunkMap.empty();
+
+            int numDocs = _load( chunkMap );
+
+            if ( numDocs >= 0 && _isValid( chunkMap ) ) {
+                _chunkMap.swap( chunkMap );
+
+                _shards.clear();
+                for ( ChunkMap::const_iterator it=_chunkMap.begin(); it!=_chunkMap.end(); ++it )
+                    _shards.insert( it->second->getShard() );
 
-            if (_isValid()) {
                 _chunkRanges.reloadAll(_chunkMap);
 
                 // The shard versioning mechanism hinges on keeping track of the number of times we reloaded ChunkManager's.
@@ -550,11 +571,20 @@ namespace mongo {
                 // the most up to date value.
                 _sequenceNumber = ++NextSequenceNumber;
 
+                log( t.millis() > cmdLine.slowMS ? 0 : 1 ) << "ChunkManager: " << ( incremental ? "refreshed " : "loaded " ) << _ns
+                        << " reading " << numDocs << " chunk documents, " << _chunkMap.size() << " chunks, took " << t.millis() << "ms" << endl;
                 return;
             }
 
-            if (_chunkMap.size() < 10) {
-                _printChunks();
+            if ( incremental ) {
+                log() << "ChunkManager: chunk changes for " << _ns << ( numDocs < 0 ? " are older than ours" : " didn't apply cleanly" )
+                      << ", reloading all chunks" << endl;
+                continue;
+            }
+
+            if (chunkMap.size() < 10) {
+                for ( ChunkMap::const_iterator it=chunkMap.begin(); it!=chunkMap.end(); ++it )
+                    log() << *it->second << endl;
             }
 
             sleepmillis(10 * (3-tries));
@@ -564,15 +594,38 @@ namespace mongo {
 
     }
 
-    void ChunkManager::_load() {
+    int ChunkManager::_load( ChunkMap& chunkMap ) {
+        // chunk versions only go up, so the chunks that changed since 'chunkMap' was current are the ones above its newest.
+        // the newest itself is read too: it is still there as it was unless something newer replaced it, so if neither
+        // comes back the collection was dropped and sharded again, with versions starting over below ours
+        ShardChunkVersion since = 0;
+        ChunkPtr newest;
+        for ( ChunkMap::const_iterator it=chunkMap.begin(); it!=chunkMap.end(); ++it ) {
+            if ( it->second->getLastmod() > since ) {
+                since = it->second->getLastmod();
+                newest = it->second;
+            }
+        }
+
+        BSONObjBuilder q;
+        q.append( "ns" , _ns );
+        if ( since.isSet() ) {
+            BSONObjBuilder gte( q.subobjStart( "lastmod" ) );
+            gte.appendTimestamp( "$gte" , since.toLong() );
+            gte.done();
+        }
+
         ScopedDbConnection conn( configServer.modelServer() );
 
-        // TODO really need the sort?
-        auto_ptr<DBClientCursor> cursor = conn->query( Chunk::chunkMetadataNS, QUERY("ns" << _ns).sort("lastmod",1), 0, 0, 0, 0,
+        // sorted so that a chunk that changed more than once ends up as its newest version
+        auto_ptr<DBClientCursor> cursor = conn->query( Chunk::chunkMetadataNS, Query( q.obj() ).sort("lastmod",1), 0, 0, 0, 0,
                                           (DEBUG_BUILD ? 2 : 1000000)); // batch size. Try to induce potential race conditions in debug builds
         assert( cursor.get() );
+        int numDocs = 0;
+        bool behind = since.isSet();
         while ( cursor->more() ) {
             BSONObj d = cursor->next();
+            numDocs++;
             if ( d["isMaxMarker"].trueValue() ) {
                 continue;
             }
@@ -580,25 +633,36 @@ namespace mongo {
             ChunkPtr c( new Chunk( this ) );
             c->unserialize( d );
 
-            _chunkMap[c->getMax()] = c;
-            _shards.insert(c->getShard());
+            if ( c->getLastmod() > since ||
+                    ( newest && c->getMin() == newest->getMin() && c->getMax() == newest->getMax() && c->getShard() == newest->getShard() ) )
+                behind = false;
 
+            // a changed chunk replaces whatever it overlaps, e.g. the chunk it was split from
+            ChunkMap::iterator it = chunkMap.upper_bound( c->getMin() );
+            while ( it != chunkMap.end() && it->second->getMin().woCompare( c->getMax() ) < 0 )
+                chunkMap.erase( it++ );
+
+            chunkMap[c->getMax()] = c;
         }
         conn.done();
+
+        if ( behind )
+            return -1;
+        return numDocs;
     }
 
-    bool ChunkManager::_isValid() const {
+    bool ChunkManager::_isValid( const ChunkMap& chunkMap ) const {
 #define ENSURE(x) do { if(!(x)) { log() << "ChunkManager::_isValid failed: " #x << endl; return false; } } while(0)
 
-        if (_chunkMap.empty())
+        if (chunkMap.empty())
             return true;
 
         // Check endpoints
-        ENSURE(allOfType(MinKey, _chunkMap.begin()->second->getMin()));
-        ENSURE(allOfType(MaxKey, prior(_chunkMap.end())->second->getMax()));
+        ENSURE(allOfType(MinKey, chunkMap.begin()->second->getMin()));
+        ENSURE(allOfType(MaxKey, prior(chunkMap.end())->second->getMax()));
 
         // Make sure there are no gaps or overlaps
-        for (ChunkMap::const_iterator it=boost::next(_chunkMap.begin()), end=_chunkMap.end(); it != end; ++it) {
+        for (ChunkMap::const_iterator it=boost::next(chunkMap.begin()), end=chunkMap.end(); it != end; ++it) {
             ChunkMap::const_iterator last = prior(it);
 
             if (!(it->second->getMin() == last->second->getMax())) {
@@ -624,32 +688,47 @@ namespace mongo {
         return _key.hasShardKey( obj );
     }
 
-    void ChunkManager::createFirstChunk( const Shard& shard ) {
+    void ChunkManager::createFirstChunks( const Shard& primary , const vector<BSONObj>& splitPoints , const vector<Shard>& shards ) {
         assert( _chunkMap.size() == 0 );
 
-        ChunkPtr c( new Chunk(this, _key.globalMin(), _key.globalMax(), shard ) );
+        vector<BSONObj> bounds;
+        bounds.push_back( _key.globalMin() );
+        bounds.insert( bounds.end() , splitPoints.begin() , splitPoints.end() );
+        bounds.push_back( _key.globalMax() );
+        const unsigned numChunks = bounds.size() - 1;
 
-        // this is the first chunk; start the versioning from scratch
+        // these are the first chunks; start the versioning from scratch
         ShardChunkVersion version;
         version.incMajor();
 
-        // build update for the chunk collection
-        BSONObjBuilder chunkBuilder;
-        c->serialize( chunkBuilder , version );
-        BSONObj chunkCmd = chunkBuilder.obj();
-
-        log() << "about to create first chunk for: " << _ns << endl;
+        log() << "about to create " << numChunks << " first chunk(s) for: " << _ns << endl;
 
         ScopedDbConnection conn( configServer.modelServer() );
-        BSONObj res;
-        conn->update( Chunk::chunkMetadataNS, QUERY( "_id" << c->genID() ), chunkCmd,  true, false );
 
-        string errmsg = conn->getLastError();
-        if ( errmsg.size() ) {
-            stringstream ss;
-            ss << "saving first chunk failed.  cmd: " << chunkCmd << " result: " << errmsg;
-            log( LL_ERROR ) << ss.str() << endl;
-            msgasserted( 13592 , ss.str() ); // assert(13592)
+        vector<ChunkPtr> chunks;
+        for ( unsigned i=0; i<numChunks; i++ ) {
+            // each shard gets a contiguous run of chunks
+            const Shard& shard = shards.empty() ? primary : shards[ i * shards.size() / numChunks ];
+            ChunkPtr c( new Chunk(this, bounds[i], bounds[i+1], shard ) );
+
+            // build update for the chunk collection
+            BSONObjBuilder chunkBuilder;
+            c->serialize( chunkBuilder , version );
+            BSONObj chunkCmd = chunkBuilder.obj();
+
+            conn->update( Chunk::chunkMetadataNS, QUERY( "_id" << c->genID() ), chunkCmd,  true, false );
+
+            string errmsg = conn->getLastError();
+            if ( errmsg.size() ) {
+                stringstream ss;
+                ss << "saving first chunk failed.  cmd: " << chunkCmd << " result: " << errmsg;
+                log( LL_ERROR ) << ss.str() << endl;
+                msgasserted( 13592 , ss.str() ); // assert(13592)
+            }
+
+            c->setLastmod( version );
+            chunks.push_back( c );
+            version.incMinor();
         }
 
         conn.done();
@@ -659,21 +738,25 @@ namespace mongo {
         // the last access to ChunkManager by checking the sequence number
         _sequenceNumber = ++NextSequenceNumber;
 
-        _chunkMap[c->getMax()] = c;
+        for ( unsigned i=0; i<chunks.size(); i++ ) {
+            _chunkMap[chunks[i]->getMax()] = chunks[i];
+            _shards.insert( chunks[i]->getShard() );
+        }
         _chunkRanges.reloadAll(_chunkMap);
-        _shards.insert(c->getShard());
-        c->setLastmod(version);
 
         // the ensure index will have the (desired) indirect effect of creating the collection on the
-        // assigned shard, as it sets up the index over the sharding keys.
+        // assigned shards, as it sets up the index over the sharding keys.
         ensureIndex_inlock();
 
-        log() << "successfully created first chunk for " << c->toString() << endl;
+        log() << "successfully created first chunk(s) for " << _ns << " " << chunks.front()->toString()
+              << ( numChunks > 1 ? " ..." : "" ) << endl;
     }
 
     ChunkPtr ChunkManager::findChunk( const BSONObj & obj , bool retry ) {
-        BSONObj key = _key.extractKey(obj);
+        return findChunkForKey( _key.extractKey( obj ) , retry );
+    }
 
+    ChunkPtr ChunkManager::findChunkForKey( const BSONObj& key , bool retry ) {
         {
             rwlock lk( _lock , false );
 
@@ -688,7 +771,7 @@ namespace mongo {
             }
 
             if ( c ) {
-                if ( c->contains( obj ) )
+                if ( c->containsKey( key ) )
                     return c;
 
                 PRINT(foo);
@@ -708,7 +791,7 @@ namespace mongo {
 
         log() << "ChunkManager: couldn't find chunk for: " << key << " going to retry" << endl;
         _reload_inlock();
-        return findChunk( obj , true );
+        return findChunkForKey( key , true );
     }
 
     ChunkPtr ChunkManager::findChunkOnServer( const Shard& shard ) const {
@@ -756,32 +839,33 @@ namespace mongo {
                 }
             }
 
-            BoundList ranges = frs->indexBounds(_key.key(), 1);
-            for (BoundList::const_iterator it=ranges.begin(), end=ranges.end(); it != end; ++it) {
-                BSONObj minObj = it->first.replaceFieldNames(_key.key());
-                BSONObj maxObj = it->second.replaceFieldNames(_key.key());
-
-                DEV PRINT(minObj);
-                DEV PRINT(maxObj);
-
-                ChunkRangeMap::const_iterator min, max;
-                min = _chunkRanges.upper_bound(minObj);
-                max = _chunkRanges.upper_bound(maxObj);
-
-                massert( 13507 , str::stream() << "invalid chunk config minObj: " << minObj , min != _chunkRanges.ranges().end());
-
-                // make max non-inclusive like end iterators
-                if(max != _chunkRanges.ranges().end())
-                    ++max;
-
-                for (ChunkRangeMap::const_iterator it=min; it != max; ++it) {
-                    shards.insert(it->second->getShard());
+            BoundList ranges;
+            if ( _key.isHashed() ) {
+                // only points hash to points: an equality or an $in goes to the chunks of their hashes,
+                // anything else could be anywhere
+                FieldRange range = frs->range( _key.key().firstElement().fieldName() );
+                if ( ! range.inQuery() ) {
+                    getAllShards(shards);
+                    return;
                 }
 
-                // once we know we need to visit all shards no need to keep looping
-                //if (shards.size() == _shards.size())
-                //return;
+                vector<BSONObj> points;
+                const vector<FieldInterval>& intervals = range.intervals();
+                for ( unsigned i=0; i<intervals.size(); i++ )
+                    points.push_back( _key.hashedKey( intervals[i]._lower._bound ) );
+                sort( points.begin() , points.end() , BSONObjCmp() );
+
+                for ( unsigned i=0; i<points.size(); i++ )
+                    ranges.push_back( make_pair( points[i] , points[i] ) );
             }
+            else {
+                ranges = frs->indexBounds(_key.key(), 1);
+            }
+            _chunkRanges.getShardsForBounds(ranges, shards);
+
+            // once we know we need to visit all shards no need to keep looping
+            if (shards.size() == _shards.size())
+                return;
 
             if (fros.moreOrClauses())
                 fros.popOrClause();
@@ -790,6 +874,34 @@ namespace mongo {
         while (fros.moreOrClauses());
     }
 
+    bool ChunkManager::getRangesForQuery( const BSONObj& query , vector< shared_ptr<ChunkRange> >& ranges ) {
+        if ( _key.key().nFields() != 1 || _key.isHashed() )
+            return false;
+
+        rwlock lk( _lock , false );
+
+        FieldRangeOrSet fros(_ns.c_str(), query, false);
+        if ( ! fros.getSpecial().empty() || fros.moreOrClauses() )
+            return false;
+
+        boost::scoped_ptr<FieldRangeSet> frs (fros.topFrs());
+        BoundList bounds = frs->indexBounds(_key.key(), 1);
+
+        const ChunkRangeMap& all = _chunkRanges.ranges();
+        unsigned b = 0;
+        for ( ChunkRangeMap::const_iterator i = all.begin(); i != all.end() && b < bounds.size(); ++i ) {
+            const ChunkRange& r = *i->second;
+
+            // the bounds are sorted, so one that ends before this range ends before the next ones too
+            while ( b < bounds.size() && bounds[b].second.woCompare( r.getMin() , BSONObj() , false ) < 0 )
+                b++;
+
+            if ( b < bounds.size() && bounds[b].first.woCompare( r.getMax() , BSONObj() , false ) < 0 )
+                ranges.push_back( i->second );
+        }
+        return true;
+    }
+
     void ChunkManager::getShardsForRange(set<Shard>& shards, const BSONObj& min, const BSONObj& max) {
         uassert(13405, "min must have shard key", hasShardKey(min));
         uassert(13406, "max must have shard key", hasShardKey(max));
@@ -1056,12 +1168,15 @@ namespace mongo {
             }
         }
 
+        _table.reload(_ranges);
+
         DEV assertValid();
     }
 
     void ChunkRangeManager::reloadAll(const ChunkMap& chunks) {
         _ranges.clear();
         _insertRange(chunks.begin(), chunks.end());
+        _table.reload(_ranges);
 
         DEV assertValid();
     }
@@ -1078,6 +1193,188 @@ namespace mongo {
         }
     }
 
+    // -------  ChunkRoutingTable --------
+
+    namespace {
+        void appendBigEndian( string& out , unsigned long long x ) {
+            for ( int shift=56; shift>=0; shift-=8 )
+                out += (char)( ( x >> shift ) & 0xff );
+        }
+
+        bool keyStringLess( const string& l , const string& r ) {
+            size_t n = min( l.size() , r.size() );
+            int c = memcmp( l.data() , r.data() , n );
+            if ( c )
+                return c < 0;
+            return l.size() < r.size();
+        }
+
+        bool keyLess( const BSONObj& l , const BSONObj& r ) {
+            // bounds from indexBounds have no field names
+            return l.woCompare( r , BSONObj() , false ) < 0;
+        }
+    }
+
+    bool ChunkRoutingTable::keyString( const BSONObj& key , string& out ) {
+        out.clear();
+
+        BSONObjIterator i( key );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+
+            // MinKey's canonical type is -1
+            out += (char)( e.canonicalType() + 1 );
+
+            switch ( e.type() ) {
+            case MinKey:
+            case MaxKey:
+            case jstNULL:
+            case Undefined:
+                break;
+
+            case NumberInt:
+            case NumberLong:
+            case NumberDouble: {
+                // woCompare compares these as doubles, other than long to long
+                double d;
+                if ( e.type() == NumberLong ) {
+                    long long x = e.numberLong();
+                    const long long exact = 1LL << 53;
+                    if ( x > exact || x < -exact )
+                        return false;
+                    d = (double)x;
+                }
+                else {
+                    d = e.number();
+                }
+
+                // woCompare puts NaN and infinities below all numbers, and equal to each other
+                if ( ! ( d <= numeric_limits<double>::max() && d >= -numeric_limits<double>::max() ) )
+                    return false;
+                if ( d == 0 )
+                    d = 0; // -0
+
+                // ieee doubles order like sign-magnitude integers: flip the sign bit of positives, all bits of negatives
+                unsigned long long bits;
+                memcpy( &bits , &d , sizeof(bits) );
+                if ( bits >> 63 )
+                    bits = ~bits;
+                else
+                    bits |= 1ULL << 63;
+                appendBigEndian( out , bits );
+                break;
+            }
+
+            case String:
+            case Symbol:
+                // strcmp: up to the first nul
+                out += e.valuestr();
+                out += '\0';
+                break;
+
+            case jstOID:
+                out.append( e.value() , 12 );
+                break;
+
+            case Bool:
+                out += *e.value();
+                break;
+
+            case Date:
+            case Timestamp:
+                appendBigEndian( out , e.date() );
+                break;
+
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ChunkRoutingTable::clear() {
+        _max.clear();
+        _maxStr.clear();
+        _encoded = true;
+        _shardOf.clear();
+        _shards.clear();
+    }
+
+    void ChunkRoutingTable::reload( const ChunkRangeMap& ranges ) {
+        clear();
+        _max.reserve( ranges.size() );
+        _shardOf.reserve( ranges.size() );
+        for ( ChunkRangeMap::const_iterator i=ranges.begin(); i!=ranges.end(); ++i )
+            add( i->second->getMax() , i->second->getShard() );
+    }
+
+    void ChunkRoutingTable::add( const BSONObj& max , const Shard& shard ) {
+        DEV if ( _max.size() ) assert( keyLess( _max.back() , max ) );
+
+        _max.push_back( max );
+
+        if ( _encoded ) {
+            string s;
+            if ( keyString( max , s ) ) {
+                _maxStr.push_back( s );
+            }
+            else {
+                _encoded = false;
+                _maxStr.clear();
+            }
+        }
+
+        unsigned n = 0;
+        while ( n < _shards.size() && ! ( _shards[n] == shard ) )
+            n++;
+        if ( n == _shards.size() )
+            _shards.push_back( shard );
+        _shardOf.push_back( n );
+    }
+
+    unsigned ChunkRoutingTable::_upperBound( const BSONObj& key , const string * keyStr , unsigned from ) const {
+        if ( keyStr )
+            return upper_bound( _maxStr.begin() + from , _maxStr.end() , *keyStr , keyStringLess ) - _maxStr.begin();
+        return upper_bound( _max.begin() + from , _max.end() , key , keyLess ) - _max.begin();
+    }
+
+    void ChunkRoutingTable::getShardsForBounds( const vector< pair<BSONObj,BSONObj> >& bounds , set<Shard>& shards ) const {
+        if ( _max.empty() )
+            return;
+
+        vector<bool> seen( _shards.size() , false );
+        unsigned numSeen = 0;
+
+        string minStr , maxStr;
+        unsigned pos = 0;
+        for ( unsigned i=0; i<bounds.size() && numSeen < _shards.size(); i++ ) {
+            const BSONObj& min = bounds[i].first;
+            const BSONObj& max = bounds[i].second;
+
+            bool useStr = _encoded && keyString( min , minStr ) && keyString( max , maxStr );
+
+            // sorted bounds: where the last one ended is as far back as this one can start
+            unsigned lo = _upperBound( min , useStr ? &minStr : 0 , pos );
+            massert( 13507 , str::stream() << "invalid chunk config minObj: " << min , lo < _max.size() );
+
+            unsigned hi = _upperBound( max , useStr ? &maxStr : 0 , lo );
+            if ( hi == _max.size() )
+                hi--;
+
+            for ( unsigned j=lo; j<=hi && numSeen < _shards.size(); j++ ) {
+                if ( ! seen[ _shardOf[j] ] ) {
+                    seen[ _shardOf[j] ] = true;
+                    numSeen++;
+                }
+            }
+            pos = hi;
+        }
+
+        for ( unsigned i=0; i<_shards.size(); i++ )
+            if ( seen[i] )
+                shards.insert( _shards[i] );
+    }
+
     int ChunkManager::getCurrentDesiredChunkSize() const {
         // split faster in early chunks helps spread out an initial load better
         const int minChunkSize = 1 << 20;  // 1 MBytes
@@ -1134,7 +1431,7 @@ namespace mongo {
     // NOTE (careful when deprecating)
     //   currently the sharding is enabled because of a write or read (as opposed to a split or migrate), the shard learns
     //   its name and through the 'setShardVersion' command call
-    bool setShardVersion( DBClientBase & conn , const string& ns , ShardChunkVersion version , bool authoritative , BSONObj& result ) {
+    BSONObj setShardVersionCommand( DBClientBase & conn , const string& ns , ShardChunkVersion version , bool authoritative ) {
         BSONObjBuilder cmdBuilder;
         cmdBuilder.append( "setShardVersion" , ns.c_str() );
         cmdBuilder.append( "configdb" , configServer.modelServer() );
@@ -1146,9 +1443,13 @@ namespace mongo {
         Shard s = Shard::make( conn.getServerAddress() );
         cmdBuilder.append( "shard" , s.getName() );
         cmdBuilder.append( "shardHost" , s.getConnString() );
-        BSONObj cmd = cmdBuilder.obj();
+        return cmdBuilder.obj();
+    }
+
+    bool setShardVersion( DBClientBase & conn , const string& ns , ShardChunkVersion version , bool authoritative , BSONObj& result ) {
+        BSONObj cmd = setShardVersionCommand( conn , ns , version , authoritative );
 
-        log(1) << "    setShardVersion  " << s.getName() << " " << conn.getServerAddress() << "  " << ns << "  " << cmd << " " << &conn << endl;
+        log(1) << "    setShardVersion  " << cmd["shard"].valuestrsafe() << " " << conn.getServerAddress() << "  " << ns << "  " << cmd << " " << &conn << endl;
 
         return conn.runCommand( "admin" , cmd , result );
     }
@@ -77,7 +77,9 @@ namespace mongo {
         bool minIsInf() const;
         bool maxIsInf() const;
 
+        /** @param obj a document, whose shard key is looked for */
         bool contains( const BSONObj& obj ) const;
+        bool containsKey( const BSONObj& key ) const;
 
         string genID() const;
         static string genID( const string& ns , const BSONObj& min );
@@ -268,11 +270,59 @@ namespace mongo {
     };
 
 
+    /**
+     * the ranges of a ChunkRangeManager as sorted flat arrays, for routing queries.
+     * range i is [ max of range i-1 , max of range i ) and lives on _shards[_shardOf[i]].
+     * when every max can be written as a key string (see keyString) lookups are memcmps
+     * rather than BSONObj compares.
+     */
+    class ChunkRoutingTable {
+    public:
+        ChunkRoutingTable() : _encoded( true ) {}
+
+        void clear();
+        void reload( const ChunkRangeMap& ranges );
+
+        /** appends a range; they have to come in order */
+        void add( const BSONObj& max , const Shard& shard );
+
+        /**
+         * adds the shards of the ranges that overlap any of bounds.
+         * bounds are inclusive, sorted and disjoint, as from FieldRangeSet::indexBounds, so all
+         * of them, e.g. one per $in value, are resolved in a single forward pass over the table.
+         */
+        void getShardsForBounds( const vector< pair<BSONObj,BSONObj> >& bounds , set<Shard>& shards ) const;
+
+        int size() const { return _max.size(); }
+
+        /**
+         * a byte string that memcmp orders the way woCompare orders keys of the same pattern.
+         * @return false if key has a value that can't be written that way: objects, arrays,
+         *         binary, regexes, code, NaN and infinities, and longs past 2^53
+         */
+        static bool keyString( const BSONObj& key , string& out );
+
+    private:
+        /** @return the first range from from on whose max is greater than key */
+        unsigned _upperBound( const BSONObj& key , const string * keyStr , unsigned from ) const;
+
+        vector<BSONObj> _max;
+        vector<string> _maxStr;      // only if _encoded
+        bool _encoded;
+        vector<unsigned> _shardOf;
+        vector<Shard> _shards;       // each once
+    };
+
     class ChunkRangeManager {
     public:
         const ChunkRangeMap& ranges() const { return _ranges; }
 
-        void clear() { _ranges.clear(); }
+        void clear() { _ranges.clear(); _table.clear(); }
+
+        /** see ChunkRoutingTable::getShardsForBounds */
+        void getShardsForBounds( const vector< pair<BSONObj,BSONObj> >& bounds , set<Shard>& shards ) const {
+            _table.getShardsForBounds( bounds , shards );
+        }
 
         void reloadAll(const ChunkMap& chunks);
         void reloadRange(const ChunkMap& chunks, const BSONObj& min, const BSONObj& max);
@@ -288,6 +338,7 @@ namespace mongo {
         void _insertRange(ChunkMap::const_iterator begin, const ChunkMap::const_iterator end);
 
         ChunkRangeMap _ranges;
+        ChunkRoutingTable _table;
     };
 
     /* config.sharding
@@ -307,8 +358,16 @@ namespace mongo {
         int numChunks() const { rwlock lk( _lock , false ); return _chunkMap.size(); }
         bool hasShardKey( const BSONObj& obj );
 
-        void createFirstChunk( const Shard& shard );
+        /**
+         * creates the collection's first chunks, one per interval between the split points (a single chunk if there
+         * are none). the chunks are handed out to 'shards' in contiguous runs, or all go to 'primary' if it is empty.
+         */
+        void createFirstChunks( const Shard& primary , const vector<BSONObj>& splitPoints = vector<BSONObj>() ,
+                                const vector<Shard>& shards = vector<Shard>() );
+        /** @param obj a document or query, whose shard key is looked for */
         ChunkPtr findChunk( const BSONObj& obj , bool retry = false );
+        /** @param key a shard key, e.g. a chunk's min */
+        ChunkPtr findChunkForKey( const BSONObj& key , bool retry = false );
         ChunkPtr findChunkOnServer( const Shard& shard ) const;
 
         const ShardKeyPattern& getShardKey() const {  return _key; }
@@ -320,8 +379,19 @@ namespace mongo {
         void getAllShards( set<Shard>& all );
         void getShardsForRange(set<Shard>& shards, const BSONObj& min, const BSONObj& max); // [min, max)
 
+        /**
+         * the ranges a query touches, in key order.  for reading them one after the other when the query is
+         * sorted on the shard key.
+         * @return false if the query doesn't map onto ranges of a single key field: a compound or hashed shard
+         *         key, an $or, a special query
+         */
+        bool getRangesForQuery( const BSONObj& query , vector< shared_ptr<ChunkRange> >& ranges );
+
         string toString() const;
 
+        /** picks up the chunks that changed on the config server since the last load */
+        void reload() { _reload(); }
+
         ShardChunkVersion getVersion( const Shard& shard ) const;
         ShardChunkVersion getVersion() const;
 
@@ -347,7 +417,13 @@ namespace mongo {
     private:
         void _reload();
         void _reload_inlock();
-        void _load();
+
+        /**
+         * reads from the config server the chunks that changed since 'chunkMap' was current (all of them, if it's empty)
+         * and puts them in it, in place of the chunks they overlap
+         * @return number of chunk documents read, -1 if the config server's chunks are older than those in 'chunkMap'
+         */
+        int _load( ChunkMap& chunkMap );
 
         void ensureIndex_inlock();
 
@@ -369,7 +445,7 @@ namespace mongo {
         friend class ChunkRangeManager; // only needed for CRM::assertValid()
         static AtomicUInt NextSequenceNumber;
 
-        bool _isValid() const;
+        bool _isValid( const ChunkMap& chunkMap ) const;
     };
 
     // like BSONObjCmp. for use as an STL comparison functor
@@ -406,6 +482,7 @@ namespace mongo {
     */
     inline string Chunk::genID() const { return genID(_manager->getns(), _min); }
 
+    BSONObj setShardVersionCommand( DBClientBase & conn , const string& ns , ShardChunkVersion version , bool authoritative );
     bool setShardVersion( DBClientBase & conn , const string& ns , ShardChunkVersion version , bool authoritative , BSONObj& result );
 
 } // namespace mongo
@@ -145,6 +145,7 @@ namespace mongo {
                 }
 
                 result.append( "shardCursorType" , shardedCursorTypes.getObj() );
+                result.append( "setShardVersion" , setShardVersionTypes.getObj() );
 
                 {
                     BSONObjBuilder asserts( result.subobjStart( "asserts" ) );
@@ -337,7 +338,10 @@ namespace mongo {
             virtual void help( stringstream& help ) const {
                 help
                         << "Shard a collection.  Requires key.  Optional unique. Sharding must already be enabled for the database.\n"
-                        << "  { enablesharding : \"<dbname>\" }\n";
+                        << "  { enablesharding : \"<dbname>\" }\n"
+                        << "A key of a single hashed field spreads documents by the hash of the field.  An empty collection\n"
+                        << "is then split right away, in numInitialChunks chunks (default: 2 per shard) over all the shards.\n"
+                        << "  { shardcollection : \"<ns>\" , key : { <field> : \"hashed\" } , numInitialChunks : <n> }\n";
             }
 
             bool run(const string& , BSONObj& cmdObj, string& errmsg, BSONObjBuilder& result, bool) {
@@ -364,12 +368,25 @@ namespace mongo {
                     return false;
                 }
 
-                BSONForEach(e, key) {
-                    if (!e.isNumber() || e.number() != 1.0) {
-                        errmsg = "shard keys must all be ascending";
+                const bool hashed = key.firstElement().type() == String;
+                if ( hashed ) {
+                    if ( key.nFields() != 1 || key.firstElement().str() != "hashed" ) {
+                        errmsg = "a hashed shard key must be a single field: { <field> : \"hashed\" }";
+                        return false;
+                    }
+                    if ( cmdObj["unique"].trueValue() ) {
+                        errmsg = "hashed shard keys can't be unique";
                         return false;
                     }
                 }
+                else {
+                    BSONForEach(e, key) {
+                        if (!e.isNumber() || e.number() != 1.0) {
+                            errmsg = "shard keys must all be ascending";
+                            return false;
+                        }
+                    }
+                }
 
                 if ( ns.find( ".system." ) != string::npos ) {
                     errmsg = "can't shard system namespaces";
@@ -393,6 +410,7 @@ namespace mongo {
                 //
                 // We enforce both these conditions in what comes next.
 
+                bool isEmpty;
                 {
                     ShardKeyPattern proposedKey( key );
                     bool hasShardIndex = false;
@@ -443,7 +461,8 @@ namespace mongo {
                         }
                     }
 
-                    if ( ! hasShardIndex && ( conn->count( ns ) != 0 ) ) {
+                    isEmpty = ( conn->count( ns ) == 0 );
+                    if ( ! hasShardIndex && ! isEmpty ) {
                         errmsg = "please create an index over the sharding key before sharding.";
                         conn.done();
                         return false;
@@ -452,9 +471,30 @@ namespace mongo {
                     conn.done();
                 }
 
+                // the hashes of an empty collection's future documents are spread evenly, so it can start out
+                // in evenly sized chunks over all the shards, rather than wait for the splits and the balancer
+                vector<BSONObj> initPoints;
+                vector<Shard> initShards;
+                if ( hashed && isEmpty ) {
+                    Shard::getAllShards( initShards );
+
+                    long long numChunks = cmdObj["numInitialChunks"].numberLong();
+                    if ( numChunks <= 0 )
+                        numChunks = 2 * initShards.size();
+                    if ( numChunks > 8192 ) {
+                        errmsg = "numInitialChunks can't be more than 8192";
+                        return false;
+                    }
+
+                    const unsigned long long interval = numeric_limits<unsigned long long>::max() / numChunks;
+                    const unsigned long long first = (unsigned long long)numeric_limits<long long>::min();
+                    for ( long long i=1; i<numChunks; i++ )
+                        initPoints.push_back( BSON( key.firstElement().fieldName() << (long long)( first + i * interval ) ) );
+                }
+
                 tlog() << "CMD: shardcollection: " << cmdObj << endl;
 
-                config->shardCollection( ns , key , cmdObj["unique"].trueValue() );
+                config->shardCollection( ns , key , cmdObj["unique"].trueValue() , initPoints , initShards );
 
                 result << "collectionsharded" << ns;
                 return true;
@@ -526,18 +566,15 @@ namespace mongo {
                 }
 
                 BSONObj find = cmdObj.getObjectField( "find" );
-                if ( find.isEmpty() ) {
-                    find = cmdObj.getObjectField( "middle" );
-
-                    if ( find.isEmpty() ) {
-                        errmsg = "need to specify find or middle";
-                        return false;
-                    }
+                BSONObj middle = cmdObj.getObjectField( "middle" );
+                if ( find.isEmpty() && middle.isEmpty() ) {
+                    errmsg = "need to specify find or middle";
+                    return false;
                 }
 
+                // 'middle' is a shard key already, e.g. a hash for a hashed shard key, while 'find' is a query
                 ChunkManagerPtr info = config->getChunkManager( ns );
-                ChunkPtr chunk = info->findChunk( find );
-                BSONObj middle = cmdObj.getObjectField( "middle" );
+                ChunkPtr chunk = find.isEmpty() ? info->findChunkForKey( middle ) : info->findChunk( find );
 
                 assert( chunk.get() );
                 log() << "splitting: " << ns << "  shard: " << chunk << endl;
@@ -24,6 +24,7 @@
 #include "../client/parallel.h"
 #include "../db/commands.h"
 #include "../db/query.h"
+#include "../db/pipeline.h"
 
 #include "config.h"
 #include "chunk.h"
@@ -56,6 +57,35 @@ namespace mongo {
                 return _passthrough("admin", conf, cmdObj, result);
             }
 
+            /**
+             * runs cmd on all of shards at once, each over a ShardConnection for ns so that the shard version goes
+             * along as for any other operation.  results come back in the order of shards.
+             * @param checkVersion if a connection has to have its version set first, the ChunkManager the shards
+             *        came from may be out of date: nothing is run then, and false returned
+             */
+            bool runOnShards( const set<Shard>& shards , const string& ns , const string& db , const BSONObj& cmd ,
+                              bool checkVersion , vector< shared_ptr<Future::CommandResult> >& results ) {
+                vector< shared_ptr<ShardConnection> > conns;
+                for ( set<Shard>::const_iterator i=shards.begin(), end=shards.end(); i != end; ++i ) {
+                    shared_ptr<ShardConnection> conn( new ShardConnection( *i , ns ) );
+                    conns.push_back( conn );
+                    if ( checkVersion && conn->setVersion() ) {
+                        for ( unsigned j=0; j<conns.size(); j++ )
+                            conns[j]->done();
+                        return false;
+                    }
+                }
+
+                for ( unsigned i=0; i<conns.size(); i++ )
+                    results.push_back( Future::spawnCommand( conns[i]->getHost() , db , cmd , conns[i]->get() ) );
+
+                for ( unsigned i=0; i<results.size(); i++ ) {
+                    results[i]->join();
+                    conns[i]->done();
+                }
+                return true;
+            }
+
         private:
             bool _passthrough(const string& db,  DBConfigPtr conf, const BSONObj& cmdObj , BSONObjBuilder& result ) {
                 ShardConnection conn( conf->getPrimary() , "" );
@@ -373,6 +403,16 @@ namespace mongo {
                     }
                 }
 
+                // each shard needs to count no further than skip+limit for the sum to give the same answer
+                BSONObjBuilder shardCmd;
+                shardCmd.append( "count" , collection );
+                shardCmd.append( "query" , filter );
+                if ( cmdObj["limit"].isNumber() && cmdObj["limit"].numberLong() > 0 ) {
+                    long long skip = cmdObj["skip"].isNumber() ? max( 0LL , cmdObj["skip"].numberLong() ) : 0;
+                    shardCmd.appendNumber( "limit" , skip + cmdObj["limit"].numberLong() );
+                }
+                BSONObj shardCountCmd = shardCmd.obj();
+
                 long long total = 0;
                 map<string,long long> shardCounts;
 
@@ -387,24 +427,18 @@ namespace mongo {
                     cm->getShardsForQuery( shards , filter );
                     assert( shards.size() );
 
-                    bool hadToBreak = false;
-
-                    for (set<Shard>::iterator it=shards.begin(), end=shards.end(); it != end; ++it) {
-                        ShardConnection conn(*it, fullns);
-                        if ( conn.setVersion() ) {
-                            total = 0;
-                            shardCounts.clear();
-                            cm = conf->getChunkManager( fullns );
-                            conn.done();
-                            hadToBreak = true;
-                            break;
-                        }
+                    vector< shared_ptr<Future::CommandResult> > counts;
+                    if ( ! runOnShards( shards , fullns , dbName , shardCountCmd , true , counts ) ) {
+                        cm = conf->getChunkManager( fullns );
+                        continue;
+                    }
 
-                        BSONObj temp;
-                        bool ok = conn->runCommand( dbName , BSON( "count" << collection << "query" << filter ) , temp );
-                        conn.done();
+                    bool stale = false;
+                    set<Shard>::iterator it = shards.begin();
+                    for ( unsigned i=0; i<counts.size(); i++, ++it ) {
+                        BSONObj temp = counts[i]->result();
 
-                        if ( ok ) {
+                        if ( counts[i]->ok() ) {
                             long long mine = temp["n"].numberLong();
                             total += mine;
                             shardCounts[it->getName()] = mine;
@@ -413,11 +447,8 @@ namespace mongo {
 
                         if ( StaleConfigInContextCode == temp["code"].numberInt() ) {
                             // my version is old
-                            total = 0;
-                            shardCounts.clear();
-                            cm = conf->getChunkManager( fullns , true );
-                            hadToBreak = true;
-                            break;
+                            stale = true;
+                            continue;
                         }
 
                         // command failed :(
@@ -425,8 +456,13 @@ namespace mongo {
                         result.append( "cause" , temp );
                         return false;
                     }
-                    if ( ! hadToBreak )
+
+                    if ( ! stale )
                         break;
+
+                    total = 0;
+                    shardCounts.clear();
+                    cm = conf->getChunkManager( fullns , true );
                 }
 
                 total = applySkipLimit( total , cmdObj );
@@ -648,41 +684,151 @@ namespace mongo {
                 set<Shard> shards;
                 cm->getShardsForQuery(shards, query);
 
-                set<BSONObj,BSONObjCmp> all;
-                int size = 32;
+                BSONObjBuilder shardCmd;
+                shardCmd.appendElements( cmdObj );
+                if ( ! cmdObj["sorted"].trueValue() )
+                    shardCmd.appendBool( "sorted" , true );
 
-                for ( set<Shard>::iterator i=shards.begin(), end=shards.end() ; i != end; ++i ) {
-                    ShardConnection conn( *i , fullns );
-                    BSONObj res;
-                    bool ok = conn->runCommand( conf->getName() , cmdObj , res );
-                    conn.done();
+                vector< shared_ptr<Future::CommandResult> > shardResults;
+                runOnShards( shards , fullns , conf->getName() , shardCmd.obj() , false , shardResults );
 
-                    if ( ! ok ) {
+                // each shard's values are distinct already and, unless it is one that can't sort them, in order
+                vector< vector<BSONElement> > values( shardResults.size() );
+                for ( unsigned i=0; i<shardResults.size(); i++ ) {
+                    BSONObj res = shardResults[i]->result();
+                    if ( ! shardResults[i]->ok() ) {
                         result.appendElements( res );
                         return false;
                     }
 
-                    BSONObjIterator it( res["values"].embeddedObject() );
-                    while ( it.more() ) {
-                        BSONElement nxt = it.next();
-                        BSONObjBuilder temp(32);
-                        temp.appendAs( nxt , "" );
-                        all.insert( temp.obj() );
+                    res["values"].embeddedObject().elems( values[i] );
+                    if ( ! res["sorted"].trueValue() )
+                        sort( values[i].begin() , values[i].end() , BSONElementCmpWithoutField() );
+                }
+
+                // merge them, dropping a value seen on more than one shard
+                BSONArrayBuilder b( result.subarrayStart( "values" ) );
+                vector<unsigned> pos( values.size() , 0 );
+                BSONElement last;
+                while ( true ) {
+                    int next = -1;
+                    for ( unsigned i=0; i<values.size(); i++ ) {
+                        if ( pos[i] == values[i].size() )
+                            continue;
+                        if ( next < 0 || values[i][pos[i]].woCompare( values[next][pos[next]] , false ) < 0 )
+                            next = i;
                     }
+                    if ( next < 0 )
+                        break;
 
-                }
+                    BSONElement e = values[next][pos[next]++];
+                    if ( ! last.eoo() && last.woCompare( e , false ) == 0 )
+                        continue;
 
-                BSONObjBuilder b( size );
-                int n=0;
-                for ( set<BSONObj,BSONObjCmp>::iterator i = all.begin() ; i != all.end(); i++ ) {
-                    b.appendAs( i->firstElement() , b.numStr( n++ ) );
+                    uassert( 14078 , "distinct too big, 16mb cap" , b.len() + e.size() + 1024 < BSONObjMaxUserSize );
+                    b.append( e );
+                    last = e;
                 }
+                b.done();
 
-                result.appendArray( "values" , b.obj() );
                 return true;
             }
         } disinctCmd;
 
+        class AggregateCmd : public PublicGridCommand {
+        public:
+            AggregateCmd() : PublicGridCommand("aggregate") {}
+            virtual void help( stringstream &help ) const {
+                help << "{ aggregate : 'collection name' , pipeline : [ { $match : {...} } , { $group : {...} } , ... ] }";
+            }
+            bool run(const string& dbName , BSONObj& cmdObj, string& errmsg, BSONObjBuilder& result, bool) {
+                string collection = cmdObj.firstElement().valuestrsafe();
+                string fullns = dbName + "." + collection;
+
+                if ( cmdObj["pipeline"].type() != Array ) {
+                    errmsg = "pipeline has to be an array of stages";
+                    return false;
+                }
+
+                // checked here too, as the shards take internal stages from us
+                Pipeline whole;
+                if ( ! whole.init( cmdObj["pipeline"].embeddedObject() , errmsg ) )
+                    return false;
+
+                DBConfigPtr conf = grid.getDBConfig( dbName , false );
+
+                if ( ! conf || ! conf->isShardingEnabled() || ! conf->isSharded( fullns ) ) {
+                    return passthrough( conf , cmdObj , result );
+                }
+
+                // the shards all run their part at once, we merge what they send back
+                BSONArrayBuilder shardPart;
+                BSONArrayBuilder mergePart;
+                Pipeline::split( cmdObj["pipeline"].embeddedObject() , shardPart , mergePart );
+                BSONArray shardStages = shardPart.arr();
+
+                Pipeline merge;
+                if ( ! merge.init( mergePart.arr() , errmsg , true ) )
+                    return false;
+
+                BSONObj shardCmd = BSON( "aggregate" << collection << "pipeline" << shardStages );
+
+                vector< shared_ptr<Future::CommandResult> > shardResults;
+                ChunkManagerPtr cm = conf->getChunkManager( fullns );
+                while ( true ) {
+                    if ( ! cm ) {
+                        // probably unsharded now
+                        return passthrough( conf , cmdObj , result );
+                    }
+
+                    set<Shard> shards;
+                    cm->getShardsForQuery( shards , whole.query() );
+
+                    shardResults.clear();
+                    if ( ! runOnShards( shards , fullns , conf->getName() , shardCmd , true , shardResults ) ) {
+                        cm = conf->getChunkManager( fullns );
+                        continue;
+                    }
+
+                    bool stale = false;
+                    for ( unsigned i=0; i<shardResults.size(); i++ ) {
+                        if ( shardResults[i]->ok() )
+                            continue;
+
+                        BSONObj res = shardResults[i]->result();
+                        if ( StaleConfigInContextCode == res["code"].numberInt() ) {
+                            // my version is old
+                            stale = true;
+                            continue;
+                        }
+
+                        result.appendElements( res );
+                        return false;
+                    }
+
+                    if ( ! stale )
+                        break;
+
+                    cm = conf->getChunkManager( fullns , true );
+                }
+
+                shared_ptr<ArraySource> input( new ArraySource() );
+                for ( unsigned i=0; i<shardResults.size(); i++ ) {
+                    BSONObjIterator it( shardResults[i]->result()["result"].embeddedObjectUserCheck() );
+                    while ( it.more() ) {
+                        BSONElement e = it.next();
+                        if ( e.type() == Object )
+                            input->add( e.embeddedObject() );
+                    }
+                }
+
+                BSONArrayBuilder arr( result.subarrayStart( "result" ) );
+                merge.run( input , arr );
+                arr.done();
+                return true;
+            }
+        } aggregateCmd;
+
         class FileMD5Cmd : public PublicGridCommand {
         public:
             FileMD5Cmd() : PublicGridCommand("filemd5") {}
@@ -755,7 +901,8 @@ namespace mongo {
                     shardArray.append(i->getName());
                 }
 
-                multimap<double, BSONObj> results; // TODO: maybe use merge-sort instead
+                // every shard gets num and maxDistance as they are, and returns its nearest in order of distance
+                vector< vector<BSONElement> > shardResults;
                 string nearStr;
                 double time = 0;
                 double btreelocs = 0;
@@ -774,11 +921,8 @@ namespace mongo {
                     nscanned += res->result()["stats"]["nscanned"].Number();
                     objectsLoaded += res->result()["stats"]["objectsLoaded"].Number();
 
-                    BSONForEach(obj, res->result()["results"].embeddedObject()) {
-                        results.insert(make_pair(obj["dis"].Number(), obj.embeddedObject().getOwned()));
-                    }
-
-                    // TODO: maybe shrink results if size() > limit
+                    shardResults.push_back( vector<BSONElement>() );
+                    res->result()["results"].embeddedObject().elems( shardResults.back() );
                 }
 
                 result.append("ns" , fullns);
@@ -789,11 +933,24 @@ namespace mongo {
                 double maxDistance = 0;
                 {
                     BSONArrayBuilder sub (result.subarrayStart("results"));
-                    for (multimap<double, BSONObj>::const_iterator it(results.begin()), end(results.end()); it!= end && outCount < limit; ++it, ++outCount) {
-                        totalDistance += it->first;
-                        maxDistance = it->first; // guaranteed to be highest so far
+                    vector<unsigned> pos( shardResults.size() , 0 );
+                    while ( outCount < limit ) {
+                        int next = -1;
+                        for ( unsigned i=0; i<shardResults.size(); i++ ) {
+                            if ( pos[i] == shardResults[i].size() )
+                                continue;
+                            if ( next < 0 || shardResults[i][pos[i]]["dis"].Number() < shardResults[next][pos[next]]["dis"].Number() )
+                                next = i;
+                        }
+                        if ( next < 0 )
+                            break;
+
+                        BSONElement obj = shardResults[next][pos[next]++];
+                        totalDistance += obj["dis"].Number();
+                        maxDistance = obj["dis"].Number(); // guaranteed to be highest so far
 
-                        sub.append(it->second);
+                        sub.append(obj);
+                        outCount++;
                     }
                     sub.done();
                 }
@@ -53,10 +53,23 @@ namespace mongo {
     DBConfig::CollectionInfo::CollectionInfo( const BSONObj& in ) {
         _dirty = false;
         _dropped = in["dropped"].trueValue();
+        _lastmod = in["lastmod"].type() == Date ? in["lastmod"].date() : Date_t( 0 );
         if ( in["key"].isABSONObj() )
             shard( in["_id"].String() , in["key"].Obj() , in["unique"].trueValue() );
     }
 
+    void DBConfig::CollectionInfo::refresh( const BSONObj& in ) {
+        if ( _cm && ! in["dropped"].trueValue() && in["key"].isABSONObj() &&
+                in["lastmod"].type() == Date && in["lastmod"].date() == _lastmod &&
+                _cm->getShardKey().key().woCompare( in["key"].Obj() ) == 0 &&
+                _cm->isUnique() == in["unique"].trueValue() ) {
+            _cm->reload();
+            return;
+        }
+
+        *this = CollectionInfo( in );
+    }
+
 
     void DBConfig::CollectionInfo::shard( const string& ns , const ShardKeyPattern& key , bool unique ) {
         _cm.reset( new ChunkManager( ns , key , unique ) );
@@ -75,7 +88,8 @@ namespace mongo {
 
         BSONObjBuilder val;
         val.append( "_id" , ns );
-        val.appendDate( "lastmod" , time(0) );
+        _lastmod = time(0);
+        val.appendDate( "lastmod" , _lastmod );
         val.appendBool( "dropped" , _dropped );
         if ( _cm )
             _cm->getInfo( val );
@@ -123,7 +137,8 @@ namespace mongo {
         _save();
     }
 
-    ChunkManagerPtr DBConfig::shardCollection( const string& ns , ShardKeyPattern fieldsAndOrder , bool unique ) {
+    ChunkManagerPtr DBConfig::shardCollection( const string& ns , ShardKeyPattern fieldsAndOrder , bool unique ,
+                                               const vector<BSONObj>& initPoints , const vector<Shard>& initShards ) {
         uassert( 8042 , "db doesn't have sharding enabled" , _shardingEnabled );
         uassert( 13648 , str::stream() << "can't shard collection because not all config servers are up" , configServer.allUp() );
         
@@ -135,16 +150,17 @@ namespace mongo {
         log() << "enable sharding on: " << ns << " with shard key: " << fieldsAndOrder << endl;
 
         // From this point on, 'ns' is going to be treated as a sharded collection. We assume this is the first
-        // time it is seen by the sharded system and thus create the first chunk for the collection. All the remaining
+        // time it is seen by the sharded system and thus create the first chunks for the collection. All the remaining
         // chunks will be created as a by-product of splitting.
         ci.shard( ns , fieldsAndOrder , unique );
         ChunkManagerPtr cm = ci.getCM();
         uassert( 13449 , "collections already sharded" , (cm->numChunks() == 0) );
-        cm->createFirstChunk( getPrimary() );
+        cm->createFirstChunks( getPrimary() , initPoints , initShards );
         _save();
 
         try {
-            cm->maybeChunkCollection();
+            if ( cm->numChunks() == 1 )
+                cm->maybeChunkCollection();
         }
         catch ( UserException& e ) {
             // failure to chunk is not critical enough to abort the command (and undo the _save()'d configDB state)
@@ -237,7 +253,13 @@ namespace mongo {
         assert( cursor.get() );
         while ( cursor->more() ) {
             BSONObj o = cursor->next();
-            _collections[o["_id"].String()] = CollectionInfo( o );
+            string ns = o["_id"].String();
+
+            Collections::iterator i = _collections.find( ns );
+            if ( i == _collections.end() )
+                _collections[ns] = CollectionInfo( o );
+            else
+                i->second.refresh( o );
         }
 
         conn.done();
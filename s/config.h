@@ -69,6 +69,7 @@ namespace mongo {
             CollectionInfo() {
                 _dirty = false;
                 _dropped = false;
+                _lastmod = 0;
             }
 
             CollectionInfo( const BSONObj& in );
@@ -84,6 +85,12 @@ namespace mongo {
             void shard( const string& ns , const ShardKeyPattern& key , bool unique );
             void unshard();
 
+            /**
+             * takes a newer config.collections entry for this collection. if it is still sharded the same way, the
+             * current ChunkManager is kept and only reads the chunks that changed since it was loaded.
+             */
+            void refresh( const BSONObj& in );
+
             bool isDirty() const { return _dirty; }
             bool wasDropped() const { return _dropped; }
 
@@ -94,6 +101,7 @@ namespace mongo {
             ChunkManagerPtr _cm;
             bool _dirty;
             bool _dropped;
+            Date_t _lastmod; // of the config.collections entry; changes when the collection is resharded
         };
 
         typedef map<string,CollectionInfo> Collections;
@@ -119,7 +127,13 @@ namespace mongo {
         }
 
         void enableSharding();
-        ChunkManagerPtr shardCollection( const string& ns , ShardKeyPattern fieldsAndOrder , bool unique );
+        /**
+         * @param initPoints split points for the initial chunks, see ChunkManager::createFirstChunks
+         * @param initShards the shards to spread the initial chunks over, the primary only if empty
+         */
+        ChunkManagerPtr shardCollection( const string& ns , ShardKeyPattern fieldsAndOrder , bool unique ,
+                                         const vector<BSONObj>& initPoints = vector<BSONObj>() ,
+                                         const vector<Shard>& initShards = vector<Shard>() );
 
         /**
            @return true if there was sharding info to remove
@@ -22,42 +22,71 @@
 #include "../client/dbclientmockcursor.h"
 #include "../db/instance.h"
 
+#include "../db/hasher.h"
+
 #include "d_chunk_manager.h"
 
 namespace mongo {
 
-    ShardChunkManager::ShardChunkManager( const string& configServer , const string& ns , const string& shardName ) {
-
-        // have to get a connection to the config db
-        // special case if i'm the configdb since i'm locked and if i connect to myself
-        // its a deadlock
-        scoped_ptr<ScopedDbConnection> scoped;
-        scoped_ptr<DBDirectClient> direct;
-        DBClientBase * conn;
-        if ( configServer.empty() ) {
-            direct.reset( new DBDirectClient() );
-            conn = direct.get();
+    /**
+     * A connection to the config db.
+     * Special case if i'm the configdb since i'm locked and if i connect to myself its a deadlock.
+     */
+    class ConfigConnection : boost::noncopyable {
+    public:
+        ConfigConnection( const string& configServer ) {
+            if ( configServer.empty() ) {
+                _direct.reset( new DBDirectClient() );
+                _conn = _direct.get();
+            }
+            else {
+                _scoped.reset( new ScopedDbConnection( configServer ) );
+                _conn = _scoped->get();
+            }
         }
-        else {
-            scoped.reset( new ScopedDbConnection( configServer ) );
-            conn = scoped->get();
+
+        DBClientBase* operator->() { return _conn; }
+
+        void done() {
+            if ( _scoped.get() )
+                _scoped->done();
         }
 
-        // get this collection's sharding key
-        BSONObj collectionDoc = conn->findOne( "config.collections", BSON( "_id" << ns ) );
+    private:
+        scoped_ptr<ScopedDbConnection> _scoped;
+        scoped_ptr<DBDirectClient> _direct;
+        DBClientBase* _conn;
+    };
+
+    static void checkCollectionDoc( const string& ns , const BSONObj& collectionDoc ) {
         uassert( 13539 , str::stream() << ns << " does not exist" , !collectionDoc.isEmpty() );
         uassert( 13540 , str::stream() << ns << " collection config entry corrupted" , collectionDoc["dropped"].type() );
         uassert( 13541 , str::stream() << ns << " dropped. Re-shard collection first." , !collectionDoc["dropped"].Bool() );
+    }
+
+    ShardChunkManager::ShardChunkManager( const string& configServer , const string& ns , const string& shardName ) {
+        ConfigConnection conn( configServer );
+
+        // get this collection's sharding key
+        BSONObj collectionDoc = conn->findOne( "config.collections", BSON( "_id" << ns ) );
+        checkCollectionDoc( ns , collectionDoc );
         _fillCollectionKey( collectionDoc );
 
+        // the collection's newest chunk, wherever it lives, is where a later refresh picks up from
+        // it's read first so that a chunk changing meanwhile is picked up again, rather than missed
+        BSONObj newest = conn->findOne( "config.chunks" , Query( BSON( "ns" << ns ) ).sort( "lastmod" , -1 ) );
+
         // query for all the chunks for 'ns' that live in this shard, sorting so we can efficiently bucket them
         BSONObj q = BSON( "ns" << ns << "shard" << shardName );
         auto_ptr<DBClientCursor> cursor = conn->query( "config.chunks" , Query(q).sort( "min" ) );
         _fillChunks( cursor.get() );
         _fillRanges();
 
-        if ( scoped.get() )
-            scoped->done();
+        _collVersion = newest.isEmpty() ? ShardChunkVersion( 0 ) : ShardChunkVersion( newest["lastmod"] );
+        if ( _version > _collVersion )
+            _collVersion = _version;
+
+        conn.done();
 
         if ( _chunksMap.empty() )
             log() << "no chunk for collection " << ns << " on shard " << shardName << endl;
@@ -69,6 +98,7 @@ namespace mongo {
         scoped_ptr<DBClientMockCursor> c ( new DBClientMockCursor( chunksArr ) );
         _fillChunks( c.get() );
         _fillRanges();
+        _collVersion = _version;
     }
 
     void ShardChunkManager::_fillCollectionKey( const BSONObj& collectionDoc ) {
@@ -76,6 +106,8 @@ namespace mongo {
         uassert( 13542 , str::stream() << "collection doesn't have a key: " << collectionDoc , ! e.eoo() && e.isABSONObj() );
 
         BSONObj keys = e.Obj().getOwned();
+        _hashed = keys.firstElement().type() == String && str::equals( keys.firstElement().valuestr() , "hashed" );
+
         BSONObjBuilder b;
         BSONForEach( key , keys ) {
             b.append( key.fieldName() , 1 );
@@ -141,7 +173,15 @@ namespace mongo {
         if ( _rangesMap.size() == 0 )
             return false;
 
-        BSONObj x = obj.extractFields(_key);
+        BSONObj x;
+        if ( _hashed ) {
+            BSONObjBuilder b;
+            b.append( _key.firstElement().fieldName() , BSONElementHasher::hash64( obj.getFieldDotted( _key.firstElement().fieldName() ) ) );
+            x = b.obj();
+        }
+        else {
+            x = obj.extractFields(_key);
+        }
 
         RangeMap::const_iterator it = _rangesMap.upper_bound( x );
         if ( it != _rangesMap.begin() )
@@ -211,6 +251,8 @@ namespace mongo {
 
         auto_ptr<ShardChunkManager> p( new ShardChunkManager );
         p->_key = this->_key;
+        p->_hashed = this->_hashed;
+        p->_collVersion = this->_collVersion;
 
         if ( _chunksMap.size() == 1 ) {
             // if left with no chunks, just reset version
@@ -264,6 +306,8 @@ namespace mongo {
         auto_ptr<ShardChunkManager> p( new ShardChunkManager );
 
         p->_key = this->_key;
+        p->_hashed = this->_hashed;
+        p->_collVersion = this->_collVersion;
         p->_chunksMap = this->_chunksMap;
         p->_chunksMap.insert( make_pair( min.getOwned() , max.getOwned() ) );
         p->_version = version;
@@ -296,6 +340,8 @@ namespace mongo {
         auto_ptr<ShardChunkManager> p( new ShardChunkManager );
 
         p->_key = this->_key;
+        p->_hashed = this->_hashed;
+        p->_collVersion = this->_collVersion;
         p->_chunksMap = this->_chunksMap;
         p->_version = version; // will increment second, third, ... chunks below
 
@@ -312,6 +358,94 @@ namespace mongo {
         return p.release();
     }
 
+    ShardChunkManager* ShardChunkManager::cloneRefreshed( const string& configServer , const string& ns , const string& shardName ) {
+        ConfigConnection conn( configServer );
+
+        BSONObj collectionDoc = conn->findOne( "config.collections", BSON( "_id" << ns ) );
+        checkCollectionDoc( ns , collectionDoc );
+
+        // if the collection got resharded on a different key, there is nothing to build on
+        ShardChunkManager reference;
+        reference._fillCollectionKey( collectionDoc );
+        if ( reference._key.woCompare( _key ) || reference._hashed != _hashed ) {
+            conn.done();
+            return new ShardChunkManager( configServer , ns , shardName );
+        }
+
+        // chunk versions only go up, so whatever changed since we last read is above the newest version we saw
+        // the changes of all shards are needed: a chunk that moved away from here is now some other shard's
+        BSONObjBuilder q;
+        q.append( "ns" , ns );
+        {
+            BSONObjBuilder gt( q.subobjStart( "lastmod" ) );
+            gt.appendTimestamp( "$gt" , _collVersion.toLong() );
+            gt.done();
+        }
+        auto_ptr<DBClientCursor> cursor = conn->query( "config.chunks" , Query( q.obj() ).sort( "lastmod" ) );
+        auto_ptr<ShardChunkManager> p( _cloneWithChanges( cursor.get() , shardName ) );
+
+        conn.done();
+
+        return p.release();
+    }
+
+    ShardChunkManager* ShardChunkManager::cloneWithChanges( const BSONArray& chunksArr , const string& shardName ) {
+        scoped_ptr<DBClientMockCursor> c ( new DBClientMockCursor( chunksArr ) );
+        return _cloneWithChanges( c.get() , shardName );
+    }
+
+    ShardChunkManager* ShardChunkManager::_cloneWithChanges( DBClientCursorInterface* cursor , const string& shardName ) {
+        assert( cursor );
+
+        auto_ptr<ShardChunkManager> p( new ShardChunkManager );
+        p->_key = this->_key;
+        p->_hashed = this->_hashed;
+        p->_chunksMap = this->_chunksMap;
+        p->_version = this->_version;
+        p->_collVersion = this->_collVersion;
+
+        // the changes come in version order, so a chunk that changed more than once ends up as its newest version
+        while ( cursor->more() ) {
+            BSONObj d = cursor->next();
+            BSONObj min = d["min"].Obj();
+            BSONObj max = d["max"].Obj();
+
+            ShardChunkVersion currVersion( d["lastmod"] );
+            if ( currVersion > p->_collVersion ) {
+                p->_collVersion = currVersion;
+            }
+
+            // whatever we had over that range is superseded, be it a chunk that moved away or one that got split
+            RangeMap::iterator it = p->_chunksMap.upper_bound( min );
+            if ( it != p->_chunksMap.begin() ) {
+                RangeMap::iterator prev = it;
+                --prev;
+                if ( prev->second.woCompare( min ) > 0 ) {
+                    p->_chunksMap.erase( prev );
+                }
+            }
+            while ( it != p->_chunksMap.end() && it->first.woCompare( max ) < 0 ) {
+                p->_chunksMap.erase( it++ );
+            }
+
+            if ( shardName != d.getStringField( "shard" ) ) {
+                continue;
+            }
+
+            p->_chunksMap.insert( make_pair( min.getOwned() , max.getOwned() ) );
+            if ( currVersion > p->_version ) {
+                p->_version = currVersion;
+            }
+        }
+
+        if ( p->_chunksMap.empty() ) {
+            p->_version = 0;
+        }
+        p->_fillRanges();
+
+        return p.release();
+    }
+
     string ShardChunkManager::toString() const {
         StringBuilder ss;
         ss << " ShardChunkManager version: " << _version << " key: " << _key;
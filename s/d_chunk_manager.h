@@ -93,6 +93,25 @@ namespace mongo {
         ShardChunkManager* cloneSplit( const BSONObj& min , const BSONObj& max , const vector<BSONObj>& splitKeys ,
                                        const ShardChunkVersion& version );
 
+        /**
+         * Generates a new manager by reading from the config server only the chunks that changed since 'this's state
+         * was loaded. The changes are applied over a copy of the chunks, so the current manager stays as it was.
+         *
+         * @param configServer, ns, shardName as in the loading constructor
+         * @return a new ShardChunkManager, to be owned by the caller
+         *
+         * This throws if collection is dropped/malformed and on connectivity errors
+         */
+        ShardChunkManager* cloneRefreshed( const string& configServer , const string& ns , const string& shardName );
+
+        /**
+         * Same as cloneRefreshed but used in unittest (no access to configDB required).
+         *
+         * @param chunksArr simulates the config.chunks' entries, of any shard, that changed since 'this' was loaded
+         * @param shardName name of the shard that this manager tracks
+         */
+        ShardChunkManager* cloneWithChanges( const BSONArray& chunksArr , const string& shardName );
+
         /**
          * Checks whether a document belongs to this shard.
          *
@@ -114,6 +133,7 @@ namespace mongo {
         // accessors
 
         ShardChunkVersion getVersion() const { return _version; }
+        ShardChunkVersion getCollectionVersion() const { return _collVersion; }
         BSONObj getKey() const { return _key.getOwned(); }
         unsigned getNumChunks() const { return _chunksMap.size(); }
 
@@ -122,9 +142,16 @@ namespace mongo {
         // highest ShardChunkVersion for which this ShardChunkManager's information is accurate
         ShardChunkVersion _version;
 
+        // highest ShardChunkVersion of any of the collection's chunks, on any shard, as last read from the config server
+        // chunks changing after that will have a higher version
+        ShardChunkVersion _collVersion;
+
         // key pattern for chunks under this range
         BSONObj _key;
 
+        // whether the chunks range over the hashes of _key's single field, for a { field : "hashed" } shard key
+        bool _hashed;
+
         // a map from a min key into the chunk's (or range's) max boundary
         typedef map< BSONObj, BSONObj , BSONObjCmp > RangeMap;
         RangeMap _chunksMap;
@@ -138,11 +165,14 @@ namespace mongo {
         void _fillChunks( DBClientCursorInterface* cursor );
         void _fillRanges();
 
+        /** applies the changed chunks over a copy of 'this's, for the cloneRefreshed / cloneWithChanges calls */
+        ShardChunkManager* _cloneWithChanges( DBClientCursorInterface* cursor , const string& shardName );
+
         /** throws if the exact chunk is not in the chunks' map */
         void _assertChunkExists( const BSONObj& min , const BSONObj& max ) const;
 
         /** can only be used in the cloning calls */
-        ShardChunkManager() {}
+        ShardChunkManager() : _hashed( false ) {}
     };
 
     typedef shared_ptr<ShardChunkManager> ShardChunkManagerPtr;
@@ -135,6 +135,7 @@ namespace mongo {
         string ns;
         BSONObj min;
         BSONObj max;
+        BSONObj keyPattern; // only set for hashed shard keys
         set<CursorId> initial;
 
         OldDataCleanup(){
@@ -144,6 +145,7 @@ namespace mongo {
             ns = other.ns;
             min = other.min.getOwned();
             max = other.max.getOwned();
+            keyPattern = other.keyPattern.getOwned();
             initial = other.initial;
             _numThreads++;
         }
@@ -151,12 +153,52 @@ namespace mongo {
             _numThreads--;
         }
 
-        void doRemove() {
+        /**
+         * deletes the range in batches, each under a write lock of its own, so that other operations get in
+         * between.
+         * @param paced if there are secondaries, a batch has to get to enough of them before the next one goes,
+         *              which keeps a large chunk from putting them behind. only for the cleanup thread, as each
+         *              wait can take up to a minute and moveChunk shouldn't be held up by them.
+         */
+        void doRemove( bool paced ) {
             ShardForceVersionOkModeBlock sf;
-            writelock lk(ns);
             RemoveSaver rs("moveChunk",ns,"post-cleanup");
-            long long num = Helpers::removeRange( ns , min , max , true , false , cmdLine.moveParanoia ? &rs : 0 );
-            log() << "moveChunk deleted: " << num << endl;
+
+            Timer t;
+            long long num = 0;
+            while ( true ) {
+                long long n;
+                {
+                    writelock lk(ns);
+                    n = Helpers::removeRange( ns , min , max , true , false , cmdLine.moveParanoia ? &rs : 0 , keyPattern , RemoveBatchSize );
+                }
+                num += n;
+
+                if ( n < RemoveBatchSize )
+                    break;
+
+                if ( paced )
+                    waitForSecondaries( cc().getLastOp() );
+            }
+            log() << "moveChunk deleted: " << num << " in " << t.millis() << "ms" << endl;
+        }
+
+        static const int RemoveBatchSize = 128;
+
+    private:
+        /** waits, up to a minute, for the secondaries to catch up with 'op' */
+        static void waitForSecondaries( ReplTime op ) {
+            // as many as a migration commit waits for
+            const int slaveCount = getSlaveCount() / 2 + 1;
+
+            Timer t;
+            while ( ! opReplicatedEnough( op , slaveCount ) ) {
+                if ( t.seconds() > 60 ) {
+                    log( LL_WARNING ) << "moveChunk cleanup not waiting any longer for " << slaveCount << " slaves to catch up" << endl;
+                    return;
+                }
+                sleepmillis( 10 );
+            }
         }
 
     };
@@ -201,7 +243,7 @@ namespace mongo {
             }
         }
 
-        cleanup.doRemove();
+        cleanup.doRemove( true );
 
         cc().shutdown();
     }
@@ -233,8 +275,12 @@ namespace mongo {
 
     };
 
-    bool isInRange( const BSONObj& obj , const BSONObj& min , const BSONObj& max ) {
-        BSONObj k = obj.extractFields( min, true );
+    /**
+     * @param keyPattern the shard key pattern if it is hashed, then obj's key is the hash of its field.
+     *                   empty otherwise.
+     */
+    bool isInRange( const BSONObj& obj , const BSONObj& min , const BSONObj& max , const BSONObj& keyPattern = BSONObj() ) {
+        BSONObj k = keyPattern.isEmpty() ? obj.extractFields( min, true ) : ShardKeyPattern( keyPattern ).extractKey( obj );
 
         return k.woCompare( min ) >= 0 && k.woCompare( max ) < 0;
     }
@@ -249,7 +295,7 @@ namespace mongo {
             _memoryUsed = 0;
         }
 
-        void start( string ns , const BSONObj& min , const BSONObj& max ) {
+        void start( string ns , const BSONObj& min , const BSONObj& max , const BSONObj& keyPattern ) {
             scoped_lock l(_m); // reads and writes _active
 
             assert( ! _active );
@@ -261,6 +307,7 @@ namespace mongo {
             _ns = ns;
             _min = min;
             _max = max;
+            _keyPattern = keyPattern;
 
             assert( _cloneLocs.size() == 0 );
             assert( _deleted.size() == 0 );
@@ -340,7 +387,7 @@ namespace mongo {
 
             }
 
-            if ( ! isInRange( it , _min , _max ) )
+            if ( ! isInRange( it , _min , _max , _keyPattern ) )
                 return;
 
             _reload.push_back( ide.wrap() );
@@ -417,7 +464,7 @@ namespace mongo {
                 return false;
             }
 
-            BSONObj keyPattern;
+            BSONObj keyPattern = _keyPattern.copy();
             // the copies are needed because the indexDetailsForRange destroys the input
             BSONObj min = _min.copy();
             BSONObj max = _max.copy();
@@ -543,6 +590,7 @@ namespace mongo {
         string _ns;
         BSONObj _min;
         BSONObj _max;
+        BSONObj _keyPattern; // only set for hashed shard keys
 
         // disk locs yet to be transferred from here to the other side
         // no locking needed because build by 1 thread in a read lock
@@ -560,8 +608,8 @@ namespace mongo {
     } migrateFromStatus;
 
     struct MigrateStatusHolder {
-        MigrateStatusHolder( string ns , const BSONObj& min , const BSONObj& max ) {
-            migrateFromStatus.start( ns , min , max );
+        MigrateStatusHolder( string ns , const BSONObj& min , const BSONObj& max , const BSONObj& keyPattern ) {
+            migrateFromStatus.start( ns , min , max , keyPattern );
         }
         ~MigrateStatusHolder() {
             migrateFromStatus.done();
@@ -637,6 +685,7 @@ namespace mongo {
             string from = cmdObj["from"].str(); // my public address, a tad redundant, but safe
             BSONObj min  = cmdObj["min"].Obj();
             BSONObj max  = cmdObj["max"].Obj();
+            BSONObj keyPattern = cmdObj.getObjectField( "keyPattern" ); // only sent for hashed shard keys
             BSONElement shardId = cmdObj["shardId"];
             BSONElement maxSizeElem = cmdObj["maxChunkSizeBytes"];
 
@@ -775,7 +824,7 @@ namespace mongo {
             timing.done(2);
 
             // 3.
-            MigrateStatusHolder statusHolder( ns , min , max );
+            MigrateStatusHolder statusHolder( ns , min , max , keyPattern );
             {
                 // this gets a read lock, so we know we have a checkpoint for mods
                 if ( ! migrateFromStatus.storeCurrentLocs( maxChunkSize , errmsg , result ) )
@@ -788,6 +837,7 @@ namespace mongo {
                                                     "from" << from <<
                                                     "min" << min <<
                                                     "max" << max <<
+                                                    "keyPattern" << keyPattern <<
                                                     "configServer" << configServer.modelServer()
                                                   ) ,
                                               res );
@@ -1070,6 +1120,7 @@ namespace mongo {
                 c.ns = ns;
                 c.min = min.getOwned();
                 c.max = max.getOwned();
+                c.keyPattern = keyPattern.getOwned();
                 ClientCursor::find( ns , c.initial );
                 if ( c.initial.size() ) {
                     log() << "forking for cleaning up chunk data" << endl;
@@ -1078,7 +1129,7 @@ namespace mongo {
                 else {
                     log() << "doing delete inline" << endl;
                     // 7.
-                    c.doRemove();
+                    c.doRemove( false );
                 }
 
 
@@ -1108,11 +1159,63 @@ namespace mongo {
        commend to "commit"
     */
 
+    /**
+     * asks the donor for the next _migrateClone batch from a thread of its own, so that the donor gathering a
+     * batch and sending it overlap with the inserts of the one before.
+     * there is one request at a time, over the migration's connection, which nothing else uses in the meantime.
+     */
+    class CloneBatchFetcher : boost::noncopyable {
+    public:
+        CloneBatchFetcher( DBClientBase* conn ) : _conn( conn ) , _ok( false ) {}
+        ~CloneBatchFetcher() { _join(); }
+
+        void start() {
+            assert( ! _thread );
+            _thread.reset( new boost::thread( boost::bind( &CloneBatchFetcher::_run , this ) ) );
+        }
+
+        /** @return false if the request failed, 'res' has why */
+        bool wait( BSONObj& res ) {
+            _join();
+            res = _res;
+            return _ok;
+        }
+
+    private:
+        void _run() {
+            try {
+                BSONObj res;
+                _ok = _conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res );
+                _res = res.getOwned();
+            }
+            catch ( std::exception& e ) {
+                _ok = false;
+                _res = BSON( "errmsg" << e.what() );
+            }
+        }
+
+        void _join() {
+            if ( ! _thread )
+                return;
+            _thread->join();
+            _thread.reset();
+        }
+
+        DBClientBase* _conn;
+        BSONObj _res;
+        bool _ok;
+        scoped_ptr<boost::thread> _thread;
+    };
+
     class MigrateStatus {
     public:
 
         MigrateStatus() : m_active("MigrateStatus") { active = false; }
 
+        // cloned documents are inserted this many at a time, or for this long, under one write lock
+        static const int CloneInsertBatchSize = 100;
+        static const int CloneInsertBatchMillis = 20;
+
         void prepare() {
             scoped_lock l(m_active); // reading and writing 'active'
 
@@ -1180,7 +1283,7 @@ namespace mongo {
                 // 2. delete any data already in range
                 writelock lk( ns );
                 RemoveSaver rs( "moveChunk" , ns , "preCleanup" );
-                long long num = Helpers::removeRange( ns , min , max , true , false , cmdLine.moveParanoia ? &rs : 0 );
+                long long num = Helpers::removeRange( ns , min , max , true , false , cmdLine.moveParanoia ? &rs : 0 , keyPattern );
                 if ( num )
                     log( LL_WARNING ) << "moveChunkCmd deleted data already in chunk # objects: " << num << endl;
 
@@ -1192,9 +1295,13 @@ namespace mongo {
                 // 3. initial bulk clone
                 state = CLONE;
 
+                // the next batch is on its way while this one gets inserted
+                CloneBatchFetcher fetcher( conn.get() );
+                fetcher.start();
+
                 while ( true ) {
                     BSONObj res;
-                    if ( ! conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res ) ) {
+                    if ( ! fetcher.wait( res ) ) {
                         state = FAIL;
                         errmsg = "_migrateClone failed: ";
                         errmsg += res.toString();
@@ -1204,22 +1311,24 @@ namespace mongo {
                     }
 
                     BSONObj arr = res["objects"].Obj();
-                    int thisTime = 0;
+                    if ( arr.isEmpty() )
+                        break;
+
+                    fetcher.start();
 
+                    // a write lock per run of documents, rather than per document
                     BSONObjIterator i( arr );
                     while( i.more() ) {
-                        BSONObj o = i.next().Obj();
-                        {
-                            writelock lk( ns );
+                        writelock lk( ns );
+                        Client::Context ctx( ns );
+                        Timer t;
+                        for ( int n=0; i.more() && n < CloneInsertBatchSize && t.millis() < CloneInsertBatchMillis; n++ ) {
+                            BSONObj o = i.next().Obj();
                             Helpers::upsert( ns , o );
+                            numCloned++;
+                            clonedBytes += o.objsize();
                         }
-                        thisTime++;
-                        numCloned++;
-                        clonedBytes += o.objsize();
                     }
-
-                    if ( thisTime == 0 )
-                        break;
                 }
 
                 timing.done(3);
@@ -1341,7 +1450,7 @@ namespace mongo {
                     // do not apply deletes if they do not belong to the chunk being migrated
                     BSONObj fullObj;
                     if ( Helpers::findById( cc() , ns.c_str() , id, fullObj ) ) {
-                        if ( ! isInRange( fullObj , min , max ) ) {
+                        if ( ! isInRange( fullObj , min , max , keyPattern ) ) {
                             log() << "not applying out of range deletion: " << fullObj << endl;
 
                             continue;
@@ -1442,6 +1551,7 @@ namespace mongo {
 
         BSONObj min;
         BSONObj max;
+        BSONObj keyPattern; // only set for hashed shard keys
 
         long long numCloned;
         long long clonedBytes;
@@ -1489,6 +1599,7 @@ namespace mongo {
             migrateStatus.from = cmdObj["from"].String();
             migrateStatus.min = cmdObj["min"].Obj().getOwned();
             migrateStatus.max = cmdObj["max"].Obj().getOwned();
+            migrateStatus.keyPattern = cmdObj.getObjectField( "keyPattern" ).getOwned();
 
             boost::thread m( migrateThread );
 
@@ -1547,6 +1658,16 @@ namespace mongo {
             assert( ! isInRange( BSON( "x" << 5 ) , min , max ) );
             assert( ! isInRange( BSON( "x" << 6 ) , min , max ) );
 
+            // a hashed key goes by the hash of the field
+            BSONObj hashed = BSON( "x" << "hashed" );
+            long long h = BSONElementHasher::hash64( BSON( "x" << 3 ).firstElement() );
+            BSONObj hmin = BSON( "x" << h );
+            BSONObj hmax = BSON( "x" << MAXKEY );
+
+            assert( isInRange( BSON( "x" << 3 ) , hmin , hmax , hashed ) );
+            assert( isInRange( BSON( "x" << 3.0 << "y" << 1 ) , hmin , hmax , hashed ) );
+            assert( ! isInRange( BSON( "x" << 3 ) , BSON( "x" << MINKEY ) , hmin , hashed ) );
+
             log(1) << "isInRangeTest passed" << endl;
         }
     } isInRangeTest;
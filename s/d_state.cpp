@@ -211,7 +211,32 @@ namespace mongo {
         //   + a stale client request a version that's not current anymore
 
         const string c = (_configServer == _shardHost) ? "" /* local */ : _configServer;
-        ShardChunkManagerPtr p( new ShardChunkManager( c , ns , _shardName ) );
+
+        ShardChunkManagerPtr current;
+        {
+            scoped_lock lk( _mutex );
+            ChunkManagersMap::const_iterator it = _chunks.find( ns );
+            if ( it != _chunks.end() )
+                current = it->second;
+        }
+
+        // usually only a few chunks changed since the current manager was loaded, so start by reading just those.
+        // if that doesn't land on the requested version, though, the current manager may be off (e.g. a migrate that
+        // got aborted here) and we fall back to reading all of this shard's chunks
+        Timer t;
+        ShardChunkManagerPtr p;
+        if ( current ) {
+            p.reset( current->cloneRefreshed( c , ns , _shardName ) );
+            if ( p->getVersion() != version )
+                p.reset();
+        }
+        bool refreshed = p.get() != 0;
+        if ( ! p )
+            p.reset( new ShardChunkManager( c , ns , _shardName ) );
+
+        log( t.millis() > cmdLine.slowMS ? 0 : 1 ) << "sharding: " << ( refreshed ? "refreshed " : "loaded " ) << ns
+                << " at version " << p->getVersion() << " with " << p->getNumChunks() << " chunks, took " << t.millis() << "ms" << endl;
+
         {
             scoped_lock lk( _mutex );
 
@@ -83,7 +83,7 @@ namespace mongo {
         if ( _chunkManager ) {
             if ( _chunkManager->numChunks() > 1 )
                 throw UserException( 8060 , "can't call primaryShard on a sharded collection" );
-            return _chunkManager->findChunk( _chunkManager->getShardKey().globalMin() )->getShard();
+            return _chunkManager->findChunkForKey( _chunkManager->getShardKey().globalMin() )->getShard();
         }
         Shard s = _config->getShard( getns() );
         uassert( 10194 ,  "can't call primaryShard on a sharded collection!" , s.ok() );
@@ -121,6 +121,7 @@ namespace mongo {
             }
             catch ( StaleConfigException& staleConfig ) {
                 log() << staleConfig.what() << " attempt: " << attempt << endl;
+                setShardVersionTypes.hit( "staleRetry" );
                 uassert( 10195 ,  "too many attempts to update config, failing" , attempt < 5 );
                 ShardConnection::checkMyConnectionVersions( getns() );
                 if (!staleConfig.justConnection() )
@@ -23,12 +23,17 @@
 #include "grid.h"
 #include "util.h"
 #include "shard.h"
+#include "stats.h"
 #include "writeback_listener.h"
 
+#include "../db/dbmessage.h"
+
 #include "shard_version.h"
 
 namespace mongo {
 
+    void assembleRequest( const string &ns, BSONObj query, int nToReturn, int nToSkip, const BSONObj *fieldsToReturn, int queryOptions, Message &toSend );
+
     // when running in sharded mode, use chunk shard version control
 
     static bool checkShardVersion( DBClientBase & conn , const string& ns , bool authoritative = false , int tryNumber = 1 );
@@ -62,29 +67,97 @@ namespace mongo {
             _map[conn][ns] = s;
         }
 
-        void reset( DBClientBase * conn ) {
+        void setPending( DBClientBase * conn , const string& ns , MSGID id ) {
+            scoped_lock lk( _mutex );
+            _pending[conn][ns] = id;
+        }
+
+        /** @return true if a setShardVersion for ns was piggybacked on conn, and its reply isn't read yet */
+        bool takePending( DBClientBase * conn , const string& ns , MSGID& id ) {
+            scoped_lock lk( _mutex );
+            map<string,MSGID>& m = _pending[conn];
+            map<string,MSGID>::iterator i = m.find( ns );
+            if ( i == m.end() )
+                return false;
+            id = i->second;
+            m.erase( i );
+            return true;
+        }
+
+        /** @param pending (OUT) the ids of piggybacked setShardVersion whose replies weren't read */
+        void reset( DBClientBase * conn , vector<MSGID>* pending ) {
             scoped_lock lk( _mutex );
             _map.erase( conn );
+
+            map<string,MSGID>& m = _pending[conn];
+            for ( map<string,MSGID>::iterator i = m.begin(); i != m.end(); ++i )
+                pending->push_back( i->second );
+            _pending.erase( conn );
         }
 
-        // protects _map
+        // protects _map and _pending
         mongo::mutex _mutex;
 
         // a map from a connection into ChunkManager's sequence number for each namespace
         map<DBClientBase*, map<string,unsigned long long> > _map;
 
+        // a map from a connection into the message id of the setShardVersion piggybacked on it, for each namespace
+        map<DBClientBase*, map<string,MSGID> > _pending;
+
     } connectionShardStatus;
 
+    /**
+     * @return the connection to piggyback setShardVersion on, if conn is a plain one.  a replica set
+     * connection may change its master before the reply is read, so doesn't get piggybacking.
+     */
+    static DBClientConnection * piggyBackConnection( DBClientBase * conn ) {
+        if ( conn->type() != ConnectionString::MASTER )
+            return 0;
+        return dynamic_cast<DBClientConnection*>( conn );
+    }
+
     void resetShardVersion( DBClientBase * conn ) {
-        connectionShardStatus.reset( conn );
+        vector<MSGID> pending;
+        connectionShardStatus.reset( conn , &pending );
+
+        DBClientConnection * c = piggyBackConnection( conn );
+        for ( unsigned i=0; c && i<pending.size(); i++ )
+            c->port().forgetReply( pending[i] );
     }
 
     /**
-     * @return true if had to do something
+     * reads the reply to a setShardVersion piggybacked on conn for ns, if there is one.  by now it normally
+     * has come in, ahead of the reply to the operation it went with.
+     * @return false if it failed, so that the connection's version for ns is unknown
      */
-    bool checkShardVersion( DBClientBase& conn , const string& ns , bool authoritative , int tryNumber ) {
-        // TODO: cache, optimize, etc...
+    static bool checkPendingShardVersion( DBClientBase& conn , const string& ns ) {
+        MSGID id;
+        if ( ! connectionShardStatus.takePending( &conn , ns , id ) )
+            return true;
+
+        DBClientConnection * c = piggyBackConnection( &conn );
+        Message response;
+        if ( c && c->port().getReply( id , response ) ) {
+            QueryResult * qr = (QueryResult*)response.singleData();
+            if ( qr->nReturned == 1 ) {
+                BSONObj result( qr->data() );
+                if ( result["ok"].trueValue() ) {
+                    LOG(1) << "      piggybacked setShardVersion success: " << result << endl;
+                    return true;
+                }
+                log(1) << "       piggybacked setShardVersion failed!\n" << result << endl;
+            }
+        }
+
+        setShardVersionTypes.hit( "piggybackFailed" );
+        connectionShardStatus.setSequence( &conn , ns , 0 );
+        return false;
+    }
 
+    /**
+     * @return true if had to do something, other than piggyback the version on the operation to come
+     */
+    bool checkShardVersion( DBClientBase& conn , const string& ns , bool authoritative , int tryNumber ) {
         WriteBackListener::init( conn );
 
         DBConfigPtr conf = grid.getDBConfig( ns );
@@ -107,6 +180,10 @@ namespace mongo {
             return false;
         }
 
+        // the last one piggybacked has to be known to have worked before there's another
+        if ( ! checkPendingShardVersion( conn , ns ) )
+            sequenceNumber = 0;
+
 
         ShardChunkVersion version = 0;
         if ( isSharded ) {
@@ -118,7 +195,25 @@ namespace mongo {
                << " version: " << version << " manager: " << manager.get()
                << endl;
 
+        // Once the shard has taken a version for ns from this connection, a newer one is hardly ever refused. So
+        // rather than waiting on it, it goes out in front of the operation that is coming, in the same send. Should
+        // it fail after all, the operation finds its version stale, and the reply is looked at the next time round.
+        DBClientConnection * pc = piggyBackConnection( &conn );
+        if ( sequenceNumber && ! authoritative && pc ) {
+            Message toSend;
+            assembleRequest( "admin.$cmd" , setShardVersionCommand( conn , ns , version , false ) , -1 , 0 , 0 , 0 , toSend );
+            pc->port().piggyBack( toSend );
+            pc->port().expectReply( toSend.header()->id );
+
+            setShardVersionTypes.hit( "piggybacked" );
+            connectionShardStatus.setPending( &conn , ns , toSend.header()->id );
+            connectionShardStatus.setSequence( &conn , ns , officialSequenceNumber );
+            // nothing to start over for: the operation goes ahead, carrying it
+            return false;
+        }
+
         BSONObj result;
+        setShardVersionTypes.hit( "roundTrip" );
         if ( setShardVersion( conn , ns , version , authoritative , result ) ) {
             // success!
             LOG(1) << "      setShardVersion success: " << result << endl;
@@ -24,9 +24,12 @@
 
 namespace mongo {
 
-    ShardKeyPattern::ShardKeyPattern( BSONObj p ) : pattern( p.getOwned() ) {
+    ShardKeyPattern::ShardKeyPattern( BSONObj p ) : pattern( p.getOwned() ) , _hashed( false ) {
         pattern.getFieldNames(patternfields);
 
+        BSONElement first = pattern.firstElement();
+        _hashed = first.type() == String && str::equals( first.valuestr() , "hashed" );
+
         BSONObjBuilder min;
         BSONObjBuilder max;
 
@@ -41,10 +44,16 @@ namespace mongo {
         gMax = max.obj();
     }
 
+    BSONObj ShardKeyPattern::hashedKey( const BSONElement& value ) const {
+        BSONObjBuilder b;
+        b.append( pattern.firstElement().fieldName() , BSONElementHasher::hash64( value ) );
+        return b.obj();
+    }
+
     int ShardKeyPattern::compare( const BSONObj& lObject , const BSONObj& rObject ) const {
-        BSONObj L = extractKey(lObject);
+        BSONObj L = lObject.extractFields(pattern);
         uassert( 10198 , "left object doesn't have full shard key", L.nFields() == (int)patternfields.size());
-        BSONObj R = extractKey(rObject);
+        BSONObj R = rObject.extractFields(pattern);
         uassert( 10199 , "right object doesn't have full shard key", R.nFields() == (int)patternfields.size());
         return L.woCompare(R);
     }
@@ -187,6 +196,23 @@ namespace mongo {
             assert( k.extractKey( fromjson("{a:1,sub:{b:2,c:3}}") ).woEqual(x) );
             assert( k.extractKey( fromjson("{sub:{b:2,c:3},a:1}") ).woEqual(x) );
         }
+        void hashedkeytest() {
+            ShardKeyPattern k( BSON( "a.b" << "hashed" ) );
+            assert( k.isHashed() );
+            assert( ! ShardKeyPattern( BSON( "a" << 1 ) ).isHashed() );
+
+            BSONObj key = k.extractKey( fromjson("{x:1,a:{b:5}}") );
+            assert( key.nFields() == 1 );
+            assert( key.firstElement().type() == NumberLong );
+            assert( key.woEqual( k.extractKey( fromjson("{a:{b:5.0}}") ) ) );
+            assert( ! key.woEqual( k.extractKey( fromjson("{a:{b:6}}") ) ) );
+            assert( k.extractKey( fromjson("{x:1}") ).isEmpty() );
+
+            // the bounds are those of the hashes
+            assert( k.globalMin().woCompare( key ) < 0 );
+            assert( k.globalMax().woCompare( key ) > 0 );
+        }
+
         void moveToFrontTest() {
             ShardKeyPattern sk (BSON("a" << 1 << "b" << 1));
 
@@ -254,6 +280,8 @@ namespace mongo {
             testIsPrefixOf();
             // add middle multitype tests
 
+            hashedkeytest();
+
             moveToFrontTest();
 
             if (0) { // toggle to run benchmark
@@ -19,6 +19,7 @@
 #pragma once
 
 #include "../client/dbclient.h"
+#include "../db/hasher.h"
 
 namespace mongo {
 
@@ -26,6 +27,9 @@ namespace mongo {
 
     /* A ShardKeyPattern is a pattern indicating what data to extract from the object to make the shard key from.
        Analogous to an index key pattern.
+
+       A hashed pattern, e.g. { _id : "hashed" }, has a single field whose value is hashed into a NumberLong to make
+       the key, so that monotonically increasing values spread over all the chunks.
     */
     class ShardKeyPattern {
     public:
@@ -54,7 +58,16 @@ namespace mongo {
             return isGlobalMin( k ) || isGlobalMax( k );
         }
 
+        /** @return true for a hashed pattern, e.g. { _id : "hashed" } */
+        bool isHashed() const { return _hashed; }
+
+        /**
+           @return the key of a hashed pattern for 'value' of its field, e.g. { _id : NumberLong(...) }
+         */
+        BSONObj hashedKey( const BSONElement& value ) const;
+
         /** compare shard keys from the objects specified
+           keys of a hashed pattern are compared as they are, so these must be keys and not documents
            l < r negative
            l == r 0
            l > r positive
@@ -72,6 +85,7 @@ namespace mongo {
 
         string toString() const;
 
+        /** @return the shard key of document 'from' (hashed, for a hashed pattern) */
         BSONObj extractKey(const BSONObj& from) const;
 
         bool partOfShardKey(const char* key ) const {
@@ -96,12 +110,18 @@ namespace mongo {
         BSONObj pattern;
         BSONObj gMin;
         BSONObj gMax;
+        bool _hashed;
 
         /* question: better to have patternfields precomputed or not?  depends on if we use copy constructor often. */
         set<string> patternfields;
     };
 
     inline BSONObj ShardKeyPattern::extractKey(const BSONObj& from) const {
+        if ( _hashed ) {
+            BSONElement e = from.getFieldDotted( pattern.firstElement().fieldName() );
+            return e.eoo() ? BSONObj() : hashedKey( e );
+        }
+
         BSONObj k = from.extractFields(pattern);
         uassert(13334, "Shard Key must be less than 512 bytes", k.objsize() < 512);
         return k;
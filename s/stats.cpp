@@ -25,4 +25,5 @@ namespace mongo {
     OpCounters opsSharded;
 
     GenericCounter shardedCursorTypes;
+    GenericCounter setShardVersionTypes;
 }
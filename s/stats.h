@@ -27,4 +27,8 @@ namespace mongo {
     extern OpCounters opsSharded;
 
     extern GenericCounter shardedCursorTypes;
+
+    // setShardVersion sent on a round trip of its own, or piggybacked on the operation that needed it,
+    // and the requests retried for a stale version
+    extern GenericCounter setShardVersionTypes;
 }
@@ -67,13 +67,22 @@ namespace mongo {
         dbcon.done();
     }
 
-    void Strategy::insert( const Shard& shard , const char * ns , const BSONObj& obj ) {
+    void Strategy::insert( const Shard& shard , const char * ns , const vector<BSONObj>& objs , int flags ) {
         ShardConnection dbcon( shard , ns );
         if ( dbcon.setVersion() ) {
             dbcon.done();
             throw StaleConfigException( ns , "for insert" );
         }
-        dbcon->insert( ns , obj );
+
+        BufBuilder b;
+        b.appendNum( flags );
+        b.appendStr( ns );
+        for ( unsigned i=0; i<objs.size(); i++ )
+            objs[i].appendSelfToBufBuilder( b );
+
+        Message toSend;
+        toSend.setData( dbInsert , b.buf() , b.len() );
+        dbcon->say( toSend );
         dbcon.done();
     }
 }
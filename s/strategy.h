@@ -36,7 +36,11 @@ namespace mongo {
         void doWrite( int op , Request& r , const Shard& shard , bool checkVersion = true );
         void doQuery( Request& r , const Shard& shard );
 
-        void insert( const Shard& shard , const char * ns , const BSONObj& obj );
+        /**
+         * one message with all of objs
+         * @param flags InsertOptions
+         */
+        void insert( const Shard& shard , const char * ns , const vector<BSONObj>& objs , int flags = 0 );
 
     };
 
@@ -22,6 +22,7 @@
 #include "cursors.h"
 #include "stats.h"
 #include "client.h"
+#include "grid.h"
 
 #include "../client/connpool.h"
 #include "../db/commands.h"
@@ -30,8 +31,170 @@
 
 namespace mongo {
 
+    /**
+     * a query sorted on a single field shard key, read a range of chunks at a time in key order.
+     * a range is only queried once the ones before it have run out, so a limited query goes to as
+     * few shards as it needs. should the chunks have moved in the meantime, the ranges left are
+     * worked out again from where the last one ended.
+     */
+    class ShardKeyOrderedCursor : public ClusteredCursor {
+    public:
+        ShardKeyOrderedCursor( QueryMessage& q , ChunkManagerPtr manager , const vector< shared_ptr<ChunkRange> >& ranges ,
+                               int direction )
+            : ClusteredCursor( q ) , _keyPattern( manager->getShardKey().key() ) , _sequence( manager->getSequenceNumber() ) ,
+              _ranges( ranges ) , _nextRange( 0 ) , _direction( direction ) {
+            _needToSkip = q.ntoskip;
+            if ( _direction < 0 )
+                reverse( _ranges.begin() , _ranges.end() );
+        }
+
+        virtual bool more() {
+            while ( true ) {
+                while ( _needToSkip > 0 && _cursor.more() ) {
+                    _cursor.next();
+                    _needToSkip--;
+                }
+
+                if ( _cursor.more() )
+                    return true;
+
+                if ( _nextRange >= _ranges.size() )
+                    return false;
+
+                _queryNextRange();
+            }
+        }
+
+        virtual BSONObj next() {
+            uassert( 14076 , "no more items" , more() );
+            return _cursor.next();
+        }
+
+        virtual string type() const { return "ShardKeyOrdered"; }
+
+    protected:
+        virtual void _init() {
+            if ( _ranges.size() )
+                _queryNextRange();
+        }
+
+        virtual void _explain( map< string,list<BSONObj> >& out ) {
+            BSONObj end;
+            for ( unsigned i=0; i<_ranges.size(); i++ ) {
+                const ChunkRange& r = *_ranges[i];
+                out[ r.getShard().getConnString() ].push_back( explain( r.getShard().getConnString() , _rangeBounds( r , end ) ) );
+                end = _direction > 0 ? r.getMax() : r.getMin();
+            }
+        }
+
+    private:
+        void _queryNextRange() {
+            bool reload = false;
+            for ( int attempt = 1; ; attempt++ ) {
+                ChunkManagerPtr current = grid.getDBConfig( _ns )->getChunkManager( _ns , reload );
+                if ( current->getSequenceNumber() != _sequence )
+                    _replan( current );
+                if ( _nextRange >= _ranges.size() )
+                    return;
+
+                const ChunkRange& r = *_ranges[_nextRange];
+                vector<ServerAndQuery> servers( 1 , ServerAndQuery( r.getShard().getConnString() , _rangeBounds( r , _end ) ) );
+                try {
+                    queryAll( servers , _needToSkip , &_cursor );
+                }
+                catch ( StaleConfigException& e ) {
+                    // past the first batch this is in a getMore, which isn't retried, so it's done here
+                    if ( attempt >= 5 )
+                        throw;
+                    log(1) << e.what() << " attempt: " << attempt << endl;
+                    reload = ! e.justConnection();
+                    continue;
+                }
+
+                _nextRange++;
+                _end = _direction > 0 ? r.getMax() : r.getMin();
+                _cursor.prefetch();
+                return;
+            }
+        }
+
+        /** the ranges left, by the chunks as they are now */
+        void _replan( ChunkManagerPtr current ) {
+            log(1) << "chunks of " << _ns << " changed while reading them in order, from " << _end << " on" << endl;
+
+            vector< shared_ptr<ChunkRange> > ranges;
+            massert( 14077 , "can't read the collection in shard key order any more" ,
+                     current->getRangesForQuery( Query( _query ).getFilter() , ranges ) );
+            if ( _direction < 0 )
+                reverse( ranges.begin() , ranges.end() );
+
+            _sequence = current->getSequenceNumber();
+            _ranges.clear();
+            _nextRange = 0;
+            for ( unsigned i=0; i<ranges.size(); i++ ) {
+                const ChunkRange& r = *ranges[i];
+                if ( _end.isEmpty() ||
+                        ( _direction > 0 && r.getMax().woCompare( _end ) > 0 ) ||
+                        ( _direction < 0 && r.getMin().woCompare( _end ) < 0 ) )
+                    _ranges.push_back( ranges[i] );
+            }
+        }
+
+        /**
+         * the part of range r that is past 'end', where the last one read ended, as $min and $max on the shard
+         * key index. a {$gte,$lt} filter wouldn't do: the matcher only compares values of the same type, so
+         * it would drop keys of other types that the chunks hold, like null in the first one.
+         */
+        BSONObj _rangeBounds( const ChunkRange& r , const BSONObj& end ) const {
+            BSONObj min = r.getMin();
+            BSONObj max = r.getMax();
+            if ( ! end.isEmpty() ) {
+                if ( _direction > 0 && min.woCompare( end ) < 0 )
+                    min = end;
+                if ( _direction < 0 && max.woCompare( end ) > 0 )
+                    max = end;
+            }
+
+            BSONObjBuilder b;
+            if ( min.firstElement().type() != MinKey )
+                b.append( "$min" , min );
+            if ( max.firstElement().type() != MaxKey )
+                b.append( "$max" , max );
+            b.append( "$hint" , _keyPattern );
+            return b.obj();
+        }
+
+        BSONObj _keyPattern;
+
+        // the ChunkManager is reloaded in place, so its sequence number when the ranges were worked out
+        unsigned long long _sequence;
+        vector< shared_ptr<ChunkRange> > _ranges;
+        unsigned _nextRange;
+        int _direction;
+
+        // where the ranges read so far end, empty before the first
+        BSONObj _end;
+
+        FilteringClientCursor _cursor;
+        int _needToSkip;
+    };
+
     class ShardStrategy : public Strategy {
 
+        /**
+         * @return 1 or -1 if sort is on the shard key alone, ascending or descending, else 0
+         */
+        int _shardKeyOrder( ChunkManagerPtr info , const BSONObj& sort ) {
+            const BSONObj& key = info->getShardKey().key();
+            if ( sort.nFields() != 1 || key.nFields() != 1 || info->getShardKey().isHashed() )
+                return 0;
+
+            BSONElement e = sort.firstElement();
+            if ( strcmp( e.fieldName() , key.firstElement().fieldName() ) || ! e.isNumber() || e.number() == 0 )
+                return 0;
+            return e.number() > 0 ? 1 : -1;
+        }
+
         virtual void queryOp( Request& r ) {
             QueryMessage q( r.d() );
 
@@ -66,10 +229,17 @@ namespace mongo {
             ClusteredCursor * cursor = 0;
 
             BSONObj sort = query.getSort();
+            int keyOrder = _shardKeyOrder( info , sort );
+            if ( query.obj.hasField( "$min" ) || query.obj.hasField( "$max" ) || query.obj.hasField( "$hint" ) )
+                keyOrder = 0; // the ranges are read with modifiers of their own
+            vector< shared_ptr<ChunkRange> > ranges;
 
             if ( sort.isEmpty() ) {
                 cursor = new SerialServerClusteredCursor( servers , q );
             }
+            else if ( keyOrder && shards.size() > 1 && info->getRangesForQuery( query.getFilter() , ranges ) ) {
+                cursor = new ShardKeyOrderedCursor( q , info , ranges , keyOrder );
+            }
             else {
                 cursor = new ParallelSortClusteredCursor( servers , q , sort );
             }
@@ -125,8 +295,15 @@ namespace mongo {
             cursorCache.remove( id );
         }
 
+        /** the documents of an insert that go to one shard, and how many bytes of them each chunk gets */
+        struct InsertBatch {
+            vector<BSONObj> docs;
+            map<ChunkPtr,long> written;
+        };
+
         void _insert( Request& r , DbMessage& d, ChunkManagerPtr manager ) {
 
+            vector<BSONObj> pending;
             while ( d.moreJSObjs() ) {
                 BSONObj o = d.nextJsObj();
                 if ( ! manager->hasShardKey( o ) ) {
@@ -149,31 +326,54 @@ namespace mongo {
                 }
 
                 // Many operations benefit from having the shard key early in the object
-                o = manager->getShardKey().moveToFront(o);
+                pending.push_back( manager->getShardKey().moveToFront(o) );
+            }
 
-                bool gotThrough = false;
-                for ( int i=0; i<10; i++ ) {
-                    try {
-                        ChunkPtr c = manager->findChunk( o );
-                        log(4) << "  server:" << c->getShard().toString() << " " << o << endl;
-                        insert( c->getShard() , r.getns() , o );
+            // one message per shard rather than one per document.  inserts don't wait for a reply,
+            // so the messages to different shards overlap.  a shard whose version is stale keeps
+            // its documents pending, and they get grouped again with a fresh chunk manager
+            for ( int i=0; i<10 && ! pending.empty(); i++ ) {
+                map<Shard,InsertBatch> batches;
+                for ( unsigned j=0; j<pending.size(); j++ ) {
+                    ChunkPtr c = manager->findChunk( pending[j] );
+                    InsertBatch& b = batches[ c->getShard() ];
+                    b.docs.push_back( pending[j] );
+                    b.written[c] += pending[j].objsize();
+                }
+                pending.clear();
 
-                        r.gotInsert();
-                        if ( r.getClientInfo()->autoSplitOk() )
-                            c->splitIfShould( o.objsize() );
-                        gotThrough = true;
-                        break;
+                for ( map<Shard,InsertBatch>::iterator j=batches.begin(); j!=batches.end(); ++j ) {
+                    InsertBatch& b = j->second;
+                    try {
+                        log(4) << "  server:" << j->first.toString() << " " << b.docs.size() << " documents" << endl;
+                        // a shard would stop at its first error, where documents sent one at a time
+                        // went on past it, so the batch asks it to go on too
+                        insert( j->first , r.getns() , b.docs , InsertOption_ContinueOnError );
                     }
                     catch ( StaleConfigException& ) {
-                        log(1) << "retrying insert because of StaleConfigException: " << o << endl;
-                        r.reset();
-                        manager = r.getChunkManager();
+                        log(1) << "retrying insert of " << b.docs.size() << " documents to " << j->first.toString()
+                               << " because of StaleConfigException" << endl;
+                        pending.insert( pending.end() , b.docs.begin() , b.docs.end() );
+                        continue;
                     }
+
+                    for ( unsigned k=0; k<b.docs.size(); k++ )
+                        r.gotInsert();
+
+                    if ( r.getClientInfo()->autoSplitOk() ) {
+                        for ( map<ChunkPtr,long>::iterator k=b.written.begin(); k!=b.written.end(); ++k )
+                            k->first->splitIfShould( k->second );
+                    }
+                }
+
+                if ( ! pending.empty() ) {
+                    r.reset();
+                    manager = r.getChunkManager();
                     sleepmillis( i * 200 );
                 }
-                
-                assert( inShutdown() || gotThrough );
             }
+
+            assert( inShutdown() || pending.empty() );
         }
 
         void _update( Request& r , DbMessage& d, ChunkManagerPtr manager ) {
@@ -194,7 +394,7 @@ namespace mongo {
                         (manager->hasShardKey(toupdate) ||
                          (toupdate.firstElement().fieldName()[0] == '$' && manager->hasShardKey(query))));
 
-                BSONObj key = manager->getShardKey().extractKey(query);
+                BSONObj key = query.extractFields( manager->getShardKey().key() );
                 BSONForEach(e, key) {
                     uassert(13465, "shard key in upsert query must be an exact match", getGtLtOp(e) == BSONObj::Equality);
                 }
@@ -26,6 +26,10 @@ namespace mongo {
 
     int Scope::_numScopes = 0;
 
+    AtomicUInt Scope::_functionCacheHits;
+    AtomicUInt Scope::_functionCacheMisses;
+    AtomicUInt Scope::_functionCacheEvictions;
+
     Scope::Scope() : _localDBName("") , _loadedVersion(0) {
         _numScopes++;
     }
@@ -222,6 +226,16 @@ namespace mongo {
 
     }
 
+    /** fnv-1a, so that finding a cached function doesn't compare whole functions */
+    static unsigned long long codeHash( const char * code ) {
+        unsigned long long hash = 14695981039346656037ULL;
+        for ( const char * c = code; *c; c++ ) {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
     ScriptingFunction Scope::createFunction( const char * code ) {
         if ( code[0] == '/' && code [1] == '*' ) {
             code += 2;
@@ -233,12 +247,56 @@ namespace mongo {
                 code++;
             }
         }
-        map<string,ScriptingFunction>::iterator i = _cachedFunctions.find( code );
-        if ( i != _cachedFunctions.end() )
-            return i->second;
-        ScriptingFunction f = _createFunction( code );
-        _cachedFunctions[code] = f;
-        return f;
+
+        unsigned long long hash = codeHash( code );
+        map< unsigned long long , CachedFunctions::iterator >::iterator i = _cachedFunctionsByHash.find( hash );
+        if ( i != _cachedFunctionsByHash.end() ) {
+            CachedFunctions::iterator f = i->second;
+            if ( f->code == code ) {
+                _functionCacheHits++;
+                _cachedFunctions.splice( _cachedFunctions.begin() , _cachedFunctions , f );
+                return f->func;
+            }
+
+            // a collision, the newer one wins
+            if ( f->func )
+                _retiredFunctions.push_back( f->func );
+            _cachedFunctions.erase( f );
+            _cachedFunctionsByHash.erase( i );
+        }
+
+        _functionCacheMisses++;
+        CachedFunction f;
+        f.code = code;
+        f.func = _createFunction( code );
+        _cachedFunctions.push_front( f );
+        _cachedFunctionsByHash[hash] = _cachedFunctions.begin();
+
+        if ( _cachedFunctions.size() > MaxCachedFunctions ) {
+            CachedFunction& old = _cachedFunctions.back();
+            _cachedFunctionsByHash.erase( codeHash( old.code.c_str() ) );
+            if ( old.func )
+                _retiredFunctions.push_back( old.func );
+            _cachedFunctions.pop_back();
+            _functionCacheEvictions++;
+        }
+
+        return _cachedFunctions.front().func;
+    }
+
+    void Scope::releaseRetiredFunctions() {
+        for ( unsigned i=0; i<_retiredFunctions.size(); i++ )
+            _releaseFunction( _retiredFunctions[i] );
+        _retiredFunctions.clear();
+    }
+
+    void Scope::appendFunctionCacheStats( BSONObjBuilder& b ) {
+        unsigned hits = _functionCacheHits.get();
+        unsigned misses = _functionCacheMisses.get();
+        b.appendNumber( "hits" , (long long)hits );
+        b.appendNumber( "misses" , (long long)misses );
+        b.appendNumber( "evictions" , (long long)_functionCacheEvictions.get() );
+        b.append( "hitRatio" , hits + misses ? (double)hits / ( hits + misses ) : 0.0 );
     }
 
     typedef map< string , list<Scope*> > PoolToScopes;
@@ -267,6 +325,8 @@ namespace mongo {
                 delete s;
             }
             else {
+                // whoever used it is done with its functions
+                s->releaseRetiredFunctions();
                 l.push_back( s );
                 s->reset();
             }
@@ -86,6 +86,7 @@ namespace mongo {
         virtual void setString( const char *field , const char * val ) = 0;
         virtual void setObject( const char *field , const BSONObj& obj , bool readOnly=true ) = 0;
         virtual void setBoolean( const char *field , bool val ) = 0;
+        /** obj may be read until the next setThis, so pass an owned one if this can be kept longer */
         virtual void setThis( const BSONObj * obj ) = 0;
 
         virtual ScriptingFunction createFunction( const char * code );
@@ -147,17 +148,47 @@ namespace mongo {
             return _numScopes;
         }
 
+        /** hits, misses and evictions of the compiled function caches of all scopes */
+        static void appendFunctionCacheStats( BSONObjBuilder& b );
+
+        /**
+         * createFunction() keeps this many compiled functions per scope.  one it drops may still be held
+         * by a caller, so it stays valid until releaseRetiredFunctions()
+         */
+        enum { MaxCachedFunctions = 1000 };
+
+        /**
+         * frees the functions the cache has dropped.  only for when nothing holds a function of this
+         * scope any more, as when it goes back to its pool
+         */
+        void releaseRetiredFunctions();
+
         static void validateObjectIdString( const string &str );
 
     protected:
 
         virtual ScriptingFunction _createFunction( const char * code ) = 0;
 
+        /** frees what _createFunction() made, when the cache drops it */
+        virtual void _releaseFunction( ScriptingFunction func ) {}
+
         string _localDBName;
         long long _loadedVersion;
         set<string> _storedNames;
         static long long _lastVersion;
-        map<string,ScriptingFunction> _cachedFunctions;
+
+        struct CachedFunction {
+            string code;
+            ScriptingFunction func;
+        };
+        typedef list<CachedFunction> CachedFunctions; // most recently used first
+        CachedFunctions _cachedFunctions;
+        map< unsigned long long , CachedFunctions::iterator > _cachedFunctionsByHash;
+        vector<ScriptingFunction> _retiredFunctions; // dropped from the cache, not released yet
+
+        static AtomicUInt _functionCacheHits;
+        static AtomicUInt _functionCacheMisses;
+        static AtomicUInt _functionCacheEvictions;
 
         static int _numScopes;
     };
@@ -1363,6 +1363,14 @@ namespace mongo {
             return (ScriptingFunction)_convertor->compileFunction( code );
         }
 
+        void _releaseFunction( ScriptingFunction func ) {
+            smlock;
+            // compiled functions are kept alive by being properties of the global object
+            const char * name = JS_GetFunctionName( (JSFunction*)func );
+            if ( name && name[0] )
+                JS_DeleteProperty( _context , _global , name );
+        }
+
         struct TimeoutSpec {
             boost::posix_time::ptime start;
             boost::posix_time::time_duration timeout;
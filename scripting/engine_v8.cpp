@@ -178,7 +178,15 @@ namespace mongo {
         V8_SIMPLE_HEADER
         // Set() accepts a ReadOnly parameter, but this just prevents the field itself
         // from being overwritten and doesn't protect the object stored in 'field'.
-        _global->Set( v8::String::New( field ) , mongoToV8( obj, false, readOnly) );
+        if ( ! readOnly ) {
+            _global->Set( v8::String::New( field ) , mongoToV8( obj, false, readOnly) );
+            return;
+        }
+
+        // read only, so fields can be decoded as they are read. owned, as the object may outlive obj
+        v8::Handle<v8::Value> argv[1];
+        argv[0] = v8::External::New( createWrapperHolder( new BSONObj( obj.getOwned() ) , true , true ) );
+        _global->Set( v8::String::New( field ) , _wrapper->NewInstance( 1, argv ) );
     }
 
     int V8Scope::type( const char *field ) {
@@ -259,7 +267,7 @@ namespace mongo {
         return code[8] == ' ' || code[8] == '(';
     }
 
-    Local< v8::Function > V8Scope::__createFunction( const char * raw ) {
+    Local< v8::Function > V8Scope::__createFunction( const char * raw , int num ) {
         raw = jsSkipWhiteSpace( raw );
         string code = raw;
         if ( !hasFunctionIdentifier( code ) ) {
@@ -271,7 +279,8 @@ namespace mongo {
             code = "function(){ " + code + "}";
         }
 
-        int num = _funcs.size() + 1;
+        if ( ! num )
+            num = _funcs.size() + 1;
 
         string fn;
         {
@@ -304,26 +313,48 @@ namespace mongo {
 
     ScriptingFunction V8Scope::_createFunction( const char * raw ) {
         V8_SIMPLE_HEADER
-        Local< Value > ret = __createFunction( raw );
+        // a slot the cache released is taken again, so _funcs is only as big as what the cache keeps
+        int num = _freeFuncs.size() ? _freeFuncs.back() : _funcs.size() + 1;
+        Local< Value > ret = __createFunction( raw , num );
         if ( ret.IsEmpty() )
             return 0;
         Persistent<Value> f = Persistent< Value >::New( ret );
         uassert( 10232, "not a func" , f->IsFunction() );
-        int num = _funcs.size() + 1;
-        _funcs.push_back( f );
+        if ( num > (int)_funcs.size() ) {
+            _funcs.push_back( f );
+        }
+        else {
+            _freeFuncs.pop_back();
+            _funcs[num-1] = f;
+        }
         return num;
     }
 
+    void V8Scope::_releaseFunction( ScriptingFunction func ) {
+        V8_SIMPLE_HEADER
+        if ( _funcs[func-1].IsEmpty() )
+            return;
+        _funcs[func-1].Dispose();
+        _funcs[func-1].Clear();
+        _freeFuncs.push_back( func );
+
+        stringstream ss;
+        ss << "_funcs" << func;
+        _global->Delete( v8::String::New( ss.str().c_str() ) );
+    }
+
     void V8Scope::setThis( const BSONObj * obj ) {
         V8_SIMPLE_HEADER
+        _this.Dispose();
         if ( ! obj ) {
             _this = Persistent< v8::Object >::New( v8::Object::New() );
             return;
         }
 
-        //_this = mongoToV8( *obj );
+        // fields are decoded as they are read, and writes only change the wrapper.
+        // not copied: a caller that keeps this past the call, like jsMode mapReduce, passes an owned obj
         v8::Handle<v8::Value> argv[1];
-        argv[0] = v8::External::New( createWrapperHolder( obj , true , false ) );
+        argv[0] = v8::External::New( createWrapperHolder( new BSONObj( *obj ) , false , true ) );
         _this = Persistent< v8::Object >::New( _wrapper->NewInstance( 1, argv ) );
     }
 
@@ -337,6 +368,7 @@ namespace mongo {
 
     int V8Scope::invoke( ScriptingFunction func , const BSONObj& argsObject, int timeoutMs , bool ignoreReturn ) {
         V8_SIMPLE_HEADER
+        massert( 14063 , "function was released from the cache" , ! _funcs[func-1].IsEmpty() );
         Handle<Value> funcValue = _funcs[func-1];
 
         TryCatch try_catch;
@@ -60,7 +60,9 @@ namespace mongo {
         virtual void rename( const char * from , const char * to );
 
         virtual ScriptingFunction _createFunction( const char * code );
-        Local< v8::Function > __createFunction( const char * code );
+        virtual void _releaseFunction( ScriptingFunction func );
+        /** @param num the number of the _funcsN global it is kept in, by default the next */
+        Local< v8::Function > __createFunction( const char * code , int num = 0 );
         virtual int invoke( ScriptingFunction func , const BSONObj& args, int timeoutMs = 0 , bool ignoreReturn = false );
         virtual bool exec( const StringData& code , const string& name , bool printResult , bool reportError , bool assertOnError, int timeoutMs );
         virtual string getError() { return _error; }
@@ -85,6 +87,7 @@ namespace mongo {
 
         string _error;
         vector< Persistent<Value> > _funcs;
+        vector<ScriptingFunction> _freeFuncs; // released from _funcs, to be used again
         v8::Persistent<v8::Object> _this;
 
         v8::Persistent<v8::Function> _wrapper;
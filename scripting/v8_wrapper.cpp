@@ -556,6 +556,12 @@ namespace mongo {
 
     // --- object wrapper ---
 
+    /**
+     * backs a js object with a BSONObj, decoding a field only when it is first read.
+     * writes and deletes are kept here and never touch the BSONObj, so the object
+     * behaves like a copy while only paying for the fields that are used.
+     * fields keep their order, with new ones after them.
+     */
     class WrapperHolder {
     public:
         WrapperHolder( const BSONObj * o , bool readOnly , bool iDelete )
@@ -563,44 +569,124 @@ namespace mongo {
         }
 
         ~WrapperHolder() {
+            for ( map< string , Persistent<Value> >::iterator i=_fields.begin(); i!=_fields.end(); ++i )
+                i->second.Dispose();
             if ( _o && _iDelete ) {
                 delete _o;
             }
             _o = 0;
         }
 
+        /** @return empty if there is no such field, so that v8 looks at the prototype */
         v8::Handle<v8::Value> get( v8::Local<v8::String> name ) {
             const string& s = toSTLString( name );
+
+            map< string , Persistent<Value> >::iterator i = _fields.find( s );
+            if ( i != _fields.end() )
+                return i->second;
+
+            if ( _removed.count( s ) )
+                return v8::Handle<v8::Value>();
+
             const BSONElement& e = _o->getField( s );
-            return mongoToV8Element(e);
+            if ( e.eoo() )
+                return v8::Handle<v8::Value>();
+
+            Local<Value> v;
+            if ( e.type() == mongo::Object || e.type() == mongo::Array )
+                v = mongoToV8( e.embeddedObject() , e.type() == mongo::Array , _readOnly );
+            else
+                v = Local<Value>::New( mongoToV8Element( e ) );
+
+            // cached, so changes to a sub object stick
+            _fields[s] = Persistent<Value>::New( v );
+            return v;
+        }
+
+        void set( v8::Local<v8::String> name , v8::Local<v8::Value> value ) {
+            const string& s = toSTLString( name );
+
+            map< string , Persistent<Value> >::iterator i = _fields.find( s );
+            if ( i != _fields.end() ) {
+                i->second.Dispose();
+                _fields.erase( i );
+            }
+            else if ( _removed.count( s ) || _o->getField( s ).eoo() ) {
+                _added.push_back( s );
+            }
+            _removed.erase( s );
+
+            _fields[s] = Persistent<Value>::New( value );
+        }
+
+        void remove( v8::Local<v8::String> name ) {
+            const string& s = toSTLString( name );
+
+            map< string , Persistent<Value> >::iterator i = _fields.find( s );
+            if ( i != _fields.end() ) {
+                i->second.Dispose();
+                _fields.erase( i );
+            }
+
+            vector<string>::iterator j = find( _added.begin() , _added.end() , s );
+            if ( j != _added.end() )
+                _added.erase( j );
+            else
+                _removed.insert( s );
+        }
+
+        v8::Handle<v8::Array> names() {
+            vector<string> all;
+            for ( BSONObjIterator i( *_o ); i.more(); ) {
+                const char * f = i.next().fieldName();
+                if ( ! _removed.count( f ) )
+                    all.push_back( f );
+            }
+            all.insert( all.end() , _added.begin() , _added.end() );
+
+            v8::Local<v8::Array> a = v8::Array::New( all.size() );
+            for ( unsigned i=0; i<all.size(); i++ )
+                a->Set( v8::Integer::New( i ) , v8::String::New( all[i].c_str() ) );
+            return a;
         }
 
         const BSONObj * _o;
         bool _readOnly;
         bool _iDelete;
+
+    private:
+        map< string , Persistent<Value> > _fields; // read or written so far
+        set<string> _removed; // fields of _o that were deleted
+        vector<string> _added; // fields that aren't in _o, in the order they were set
     };
 
     WrapperHolder * createWrapperHolder( const BSONObj * o , bool readOnly , bool iDelete ) {
         return new WrapperHolder( o , readOnly , iDelete );
     }
 
-#define WRAPPER_STRING (v8::String::New( "_wrapper" ) )
-
     WrapperHolder * getWrapper( v8::Handle<v8::Object> o ) {
-        Handle<v8::Value> t = o->GetRealNamedProperty( WRAPPER_STRING );
-        assert( t->IsExternal() );
-        Local<External> c = External::Cast( *t );
+        Local<External> c = External::Cast( *o->GetInternalField( 0 ) );
         WrapperHolder * w = (WrapperHolder*)(c->Value());
         assert( w );
         return w;
     }
 
+    static void wrapperGone( v8::Persistent<v8::Value> object , void * holder ) {
+        delete (WrapperHolder*)holder;
+        object.Dispose();
+        object.Clear();
+    }
 
     Handle<Value> wrapperCons(const Arguments& args) {
         if ( ! ( args.Length() == 1 && args[0]->IsExternal() ) )
             return v8::ThrowException( v8::String::New( "wrapperCons needs 1 External arg" ) );
 
-        args.This()->Set( WRAPPER_STRING , args[0] );
+        // an internal field, so it isn't one of the object's properties
+        args.This()->SetInternalField( 0 , args[0] );
+
+        // the holder goes when the object does
+        Persistent<v8::Object> self = Persistent<v8::Object>::New( args.This() );
+        self.MakeWeak( External::Cast( *args[0] )->Value() , wrapperGone );
 
         return v8::Undefined();
     }
@@ -609,9 +695,31 @@ namespace mongo {
         return getWrapper( info.This() )->get( name );
     }
 
+    v8::Handle<v8::Value> wrapperSetHandler( v8::Local<v8::String> name, v8::Local<v8::Value> value, const v8::AccessorInfo &info ) {
+        WrapperHolder * w = getWrapper( info.This() );
+        if ( w->_readOnly )
+            return NamedReadOnlySet( name , value , info );
+        w->set( name , value );
+        return value;
+    }
+
+    v8::Handle<v8::Boolean> wrapperDeleteHandler( v8::Local<v8::String> name, const v8::AccessorInfo &info ) {
+        WrapperHolder * w = getWrapper( info.This() );
+        if ( w->_readOnly )
+            return NamedReadOnlyDelete( name , info );
+        w->remove( name );
+        return v8::True();
+    }
+
+    v8::Handle<v8::Array> wrapperEnumHandler( const v8::AccessorInfo &info ) {
+        return getWrapper( info.This() )->names();
+    }
+
     v8::Handle<v8::FunctionTemplate> getObjectWrapperTemplate() {
         v8::Local<v8::FunctionTemplate> t = newV8Function< wrapperCons >();
-        t->InstanceTemplate()->SetNamedPropertyHandler( wrapperGetHandler );
+        t->InstanceTemplate()->SetInternalFieldCount( 1 );
+        t->InstanceTemplate()->SetNamedPropertyHandler( wrapperGetHandler , wrapperSetHandler , 0 ,
+                                                        wrapperDeleteHandler , wrapperEnumHandler );
         return t;
     }
 
@@ -502,6 +502,8 @@ again:
             //log() << "got response: " << response.data->responseTo << endl;
             if ( response.header()->responseTo == toSend.header()->id )
                 break;
+            if ( _keepReply( response ) )
+                continue;
             error() << "MessagingPort::call() wrong id got:" << hex << (unsigned)response.header()->responseTo << " expect:" << (unsigned)toSend.header()->id << '\n'
                     << dec
                     << "  toSend op: " << (unsigned)toSend.operation() << '\n'
@@ -691,6 +693,58 @@ again:
         piggyBackData->append( toSend );
     }
 
+    void MessagingPort::expectReply( MSGID id ) {
+        _replies[ id.get() ];
+    }
+
+    bool MessagingPort::getReply( MSGID id , Message& response ) {
+        map< unsigned , shared_ptr<Message> >::iterator i = _replies.find( id.get() );
+        if ( i == _replies.end() )
+            return false;
+
+        // it may not even be sent yet
+        if ( ! i->second && piggyBackData )
+            piggyBackData->flush();
+
+        while ( ! i->second ) {
+            Message m;
+            if ( ! recv( m ) || ! _keepReply( m ) ) {
+                _replies.erase( i );
+                return false;
+            }
+        }
+
+        response = *i->second;
+        _replies.erase( i );
+        return true;
+    }
+
+    void MessagingPort::forgetReply( MSGID id ) {
+        map< unsigned , shared_ptr<Message> >::iterator i = _replies.find( id.get() );
+        if ( i == _replies.end() )
+            return;
+        if ( ! i->second )
+            _forgottenReplies.insert( id.get() );
+        _replies.erase( i );
+    }
+
+    bool MessagingPort::_keepReply( Message& response ) {
+        unsigned id = response.header()->responseTo.get();
+
+        if ( _forgottenReplies.erase( id ) ) {
+            response.reset();
+            return true;
+        }
+
+        map< unsigned , shared_ptr<Message> >::iterator i = _replies.find( id );
+        if ( i == _replies.end() || i->second )
+            return false;
+
+        i->second.reset( new Message() );
+        *i->second = response;
+        return true;
+    }
+
     unsigned MessagingPort::remotePort() const {
         return farEnd.getPort();
     }
@@ -129,6 +129,21 @@ namespace mongo {
 
         void piggyBack( Message& toSend , int responseTo = -1 );
 
+        /**
+         * for a message sent with say() or piggyBack() whose reply is to be read later on, rather than right away.
+         * recv( sent , response ) keeps a reply to 'id' it comes across for getReply(), instead of failing on it.
+         */
+        void expectReply( MSGID id );
+
+        /**
+         * waits for the reply to 'id' unless it has come in already
+         * @return false if it was never expected on this port, or the connection failed
+         */
+        bool getReply( MSGID id , Message& response );
+
+        /** the reply to 'id' is no longer wanted.  it is dropped now, or when it comes in */
+        void forgetReply( MSGID id );
+
         virtual unsigned remotePort() const;
         virtual HostAndPort remote() const;
 
@@ -148,6 +163,13 @@ namespace mongo {
         int sock;
         PiggyBackData * piggyBackData;
 
+        /** @return true if 'response' is a reply that expectReply() asked to keep or forgetReply() to drop */
+        bool _keepReply( Message& response );
+
+        // replies from expectReply(), by id.  null until they come in
+        map< unsigned , shared_ptr<Message> > _replies;
+        set< unsigned > _forgottenReplies;
+
         long long _bytesIn;
         long long _bytesOut;
         